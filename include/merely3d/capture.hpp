@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace merely3d
+{
+    /// The format of the image files written by a capture (see CaptureTarget::image_files).
+    enum class CaptureFormat
+    {
+        /// Uncompressed PNG images, which are quick to write and readable by any image viewer or encoder.
+        /// The image data is stored rather than compressed, so every file takes about 3 bytes per pixel,
+        /// like a Raw file, and may be recompressed by any PNG optimizer.
+        Png,
+        /// The bare RGB bytes of the image, 8 bits per channel, top row first and without any header.
+        Raw
+    };
+
+    /// Where the frames captured from a window are written to (see Window::start_capture).
+    class CaptureTarget
+    {
+    public:
+        /// Writes each frame to an image file of its own. The name of the file is given by the pattern,
+        /// in which the last run of '#' characters is replaced by the zero-padded index of the frame,
+        /// e.g. "frames/frame_#####.png". The directory must exist.
+        ///
+        /// PNG files are written without compression (see CaptureFormat::Png), so that writing keeps up
+        /// with rendering, and a capture of 1920 x 1080 pixels takes about 6 MB per frame.
+        ///
+        /// Throws std::invalid_argument if the pattern does not contain '#'.
+        static CaptureTarget image_files(std::string pattern, CaptureFormat format = CaptureFormat::Png)
+        {
+            if (pattern.find('#') == std::string::npos)
+            {
+                throw std::invalid_argument("The file name pattern must contain '#'.");
+            }
+            return CaptureTarget(Kind::ImageFiles, std::move(pattern), format);
+        }
+
+        /// Streams the frames into the standard input of the given shell command, as the bare RGB bytes of each
+        /// frame, 8 bits per channel and top row first. This is the rawvideo format with the rgb24 pixel format
+        /// understood by encoders such as FFmpeg, e.g.
+        ///
+        ///     ffmpeg -f rawvideo -pix_fmt rgb24 -s 1920x1080 -r 60 -i - video.mp4
+        ///
+        /// The size of the stream is that of the first frame, and frames of any other size are skipped,
+        /// so the window should not be resized while capturing.
+        static CaptureTarget pipe(std::string command)
+        {
+            return CaptureTarget(Kind::Pipe, std::move(command), CaptureFormat::Raw);
+        }
+
+        bool is_pipe() const { return _kind == Kind::Pipe; }
+
+        /// The file name pattern or the command, depending on the kind of target.
+        const std::string & destination() const { return _destination; }
+
+        CaptureFormat format() const { return _format; }
+
+    private:
+        enum class Kind
+        {
+            ImageFiles,
+            Pipe
+        };
+
+        CaptureTarget(Kind kind, std::string destination, CaptureFormat format)
+            : _kind(kind), _destination(std::move(destination)), _format(format)
+        {}
+
+        Kind            _kind;
+        std::string     _destination;
+        CaptureFormat   _format;
+    };
+
+    /// A single image which is rendered in tiles into a PNG file (see Window::render_tiled), so that its size
+    /// is limited neither by the maximum size of framebuffers nor by the memory of the GPU, e.g. for figures
+    /// of 16384 x 16384 pixels or more.
+    ///
+    /// Each tile is rendered with a projection that covers its part of the image only, and the image is written
+    /// one row of tiles at a time, so only a single row of tiles is ever held in memory. Like the PNG files
+    /// of a capture, the file is not compressed (see CaptureFormat::Png).
+    class TiledImage
+    {
+    public:
+        /// The default size of the (square) tiles, in pixels.
+        static const int DEFAULT_TILE_SIZE = 1024;
+
+        /// The default margin of the tiles, in pixels (see with_tile_margin).
+        static const int DEFAULT_TILE_MARGIN = 32;
+
+        /// Describes an image of the given size, in pixels, which is written to the given PNG file.
+        ///
+        /// Throws std::invalid_argument if the width or height is not positive.
+        TiledImage(std::string file_name, int width, int height)
+            : _file_name(std::move(file_name)),
+              _width(width),
+              _height(height),
+              _tile_size(DEFAULT_TILE_SIZE),
+              _tile_margin(DEFAULT_TILE_MARGIN)
+        {
+            if (width <= 0 || height <= 0)
+            {
+                throw std::invalid_argument("The size of the image must be positive.");
+            }
+        }
+
+        /// Sets the size of the tiles, which is rounded down to a multiple of 4 pixels, so that reduced
+        /// resolution particles line up across tiles. Larger tiles render faster, but a row of tiles takes
+        /// `3 * width * tile_size` bytes of memory. Tiles are made smaller if a tile and its margins
+        /// would exceed the largest framebuffer supported.
+        ///
+        /// Throws std::invalid_argument if the size is less than 4 pixels.
+        TiledImage with_tile_size(int tile_size) const
+        {
+            if (tile_size < 4)
+            {
+                throw std::invalid_argument("The tile size must be at least 4 pixels.");
+            }
+            auto result = *this;
+            result._tile_size = tile_size - tile_size % 4;
+            return result;
+        }
+
+        /// Sets the margin by which each tile is extended into its neighbors while rendering, which is rounded up
+        /// to a multiple of 4 pixels. Only the tile itself is kept, but everything that reaches into it from
+        /// the margin is drawn, such as density splats of particles whose centers lie in a neighboring tile,
+        /// which are otherwise clipped. Splats with a radius larger than the margin may show seams between tiles.
+        ///
+        /// Throws std::invalid_argument if the margin is negative.
+        TiledImage with_tile_margin(int margin) const
+        {
+            if (margin < 0)
+            {
+                throw std::invalid_argument("The tile margin must not be negative.");
+            }
+            auto result = *this;
+            result._tile_margin = (margin + 3) / 4 * 4;
+            return result;
+        }
+
+        const std::string & file_name() const { return _file_name; }
+        int width() const { return _width; }
+        int height() const { return _height; }
+        int tile_size() const { return _tile_size; }
+        int tile_margin() const { return _tile_margin; }
+
+    private:
+        std::string     _file_name;
+        int             _width;
+        int             _height;
+        int             _tile_size;
+        int             _tile_margin;
+    };
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <merely3d/color.hpp>
+
+namespace merely3d
+{
+    /// Built-in colormaps, used to map scalar values to colors.
+    ///
+    /// With the exception of Grayscale, these are the perceptually uniform
+    /// colormaps from matplotlib.
+    enum class Colormap
+    {
+        Viridis,
+        Plasma,
+        Magma,
+        Inferno,
+        Grayscale
+    };
+
+    /// Evaluates the given colormap at t, where t is clamped to the interval [0, 1].
+    Color evaluate_colormap(Colormap colormap, float t);
+}
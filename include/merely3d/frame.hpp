@@ -9,10 +9,13 @@
 #include <merely3d/primitives.hpp>
 #include <merely3d/renderable.hpp>
 #include <merely3d/mesh.hpp>
+#include <merely3d/particle_options.hpp>
+#include <merely3d/particle_set.hpp>
 
 namespace merely3d
 {
     class CommandBuffer;
+    class MeshRegistry;
 
     class Frame
     {
@@ -26,17 +29,40 @@ namespace merely3d
 
         void draw_particle(const Particle & particle);
 
+        void draw_particle(const ScalarParticle & particle);
+
+        /// Draws a persistent set of particles. Only the particles that were updated
+        /// since the set was last drawn are transferred to the GPU.
+        void draw_particles(const ParticleSet & particles);
+
+        /// Sets the options used for rendering the particles of this frame.
+        void set_particle_options(const ParticleOptions & options);
+
+        /// Blends the transforms (position, orientation and scale) of the boxes, rectangles, spheres and meshes
+        /// of this frame between their previous (0) and their current (1) snapshot, which is the default.
+        ///
+        /// A new snapshot starts whenever the objects drawn differ from those of the last frame, in which case
+        /// the objects of the last frame become the previous snapshot. The blending happens on the GPU, so
+        /// a simulation running at a lower rate than the display can be rendered smoothly by drawing the same
+        /// objects in every frame between two simulation steps, and only varying the interpolation.
+        /// Objects are matched to their previous snapshot by the order in which they are drawn, and objects
+        /// of scenes that have not changed for a while (see Scene) are always drawn at their current transform.
+        /// Particle sets are blended by ParticleOptions::interpolation instead.
+        void set_interpolation(float interpolation);
+
         /// Returns the number of seconds since the beginning of the previous frame.
         double time_since_prev_frame() const;
 
     private:
-        Frame(CommandBuffer * buffer, double delta_elapsed_time)
-            : _buffer(buffer), _delta_time(delta_elapsed_time) {}
-        Frame(Frame && frame) : _buffer(frame._buffer), _delta_time(frame._delta_time) {}
+        Frame(CommandBuffer * buffer, const MeshRegistry * meshes, double delta_elapsed_time)
+            : _buffer(buffer), _meshes(meshes), _delta_time(delta_elapsed_time) {}
+        Frame(Frame && frame) : _buffer(frame._buffer), _meshes(frame._meshes), _delta_time(frame._delta_time) {}
         ~Frame() {}
         friend class Window;
+        friend class WindowGroup;
 
         CommandBuffer * _buffer;
+        const MeshRegistry * _meshes;
         double _delta_time;
     };
 
@@ -52,6 +78,12 @@ namespace merely3d
     template <>
     void Frame::draw(const merely3d::Renderable<StaticMesh> & mesh);
 
+    /// Draws a mesh registered with the window through Window::register_mesh.
+    ///
+    /// Throws std::invalid_argument if the handle does not refer to a mesh registered with the window.
+    template <>
+    void Frame::draw(const merely3d::Renderable<MeshHandle> & mesh);
+
     template <typename Shape>
     void Frame::draw(const merely3d::Renderable<Shape> &renderable)
     {
@@ -10,7 +10,12 @@ namespace merely3d
     {
         Material() : color(DEFAULT_MATERIAL_COLOR),
                      wireframe(false),
-                     pattern_grid_size(0.5f) {}
+                     pattern_grid_size(0.5f),
+                     specular_strength(0.5f),
+                     unlit(false),
+                     edges(false),
+                     edge_color(0.0, 0.0, 0.0),
+                     edge_width(1.0f) {}
 
         Color color;
 
@@ -22,6 +27,22 @@ namespace merely3d
         // Set to 0.0f to disable patterned rendering.
         float pattern_grid_size;
 
+        // The strength of the specular highlights. Set to 0.0f to disable specular highlights.
+        float specular_strength;
+
+        // Whether to render this entity in the plain color of the material (and pattern),
+        // without any lighting.
+        bool unlit;
+
+        // Whether to draw the edges of the triangles on top of the shaded surface.
+        // Wireframes consist of nothing but the edges, which are drawn in the color of the material.
+        bool edges;
+
+        Color edge_color;
+
+        // The width of the edges, and of the lines of wireframes, in pixels.
+        float edge_width;
+
         Material with_color(const Color & color) const
         {
             auto result = *this;
@@ -42,5 +63,40 @@ namespace merely3d
             result.pattern_grid_size = size;
             return result;
         }
+
+        Material with_specular_strength(float strength) const
+        {
+            auto result = *this;
+            result.specular_strength = strength;
+            return result;
+        }
+
+        Material with_unlit(bool unlit) const
+        {
+            auto result = *this;
+            result.unlit = unlit;
+            return result;
+        }
+
+        Material with_edges(bool edges) const
+        {
+            auto result = *this;
+            result.edges = edges;
+            return result;
+        }
+
+        Material with_edge_color(const Color & color) const
+        {
+            auto result = *this;
+            result.edge_color = color;
+            return result;
+        }
+
+        Material with_edge_width(float width) const
+        {
+            auto result = *this;
+            result.edge_width = width;
+            return result;
+        }
     };
 }
@@ -4,10 +4,16 @@
 
 #include <merely3d/app.hpp>
 #include <merely3d/camera_controller.hpp>
+#include <merely3d/capture.hpp>
 #include <merely3d/color.hpp>
+#include <merely3d/colormap.hpp>
 #include <merely3d/events.hpp>
 #include <merely3d/frame.hpp>
+#include <merely3d/particle_options.hpp>
+#include <merely3d/particle_set.hpp>
 #include <merely3d/primitives.hpp>
 #include <merely3d/renderable.hpp>
+#include <merely3d/scene.hpp>
 #include <merely3d/types.hpp>
 #include <merely3d/window.hpp>
+#include <merely3d/window_group.hpp>
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <memory>
 
@@ -11,8 +13,8 @@ namespace merely3d
 
         inline UniqueMeshId next_mesh_id()
         {
-            // TODO: Make atomic
-            static UniqueMeshId next_id = 0;
+            // Meshes may be created on several threads, e.g. while recording the frames of a WindowGroup
+            static std::atomic<UniqueMeshId> next_id(0);
             return next_id++;
         }
 
@@ -61,6 +63,26 @@ namespace merely3d
         std::shared_ptr<const detail::StaticMeshData> _data;
 
         friend class MeshRenderer;
+        friend class MeshRegistry;
+        friend class Scene;
+    };
+
+    /**
+     * Refers to a static mesh registered with a Window (see Window::register_mesh).
+     *
+     * Drawing a Renderable<MeshHandle> is cheaper than drawing a Renderable<StaticMesh>, since only
+     * the index of the mesh is submitted with the draw, rather than a reference to the mesh data.
+     * Handles are never reused, even after the mesh has been unregistered.
+     */
+    struct MeshHandle
+    {
+        MeshHandle() : index(UINT32_MAX) {}
+        explicit MeshHandle(uint32_t index) : index(index) {}
+
+        uint32_t index;
+
+        bool operator==(const MeshHandle & other) const { return index == other.index; }
+        bool operator!=(const MeshHandle & other) const { return index != other.index; }
     };
 
 }
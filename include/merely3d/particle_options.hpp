@@ -0,0 +1,136 @@
+#pragma once
+
+#include <merely3d/colormap.hpp>
+
+namespace merely3d
+{
+    enum class ParticleRenderMode
+    {
+        /// Particles are rendered as lit, depth-tested spheres.
+        Spheres,
+        /// Particles are splatted additively into an offscreen density buffer without depth testing,
+        /// which is subsequently mapped to colors by a colormap. Much cheaper than Spheres
+        /// for very large numbers of particles, but particle colors and occlusion are ignored.
+        Density
+    };
+
+    /// The resolution at which particles are rendered, relative to the resolution of the window.
+    enum class ParticleResolution
+    {
+        Full,
+        Half,
+        Quarter
+    };
+
+    /// Options that control how the particles of a frame are rendered.
+    ///
+    /// Options are set per frame through Frame::set_particle_options,
+    /// and are reset to their defaults at the start of every frame.
+    struct ParticleOptions
+    {
+        ParticleOptions() : spatial_sorting(false),
+                            render_mode(ParticleRenderMode::Spheres),
+                            density_colormap(Colormap::Inferno),
+                            density_exposure(0.1f),
+                            resolution(ParticleResolution::Full),
+                            scalar_colormap(Colormap::Viridis),
+                            scalar_min(0.0f),
+                            scalar_max(1.0f),
+                            interpolation(1.0f) {}
+
+        // Whether or not to reorder particles along a Morton (Z-order) curve before rendering.
+        // This improves memory and depth buffer locality, and makes it possible to cull
+        // chunks of particles that are outside of the view and to only upload
+        // chunks of particles that changed since the previous frame. The sorting itself
+        // costs CPU time, so this is mostly beneficial for large numbers of particles.
+        bool spatial_sorting;
+
+        ParticleRenderMode render_mode;
+
+        // The colormap used to map density to color in the Density render mode.
+        Colormap density_colormap;
+
+        // Scales the accumulated density before tone mapping in the Density render mode.
+        // The accumulated density d of a pixel is mapped to the colormap by 1 - exp(-exposure * d),
+        // where a single particle fully covering a pixel contributes 1 to d.
+        float density_exposure;
+
+        // Particles may be rendered to an offscreen buffer at reduced resolution, which is then
+        // upsampled and composited on top of the rest of the scene (which is always rendered at full resolution).
+        // This greatly reduces the cost of shading particles when they cover large parts of the screen,
+        // at the cost of slightly blurrier particles.
+        ParticleResolution resolution;
+
+        // The colormap used to color scalar particles (see ScalarParticle). Scalars are mapped
+        // linearly from [scalar_min, scalar_max] to the colormap, and clamped outside of this range.
+        // Since the lookup happens on the GPU, changing the colormap or range does not require
+        // the particles to be uploaded again.
+        Colormap scalar_colormap;
+        float scalar_min;
+        float scalar_max;
+
+        // Blends the positions of particle sets (see ParticleSet) between their previous
+        // snapshot (0) and their current snapshot (1). The blending happens on the GPU, so a simulation
+        // running at a lower rate than the display can be rendered smoothly by only varying this factor
+        // between snapshots, without submitting or uploading any particle data. The transforms of other objects
+        // are blended by Frame::set_interpolation.
+        float interpolation;
+
+        ParticleOptions with_spatial_sorting(bool enable) const
+        {
+            auto result = *this;
+            result.spatial_sorting = enable;
+            return result;
+        }
+
+        ParticleOptions with_render_mode(ParticleRenderMode mode) const
+        {
+            auto result = *this;
+            result.render_mode = mode;
+            return result;
+        }
+
+        ParticleOptions with_density_colormap(Colormap colormap) const
+        {
+            auto result = *this;
+            result.density_colormap = colormap;
+            return result;
+        }
+
+        ParticleOptions with_density_exposure(float exposure) const
+        {
+            auto result = *this;
+            result.density_exposure = exposure;
+            return result;
+        }
+
+        ParticleOptions with_resolution(ParticleResolution resolution) const
+        {
+            auto result = *this;
+            result.resolution = resolution;
+            return result;
+        }
+
+        ParticleOptions with_scalar_colormap(Colormap colormap) const
+        {
+            auto result = *this;
+            result.scalar_colormap = colormap;
+            return result;
+        }
+
+        ParticleOptions with_scalar_range(float min, float max) const
+        {
+            auto result = *this;
+            result.scalar_min = min;
+            result.scalar_max = max;
+            return result;
+        }
+
+        ParticleOptions with_interpolation(float t) const
+        {
+            auto result = *this;
+            result.interpolation = t;
+            return result;
+        }
+    };
+}
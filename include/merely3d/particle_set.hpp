@@ -0,0 +1,66 @@
+#pragma once
+
+#include <merely3d/primitives.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace merely3d
+{
+    namespace detail
+    {
+        struct ParticleSetData;
+    }
+
+    /**
+     * A persistent set of particles, whose data is retained on the GPU between frames.
+     *
+     * Unlike particles drawn with Frame::draw_particle, which are uploaded in their entirety on every frame,
+     * a particle set keeps track of which particles have been modified through update() since it was last
+     * rendered, and only those particles are transferred to the GPU. This holds for every window that draws
+     * the set, and a set may be modified while windows of a WindowGroup render it. This makes particle sets well suited
+     * for large simulations in which only a fraction of the particles move at any given time.
+     *
+     * Like StaticMesh, copies of a ParticleSet refer to the same underlying particles.
+     * Hand the set to Frame::draw_particles() on every frame to render it.
+     *
+     * Particle sets are rendered in the order in which they are stored, and are therefore
+     * not affected by ParticleOptions::spatial_sorting.
+     *
+     * The GPU also retains the previous snapshot of the set: every frame in which the set is drawn after
+     * having been modified starts a new snapshot, and the state drawn before it becomes the previous snapshot.
+     * Frames in between may blend the two with ParticleOptions::with_interpolation at no CPU cost.
+     */
+    class ParticleSet
+    {
+    public:
+        /// Creates an empty particle set.
+        ParticleSet();
+
+        explicit ParticleSet(const std::vector<Particle> & particles);
+
+        /// Returns the number of particles in the set.
+        size_t size() const;
+
+        /// Resizes the set. New particles are default-constructed.
+        void resize(size_t num_particles);
+
+        /// Overwrites `count` particles starting at index `first`.
+        ///
+        /// Throws std::out_of_range if the updated particles do not fit in the set.
+        void update(size_t first, const Particle * particles, size_t count);
+
+        /// Overwrites particles starting at index `first` with the given particles.
+        ///
+        /// Throws std::out_of_range if the updated particles do not fit in the set.
+        void update(size_t first, const std::vector<Particle> & particles);
+
+    private:
+        // Allocate the data on the heap, so that the renderer can track it
+        // even if the user chooses to move the ParticleSet instance.
+        std::shared_ptr<detail::ParticleSetData> _data;
+
+        friend class ParticleRenderer;
+    };
+}
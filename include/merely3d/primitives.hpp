@@ -84,4 +84,45 @@ namespace merely3d
             return Particle(position, radius, new_color);
         }
     };
+
+    /// A particle whose color is determined by mapping a scalar value (e.g. pressure or speed)
+    /// through a colormap on the GPU (see ParticleOptions::with_scalar_colormap and
+    /// ParticleOptions::with_scalar_range).
+    struct ScalarParticle
+    {
+        ScalarParticle() : ScalarParticle(Eigen::Vector3f::Zero()) {}
+        ScalarParticle(const Eigen::Vector3f & position,
+                       float radius = DEFAULT_PARTICLE_RADIUS,
+                       float scalar = 0.0f)
+            : position(position), scalar(scalar), radius(radius) {}
+        ScalarParticle(float x, float y, float z,
+                       float radius = DEFAULT_PARTICLE_RADIUS,
+                       float scalar = 0.0f)
+            : ScalarParticle(Eigen::Vector3f(x, y, z), radius, scalar)
+        {}
+
+        Eigen::Vector3f position;
+        float           scalar;
+        float           radius;
+
+        ScalarParticle with_radius(float new_radius) const
+        {
+            return ScalarParticle(position, new_radius, scalar);
+        }
+
+        ScalarParticle with_position(const Eigen::Vector3f & new_position) const
+        {
+            return ScalarParticle(new_position, radius, scalar);
+        }
+
+        ScalarParticle with_position(float x, float y, float z) const
+        {
+            return ScalarParticle(x, y, z, radius, scalar);
+        }
+
+        ScalarParticle with_scalar(float new_scalar) const
+        {
+            return ScalarParticle(position, radius, new_scalar);
+        }
+    };
 }
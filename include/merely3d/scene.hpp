@@ -0,0 +1,144 @@
+#pragma once
+
+#include <merely3d/material.hpp>
+#include <merely3d/primitives.hpp>
+#include <merely3d/renderable.hpp>
+#include <merely3d/mesh.hpp>
+
+#include <Eigen/Dense>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace merely3d
+{
+    namespace detail
+    {
+        class SceneData;
+    }
+
+    /// Refers to an object in a Scene.
+    ///
+    /// A handle is invalidated when its object is removed from the scene,
+    /// and is never reused for a different object.
+    /// Default-constructed handles do not refer to any object.
+    struct SceneHandle
+    {
+        SceneHandle() : index(0), generation(0) {}
+
+        uint32_t index;
+        uint32_t generation;
+
+        bool operator==(const SceneHandle & other) const
+        {
+            return index == other.index && generation == other.generation;
+        }
+
+        bool operator!=(const SceneHandle & other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    /// Refers to a node of the transform hierarchy of a Scene.
+    ///
+    /// Like SceneHandle, a node handle is never reused after its node has been removed.
+    /// Default-constructed node handles refer to the world frame itself.
+    struct NodeHandle
+    {
+        NodeHandle() : index(0), generation(0) {}
+
+        uint32_t index;
+        uint32_t generation;
+
+        bool operator==(const NodeHandle & other) const
+        {
+            return index == other.index && generation == other.generation;
+        }
+
+        bool operator!=(const NodeHandle & other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * A retained collection of objects that are rendered on every frame of the window that owns it.
+     *
+     * Unlike objects drawn with Frame::draw, which must be submitted on every frame, objects added
+     * to the scene remain until they are removed. The scene keeps track of which objects have changed
+     * since the last frame, and only those are transferred to the GPU. This makes the scene well suited
+     * for large numbers of mostly static objects.
+     *
+     * Objects drawn with Frame::draw are rendered together with the objects in the scene.
+     *
+     * Objects may be attached to the nodes of a transform hierarchy, in which case their position and
+     * orientation are given relative to the node. Every node has a rigid transform (position and orientation)
+     * relative to its parent node. When the transform of a node changes, the world transforms of the node,
+     * its descendants and their attached objects are recomputed once before the next frame is rendered,
+     * so moving a single node moves an entire articulated model.
+     *
+     * Functions taking a handle throw std::invalid_argument if the handle
+     * does not refer to an object or node in the scene.
+     */
+    class Scene final
+    {
+    public:
+        Scene();
+        Scene(Scene && other);
+        ~Scene();
+
+        Scene(const Scene & other) = delete;
+        Scene & operator=(const Scene & other) = delete;
+        Scene & operator=(Scene && other) = delete;
+
+        /// Adds an object to the scene, attached to the given node. The position and orientation
+        /// of the renderable are relative to the node.
+        SceneHandle add(const Renderable<Box> & renderable, NodeHandle node = NodeHandle());
+        SceneHandle add(const Renderable<Rectangle> & renderable, NodeHandle node = NodeHandle());
+        SceneHandle add(const Renderable<Sphere> & renderable, NodeHandle node = NodeHandle());
+        SceneHandle add(const Renderable<StaticMesh> & renderable, NodeHandle node = NodeHandle());
+
+        /// Sets the position and orientation of the object, relative to the node it is attached to.
+        void set_transform(SceneHandle handle,
+                           const Eigen::Vector3f & position,
+                           const Eigen::Quaternionf & orientation);
+
+        void set_scale(SceneHandle handle, const Eigen::Vector3f & scale);
+
+        void set_material(SceneHandle handle, const Material & material);
+
+        void remove(SceneHandle handle);
+
+        /// Returns whether the handle refers to an object in the scene.
+        bool contains(SceneHandle handle) const;
+
+        /// Adds a node to the transform hierarchy, whose position and orientation are relative to the parent node.
+        NodeHandle add_node(const Eigen::Vector3f & position,
+                            const Eigen::Quaternionf & orientation,
+                            NodeHandle parent = NodeHandle());
+
+        /// Sets the position and orientation of the node, relative to its parent node.
+        void set_node_transform(NodeHandle node,
+                                const Eigen::Vector3f & position,
+                                const Eigen::Quaternionf & orientation);
+
+        /// Removes the node, all of its descendants and all objects attached to any of them.
+        void remove_node(NodeHandle node);
+
+        /// Returns whether the handle refers to a node in the scene.
+        bool contains(NodeHandle node) const;
+
+        /// Returns the number of objects in the scene.
+        size_t size() const;
+
+        /// Removes all objects and nodes from the scene.
+        void clear();
+
+    private:
+        std::unique_ptr<detail::SceneData> _d;
+
+        friend class Window;
+    };
+}
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 
+#include <merely3d/capture.hpp>
 #include <merely3d/frame.hpp>
 #include <merely3d/camera.hpp>
 #include <merely3d/events.hpp>
+#include <merely3d/scene.hpp>
 
 struct GLFWwindow;
 
@@ -39,6 +42,16 @@ namespace merely3d
         ScreenCoords(double x, double y) : x(x), y(y) {}
     };
 
+    /// Statistics about the rendering of a single frame.
+    struct FrameStatistics
+    {
+        /// The number of OpenGL state changes (bound objects, enabled capabilities and so on) made.
+        size_t state_changes;
+
+        /// The number of requested state changes that were skipped, since they would not have changed anything.
+        size_t redundant_state_changes;
+    };
+
     class Window final
     {
     public:
@@ -58,9 +71,71 @@ namespace merely3d
             render_frame_impl(frame);
         }
 
+        /// Renders a single image of the size given by `image`, which may be far larger than the window, in tiles,
+        /// and writes it to the PNG file of `image` (see TiledImage). Like render_frame, the given function
+        /// records the commands of the frame, which are then rendered once for every tile, with the camera and
+        /// field of view of the window and the aspect ratio of the image. Nothing is shown in the window.
+        ///
+        /// Throws std::runtime_error if the file cannot be written.
+        template <typename RenderFunc>
+        void render_tiled(const TiledImage & image, RenderFunc && render_func)
+        {
+            make_current();
+            auto frame = begin_frame();
+            std::forward<RenderFunc>(render_func)(frame);
+            render_tiled_impl(image, frame);
+        }
+
         Camera & camera();
         const Camera & camera() const;
 
+        /// Returns the retained scene of the window, whose objects are rendered on every frame.
+        Scene & scene();
+        const Scene & scene() const;
+
+        /// Registers a mesh with the window, so that it can be drawn through the returned handle
+        /// (see MeshHandle). The window keeps the mesh alive until it is unregistered.
+        MeshHandle register_mesh(const StaticMesh & mesh);
+
+        /// Unregisters a mesh. Draws of the mesh that have already been submitted
+        /// in the current frame are skipped.
+        ///
+        /// Throws std::invalid_argument if the handle does not refer to a registered mesh.
+        void unregister_mesh(MeshHandle handle);
+
+        /// Enables or disables a depth-only pre-pass over opaque geometry, which is disabled by default.
+        ///
+        /// The pre-pass ensures that lighting is only computed once per pixel, at the cost of
+        /// transforming all geometry twice. This pays off for scenes in which many objects overlap.
+        void set_depth_prepass(bool enabled);
+        bool depth_prepass() const;
+
+        /// Returns whether the window is headless (see WindowBuilder::headless).
+        bool headless() const;
+
+        /// Starts capturing every frame rendered by the window into the given target, and stops any capture
+        /// in progress. Frames are read back from the GPU asynchronously and written on a thread
+        /// of their own, so that capturing barely slows down rendering.
+        ///
+        /// Like stop_capture(), this makes the context of the window current, and so must not be called while
+        /// the window is in a WindowGroup. Throws std::runtime_error if the target is a pipe whose command
+        /// cannot be started, in which case the capture in progress continues, or if any frame of the capture
+        /// in progress could not be written, in which case the new capture has started nonetheless.
+        void start_capture(const CaptureTarget & target);
+
+        /// Stops capturing frames, and waits for the frames captured so far to be written, which includes
+        /// waiting for the command of a pipe to exit. Captures are also stopped when the window is destroyed.
+        ///
+        /// Throws std::runtime_error if any frame could not be written. Once a frame fails,
+        /// the remaining frames of the capture are skipped.
+        void stop_capture();
+
+        /// Returns whether frames are being captured.
+        bool capturing() const;
+
+        /// Returns statistics about the rendering of the most recent frame.
+        FrameStatistics frame_statistics() const;
+
         void add_event_handler(std::shared_ptr<EventHandler> handler);
 
         /// Returns a pointer to the underlying GLFW window.
@@ -102,6 +177,7 @@ namespace merely3d
 
     private:
         friend class WindowBuilder;
+        friend class WindowGroup;
         friend void dispatch_key_event(Window *, Key, Action, int, int);
         friend void dispatch_mouse_button_event(Window *, MouseButton, Action, int);
         friend void dispatch_mouse_move_event(Window * window, double xpos, double ypos);
@@ -116,6 +192,14 @@ namespace merely3d
         Frame begin_frame();
         void end_frame();
         void render_frame_impl(Frame & frame);
+        void render_tiled_impl(const TiledImage & image, Frame & frame);
+
+        // Rendering a frame is split into the following steps, so that WindowGroup can perform
+        // the steps that do not involve GLFW on other threads. Returns the projection matrix.
+        Eigen::Matrix4f update_viewport();
+        void render_commands(const Eigen::Matrix4f & projection);
+        void swap_buffers();
+
         CommandBuffer * get_command_buffer();
 
         WindowData * _d;
@@ -127,7 +211,9 @@ namespace merely3d
         WindowBuilder()
             :   _width(640),
                 _height(480),
-                _samples(0)
+                _samples(0),
+                _headless(false),
+                _share(nullptr)
         {
 
         }
@@ -154,12 +240,58 @@ namespace merely3d
             return result;
         }
 
+        /// Builds a headless window, which is never shown on screen. Frames are instead rendered into
+        /// an offscreen framebuffer of the dimensions of the window, and are not paced by vertical sync,
+        /// so that offline rendering runs as fast as the GPU allows. Otherwise, the window is used like
+        /// any other window. Multisampling is not supported for headless windows.
+        ///
+        /// Machines without a display server require merely3d to be configured with MERELY_HEADLESS,
+        /// which builds GLFW against OSMesa, so that no window is ever shown on screen.
+        WindowBuilder headless() const
+        {
+            auto result = *this;
+            result._headless = true;
+            return result;
+        }
+
+        /// Stores the compiled shader programs of the window in the given directory, which must exist,
+        /// so that windows built later, even by other processes, start faster by loading them from there.
+        ///
+        /// The cache is keyed by the graphics driver and the shader sources, so it is safe to share between
+        /// different versions of merely3d and different machines. If the driver does not support program
+        /// binaries, or the directory cannot be read or written, programs are compiled as usual.
+        /// By default, no cache is used.
+        WindowBuilder program_cache_directory(std::string directory) const
+        {
+            auto result = *this;
+            result._program_cache_directory = std::move(directory);
+            return result;
+        }
+
+        /// Shares the GPU resources of the given window with the window to be built: the compiled shader
+        /// programs, the geometry of the primitives and the geometry of the meshes drawn by either window.
+        /// Resources are only created and uploaded once for all windows that share them, which makes building
+        /// the window quicker and, when the windows draw the same meshes, saves a lot of GPU memory.
+        ///
+        /// Any window that shares the resources may in turn be given to further windows, and the resources
+        /// are kept alive for as long as any of the windows exists. The given window must exist when build()
+        /// is called. The program cache directory is that of the window that first created the resources.
+        WindowBuilder share_resources_with(const Window & window) const
+        {
+            auto result = *this;
+            result._share = &window;
+            return result;
+        }
+
         Window build() const;
 
     private:
         int             _width;
         int             _height;
         unsigned int    _samples;
+        bool            _headless;
         std::string     _title;
+        std::string     _program_cache_directory;
+        const Window *  _share;
     };
 }
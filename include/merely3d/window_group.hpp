@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+#include <merely3d/frame.hpp>
+#include <merely3d/window.hpp>
+
+namespace merely3d
+{
+    /// Timings of the rendering of a single frame of a window in a WindowGroup, in seconds.
+    struct FrameTimings
+    {
+        /// The time spent in the recording function, drawing into the frame.
+        double record;
+
+        /// The time spent issuing OpenGL commands for the recorded frame.
+        double render;
+
+        /// The time spent swapping the buffers of the window, which usually includes waiting for vertical sync.
+        double swap;
+
+        /// The time from the start of WindowGroup::render_frame until the buffers of the window were swapped.
+        /// The difference between windows tells how far apart the windows were presented.
+        double presented;
+    };
+
+    /// Renders the frames of several windows concurrently.
+    ///
+    /// Rendering each window in turn with Window::render_frame waits for the vertical sync of every window
+    /// in sequence, so that the frame rate of each window drops with the number of windows. Instead, a group
+    /// renders each of its windows on a thread of its own, and all windows are presented within the same
+    /// vertical sync interval. Windows that share resources (see WindowBuilder::share_resources_with) take turns
+    /// issuing their OpenGL commands, but still wait for vertical sync at the same time.
+    ///
+    /// While a window is in a group, its OpenGL context is current on the thread of the group, so the window
+    /// must not be rendered with Window::render_frame, and make_current() must not be called on it.
+    /// The windows must neither be moved nor destroyed for as long as the group exists.
+    class WindowGroup final
+    {
+    public:
+        WindowGroup();
+        WindowGroup(WindowGroup && other);
+        WindowGroup(const WindowGroup & other) = delete;
+        WindowGroup & operator=(const WindowGroup & other) = delete;
+
+        /// Waits for any rendering to complete, and releases the contexts of the windows,
+        /// which may then be made current on the calling thread again.
+        ~WindowGroup();
+
+        /// Adds a window to the group, which from then on renders it on a thread of its own.
+        void add(Window & window);
+
+        size_t size() const;
+
+        Window & window(size_t index);
+        const Window & window(size_t index) const;
+
+        /// Returns whether any window of the group should close.
+        bool any_should_close() const;
+
+        /// Renders a frame for every window of the group, and returns once all windows have been presented.
+        ///
+        /// Events are polled and the before_frame and after_frame event handlers are called on the calling
+        /// thread, like with Window::render_frame. In between, `record_func(window, frame)` is called for
+        /// each window on the thread of the window, so that the frames of all windows are recorded at the same
+        /// time. It must therefore only use the given window and frame, and must not call any function
+        /// of the window that uses GLFW, such as size() or get_last_key_action(). The camera, the scene
+        /// and the meshes of the window may be used freely.
+        ///
+        /// If `record_func` throws for any window, the exception is rethrown once all windows are done.
+        template <typename RecordFunc>
+        void render_frame(RecordFunc && record_func)
+        {
+            render_frame_impl(std::function<void(Window &, Frame &)>(std::forward<RecordFunc>(record_func)));
+        }
+
+        /// Returns the timings of the most recent frame of the window with the given index.
+        const FrameTimings & frame_timings(size_t index) const;
+
+    private:
+        class WindowGroupData;
+
+        void render_frame_impl(const std::function<void(Window &, Frame &)> & record_func);
+
+        WindowGroupData * _d;
+    };
+}
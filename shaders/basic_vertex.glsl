@@ -1,11 +1,18 @@
 #version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl)
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// Per-instance attributes, giving the end points and color of each line
+layout (location = 1) in vec3 line_from;
+layout (location = 2) in vec3 line_to;
+layout (location = 3) in vec3 line_color;
+
+flat out vec3 object_color;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    // The reference line goes from [0, 0, 0] to [1, 0, 0]
+    vec3 world_pos = mix(line_from, line_to, aPos.x);
+    object_color = line_color;
+    gl_Position = projection * (view * vec4(world_pos, 1.0));
 }
@@ -1,50 +1,67 @@
 #version 330 core
-
-in vec3 normal_world;
-in vec3 frag_pos_world;
-in vec3 frag_pos_local;
-
-uniform vec3 light_color;
-uniform vec3 object_color;
-
-// The position of the camera in world coordinates
-uniform vec3 view_pos;
-
-// Light direction is direction from light source to fragment (in world coordinates)
-uniform vec3 light_dir;
-
-// The transform taking the reference shape (i.e. a unit cube) into
-// the actual shape of the object (i.e. a box with certain extents)
-uniform mat3 reference_transform;
-
-uniform float pattern_grid_size;
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl),
+// and the MeshVertex block by mesh_vertex.glsl.
+//
+// Compiled in variants with any of PATTERN, LIGHTING, SPECULAR and EDGES defined (see default_vertex.glsl).
+// A variant is only used for draws whose instances need no more than its features, but instances
+// that need fewer features, e.g. instances without a pattern, must still be shaded correctly.
+
+#ifdef EDGES
+// Added by edges_geometry.glsl
+noperspective in vec3 barycentric;
+#endif
 
 out vec4 FragColor;
 
 void main()
 {
-    // TODO: Make ambient/specular etc. configurable
-    float ambient_strength = 0.15;
-    float specular_strength = 0.5;
-
+#ifdef EDGES
+    // The barycentric coordinates vary linearly across the screen, so dividing by their rate of change
+    // gives the distance to each edge in pixels. Every edge is shared by two triangles (except at the silhouette),
+    // each of which covers half the width of the edge, plus a pixel wide ramp that anti-aliases it.
+    // Derivatives are undefined in non-uniform control flow, so this comes before any branching.
+    vec3 edge_distance = barycentric / fwidth(barycentric);
+    float nearest_edge = min(edge_distance.x, min(edge_distance.y, edge_distance.z));
+    float edge_coverage = clamp(0.5 * mesh.edge_width + 0.5 - nearest_edge, 0.0, 1.0);
+
+    // Wireframes consist of nothing but edges, in the color of the object
+    if (mesh.edge_mode == EDGE_MODE_WIREFRAME)
+    {
+        if (edge_coverage <= 0.0)
+        {
+            discard;
+        }
+        FragColor = vec4(mesh.object_color, edge_coverage);
+        return;
+    }
+#endif
+
+#ifdef PATTERN
     // frag_pos_local gives us local coordinates in the reference
     // primitive (i.e. unit cube). We need to transform by the reference
-    // transform in order to obtain the actual local coordinates of the
+    // scaling in order to obtain the actual local coordinates of the
     // logical entity (i.e. a box with certain extents)
-    vec3 local_pos = reference_transform * frag_pos_local;
+    vec3 local_pos = mesh.reference_scale * mesh.frag_pos_local;
 
     // Assign the fragment to a grid cell and determine if the grid cell should
     // be patterned
-    ivec3 grid_coords = pattern_grid_size > 0.0
-        ? ivec3(round(local_pos / pattern_grid_size))
+    ivec3 grid_coords = mesh.pattern_grid_size > 0.0
+        ? ivec3(round(local_pos / mesh.pattern_grid_size))
         : ivec3(0);
     bool patterned = (grid_coords[0] + grid_coords[1] + grid_coords[2]) % 2 != 0;
 
     vec3 base_color = patterned
-                    ? 0.9 * object_color
-                    : object_color;
+                    ? 0.9 * mesh.object_color
+                    : mesh.object_color;
+#else
+    vec3 base_color = mesh.object_color;
+#endif
+
+#ifdef LIGHTING
+    // TODO: Make ambient strength configurable
+    float ambient_strength = 0.15;
 
-    vec3 normal = normalize(normal_world);
+    vec3 normal = normalize(mesh.normal_world);
 
     // Ambient
     vec3 ambient = ambient_strength * light_color;
@@ -52,13 +69,27 @@ void main()
     // Diffuse
     float diff = max(- dot(normal, light_dir), 0.0);
     vec3 diffuse = diff * light_color;
+    vec3 light = ambient + diffuse;
 
+#ifdef SPECULAR
     // Specular
-    vec3 view_dir = normalize(frag_pos_world - view_pos);
+    vec3 view_dir = normalize(mesh.frag_pos_world - camera_position);
     vec3 reflect_dir = reflect(light_dir, normal);
     float spec = pow(max(- dot(view_dir, reflect_dir), 0.0), 32);
-    vec3 specular = specular_strength * spec * light_color;
-
-    vec3 result = (ambient + diffuse + specular) * base_color;
+    vec3 specular = mesh.specular_strength * spec * light_color;
+    light += specular;
+#endif
+
+    vec3 result = mesh.lighting != 0.0 ? light * base_color : base_color;
+#else
+    vec3 result = base_color;
+#endif
+
+#ifdef EDGES
+    if (mesh.edge_mode == EDGE_MODE_FILLED)
+    {
+        result = mix(result, mesh.edge_color, edge_coverage);
+    }
+#endif
     FragColor = vec4(result, 1.0);
 }
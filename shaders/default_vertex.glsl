@@ -1,21 +1,53 @@
 #version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl),
+// the per-instance data by instance_attributes.glsl and the MeshVertex block by mesh_vertex.glsl.
+//
+// Compiled in variants (see ShaderCollection::mesh_shader), which only pass on the data needed
+// by the shading features that are defined: PATTERN, LIGHTING, SPECULAR and EDGES.
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
-out vec3 normal_world;
-out vec3 frag_pos_world;
-out vec3 frag_pos_local;
+// Must match the depth of depth_vertex.glsl exactly (see the depth pre-pass)
+invariant gl_Position;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
-uniform mat3 normal_transform;
+/// Rotates v by the unit quaternion q = (x, y, z, w).
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 void main()
 {
-    vec4 world_pos = model * vec4(aPos, 1.0);
-    normal_world = normalize(normal_transform * aNormal);
-    frag_pos_world = vec3(world_pos);
-    frag_pos_local = aPos;
-    gl_Position = projection * (view * world_pos);
+    load_instance();
+
+    // The model transform is given by translation * rotation * scale, where the scale includes
+    // the reference transform of the primitive. The normal transform is the inverse transpose of
+    // its linear part, which for a diagonal scale amounts to rotation * inverse(scale).
+    vec3 world_pos = instance_position + rotate(instance_orientation, instance_scale * aPos);
+
+#ifdef LIGHTING
+    mesh.normal_world = normalize(rotate(instance_orientation, aNormal / instance_scale));
+    mesh.lighting = instance_lighting;
+#endif
+
+#ifdef SPECULAR
+    mesh.frag_pos_world = world_pos;
+    mesh.specular_strength = instance_specular_strength;
+#endif
+
+#ifdef PATTERN
+    mesh.frag_pos_local = aPos;
+    mesh.reference_scale = instance_reference_scale;
+    mesh.pattern_grid_size = instance_pattern_grid_size;
+#endif
+
+    mesh.object_color = instance_color;
+
+#ifdef EDGES
+    mesh.edge_mode = instance_edge_mode;
+    mesh.edge_width = instance_edge_width;
+    mesh.edge_color = instance_edge_color;
+#endif
+
+    gl_Position = projection * (view * vec4(world_pos, 1.0));
 }
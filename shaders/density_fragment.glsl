@@ -0,0 +1,18 @@
+#version 330 core
+
+out float density;
+
+void main()
+{
+    // Weight the contribution of the particle by a kernel which falls off
+    // from 1 at the center of the (projected) sphere to 0 at its boundary
+    vec2 offset = 2.0 * gl_PointCoord - vec2(1.0);
+    float r2 = dot(offset, offset);
+
+    if (r2 > 1.0)
+    {
+        discard;
+    }
+
+    density = 1.0 - r2;
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+uniform sampler2D density_texture;
+uniform sampler1D colormap;
+uniform float exposure;
+
+// The ratio between the full resolution and the resolution of the density buffer
+uniform int resolution_divisor;
+
+out vec4 FragColor;
+
+void main()
+{
+    float density = texelFetch(density_texture, ivec2(gl_FragCoord.xy) / resolution_divisor, 0).r;
+
+    // Tone map the unbounded density into [0, 1)
+    float intensity = 1.0 - exp(-exposure * density);
+
+    if (intensity <= 0.0)
+    {
+        discard;
+    }
+
+    // Sample at the centers of the first and last texels for intensity 0 and 1
+    float lut_size = float(textureSize(colormap, 0));
+    float lut_coord = (intensity * (lut_size - 1.0) + 0.5) / lut_size;
+    vec3 color = texture(colormap, lut_coord).rgb;
+
+    // Sparse regions are blended with the scene behind the particles
+    FragColor = vec4(color, intensity);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl)
+layout (location = 0) in vec3 pos;
+layout (location = 2) in float radius;
+layout (location = 4) in vec3 previous_pos;
+
+uniform float viewport_height;
+
+// Blends between the previous (0) and the current (1) snapshot of the particle positions
+uniform float interpolation;
+
+void main()
+{
+    vec4 view_pos = view * vec4(mix(previous_pos, pos, interpolation), 1.0);
+    gl_Position = projection * view_pos;
+
+    // Size of the point sprite in pixels, so that it covers the projected sphere
+    // (approximately, ignoring perspective distortion away from the view axis).
+    // Particles behind the camera are clipped, so we only guard against division by zero.
+    // The sub-frustum of a tile scales projection[1][1] by the inverse of the tile's share of the image,
+    // so sprites have the same size in pixels in a tile as in the whole image.
+    float pixels_per_unit = 0.5 * viewport_height * projection[1][1] / max(-view_pos.z, 1e-6);
+    gl_PointSize = max(2.0 * radius * pixels_per_unit, 1.0);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Only depth is written in the depth pre-pass
+void main()
+{
+}
@@ -0,0 +1,20 @@
+#version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl),
+// and the per-instance data by instance_attributes.glsl
+layout (location = 0) in vec3 aPos;
+
+// The depth pre-pass relies on producing exactly the same depth as default_vertex.glsl
+invariant gl_Position;
+
+/// Rotates v by the unit quaternion q = (x, y, z, w).
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    load_instance();
+    vec3 world_pos = instance_position + rotate(instance_orientation, instance_scale * aPos);
+    gl_Position = projection * (view * vec4(world_pos, 1.0));
+}
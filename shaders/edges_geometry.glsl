@@ -0,0 +1,53 @@
+#version 330 core
+// The MeshVertex block is declared by mesh_vertex.glsl, as `vertices` for the input
+// and `mesh` for the output. Only used by the variants of the mesh shader with EDGES defined.
+//
+// Passes each triangle through unchanged, except for adding the barycentric coordinates of its vertices,
+// from which default_fragment.glsl finds the distance to the nearest edge. Since the same draw may contain
+// both wireframes and filled instances, back face culling must be disabled, and is done here instead,
+// for all but the wireframes.
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+noperspective out vec3 barycentric;
+
+void main()
+{
+    // The sign of the determinant of the homogeneous (x, y, w) coordinates gives the winding of the triangle
+    // in window coordinates, also for triangles that cross the near plane. Front faces are counter-clockwise.
+    mat3 corners = mat3(gl_in[0].gl_Position.xyw, gl_in[1].gl_Position.xyw, gl_in[2].gl_Position.xyw);
+    if (vertices[0].edge_mode != EDGE_MODE_WIREFRAME && determinant(corners) < 0.0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+#ifdef LIGHTING
+        mesh.normal_world = vertices[i].normal_world;
+        mesh.lighting = vertices[i].lighting;
+#endif
+
+#ifdef SPECULAR
+        mesh.frag_pos_world = vertices[i].frag_pos_world;
+        mesh.specular_strength = vertices[i].specular_strength;
+#endif
+
+#ifdef PATTERN
+        mesh.frag_pos_local = vertices[i].frag_pos_local;
+        mesh.reference_scale = vertices[i].reference_scale;
+        mesh.pattern_grid_size = vertices[i].pattern_grid_size;
+#endif
+
+        mesh.object_color = vertices[i].object_color;
+        mesh.edge_mode = vertices[i].edge_mode;
+        mesh.edge_width = vertices[i].edge_width;
+        mesh.edge_color = vertices[i].edge_color;
+
+        barycentric = vec3(0.0);
+        barycentric[i] = 1.0;
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,23 @@
+// Per-frame camera and lighting data, shared by all shader programs and written once per frame.
+// Inserted right after the #version directive of the shaders that use it. Must match FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inv_projection;
+
+    // The position of the camera in world coordinates
+    vec3 camera_position;
+
+    // The distance from the camera to the near plane
+    float near_plane_dist;
+
+    vec3 light_color;
+    float frame_padding0;
+
+    // Light direction is direction from light source to fragment, in world and eye coordinates respectively
+    vec3 light_dir;
+    float frame_padding1;
+    vec3 light_dir_eye;
+    float frame_padding2;
+};
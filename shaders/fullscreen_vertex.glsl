@@ -0,0 +1,10 @@
+#version 330 core
+
+// Generates a single triangle which covers the entire viewport when drawn
+// with glDrawArrays(GL_TRIANGLES, 0, 3), without any vertex data.
+void main()
+{
+    vec2 position = vec2(float((gl_VertexID & 1) << 2) - 1.0,
+                         float((gl_VertexID & 2) << 1) - 1.0);
+    gl_Position = vec4(position, 0.0, 1.0);
+}
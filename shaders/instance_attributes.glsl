@@ -0,0 +1,147 @@
+// Per-instance data of instanced geometry, laid out as in instance_data.hpp. Inserted right after
+// the #version directive of the vertex shaders that use it, which must call load_instance() before
+// reading any of the instance_* variables.
+//
+// With INSTANCE_TEXTURE defined, the records are fetched from a buffer texture (see GlInstanceTexture)
+// rather than read from vertex attributes, which lets draws of different meshes share a vertex array.
+//
+// The position, orientation and scale of each instance are blended between the previous snapshot of its record
+// and the current one (see GlInstanceBuffer), so that display frames between two simulation steps need no uploads.
+
+// Blends between the previous (0) and the current (1) snapshot of the instance transforms
+uniform float instance_interpolation;
+
+vec3 instance_position;
+vec4 instance_orientation;
+vec3 instance_scale;
+
+/// Spherical linear interpolation between the unit quaternions q0 and q1, along the shorter arc.
+vec4 slerp(vec4 q0, vec4 q1, float t)
+{
+    // q and -q represent the same rotation
+    float cos_angle = dot(q0, q1);
+    if (cos_angle < 0.0)
+    {
+        q1 = -q1;
+        cos_angle = -cos_angle;
+    }
+
+    // Nearly identical rotations are blended linearly instead, since sin(angle) vanishes
+    if (cos_angle > 0.9995)
+    {
+        return normalize(mix(q0, q1, t));
+    }
+
+    float angle = acos(cos_angle);
+    return (sin((1.0 - t) * angle) * q0 + sin(t * angle) * q1) / sin(angle);
+}
+
+/// Blends the transform of the current instance, which must have been loaded, with that of its previous snapshot.
+void interpolate_transform(vec3 previous_position, vec4 previous_orientation, vec3 previous_scale)
+{
+    // Drawing the current snapshot reproduces it exactly
+    if (instance_interpolation < 1.0)
+    {
+        instance_position = mix(previous_position, instance_position, instance_interpolation);
+        instance_orientation = slerp(previous_orientation, instance_orientation, instance_interpolation);
+        instance_scale = mix(previous_scale, instance_scale, instance_interpolation);
+    }
+}
+
+#ifdef INSTANCE_TEXTURE
+uniform samplerBuffer instance_records;
+uniform samplerBuffer previous_instance_records;
+
+// The index of the record of the first instance of the current draw
+uniform int instance_base;
+
+// The index of the record of each vertex of a static batch (see GlStaticBatch), or of the first instance of
+// each command of an indirect draw (see GlIndirectDraws), relative to instance_base.
+// Other draws do not enable the attribute, which then reads as 0.
+layout (location = 2) in float batch_instance_index;
+
+vec3 instance_reference_scale;
+vec3 instance_color;
+float instance_pattern_grid_size;
+float instance_specular_strength;
+float instance_lighting;
+vec3 instance_edge_color;
+float instance_edge_width;
+float instance_edge_mode;
+
+float instance_component(int first, int offset)
+{
+    return texelFetch(instance_records, first + offset).r;
+}
+
+float previous_instance_component(int first, int offset)
+{
+    return texelFetch(previous_instance_records, first + offset).r;
+}
+
+void load_instance()
+{
+    int first = (instance_base + gl_InstanceID + int(batch_instance_index)) * FLOATS_PER_INSTANCE;
+    instance_position = vec3(instance_component(first, 0),
+                             instance_component(first, 1),
+                             instance_component(first, 2));
+    instance_orientation = vec4(instance_component(first, 3),
+                                instance_component(first, 4),
+                                instance_component(first, 5),
+                                instance_component(first, 6));
+    instance_scale = vec3(instance_component(first, 7),
+                          instance_component(first, 8),
+                          instance_component(first, 9));
+    instance_reference_scale = vec3(instance_component(first, 10),
+                                    instance_component(first, 11),
+                                    instance_component(first, 12));
+    instance_color = vec3(instance_component(first, 13),
+                          instance_component(first, 14),
+                          instance_component(first, 15));
+    instance_pattern_grid_size = instance_component(first, 16);
+    instance_specular_strength = instance_component(first, 17);
+    instance_lighting = instance_component(first, 18);
+    instance_edge_color = vec3(instance_component(first, 19),
+                               instance_component(first, 20),
+                               instance_component(first, 21));
+    instance_edge_width = instance_component(first, 22);
+    instance_edge_mode = instance_component(first, 23);
+
+    if (instance_interpolation < 1.0)
+    {
+        interpolate_transform(vec3(previous_instance_component(first, 0),
+                                   previous_instance_component(first, 1),
+                                   previous_instance_component(first, 2)),
+                              vec4(previous_instance_component(first, 3),
+                                   previous_instance_component(first, 4),
+                                   previous_instance_component(first, 5),
+                                   previous_instance_component(first, 6)),
+                              vec3(previous_instance_component(first, 7),
+                                   previous_instance_component(first, 8),
+                                   previous_instance_component(first, 9)));
+    }
+}
+#else
+layout (location = 2) in vec3 current_instance_position;
+layout (location = 3) in vec4 current_instance_orientation;
+layout (location = 4) in vec3 current_instance_scale;
+layout (location = 5) in vec3 instance_reference_scale;
+layout (location = 6) in vec3 instance_color;
+layout (location = 7) in float instance_pattern_grid_size;
+layout (location = 8) in float instance_specular_strength;
+layout (location = 9) in float instance_lighting;
+layout (location = 10) in vec3 instance_edge_color;
+layout (location = 11) in float instance_edge_width;
+layout (location = 12) in float instance_edge_mode;
+layout (location = 13) in vec3 previous_instance_position;
+layout (location = 14) in vec4 previous_instance_orientation;
+layout (location = 15) in vec3 previous_instance_scale;
+
+void load_instance()
+{
+    instance_position = current_instance_position;
+    instance_orientation = current_instance_orientation;
+    instance_scale = current_instance_scale;
+    interpolate_transform(previous_instance_position, previous_instance_orientation, previous_instance_scale);
+}
+#endif
@@ -0,0 +1,38 @@
+// The members of the MeshVertex interface block, through which default_vertex.glsl passes the data of each vertex
+// on to default_fragment.glsl, by way of edges_geometry.glsl when EDGES is defined. The block itself is declared
+// around these members by ShaderCollection, since its storage qualifier and instance name differ between stages.
+//
+// Only the members needed by the shading features that are defined are declared (see default_vertex.glsl).
+#ifdef LIGHTING
+    vec3 normal_world;
+
+    // 0 for instances that are unlit
+    flat float lighting;
+#endif
+
+#ifdef SPECULAR
+    vec3 frag_pos_world;
+    flat float specular_strength;
+#endif
+
+#ifdef PATTERN
+    vec3 frag_pos_local;
+
+    // The scaling taking the reference shape (i.e. a unit cube) into
+    // the actual shape of the object (i.e. a box with certain extents)
+    flat vec3 reference_scale;
+
+    flat float pattern_grid_size;
+#endif
+
+    flat vec3 object_color;
+
+#ifdef EDGES
+    // See EDGE_MODE_NONE and friends in instance_data.hpp
+    flat float edge_mode;
+
+    // In pixels
+    flat float edge_width;
+
+    flat vec3 edge_color;
+#endif
@@ -1,4 +1,5 @@
 #version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl)
 
 in VertexData
 {
@@ -7,13 +8,12 @@ in VertexData
     float sphere_radius;
 } vs_in;
 
-uniform mat4 projection;
-uniform mat4 inv_projection;
-uniform vec3 light_color;
-uniform vec3 light_dir_eye;
+// The viewport of the pass, whose NDC the projection of the frame maps to. When an image is rendered in tiles,
+// this is the viewport of the tile, and the projection (and so inv_projection) is that of the tile's sub-frustum
+uniform float viewport_x;
+uniform float viewport_y;
 uniform float viewport_width;
 uniform float viewport_height;
-uniform float near_plane_dist;
 
 out vec4 FragColor;
 
@@ -21,8 +21,9 @@ out vec4 FragColor;
 /// associated with the current fragment
 vec3 compute_ray_direction()
 {
-    float ndc_x = 2.0 * (gl_FragCoord.x - viewport_width / 2.0) / viewport_width;
-    float ndc_y = 2.0 * (gl_FragCoord.y - viewport_height / 2.0) / viewport_height;
+    // gl_FragCoord is relative to the framebuffer rather than to the viewport
+    float ndc_x = 2.0 * (gl_FragCoord.x - viewport_x - viewport_width / 2.0) / viewport_width;
+    float ndc_y = 2.0 * (gl_FragCoord.y - viewport_y - viewport_height / 2.0) / viewport_height;
     vec4 ndc_point = vec4(ndc_x, ndc_y, -1.0, 1.0);
     vec4 view_point = inv_projection * near_plane_dist * ndc_point;
     return vec3(view_point);
@@ -1,4 +1,5 @@
 #version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl)
 layout (points) in;
 layout (triangle_strip, max_vertices = 4) out;
 
@@ -15,8 +16,6 @@ out VertexData
     float sphere_radius;
 } vs_out;
 
-uniform mat4 projection;
-
 vec3 orthogonal_to_view_vector(vec3 v)
 {
     // We assume here that v.z != 0!
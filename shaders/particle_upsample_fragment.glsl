@@ -0,0 +1,84 @@
+#version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl)
+
+// Color and depth of the particles, rendered at a reduced resolution
+uniform sampler2D color_texture;
+uniform sampler2D depth_texture;
+
+// The ratio between the full resolution and the reduced resolution
+uniform int resolution_divisor;
+
+out vec4 FragColor;
+
+/// Maps window depth to the (positive) distance along the view axis, for the
+/// "infinite" projection matrix used by merely3d, for which window depth is given by 1 - n / distance.
+float linear_depth(float window_depth)
+{
+    return near_plane_dist / max(1.0 - window_depth, 1e-7);
+}
+
+void main()
+{
+    // Position of the current pixel in the texel grid of the low resolution buffer,
+    // in which texel centers have integer coordinates
+    vec2 position = gl_FragCoord.xy / float(resolution_divisor) - vec2(0.5);
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+    ivec2 max_texel = textureSize(color_texture, 0) - ivec2(1);
+
+    ivec2 offsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+    float bilinear_weights[4] = float[]((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+    vec4 colors[4];
+    float depths[4];
+
+    // The reference depth is the depth of the nearest particle among the neighboring texels
+    float reference_depth = 1.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 texel = clamp(base + offsets[i], ivec2(0), max_texel);
+        colors[i] = texelFetch(color_texture, texel, 0);
+        depths[i] = texelFetch(depth_texture, texel, 0).r;
+        if (colors[i].a > 0.0)
+        {
+            reference_depth = min(reference_depth, depths[i]);
+        }
+    }
+
+    if (reference_depth >= 1.0)
+    {
+        discard;
+    }
+
+    // Bilateral upsampling: bilinear weights are attenuated for texels whose depth differs from the
+    // reference depth, so that particles at different depths do not bleed into each other.
+    // Empty texels keep their bilinear weight, which gives smooth coverage at particle silhouettes.
+    float reference_distance = linear_depth(reference_depth);
+    vec3 premultiplied_color = vec3(0.0);
+    float coverage = 0.0;
+    float total_weight = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        float depth_weight = 1.0;
+        if (colors[i].a > 0.0)
+        {
+            float relative_difference = (linear_depth(depths[i]) - reference_distance) / reference_distance;
+            depth_weight = exp(-400.0 * relative_difference * relative_difference);
+        }
+
+        float weight = bilinear_weights[i] * depth_weight + 1e-5;
+        premultiplied_color += weight * colors[i].a * colors[i].rgb;
+        coverage += weight * colors[i].a;
+        total_weight += weight;
+    }
+
+    if (coverage <= 0.0)
+    {
+        discard;
+    }
+
+    // Depth testing against the full resolution depth buffer makes sure that the particles are correctly
+    // occluded by opaque geometry, and writing the depth makes subsequently rendered geometry occluded by them
+    gl_FragDepth = reference_depth;
+    FragColor = vec4(premultiplied_color / coverage, coverage / total_weight);
+}
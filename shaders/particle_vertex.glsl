@@ -1,7 +1,10 @@
 #version 330 core
+// Camera and lighting uniforms are declared by the FrameUniforms block (see frame_uniforms.glsl)
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec3 color;
 layout (location = 2) in float radius;
+layout (location = 3) in float scalar;
+layout (location = 4) in vec3 previous_pos;
 
 out VertexData
 {
@@ -9,13 +12,28 @@ out VertexData
     float sphere_radius;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+// Blends between the previous (0) and the current (1) snapshot of the particle positions
+uniform float interpolation;
+
+// If enabled, the color is obtained by mapping the scalar attribute through the colormap
+// instead of from the color attribute
+uniform bool use_colormap;
+uniform sampler1D colormap;
+uniform float scalar_min;
+uniform float scalar_max;
+
+vec3 lookup_color(float value)
+{
+    float t = clamp((value - scalar_min) / max(scalar_max - scalar_min, 1e-20), 0.0, 1.0);
+    // Map t to the range between the centers of the first and last texels
+    float n = float(textureSize(colormap, 0));
+    return texture(colormap, (t * (n - 1.0) + 0.5) / n).rgb;
+}
 
 void main()
 {
-    vec4 view_pos = view * vec4(pos, 1.0);
+    vec4 view_pos = view * vec4(mix(previous_pos, pos, interpolation), 1.0);
     vs_out.sphere_radius = radius;
-    vs_out.sphere_color = color;
+    vs_out.sphere_color = use_colormap ? lookup_color(scalar) : color;
     gl_Position = view_pos;
 }
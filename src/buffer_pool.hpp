@@ -0,0 +1,131 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace merely3d
+{
+    /// The size of the storage of the smallest buffers handed out by the buffer pool of GlGarbagePile.
+    const size_t MIN_POOLED_BUFFER_SIZE = 256;
+
+    /// Returns the size of the storage of a pooled buffer with room for at least `size` bytes, which is
+    /// the smallest power of two that is at least `size` and no less than MIN_POOLED_BUFFER_SIZE.
+    ///
+    /// Rounding up to powers of two means that buffers of similar sizes are interchangeable,
+    /// and that a buffer that grows one bucket at a time grows geometrically.
+    inline size_t pooled_buffer_size(size_t size)
+    {
+        size_t bucket = MIN_POOLED_BUFFER_SIZE;
+        while (bucket < size)
+        {
+            bucket *= 2;
+        }
+        return bucket;
+    }
+
+    /// Keeps track of buffer objects that are no longer used, bucketed by the size of their storage,
+    /// so that they may be handed out again rather than deleted and recreated.
+    ///
+    /// The pool itself makes no OpenGL calls: it is up to the owner to only add buffers that the GPU
+    /// is done with, and to delete the buffers that are trimmed from the pool (see GlGarbagePile).
+    class BufferPool
+    {
+    public:
+        BufferPool() : _size_in_bytes(0), _buffer_count(0) {}
+
+        /// Adds a buffer whose storage is `size` bytes, where `size` is a bucket size (see pooled_buffer_size).
+        /// `frame` is the number of the frame in which the buffer is added, and determines its age.
+        void add(GLuint buffer, size_t size, uint64_t frame)
+        {
+            assert(size == pooled_buffer_size(size));
+            _buckets[size].push_back(Entry { buffer, frame });
+            _size_in_bytes += size;
+            ++_buffer_count;
+        }
+
+        /// Removes and returns a buffer whose storage is `size` bytes, or 0 if there is none.
+        /// The most recently added buffer of the bucket is returned first.
+        GLuint take(size_t size)
+        {
+            auto bucket = _buckets.find(size);
+            if (bucket == _buckets.end() || bucket->second.empty())
+            {
+                return 0;
+            }
+
+            const auto buffer = bucket->second.back().buffer;
+            bucket->second.pop_back();
+            _size_in_bytes -= size;
+            --_buffer_count;
+            return buffer;
+        }
+
+        /// Removes all buffers that were added before `oldest_frame`, and then removes buffers, the least
+        /// recently added first, until the pool holds no more than `budget` bytes. The removed buffers
+        /// are appended to `removed`.
+        void trim(size_t budget, uint64_t oldest_frame, std::vector<GLuint> & removed)
+        {
+            // Buffers are added in order of their frames, so the oldest buffers of each bucket come first
+            for (auto & bucket : _buckets)
+            {
+                auto & entries = bucket.second;
+                auto end = entries.begin();
+                while (end != entries.end() && end->frame < oldest_frame)
+                {
+                    removed.push_back(end->buffer);
+                    _size_in_bytes -= bucket.first;
+                    --_buffer_count;
+                    ++end;
+                }
+                entries.erase(entries.begin(), end);
+            }
+
+            while (_size_in_bytes > budget)
+            {
+                auto oldest = _buckets.end();
+                for (auto it = _buckets.begin(); it != _buckets.end(); ++it)
+                {
+                    if (!it->second.empty()
+                        && (oldest == _buckets.end() || it->second.front().frame < oldest->second.front().frame))
+                    {
+                        oldest = it;
+                    }
+                }
+                assert(oldest != _buckets.end());
+
+                removed.push_back(oldest->second.front().buffer);
+                oldest->second.erase(oldest->second.begin());
+                _size_in_bytes -= oldest->first;
+                --_buffer_count;
+            }
+        }
+
+        /// The total size of the storage of the buffers in the pool.
+        size_t size_in_bytes() const
+        {
+            return _size_in_bytes;
+        }
+
+        size_t buffer_count() const
+        {
+            return _buffer_count;
+        }
+
+    private:
+        struct Entry
+        {
+            GLuint      buffer;
+            uint64_t    frame;
+        };
+
+        // Bucket size -> buffers of that size, in the order they were added
+        std::map<size_t, std::vector<Entry>> _buckets;
+        size_t _size_in_bytes;
+        size_t _buffer_count;
+    };
+}
@@ -0,0 +1,85 @@
+#include <merely3d/colormap.hpp>
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <stdexcept>
+
+using Eigen::Vector3f;
+
+namespace merely3d
+{
+    /// Evaluates a degree 6 polynomial with vector-valued coefficients c[0], ..., c[6] at t.
+    static Vector3f evaluate_polynomial(const float (&c)[7][3], float t)
+    {
+        Vector3f result = Vector3f::Zero();
+        for (int i = 6; i >= 0; --i)
+        {
+            result = t * result + Vector3f(c[i][0], c[i][1], c[i][2]);
+        }
+        return result;
+    }
+
+    // The matplotlib colormaps are represented by least-squares polynomial fits
+    // to the original tables (courtesy of Matt Zucker), which are accurate to within
+    // a few units of 8-bit color.
+
+    static const float VIRIDIS[7][3] = {
+        {   0.2777273272234177f,  0.005407344544966578f,  0.3340998053353061f },
+        {   0.1050930431085774f,  1.404613529898575f,     1.384590162594685f  },
+        {  -0.3308618287255563f,  0.214847559468213f,     0.09509516302823659f },
+        {  -4.634230498983486f,  -5.799100973351585f,   -19.33244095627987f   },
+        {   6.228269936347081f,  14.17993336680509f,     56.69055260068105f   },
+        {   4.776384997670288f, -13.74514537774601f,    -65.35303263337234f   },
+        {  -5.435455855934631f,   4.645852612178535f,    26.3124352495832f    }
+    };
+
+    static const float PLASMA[7][3] = {
+        {   0.05873234392399702f,  0.02333670892565664f,  0.5433401826748754f },
+        {   2.176514634195958f,    0.2383834171260182f,   0.7539604599784036f },
+        {  -2.689460476458034f,   -7.455851135738909f,    3.110799939717086f  },
+        {   6.130348345893603f,   42.3461881477227f,    -28.51885465332158f   },
+        { -11.10743619062271f,   -82.66631109428045f,    60.13984767418263f   },
+        {  10.02306557647065f,    71.41361770095349f,   -54.07218655560067f   },
+        {  -3.658713842777788f,  -22.93153465461149f,    18.19190778539828f   }
+    };
+
+    static const float MAGMA[7][3] = {
+        {  -0.002136485053939582f, -0.000749655052795221f, -0.005386127855323933f },
+        {   0.2516605407371642f,    0.6775232436837668f,    2.494026599312351f    },
+        {   8.353717279216625f,    -3.577719514958484f,     0.3144679030132573f   },
+        { -27.66873308576866f,     14.26473078096533f,    -13.64921318813922f     },
+        {  52.17613981234068f,    -27.94360607168351f,     12.94416944238394f     },
+        { -50.76852536473588f,     29.04658282127291f,      4.23415299384598f     },
+        {  18.65570506591883f,    -11.48977351997711f,     -5.601961508734096f    }
+    };
+
+    static const float INFERNO[7][3] = {
+        {   0.0002189403691192265f,  0.001651004631001012f, -0.01948089843709184f },
+        {   0.1065134194856116f,     0.5639564367884091f,    3.932712388889277f   },
+        {  11.60249308247187f,      -3.972853965665698f,   -15.9423941062914f     },
+        { -41.70399613139459f,      17.43639888205313f,     44.35414519872813f    },
+        {  77.162935699427f,       -33.40235894210092f,    -81.80730925738993f    },
+        { -71.31942824499214f,      32.62606426397723f,     73.20951985803202f    },
+        {  25.13112622477341f,     -12.24266895238567f,    -23.07032500287172f    }
+    };
+
+    Color evaluate_colormap(Colormap colormap, float t)
+    {
+        t = std::max(0.0f, std::min(t, 1.0f));
+
+        Vector3f rgb;
+        switch (colormap)
+        {
+            case Colormap::Viridis: rgb = evaluate_polynomial(VIRIDIS, t); break;
+            case Colormap::Plasma: rgb = evaluate_polynomial(PLASMA, t); break;
+            case Colormap::Magma: rgb = evaluate_polynomial(MAGMA, t); break;
+            case Colormap::Inferno: rgb = evaluate_polynomial(INFERNO, t); break;
+            case Colormap::Grayscale: rgb = Vector3f::Constant(t); break;
+            default: throw std::invalid_argument("Unknown colormap");
+        }
+
+        rgb = rgb.cwiseMax(0.0f).cwiseMin(1.0f);
+        return Color(rgb.x(), rgb.y(), rgb.z());
+    }
+}
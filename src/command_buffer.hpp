@@ -4,12 +4,17 @@
 #include <merely3d/primitives.hpp>
 #include <merely3d/renderable.hpp>
 #include <merely3d/mesh.hpp>
+#include <merely3d/particle_options.hpp>
+#include <merely3d/particle_set.hpp>
 
 #include <Eigen/Dense>
 
 #include <type_traits>
 #include <vector>
 
+#include "instance_data.hpp"
+#include "mesh_registry.hpp"
+
 namespace merely3d
 {
     class CommandBuffer
@@ -24,12 +29,27 @@ namespace merely3d
 
         void push_particle(const Particle & particle);
 
+        void push_scalar_particle(const ScalarParticle & particle);
+
+        void push_particle_set(const ParticleSet & particles);
+
+        void set_particle_options(const ParticleOptions & options);
+
+        void set_interpolation(float interpolation);
+
         const std::vector<Renderable<Rectangle>> &  rectangles() const;
         const std::vector<Renderable<Box>> &        boxes() const;
         const std::vector<Renderable<Sphere>> &     spheres() const;
         const std::vector<Renderable<StaticMesh>> & meshes() const;
         const std::vector<Line> &                   lines() const;
         const std::vector<float> &                  particle_data() const;
+        const std::vector<float> &                  scalar_particle_data() const;
+        const std::vector<ParticleSet> &            particle_sets() const;
+        const ParticleOptions &                     particle_options() const;
+        float                                       interpolation() const;
+
+        /// Returns the instances of registered meshes.
+        const MeshHandleInstances & mesh_handle_instances() const;
 
         std::vector<Renderable<Rectangle>> &  rectangles();
         std::vector<Renderable<Box>> &        boxes();
@@ -37,6 +57,7 @@ namespace merely3d
         std::vector<Renderable<StaticMesh>> & meshes();
         std::vector<Line> &                   lines();
         std::vector<float> &                  particle_data();
+        std::vector<float> &                  scalar_particle_data();
 
     private:
         std::vector<Renderable<Rectangle>>  _rectangles;
@@ -45,6 +66,11 @@ namespace merely3d
         std::vector<Renderable<StaticMesh>> _meshes;
         std::vector<Line>                   _lines;
         std::vector<float>                  _particle_data;
+        std::vector<float>                  _scalar_particle_data;
+        std::vector<ParticleSet>            _particle_sets;
+        ParticleOptions                     _particle_options;
+        float                               _interpolation = 1.0f;
+        MeshHandleInstances                 _mesh_handle_instances;
     };
 
     inline void CommandBuffer::clear()
@@ -55,6 +81,11 @@ namespace merely3d
         _meshes.clear();
         _lines.clear();
         _particle_data.clear();
+        _scalar_particle_data.clear();
+        _particle_sets.clear();
+        _particle_options = ParticleOptions();
+        _interpolation = 1.0f;
+        _mesh_handle_instances.clear();
     }
 
     inline const std::vector<Renderable<Rectangle>> & CommandBuffer::rectangles() const
@@ -86,6 +117,31 @@ namespace merely3d
         return _particle_data;
     }
 
+    inline const std::vector<float> & CommandBuffer::scalar_particle_data() const
+    {
+        return _scalar_particle_data;
+    }
+
+    inline const std::vector<ParticleSet> & CommandBuffer::particle_sets() const
+    {
+        return _particle_sets;
+    }
+
+    inline const ParticleOptions & CommandBuffer::particle_options() const
+    {
+        return _particle_options;
+    }
+
+    inline float CommandBuffer::interpolation() const
+    {
+        return _interpolation;
+    }
+
+    inline const MeshHandleInstances & CommandBuffer::mesh_handle_instances() const
+    {
+        return _mesh_handle_instances;
+    }
+
     inline std::vector<Renderable<Rectangle>> & CommandBuffer::rectangles()
     {
         return _rectangles;
@@ -116,6 +172,11 @@ namespace merely3d
         return _particle_data;
     }
 
+    inline std::vector<float> & CommandBuffer::scalar_particle_data()
+    {
+        return _scalar_particle_data;
+    }
+
     template<typename Shape>
     inline void CommandBuffer::push_renderable(const Renderable <Shape> & renderable)
     {
@@ -146,6 +207,17 @@ namespace merely3d
         _meshes.push_back(renderable);
     }
 
+    template <>
+    inline void CommandBuffer::push_renderable(const Renderable<MeshHandle> & renderable)
+    {
+        // The instance is packed right away, so that the material does not need to be stored separately
+        auto & target = _mesh_handle_instances;
+        const Eigen::Vector3f reference_scale(1.0f, 1.0f, 1.0f);
+        target.meshes.push_back(renderable.shape.index);
+        append_instance(target.instances, renderable.position, renderable.orientation,
+                        renderable.scale, reference_scale, renderable.material);
+    }
+
     inline void CommandBuffer::push_line(const Line &line)
     {
         _lines.push_back(line);
@@ -164,5 +236,31 @@ namespace merely3d
         _particle_data[offset + 5] = p.color.b();
         _particle_data[offset + 6] = p.radius;
     }
-}
 
+    inline void CommandBuffer::push_scalar_particle(const ScalarParticle & particle)
+    {
+        const auto & p = particle;
+        const auto offset = _scalar_particle_data.size();
+        _scalar_particle_data.resize(offset + 5);
+        _scalar_particle_data[offset + 0] = p.position.x();
+        _scalar_particle_data[offset + 1] = p.position.y();
+        _scalar_particle_data[offset + 2] = p.position.z();
+        _scalar_particle_data[offset + 3] = p.scalar;
+        _scalar_particle_data[offset + 4] = p.radius;
+    }
+
+    inline void CommandBuffer::push_particle_set(const ParticleSet & particles)
+    {
+        _particle_sets.push_back(particles);
+    }
+
+    inline void CommandBuffer::set_particle_options(const ParticleOptions & options)
+    {
+        _particle_options = options;
+    }
+
+    inline void CommandBuffer::set_interpolation(float interpolation)
+    {
+        _interpolation = interpolation;
+    }
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <vector>
+
+namespace merely3d
+{
+    /// A set of disjoint, half-open index ranges [begin, end), used to keep track of which
+    /// parts of a buffer have been modified since it was last transferred to the GPU.
+    ///
+    /// Ranges are kept sorted, and overlapping or adjacent ranges are merged as they are added,
+    /// so that each stored range corresponds to a single contiguous upload.
+    class DirtyRanges
+    {
+    public:
+        struct Range
+        {
+            size_t begin;
+            size_t end;
+        };
+
+        /// Marks the indices [begin, end) as dirty.
+        void add(size_t begin, size_t end);
+
+        /// Removes all parts of the ranges at or beyond the given size.
+        void truncate(size_t size);
+
+        void clear() { _ranges.clear(); }
+
+        bool empty() const { return _ranges.empty(); }
+
+        /// Returns the dirty ranges, in increasing order.
+        const std::vector<Range> & ranges() const { return _ranges; }
+
+    private:
+        std::vector<Range> _ranges;
+    };
+
+    /// Keeps track of the modified parts of a buffer that several consumers transfer to the GPU independently,
+    /// such as the renderers of the windows that draw the same particle set.
+    ///
+    /// Modifications accumulate until a consumer asks for the changes, which closes them into a new version.
+    /// Each consumer remembers the latest version it has transferred, and derives its own dirty ranges from
+    /// the versions after it. Only the most recent versions are kept, so a consumer that falls further
+    /// behind has to transfer everything.
+    class DirtyHistory
+    {
+    public:
+        /// The number of versions whose modifications are kept.
+        static const size_t MAX_VERSIONS = 16;
+
+        DirtyHistory() : _pending_min_size(not_truncated()), _latest(0) {}
+
+        /// Marks the indices [begin, end) as dirty.
+        void add(size_t begin, size_t end) { _pending.add(begin, end); }
+
+        /// Removes all modifications at or beyond the given size. The indices that are added again later on
+        /// hold different records than before, which consumers learn about through changes_since().
+        void truncate(size_t size);
+
+        /// Returns the latest version, closing the pending modifications into a new version first.
+        uint64_t latest_version();
+
+        /// Stores the indices modified after the given version in `dirty`, closing the pending modifications
+        /// into a new version first. Returns false if the modifications are no longer known, in which case
+        /// all indices must be considered modified.
+        bool changes_since(uint64_t version, DirtyRanges & dirty);
+
+        /// Like changes_since(), but also stores the smallest size the buffer was truncated to after the given
+        /// version in `min_size`, or the largest size_t if it was not truncated. Records at or beyond it may hold
+        /// different records than at the given version, even if they are not part of `dirty`.
+        bool changes_since(uint64_t version, DirtyRanges & dirty, size_t & min_size);
+
+    private:
+        struct Version
+        {
+            uint64_t version;
+            DirtyRanges changes;
+
+            // The smallest size the buffer was truncated to during the version
+            size_t min_size;
+        };
+
+        static size_t not_truncated() { return std::numeric_limits<size_t>::max(); }
+
+        void close_pending();
+
+        DirtyRanges         _pending;
+        size_t              _pending_min_size;
+        // The most recent versions, oldest first
+        std::deque<Version> _versions;
+        uint64_t            _latest;
+    };
+
+    inline void DirtyRanges::add(size_t begin, size_t end)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        // Find the first range that overlaps or touches [begin, end), and absorb
+        // all subsequent ranges that do the same
+        auto first = std::lower_bound(_ranges.begin(), _ranges.end(), begin,
+                                      [] (const Range & range, size_t index) { return range.end < index; });
+        auto last = first;
+        while (last != _ranges.end() && last->begin <= end)
+        {
+            begin = std::min(begin, last->begin);
+            end = std::max(end, last->end);
+            ++last;
+        }
+
+        first = _ranges.erase(first, last);
+        _ranges.insert(first, Range { begin, end });
+    }
+
+    inline void DirtyRanges::truncate(size_t size)
+    {
+        while (!_ranges.empty() && _ranges.back().begin >= size)
+        {
+            _ranges.pop_back();
+        }
+
+        if (!_ranges.empty())
+        {
+            _ranges.back().end = std::min(_ranges.back().end, size);
+        }
+    }
+
+    inline void DirtyHistory::truncate(size_t size)
+    {
+        _pending.truncate(size);
+        _pending_min_size = std::min(_pending_min_size, size);
+        for (auto & version : _versions)
+        {
+            version.changes.truncate(size);
+        }
+    }
+
+    inline uint64_t DirtyHistory::latest_version()
+    {
+        close_pending();
+        return _latest;
+    }
+
+    inline bool DirtyHistory::changes_since(uint64_t version, DirtyRanges & dirty)
+    {
+        size_t min_size;
+        return changes_since(version, dirty, min_size);
+    }
+
+    inline bool DirtyHistory::changes_since(uint64_t version, DirtyRanges & dirty, size_t & min_size)
+    {
+        close_pending();
+        assert(version <= _latest);
+        dirty.clear();
+        min_size = not_truncated();
+
+        if (version == _latest)
+        {
+            return true;
+        }
+        if (_versions.empty() || _versions.front().version > version + 1)
+        {
+            min_size = 0;
+            return false;
+        }
+
+        for (const auto & entry : _versions)
+        {
+            if (entry.version > version)
+            {
+                for (const auto & range : entry.changes.ranges())
+                {
+                    dirty.add(range.begin, range.end);
+                }
+                min_size = std::min(min_size, entry.min_size);
+            }
+        }
+        return true;
+    }
+
+    inline void DirtyHistory::close_pending()
+    {
+        if (_pending.empty() && _pending_min_size == not_truncated())
+        {
+            return;
+        }
+
+        _versions.push_back(Version { ++_latest, std::move(_pending), _pending_min_size });
+        _pending.clear();
+        _pending_min_size = not_truncated();
+        if (_versions.size() > MAX_VERSIONS)
+        {
+            _versions.pop_front();
+        }
+    }
+
+    /// Calls func(first, count) for each of the given ranges. Beyond a certain number of separate ranges,
+    /// the overhead of the individual transfers outweighs the cost of transferring the unmodified
+    /// data between them, in which case func is called once for the range enclosing all of them.
+    template <typename Func>
+    void for_each_transfer_range(const DirtyRanges & dirty, Func func)
+    {
+        const size_t max_transfers = 64;
+
+        const auto & ranges = dirty.ranges();
+        if (ranges.size() > max_transfers)
+        {
+            func(ranges.front().begin, ranges.back().end - ranges.front().begin);
+        }
+        else
+        {
+            for (const auto & range : ranges)
+            {
+                func(range.begin, range.end - range.begin);
+            }
+        }
+    }
+
+    /// Compares two arrays of records of `floats_per_record` floats each, in blocks of `records_per_block` records,
+    /// and stores the records of every block of `current` that differs from `previous` in `changed`
+    /// (which is cleared first). Records beyond the end of `previous` are always considered changed.
+    ///
+    /// Records are compared bitwise, which is cheap and treats NaNs consistently.
+    inline void find_changed_records(const std::vector<float> & previous,
+                                     const std::vector<float> & current,
+                                     size_t floats_per_record,
+                                     size_t records_per_block,
+                                     DirtyRanges & changed)
+    {
+        changed.clear();
+
+        const auto num_previous = previous.size() / floats_per_record;
+        const auto num_current = current.size() / floats_per_record;
+        const auto num_common = std::min(num_previous, num_current);
+
+        for (size_t begin = 0; begin < num_common; begin += records_per_block)
+        {
+            const auto end = std::min(begin + records_per_block, num_common);
+            const auto offset = floats_per_record * begin;
+            const auto bytes = sizeof(float) * floats_per_record * (end - begin);
+            if (std::memcmp(previous.data() + offset, current.data() + offset, bytes) != 0)
+            {
+                changed.add(begin, end);
+            }
+        }
+
+        changed.add(num_common, num_current);
+    }
+
+    /// The transfers that bring a GPU buffer of records and its previous snapshot up to date, such as those
+    /// of a particle set (see GlParticleBuffer) or of instances (see GlInstanceBuffer).
+    ///
+    /// The previous snapshot equals the current records except for those that changed in the last snapshot.
+    /// Whenever records are modified, a new snapshot is started, in which the current records become the previous
+    /// snapshot, so only the records that changed in the last snapshot need to be copied.
+    struct SnapshotTransfers
+    {
+        /// The records to copy into the previous snapshot before uploading, so that the records that changed
+        /// in the last snapshot become the previous snapshot.
+        DirtyRanges copy_before_upload;
+
+        /// The records to upload.
+        DirtyRanges upload;
+
+        /// The records to copy into the previous snapshot after uploading, which are the records that have
+        /// no previous snapshot to interpolate from.
+        DirtyRanges copy_after_upload;
+    };
+
+    /// Plans the transfers of `size` records to a GPU buffer that holds `uploaded_size` records.
+    /// `changed` are the records that changed in the last snapshot, and `modified` those modified
+    /// since the last upload, which start a new snapshot. `replaced` are the modified records whose index
+    /// held a different record at the last upload, e.g. because records were moved, or removed and added again,
+    /// which have no previous snapshot. If `upload_all` is true, the buffer holds nothing useful,
+    /// and all records are uploaded without a previous snapshot.
+    inline void plan_snapshot_transfers(bool upload_all,
+                                        const DirtyRanges & changed,
+                                        const DirtyRanges & modified,
+                                        const DirtyRanges & replaced,
+                                        size_t uploaded_size,
+                                        size_t size,
+                                        SnapshotTransfers & transfers)
+    {
+        transfers.copy_before_upload.clear();
+        transfers.upload.clear();
+        transfers.copy_after_upload.clear();
+
+        if (upload_all)
+        {
+            transfers.upload.add(0, size);
+            transfers.copy_after_upload.add(0, size);
+        }
+        else if (!modified.empty())
+        {
+            transfers.copy_before_upload = changed;
+            transfers.copy_before_upload.truncate(std::min(uploaded_size, size));
+            transfers.upload = modified;
+            transfers.upload.truncate(size);
+
+            // Replaced and appended records would otherwise be blended in from whatever
+            // the previous snapshot held at their indices
+            transfers.copy_after_upload = replaced;
+            transfers.copy_after_upload.truncate(size);
+            if (size > uploaded_size)
+            {
+                transfers.copy_after_upload.add(uploaded_size, size);
+            }
+        }
+    }
+}
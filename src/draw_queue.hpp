@@ -0,0 +1,245 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "instance_data.hpp"
+#include "particle_sort.hpp"
+
+namespace merely3d
+{
+    class GlInstanceTexture;
+
+    /// A draw call of opaque triangles, deferred so that draw calls can be reordered before they are issued.
+    struct OpaqueDraw
+    {
+        /// The vertex array that binds the geometry, and for instanced draws, the instance attributes.
+        GLuint  vertex_array;
+
+        /// Whether `first` and `count` refer to the indices of the element buffer bound to the vertex array,
+        /// rather than to consecutive vertices.
+        bool    indexed;
+        GLint   first;
+        GLsizei count;
+
+        /// The value added to each index of an indexed draw.
+        GLint   base_vertex;
+
+        /// The number of instances to draw, or 0 for a non-instanced draw.
+        GLsizei instance_count;
+
+        /// The index of the first instance record in `instance_texture`, or -1 if the instances are given
+        /// by the per-instance attributes of the vertex array.
+        GLint   instance_base;
+
+        /// The instance texture that the records of the draw are fetched from, if any. Draws of static batches
+        /// are not instanced, but fetch the record of each vertex (see GlStaticBatch).
+        const GlInstanceTexture * instance_texture;
+
+        /// The shading features used by the instances of the draw (see shading_features),
+        /// which determine the variant of the mesh shader it is drawn with.
+        unsigned int shading;
+
+        static OpaqueDraw arrays(GLint first, GLsizei count)
+        {
+            return OpaqueDraw { 0, false, first, count, 0, 0, -1, nullptr, SHADING_ALL };
+        }
+
+        static OpaqueDraw elements(GLsizei count)
+        {
+            return OpaqueDraw { 0, true, 0, count, 0, 0, -1, nullptr, SHADING_ALL };
+        }
+
+        /// An indexed draw of `count` indices starting at index `first`, whose indices are relative to `base_vertex`.
+        static OpaqueDraw elements(GLint first, GLsizei count, GLint base_vertex)
+        {
+            return OpaqueDraw { 0, true, first, count, base_vertex, 0, -1, nullptr, SHADING_ALL };
+        }
+    };
+
+    /// The number of bits of the sort key of a draw that hold its quantized view depth.
+    const unsigned int DRAW_KEY_DEPTH_BITS = 24;
+
+    /// The number of bits of the sort key of a draw that identify its shader program.
+    const unsigned int DRAW_KEY_PROGRAM_BITS = 2 + SHADING_FEATURE_BITS;
+
+    /// Quantizes a view depth (i.e. distance along the viewing direction) into DRAW_KEY_DEPTH_BITS bits,
+    /// preserving order. Depths behind the camera are all mapped to 0.
+    inline uint32_t quantize_view_depth(float depth)
+    {
+        // Negated comparison, so that NaN also maps to 0
+        if (!(depth > 0.0f))
+        {
+            return 0;
+        }
+
+        // The bit patterns of non-negative floats are ordered like the floats themselves, so their most
+        // significant bits make for a quantization with constant relative precision, regardless of scale
+        uint32_t bits;
+        static_assert(sizeof(bits) == sizeof(depth), "Float must be 32 bits");
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (31 - DRAW_KEY_DEPTH_BITS);
+    }
+
+    /// Returns the sort key of a draw whose nearest geometry is at the given view depth.
+    ///
+    /// The shader program occupies the most significant bits, so that all draws using the same program
+    /// are consecutive, followed by the quantized depth, so that these are ordered front to back.
+    /// The program is determined by where the instance records are read from and by the shading features.
+    /// Draws with edges come after all other draws: the anti-aliased edges are blended with what has already
+    /// been drawn behind them, and since they also write depth, anything drawn behind them later would be hidden.
+    /// Vertex arrays are not part of the key: draws of meshes that read instances from the instance texture all
+    /// share the same vertex array, and every other draw has a vertex array of its own.
+    inline uint32_t opaque_draw_key(const OpaqueDraw & draw, float view_depth)
+    {
+        const uint32_t edges = (draw.shading & SHADING_EDGES) != 0 ? 1u : 0u;
+        const uint32_t textured = draw.instance_base >= 0 ? 1u : 0u;
+        const uint32_t program = (((edges << 1) | textured) << SHADING_FEATURE_BITS) | draw.shading;
+        return (program << DRAW_KEY_DEPTH_BITS) | quantize_view_depth(view_depth);
+    }
+
+    /// Returns the smallest view depth among the positions of the given instance records,
+    /// or infinity if there are no records.
+    inline float nearest_view_depth(const std::vector<float> & instances, const Eigen::Affine3f & view)
+    {
+        assert(instances.size() % FLOATS_PER_INSTANCE == 0);
+
+        // The camera looks along the negative z-axis of view space
+        const Eigen::Vector4f depth_row = -view.matrix().row(2).transpose();
+        float nearest = std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < instances.size(); i += FLOATS_PER_INSTANCE)
+        {
+            const float * position = instances.data() + i + INSTANCE_POSITION_OFFSET;
+            const float depth = depth_row(0) * position[0]
+                              + depth_row(1) * position[1]
+                              + depth_row(2) * position[2]
+                              + depth_row(3);
+            nearest = std::min(nearest, depth);
+        }
+        return nearest;
+    }
+
+    /// Collects the opaque draws of a frame, and orders them by their sort keys (see opaque_draw_key).
+    class DrawQueue
+    {
+    public:
+        void push(const OpaqueDraw & draw, float view_depth)
+        {
+            _keys.push_back(opaque_draw_key(draw, view_depth));
+            _draws.push_back(draw);
+        }
+
+        /// Sorts the draws by key with a radix sort. Draws with equal keys keep the order in which they were pushed.
+        void sort();
+
+        /// The draws of the queue, in sorted order if sort() has been called since the last push.
+        const std::vector<OpaqueDraw> & draws() const
+        {
+            return _draws;
+        }
+
+        void clear()
+        {
+            _draws.clear();
+            _keys.clear();
+        }
+
+    private:
+        std::vector<OpaqueDraw> _draws;
+        std::vector<uint32_t>   _keys;
+
+        // Scratch space for sorting
+        std::vector<OpaqueDraw> _sorted;
+        std::vector<uint32_t>   _order;
+        std::vector<uint32_t>   _key_scratch;
+        std::vector<uint32_t>   _order_scratch;
+    };
+
+    /// A command of glMultiDrawElementsIndirect, in the layout the GL reads it in.
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint  base_vertex;
+        GLuint base_instance;
+    };
+
+    /// The draws of a single shader program that are issued together by one call
+    /// to glMultiDrawElementsIndirect (see GlIndirectDraws).
+    struct IndirectBatch
+    {
+        /// The index of the first draw of the batch among the sorted draws, in whose place the batch is issued.
+        size_t first_draw;
+        size_t first_command;
+        size_t command_count;
+    };
+
+    /// Whether the draw may be issued as part of an indirect batch over the given vertex array, which holds
+    /// for the indexed draws that fetch their instances from an instance texture.
+    inline bool is_indirect_draw(const OpaqueDraw & draw, GLuint vertex_array)
+    {
+        return draw.vertex_array == vertex_array && draw.indexed && draw.instance_count > 0 && draw.instance_base >= 0;
+    }
+
+    /// Gathers the commands of the indirect draws over the given vertex array (see is_indirect_draw) into one batch
+    /// per shader program, in the order of the draws. The draws must be sorted (see DrawQueue::sort), so that all draws
+    /// of the same program are consecutive. The first instance record of each draw becomes its base instance.
+    inline void plan_indirect_batches(const std::vector<OpaqueDraw> & draws,
+                                      GLuint vertex_array,
+                                      std::vector<DrawElementsIndirectCommand> & commands,
+                                      std::vector<IndirectBatch> & batches)
+    {
+        commands.clear();
+        batches.clear();
+        for (size_t i = 0; i < draws.size(); ++i)
+        {
+            const auto & draw = draws[i];
+            if (!is_indirect_draw(draw, vertex_array))
+            {
+                continue;
+            }
+
+            // All indirect draws fetch their instances from a texture, so their program is given by their shading
+            if (batches.empty() || draws[batches.back().first_draw].shading != draw.shading)
+            {
+                batches.push_back(IndirectBatch { i, commands.size(), 0 });
+            }
+            commands.push_back(DrawElementsIndirectCommand {
+                static_cast<GLuint>(draw.count),
+                static_cast<GLuint>(draw.instance_count),
+                static_cast<GLuint>(draw.first),
+                draw.base_vertex,
+                static_cast<GLuint>(draw.instance_base)
+            });
+            ++batches.back().command_count;
+        }
+    }
+
+    inline void DrawQueue::sort()
+    {
+        _order.resize(_draws.size());
+        for (size_t i = 0; i < _order.size(); ++i)
+        {
+            _order[i] = static_cast<uint32_t>(i);
+        }
+
+        // There are rarely more than a few hundred draws, which is too few to pay off with multiple threads
+        radix_sort_by_key(_keys, _order, _key_scratch, _order_scratch, DRAW_KEY_DEPTH_BITS + DRAW_KEY_PROGRAM_BITS, 1);
+
+        _sorted.clear();
+        for (const auto index : _order)
+        {
+            _sorted.push_back(_draws[index]);
+        }
+        _draws.swap(_sorted);
+    }
+}
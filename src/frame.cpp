@@ -1,6 +1,9 @@
 #include <merely3d/frame.hpp>
 
 #include "command_buffer.hpp"
+#include "mesh_registry.hpp"
+
+#include <stdexcept>
 
 using Eigen::Transform;
 using Eigen::Translation3f;
@@ -37,6 +40,16 @@ namespace merely3d
         _buffer->push_renderable(mesh);
     }
 
+    template <>
+    void Frame::draw(const merely3d::Renderable<MeshHandle> & mesh)
+    {
+        if (!_meshes->contains(mesh.shape))
+        {
+            throw std::invalid_argument("Mesh handle does not refer to a mesh registered with the window.");
+        }
+        _buffer->push_renderable(mesh);
+    }
+
     void Frame::draw_line(const merely3d::Line &line)
     {
         _buffer->push_line(line);
@@ -46,4 +59,24 @@ namespace merely3d
     {
         _buffer->push_particle(particle);
     }
+
+    void Frame::draw_particle(const merely3d::ScalarParticle & particle)
+    {
+        _buffer->push_scalar_particle(particle);
+    }
+
+    void Frame::draw_particles(const ParticleSet & particles)
+    {
+        _buffer->push_particle_set(particles);
+    }
+
+    void Frame::set_particle_options(const ParticleOptions & options)
+    {
+        _buffer->set_particle_options(options);
+    }
+
+    void Frame::set_interpolation(float interpolation)
+    {
+        _buffer->set_interpolation(interpolation);
+    }
 }
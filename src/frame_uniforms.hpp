@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <merely3d/camera.hpp>
+#include <merely3d/color.hpp>
+
+#include <algorithm>
+
+namespace merely3d
+{
+    /// The name of the uniform block declared by frame_uniforms.glsl.
+    const char * const FRAME_UNIFORMS_BLOCK = "FrameUniforms";
+
+    /// The uniform buffer binding point that all programs read the FrameUniforms block from.
+    const unsigned int FRAME_UNIFORMS_BINDING = 0;
+
+    /// The contents of the FrameUniforms block, laid out according to the std140 rules.
+    ///
+    /// Matrices are stored in column-major order. Every vec3 is followed by a float,
+    /// which together occupy the 16 bytes that std140 aligns a vec3 to.
+    struct FrameUniformData
+    {
+        float view[16];
+        float projection[16];
+        float inv_projection[16];
+        float camera_position[3];
+        float near_plane_dist;
+        float light_color[3];
+        float padding0;
+        float light_dir[3];
+        float padding1;
+        float light_dir_eye[3];
+        float padding2;
+    };
+
+    static_assert(sizeof(FrameUniformData) == 3 * 64 + 4 * 16, "FrameUniformData must match the std140 layout");
+
+    /// Computes the per-frame uniforms for the given camera and projection.
+    ///
+    /// The projection is inverted here, once per frame, rather than by every program that needs the inverse.
+    inline FrameUniformData make_frame_uniforms(const Camera & camera, const Eigen::Matrix4f & projection)
+    {
+        const Eigen::Affine3f view = camera.transform().inverse();
+        const Eigen::Matrix4f inv_projection = projection.inverse();
+
+        // TODO: Make lighting configurable rather than hard-coded
+        const auto light_color = Color(1.0, 1.0, 1.0).into_array();
+        const Eigen::Vector3f light_dir = Eigen::Vector3f(0.9, 1.2, -0.8).normalized();
+        const Eigen::Vector3f light_dir_eye = view.linear() * light_dir;
+        const Eigen::Vector3f camera_position = camera.position();
+
+        FrameUniformData data;
+        std::copy(view.data(), view.data() + 16, data.view);
+        std::copy(projection.data(), projection.data() + 16, data.projection);
+        std::copy(inv_projection.data(), inv_projection.data() + 16, data.inv_projection);
+        std::copy(camera_position.data(), camera_position.data() + 3, data.camera_position);
+        std::copy(light_color.begin(), light_color.end(), data.light_color);
+        std::copy(light_dir.data(), light_dir.data() + 3, data.light_dir);
+        std::copy(light_dir_eye.data(), light_dir_eye.data() + 3, data.light_dir_eye);
+        data.padding0 = data.padding1 = data.padding2 = 0.0f;
+
+        // Compute the distance to the near plane by transforming from a point on the near plane in
+        // NDC to view space. We have that
+        //  n = P * X / N,
+        // where N is the distance to the near plane, X = [x, 1] and x are the coordinate in
+        // view space, and n represents the coordinates in NDC. Letting Y = X / N,
+        // we have that N = 1 / Y_w, where Y = P^-1 * n.
+        data.near_plane_dist = 1.0 / (inv_projection * Eigen::Vector4f(0.0, 0.0, -1.0, 1.0)).w();
+
+        return data;
+    }
+}
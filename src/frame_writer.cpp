@@ -0,0 +1,276 @@
+#include "frame_writer.hpp"
+
+#include <cassert>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include "png_writer.hpp"
+
+namespace merely3d
+{
+    namespace
+    {
+        std::FILE * open_pipe(const std::string & command)
+        {
+#ifdef _WIN32
+            return _popen(command.c_str(), "wb");
+#else
+            return popen(command.c_str(), "w");
+#endif
+        }
+
+        int close_pipe(std::FILE * pipe)
+        {
+#ifdef _WIN32
+            return _pclose(pipe);
+#else
+            return pclose(pipe);
+#endif
+        }
+    }
+
+    std::string capture_file_name(const std::string & pattern, size_t index)
+    {
+        const auto end = pattern.find_last_of('#');
+        assert(end != std::string::npos);
+        const auto begin = pattern.find_last_not_of('#', end);
+        const auto first = begin == std::string::npos ? 0 : begin + 1;
+        const auto width = end + 1 - first;
+
+        auto digits = std::to_string(index);
+        if (digits.size() < width)
+        {
+            digits.insert(0, width - digits.size(), '0');
+        }
+        return pattern.substr(0, first) + digits + pattern.substr(end + 1);
+    }
+
+    FrameWriter::FrameWriter(const CaptureTarget & target)
+        : _target(target),
+          _pipe(nullptr),
+          _unreleased(0),
+          _submitted(0),
+          _written(0),
+          _skipped(0),
+          _stop(false),
+          _stream_width(0),
+          _stream_height(0)
+    {
+        if (_target.is_pipe())
+        {
+            _pipe = open_pipe(_target.destination());
+            if (!_pipe)
+            {
+                throw std::runtime_error("Failed to start the capture command: " + _target.destination());
+            }
+        }
+        _thread = std::thread([this] { run(); });
+    }
+
+    FrameWriter::~FrameWriter()
+    {
+        if (_thread.joinable())
+        {
+            try
+            {
+                finish();
+            }
+            catch (const std::runtime_error &)
+            {
+                // Errors can only be reported through finish()
+            }
+        }
+    }
+
+    void FrameWriter::submit(const unsigned char * rgba, int width, int height, size_t slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.push_back(Job { rgba, width, height, slot });
+            ++_unreleased;
+        }
+        _wake.notify_one();
+    }
+
+    bool FrameWriter::take_released(size_t & slot, bool wait)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (wait)
+        {
+            _released_changed.wait(lock, [this] { return !_released.empty() || _unreleased == 0; });
+        }
+
+        if (_released.empty())
+        {
+            return false;
+        }
+        slot = _released.back();
+        _released.pop_back();
+        return true;
+    }
+
+    void FrameWriter::finish()
+    {
+        assert(_thread.joinable());
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_one();
+        _thread.join();
+
+        if (_pipe)
+        {
+            // Waits for the command to exit, e.g. for an encoder to finish the video
+            const auto status = close_pipe(_pipe);
+            _pipe = nullptr;
+            if (status != 0 && _error.empty())
+            {
+                _error = "The capture command failed: " + _target.destination();
+            }
+        }
+
+        if (!_error.empty())
+        {
+            throw std::runtime_error(_error);
+        }
+    }
+
+    size_t FrameWriter::frames_written() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _written;
+    }
+
+    size_t FrameWriter::frames_skipped() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _skipped;
+    }
+
+    void FrameWriter::run()
+    {
+#ifndef _WIN32
+        // If the capture command exits early, writing to the pipe raises SIGPIPE, which by default terminates
+        // the process. With the signal blocked on this thread, the write fails with an error instead.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true)
+        {
+            _wake.wait(lock, [this] { return !_jobs.empty() || _stop; });
+            if (_jobs.empty())
+            {
+                return;
+            }
+
+            const auto job = _jobs.front();
+            _jobs.pop_front();
+            const auto index = _submitted++;
+            const bool failed = !_error.empty();
+            lock.unlock();
+
+            // The pixels are converted first, so that their slot can be reused while the frame is written
+            const auto size = 3 * static_cast<size_t>(job.width) * static_cast<size_t>(job.height);
+            if (!failed)
+            {
+                _rgb.resize(size);
+                rgba_to_rgb_top_down(job.rgba, job.width, job.height, _rgb.data());
+            }
+
+            lock.lock();
+            _released.push_back(job.slot);
+            --_unreleased;
+            lock.unlock();
+            _released_changed.notify_all();
+
+            bool written = false;
+            std::string error;
+            if (!failed)
+            {
+                try
+                {
+                    written = write(job, index);
+                }
+                catch (const std::runtime_error & e)
+                {
+                    error = e.what();
+                }
+            }
+
+            lock.lock();
+            if (written)
+            {
+                ++_written;
+            }
+            else
+            {
+                ++_skipped;
+            }
+            if (!error.empty() && _error.empty())
+            {
+                _error = error;
+            }
+        }
+    }
+
+    bool FrameWriter::write(const Job & job, size_t index)
+    {
+        if (_target.is_pipe())
+        {
+            // The stream has no header, so every frame must have the size of the first
+            if (_stream_width == 0)
+            {
+                _stream_width = job.width;
+                _stream_height = job.height;
+            }
+            if (job.width != _stream_width || job.height != _stream_height)
+            {
+                return false;
+            }
+
+            if (std::fwrite(_rgb.data(), 1, _rgb.size(), _pipe) != _rgb.size())
+            {
+                throw std::runtime_error("The capture command stopped reading frames: " + _target.destination());
+            }
+            return true;
+        }
+
+        const auto file_name = capture_file_name(_target.destination(), index);
+        std::ofstream file(file_name, std::ios::binary);
+        if (file)
+        {
+            switch (_target.format())
+            {
+                case CaptureFormat::Png:
+                {
+                    PngWriter png(file, job.width, job.height);
+                    const auto row_size = 3 * static_cast<size_t>(job.width);
+                    for (int y = 0; y < job.height; ++y)
+                    {
+                        png.write_row(_rgb.data() + row_size * static_cast<size_t>(y));
+                    }
+                    png.finish();
+                    break;
+                }
+                case CaptureFormat::Raw:
+                    file.write(reinterpret_cast<const char *>(_rgb.data()), static_cast<std::streamsize>(_rgb.size()));
+                    break;
+            }
+        }
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write the captured frame " + file_name);
+        }
+        return true;
+    }
+}
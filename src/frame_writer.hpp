@@ -0,0 +1,99 @@
+#pragma once
+
+#include <merely3d/capture.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace merely3d
+{
+    /// Returns the name of the file of the captured frame with the given index, i.e. the pattern
+    /// with its last run of '#' characters replaced by the index, zero-padded to the length of the run.
+    std::string capture_file_name(const std::string & pattern, size_t index);
+
+    /// Writes captured frames to a CaptureTarget on a thread of its own, so that encoding the frames
+    /// and waiting for the disk or the receiving command does not hold up rendering.
+    ///
+    /// The writer works directly on the pixels handed to it, which are typically the mapped memory
+    /// of pixel buffer objects. Each frame is identified by a slot, which is released once the writer
+    /// no longer needs its pixels, which is before the frame is written.
+    class FrameWriter
+    {
+    public:
+        /// Starts the thread of the writer, and, if the target is a pipe, the command.
+        ///
+        /// Throws std::runtime_error if the command cannot be started.
+        explicit FrameWriter(const CaptureTarget & target);
+
+        FrameWriter(const FrameWriter & other) = delete;
+        FrameWriter & operator=(const FrameWriter & other) = delete;
+
+        /// Waits for the queued frames to be written, ignoring any errors (see finish()).
+        ~FrameWriter();
+
+        /// Queues a frame for writing. The RGBA pixels, whose bottom row comes first as read by glReadPixels,
+        /// must stay valid until the slot has been released (see take_released()).
+        void submit(const unsigned char * rgba, int width, int height, size_t slot);
+
+        /// Returns whether a slot has been released since it was last asked for, and if so, stores it in `slot`.
+        /// If `wait` is true and frames are still queued, waits for the next slot to be released.
+        bool take_released(size_t & slot, bool wait);
+
+        /// Waits for all queued frames to be written, and closes the target. All slots have been released
+        /// afterwards. Must be called once only.
+        ///
+        /// Throws std::runtime_error if any frame could not be written. Once a frame fails, the remaining
+        /// frames are skipped.
+        void finish();
+
+        /// The number of frames that were written so far.
+        size_t frames_written() const;
+
+        /// The number of frames that were skipped, since their size differed from the size of a stream,
+        /// or since writing an earlier frame failed.
+        size_t frames_skipped() const;
+
+    private:
+        struct Job
+        {
+            const unsigned char * rgba;
+            int width;
+            int height;
+            size_t slot;
+        };
+
+        void run();
+
+        /// Writes the converted frame to the target, and returns whether it was written rather than skipped.
+        /// Throws std::runtime_error on failure.
+        bool write(const Job & job, size_t index);
+
+        const CaptureTarget                 _target;
+        std::FILE *                         _pipe;
+
+        mutable std::mutex                  _mutex;
+        std::condition_variable             _wake;
+        std::condition_variable             _released_changed;
+        std::deque<Job>                     _jobs;
+        std::vector<size_t>                 _released;
+        size_t                              _unreleased;
+        size_t                              _submitted;
+        size_t                              _written;
+        size_t                              _skipped;
+        bool                                _stop;
+        std::string                         _error;
+
+        // Only used by the thread of the writer
+        std::vector<unsigned char>          _rgb;
+        int                                 _stream_width;
+        int                                 _stream_height;
+
+        std::thread                         _thread;
+    };
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+namespace merely3d
+{
+    /// A view frustum represented by the six planes bounding the
+    /// region of space that is visible through a given view-projection transform.
+    class Frustum
+    {
+    public:
+        /// Extracts the frustum planes from the given (projection * view) transform.
+        ///
+        /// Works for the "infinite" projection used by merely3d, in which case
+        /// the far plane degenerates into a plane that contains all points.
+        static Frustum from_view_projection(const Eigen::Matrix4f & view_projection);
+
+        /// Returns false only if the box is guaranteed to lie entirely outside of the frustum.
+        ///
+        /// The test is conservative: boxes near the corners of the frustum may
+        /// be reported as intersecting even if they are not visible.
+        bool intersects(const Eigen::AlignedBox3f & box) const;
+
+    private:
+        Frustum() {}
+
+        // Each row represents a plane (n, d) such that n^T x + d >= 0
+        // for points x inside the frustum.
+        Eigen::Matrix<float, 6, 4, Eigen::RowMajor | Eigen::DontAlign> _planes;
+    };
+
+    inline Frustum Frustum::from_view_projection(const Eigen::Matrix4f & m)
+    {
+        Frustum frustum;
+        frustum._planes.row(0) = m.row(3) + m.row(0);
+        frustum._planes.row(1) = m.row(3) - m.row(0);
+        frustum._planes.row(2) = m.row(3) + m.row(1);
+        frustum._planes.row(3) = m.row(3) - m.row(1);
+        frustum._planes.row(4) = m.row(3) + m.row(2);
+        frustum._planes.row(5) = m.row(3) - m.row(2);
+        return frustum;
+    }
+
+    inline bool Frustum::intersects(const Eigen::AlignedBox3f & box) const
+    {
+        if (box.isEmpty())
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 6; ++i)
+        {
+            const Eigen::Vector3f normal = _planes.row(i).head<3>().transpose();
+
+            // The corner of the box that is furthest along the plane normal
+            const Eigen::Vector3f corner = (normal.array() >= 0.0f).select(box.max(), box.min());
+            if (normal.dot(corner) + _planes(i, 3) < 0.0f)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
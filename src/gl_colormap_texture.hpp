@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <merely3d/colormap.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "gl_gc.hpp"
+
+namespace merely3d
+{
+    /// A 1D texture holding a lookup table for one of the built-in colormaps.
+    ///
+    /// To map a value t in [0, 1] to the center of the first and last texels, shaders
+    /// should sample the texture at (t * (LUT_SIZE - 1) + 0.5) / LUT_SIZE.
+    class GlColormapTexture
+    {
+    public:
+        static const int LUT_SIZE = 256;
+
+        GlColormapTexture(GlColormapTexture && other) noexcept
+            : _texture(other._texture), _colormap(other._colormap), _garbage(other._garbage)
+        {
+            other._garbage.reset();
+        }
+
+        ~GlColormapTexture()
+        {
+            if (_garbage)
+            {
+                _garbage->delete_texture_later(_texture);
+            }
+        }
+
+        GlColormapTexture(const GlColormapTexture & other) = delete;
+        GlColormapTexture & operator=(const GlColormapTexture & other) = delete;
+        GlColormapTexture & operator=(GlColormapTexture && other) = delete;
+
+        /// Creates a texture holding the lookup table for the given colormap.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlColormapTexture create(const std::shared_ptr<GlGarbagePile> & garbage, Colormap colormap);
+
+        /// Replaces the lookup table if the texture currently holds a different colormap.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        void set_colormap(Colormap colormap);
+
+        /// Binds the texture to the given texture unit.
+        void bind(GLenum texture_unit);
+
+    private:
+        GlColormapTexture(const std::shared_ptr<GlGarbagePile> & garbage, GLuint texture, Colormap colormap)
+            : _texture(texture), _colormap(colormap), _garbage(garbage)
+        {}
+
+        static void upload_lookup_table(Colormap colormap);
+
+        GLuint      _texture;
+        Colormap    _colormap;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+
+    inline void GlColormapTexture::upload_lookup_table(Colormap colormap)
+    {
+        std::vector<float> lut;
+        lut.reserve(3 * LUT_SIZE);
+        for (int i = 0; i < LUT_SIZE; ++i)
+        {
+            const auto color = evaluate_colormap(colormap, static_cast<float>(i) / (LUT_SIZE - 1));
+            lut.push_back(color.r());
+            lut.push_back(color.g());
+            lut.push_back(color.b());
+        }
+
+        glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, LUT_SIZE, 0, GL_RGB, GL_FLOAT, lut.data());
+    }
+
+    inline GlColormapTexture GlColormapTexture::create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                                       Colormap colormap)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_1D, texture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        upload_lookup_table(colormap);
+        glBindTexture(GL_TEXTURE_1D, 0);
+
+        return GlColormapTexture(garbage, texture, colormap);
+    }
+
+    inline void GlColormapTexture::set_colormap(Colormap colormap)
+    {
+        if (colormap != _colormap)
+        {
+            glBindTexture(GL_TEXTURE_1D, _texture);
+            upload_lookup_table(colormap);
+            glBindTexture(GL_TEXTURE_1D, 0);
+            _colormap = colormap;
+        }
+    }
+
+    inline void GlColormapTexture::bind(GLenum texture_unit)
+    {
+        glActiveTexture(texture_unit);
+        glBindTexture(GL_TEXTURE_1D, _texture);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+namespace merely3d
+{
+    /// Whether the current context supports the given extension.
+    inline bool has_gl_extension(const char * name)
+    {
+        GLint num_extensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+        for (GLint i = 0; i < num_extensions; ++i)
+        {
+            const auto extension = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i));
+            if (extension && std::strcmp(reinterpret_cast<const char *>(extension), name) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Whether the OpenGL version of the current context is at least the given version.
+    inline bool has_gl_version(GLint major, GLint minor)
+    {
+        GLint context_major = 0, context_minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+        glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+        return context_major > major || (context_major == major && context_minor >= minor);
+    }
+}
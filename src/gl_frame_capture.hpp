@@ -0,0 +1,273 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <merely3d/capture.hpp>
+
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "frame_writer.hpp"
+#include "gl_errors.hpp"
+#include "gl_gc.hpp"
+
+namespace merely3d
+{
+    /// The number of pixel buffer objects that captured frames cycle through.
+    ///
+    /// A frame is normally handed to the writer once the GPU has finished reading it back, which is checked
+    /// on every following frame without waiting. Only when all buffers are in use does capturing wait,
+    /// either for the oldest readback or for the writer, which happens 2-3 frames after the readback.
+    const size_t CAPTURE_BUFFER_COUNT = 3;
+
+    /// Captures rendered frames without stalling the pipeline, by reading them back asynchronously into
+    /// pixel buffer objects, and handing the mapped buffers to a FrameWriter once a fence shows that
+    /// the readback has completed.
+    class GlFrameCapture
+    {
+    public:
+        GlFrameCapture(GlFrameCapture && other) = default;
+        GlFrameCapture(const GlFrameCapture & other) = delete;
+        GlFrameCapture & operator=(const GlFrameCapture & other) = delete;
+
+        /// Waits for the captured frames to be written, ignoring any errors (see finish()).
+        ///
+        /// The correct OpenGL context MUST be current when the capture is destroyed.
+        ~GlFrameCapture();
+
+        /// Starts a capture into the given target. The buffers are allocated on the first capture.
+        ///
+        /// Throws std::runtime_error if the target is a pipe whose command cannot be started.
+        static GlFrameCapture create(const std::shared_ptr<GlGarbagePile> & garbage, const CaptureTarget & target);
+
+        /// Reads back the given rectangle of the current read framebuffer. The pixel pack buffer binding must be 0.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to calling this function.
+        void capture(int width, int height);
+
+        /// Waits for all captured frames to be written, and closes the target.
+        ///
+        /// Throws std::runtime_error if any frame could not be written (see FrameWriter::finish()).
+        /// Note that the correct OpenGL context MUST be set prior to calling this function.
+        void finish();
+
+    private:
+        enum class SlotState
+        {
+            Free,
+            Reading,
+            Writing
+        };
+
+        struct Slot
+        {
+            GLuint buffer;
+            size_t size;
+            GLsync fence;
+            int width;
+            int height;
+            SlotState state;
+        };
+
+        GlFrameCapture(const std::shared_ptr<GlGarbagePile> & garbage, std::unique_ptr<FrameWriter> writer)
+            : _slots(CAPTURE_BUFFER_COUNT, Slot { 0, 0, nullptr, 0, 0, SlotState::Free }),
+              _writer(std::move(writer)),
+              _garbage(garbage)
+        {}
+
+        /// Unmaps the buffers of the slots released by the writer. Waits for a slot if `wait` is true.
+        void reclaim_released(bool wait);
+
+        /// Maps the buffer of the oldest readback and hands it to the writer. If `wait` is false,
+        /// only does so if the readback has already completed. Returns whether the readback was handed over.
+        bool hand_over_oldest(bool wait);
+
+        /// Returns the index of a free slot, waiting for one if necessary.
+        size_t free_slot();
+
+        std::vector<Slot>               _slots;
+
+        // The slots that are being read back, oldest first
+        std::deque<size_t>              _reading;
+
+        std::unique_ptr<FrameWriter>    _writer;
+        std::shared_ptr<GlGarbagePile>  _garbage;
+    };
+
+    inline GlFrameCapture GlFrameCapture::create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                                 const CaptureTarget & target)
+    {
+        return GlFrameCapture(garbage, std::unique_ptr<FrameWriter>(new FrameWriter(target)));
+    }
+
+    inline GlFrameCapture::~GlFrameCapture()
+    {
+        // Moved-from captures have no writer
+        if (_writer)
+        {
+            try
+            {
+                finish();
+            }
+            catch (const std::runtime_error &)
+            {
+                // Errors can only be reported through finish()
+            }
+        }
+    }
+
+    inline void GlFrameCapture::capture(int width, int height)
+    {
+        assert(_writer);
+        if (width <= 0 || height <= 0)
+        {
+            return;
+        }
+
+        // Frames read back in earlier frames are handed over as soon as they are ready, but never waited for here
+        reclaim_released(false);
+        while (!_reading.empty() && hand_over_oldest(false)) {}
+
+        auto & slot = _slots[free_slot()];
+        const auto size = 4 * static_cast<size_t>(width) * static_cast<size_t>(height);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (slot.size < size)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+            slot.size = size;
+        }
+
+        // RGBA is the native layout of the framebuffer, so that the driver can copy it without conversion
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = width;
+        slot.height = height;
+        slot.state = SlotState::Reading;
+        _reading.push_back(static_cast<size_t>(&slot - _slots.data()));
+    }
+
+    inline void GlFrameCapture::finish()
+    {
+        assert(_writer);
+        while (!_reading.empty())
+        {
+            hand_over_oldest(true);
+        }
+
+        // The writer has released every slot once it has finished, even if it failed
+        auto release_buffers = [this] ()
+        {
+            reclaim_released(false);
+            for (auto & slot : _slots)
+            {
+                assert(slot.state == SlotState::Free);
+                if (slot.buffer != 0)
+                {
+                    _garbage->delete_buffer_later(slot.buffer);
+                    slot.buffer = 0;
+                }
+            }
+            _writer.reset();
+        };
+
+        try
+        {
+            _writer->finish();
+        }
+        catch (...)
+        {
+            release_buffers();
+            throw;
+        }
+        release_buffers();
+    }
+
+    inline void GlFrameCapture::reclaim_released(bool wait)
+    {
+        size_t index;
+        while (_writer->take_released(index, wait))
+        {
+            auto & slot = _slots[index];
+            assert(slot.state == SlotState::Writing);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.state = SlotState::Free;
+
+            // Only a single slot is waited for
+            wait = false;
+        }
+    }
+
+    inline bool GlFrameCapture::hand_over_oldest(bool wait)
+    {
+        assert(!_reading.empty());
+        auto & slot = _slots[_reading.front()];
+        assert(slot.state == SlotState::Reading);
+
+        const GLuint64 timeout = wait ? 1000000000ull : 0;
+        GLenum status;
+        do
+        {
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        }
+        while (wait && status == GL_TIMEOUT_EXPIRED);
+
+        // Should waiting fail, mapping the buffer waits for the readback anyway
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            return false;
+        }
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        _reading.pop_front();
+
+        const auto size = 4 * static_cast<size_t>(slot.width) * static_cast<size_t>(slot.height);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const auto pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+
+        slot.state = SlotState::Writing;
+        _writer->submit(static_cast<const unsigned char *>(pixels), slot.width, slot.height,
+                        static_cast<size_t>(&slot - _slots.data()));
+        return true;
+    }
+
+    inline size_t GlFrameCapture::free_slot()
+    {
+        while (true)
+        {
+            for (size_t i = 0; i < _slots.size(); ++i)
+            {
+                auto & slot = _slots[i];
+                if (slot.state == SlotState::Free)
+                {
+                    if (slot.buffer == 0)
+                    {
+                        glGenBuffers(1, &slot.buffer);
+                    }
+                    return i;
+                }
+            }
+
+            // Either the oldest readback or the writer is behind. Readbacks are handed over first,
+            // so that the writer always has work to do while waiting for it
+            if (!_reading.empty())
+            {
+                hand_over_oldest(true);
+            }
+            else
+            {
+                reclaim_released(true);
+            }
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+
+#include "gl_gc.hpp"
+#include "gl_errors.hpp"
+#include "gl_state.hpp"
+
+namespace merely3d
+{
+    /// An offscreen render target, consisting of a framebuffer object with a
+    /// color texture attachment and optionally a depth texture attachment.
+    ///
+    /// The textures have no storage until ensure_size() is called.
+    class GlFramebuffer
+    {
+    public:
+        GlFramebuffer(GlFramebuffer && other) noexcept;
+        ~GlFramebuffer();
+
+        GlFramebuffer(const GlFramebuffer & other) = delete;
+        GlFramebuffer & operator=(const GlFramebuffer & other) = delete;
+        GlFramebuffer & operator=(GlFramebuffer && other) = delete;
+
+        /// Creates a new framebuffer whose color attachment has the given internal format
+        /// (GL_R32F, GL_RGBA8 or GL_RGBA16F), and a 24-bit depth attachment if `with_depth` is true.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlFramebuffer create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                    GlState & state,
+                                    GLenum color_internal_format,
+                                    bool with_depth);
+
+        /// (Re)allocates the storage of the attachments if the current size differs from the given size.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        void ensure_size(GlState & state, int width, int height);
+
+        /// Binds the framebuffer as the target for rendering.
+        void bind(GlState & state);
+
+        GLuint framebuffer() const { return _fbo; }
+        GLuint color_texture() const { return _color_texture; }
+        GLuint depth_texture() const { return _depth_texture; }
+
+        int width() const { return _width; }
+        int height() const { return _height; }
+
+    private:
+        GlFramebuffer(const std::shared_ptr<GlGarbagePile> & garbage,
+                      GLuint fbo, GLuint color_texture, GLuint depth_texture,
+                      GLenum color_internal_format)
+            : _fbo(fbo), _color_texture(color_texture), _depth_texture(depth_texture),
+              _color_internal_format(color_internal_format), _width(0), _height(0),
+              _garbage(garbage)
+        {}
+
+        GLuint _fbo;
+        GLuint _color_texture;
+        GLuint _depth_texture;
+        GLenum _color_internal_format;
+        int _width;
+        int _height;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+
+    inline GlFramebuffer::GlFramebuffer(GlFramebuffer && other) noexcept
+        : _fbo(other._fbo),
+          _color_texture(other._color_texture),
+          _depth_texture(other._depth_texture),
+          _color_internal_format(other._color_internal_format),
+          _width(other._width),
+          _height(other._height),
+          _garbage(other._garbage)
+    {
+        other._garbage.reset();
+    }
+
+    inline GlFramebuffer::~GlFramebuffer()
+    {
+        if (_garbage)
+        {
+            _garbage->delete_framebuffer_later(_fbo);
+            _garbage->delete_texture_later(_color_texture);
+            if (_depth_texture != 0)
+            {
+                _garbage->delete_texture_later(_depth_texture);
+            }
+        }
+    }
+
+    inline GLuint create_render_texture()
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    inline GlFramebuffer GlFramebuffer::create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                               GlState & state,
+                                               GLenum color_internal_format,
+                                               bool with_depth)
+    {
+        assert(color_internal_format == GL_R32F
+               || color_internal_format == GL_RGBA8
+               || color_internal_format == GL_RGBA16F);
+
+        GLuint fbo;
+        glGenFramebuffers(1, &fbo);
+        const auto color_texture = create_render_texture();
+        const auto depth_texture = with_depth ? create_render_texture() : 0;
+
+        state.with_framebuffer(fbo, [&]
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture, 0);
+            if (with_depth)
+            {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
+            }
+        });
+        MERELY_CHECK_GL_ERRORS();
+
+        return GlFramebuffer(garbage, fbo, color_texture, depth_texture, color_internal_format);
+    }
+
+    inline void GlFramebuffer::ensure_size(GlState & state, int width, int height)
+    {
+        if (width == _width && height == _height)
+        {
+            return;
+        }
+
+        const auto format = _color_internal_format == GL_R32F ? GL_RED : GL_RGBA;
+        const auto type = _color_internal_format == GL_RGBA8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+
+        glBindTexture(GL_TEXTURE_2D, _color_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, _color_internal_format, width, height, 0, format, type, nullptr);
+
+        if (_depth_texture != 0)
+        {
+            glBindTexture(GL_TEXTURE_2D, _depth_texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0,
+                         GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        MERELY_CHECK_GL_ERRORS();
+
+        _width = width;
+        _height = height;
+
+        state.with_framebuffer(_fbo, []
+        {
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            {
+                throw std::runtime_error("Offscreen framebuffer is incomplete.");
+            }
+        });
+    }
+
+    inline void GlFramebuffer::bind(GlState & state)
+    {
+        state.bind_framebuffer(_fbo);
+    }
+}
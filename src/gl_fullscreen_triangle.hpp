@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <memory>
+
+#include "gl_gc.hpp"
+#include "gl_state.hpp"
+
+namespace merely3d
+{
+    /// Helper for drawing a single triangle that covers the entire viewport,
+    /// as used by full-screen post-processing passes.
+    ///
+    /// The triangle has no vertex data: the vertex shader is expected to generate
+    /// its vertices from gl_VertexID (see fullscreen_vertex.glsl). The core profile nevertheless
+    /// requires a vertex array object to be bound, which is what this class holds.
+    class GlFullscreenTriangle
+    {
+    public:
+        GlFullscreenTriangle(GlFullscreenTriangle && other) noexcept
+            : _vao(other._vao), _garbage(other._garbage)
+        {
+            other._garbage.reset();
+        }
+
+        ~GlFullscreenTriangle()
+        {
+            if (_garbage)
+            {
+                _garbage->delete_vertex_array_later(_vao);
+            }
+        }
+
+        GlFullscreenTriangle(const GlFullscreenTriangle & other) = delete;
+        GlFullscreenTriangle & operator=(const GlFullscreenTriangle & other) = delete;
+        GlFullscreenTriangle & operator=(GlFullscreenTriangle && other) = delete;
+
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlFullscreenTriangle create(const std::shared_ptr<GlGarbagePile> & garbage)
+        {
+            GLuint vao;
+            glGenVertexArrays(1, &vao);
+            return GlFullscreenTriangle(garbage, vao);
+        }
+
+        /// Draws the triangle with the currently active shader program.
+        void draw(GlState & state)
+        {
+            state.bind_vertex_array(_vao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+
+    private:
+        GlFullscreenTriangle(const std::shared_ptr<GlGarbagePile> & garbage, GLuint vao)
+            : _vao(vao), _garbage(garbage)
+        {}
+
+        GLuint _vao;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+}
@@ -18,16 +18,172 @@ void GlGarbagePile::delete_element_buffer_later(GLuint ebo)
     _ebo.push_back(ebo);
 }
 
+void GlGarbagePile::delete_buffer_later(GLuint buffer)
+{
+    _buffers.push_back(buffer);
+}
+
+void GlGarbagePile::delete_texture_later(GLuint texture)
+{
+    _textures.push_back(texture);
+}
+
+void GlGarbagePile::delete_framebuffer_later(GLuint fbo)
+{
+    _framebuffers.push_back(fbo);
+}
+
+GLuint GlGarbagePile::acquire_buffer(size_t size)
+{
+    const auto bucket = pooled_buffer_size(size);
+    auto buffer = _buffer_pool.take(bucket);
+    if (buffer == 0)
+    {
+        // The copy binding point is used so that the bindings of the current vertex array are left untouched.
+        // Pooled buffers may be reused for any purpose, so the usage hint is a compromise
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(bucket), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return buffer;
+}
+
+void GlGarbagePile::recycle_buffer_later(GLuint buffer, size_t size)
+{
+    _recycled_buffers.push_back(std::make_pair(buffer, size));
+}
+
+GLuint GlGarbagePile::acquire_vertex_array()
+{
+    if (_free_vertex_arrays.empty())
+    {
+        GLuint vao;
+        glGenVertexArrays(1, &vao);
+        return vao;
+    }
+
+    const auto vao = _free_vertex_arrays.back();
+    _free_vertex_arrays.pop_back();
+    return vao;
+}
+
+void GlGarbagePile::recycle_vertex_array_later(GLuint vao)
+{
+    _recycled_vertex_arrays.push_back(vao);
+}
+
+/// Disables all attributes of the vertex array and detaches its buffers, so that it is indistinguishable
+/// from a new vertex array, and does not keep the storage of deleted buffers alive.
+static void reset_vertex_array(GLuint vao, GLuint max_attributes)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    for (GLuint i = 0; i < max_attributes; ++i)
+    {
+        glDisableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 0);
+        glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
 void GlGarbageCollector::collect_garbage()
 {
     auto & garbage = *_garbage;
 
     glDeleteBuffers(garbage._ebo.size(), garbage._ebo.data());
     glDeleteBuffers(garbage._vbo.size(), garbage._vbo.data());
+    glDeleteBuffers(garbage._buffers.size(), garbage._buffers.data());
     glDeleteVertexArrays(garbage._vao.size(), garbage._vao.data());
+    glDeleteFramebuffers(garbage._framebuffers.size(), garbage._framebuffers.data());
+    glDeleteTextures(garbage._textures.size(), garbage._textures.data());
     garbage._ebo.clear();
     garbage._vbo.clear();
+    garbage._buffers.clear();
     garbage._vao.clear();
+    garbage._framebuffers.clear();
+    garbage._textures.clear();
+
+    // Vertex arrays only hold state, so they may be reused right away
+    if (!garbage._recycled_vertex_arrays.empty())
+    {
+        GLint max_attributes = 0;
+        glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &max_attributes);
+        for (const auto vao : garbage._recycled_vertex_arrays)
+        {
+            if (garbage._free_vertex_arrays.size() < VERTEX_ARRAY_POOL_SIZE)
+            {
+                reset_vertex_array(vao, static_cast<GLuint>(max_attributes));
+                garbage._free_vertex_arrays.push_back(vao);
+            }
+            else
+            {
+                glDeleteVertexArrays(1, &vao);
+            }
+        }
+        garbage._recycled_vertex_arrays.clear();
+    }
+
+    // Buffers may still be read by draws of this frame, so they are only reused once the GPU has caught up
+    if (!garbage._recycled_buffers.empty())
+    {
+        const auto fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        garbage._pending_buffers.push_back(GlGarbagePile::PendingBuffers { fence, std::move(garbage._recycled_buffers) });
+        garbage._recycled_buffers.clear();
+    }
+
+    // Fences are signaled in the order they were issued, so there is no need to look past the first unsignaled fence
+    while (!garbage._pending_buffers.empty())
+    {
+        auto & pending = garbage._pending_buffers.front();
+        const auto status = glClientWaitSync(pending.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+
+        glDeleteSync(pending.fence);
+        for (const auto & buffer : pending.buffers)
+        {
+            garbage._buffer_pool.add(buffer.first, buffer.second, garbage._frame);
+        }
+        garbage._pending_buffers.pop_front();
+    }
+
+    // Storage is only given back to the driver when there is a lot of it, or when it has not been needed for a while
+    const auto oldest_frame = garbage._frame >= BUFFER_POOL_MAX_AGE ? garbage._frame - BUFFER_POOL_MAX_AGE : 0;
+    garbage._trimmed_buffers.clear();
+    garbage._buffer_pool.trim(BUFFER_POOL_BUDGET, oldest_frame, garbage._trimmed_buffers);
+    glDeleteBuffers(garbage._trimmed_buffers.size(), garbage._trimmed_buffers.data());
+
+    ++garbage._frame;
+}
+
+void GlGarbageCollector::release_all()
+{
+    collect_garbage();
+    auto & garbage = *_garbage;
+
+    // Deleting buffers that the GPU still reads from is safe, since the driver defers the deletion
+    for (const auto & pending : garbage._pending_buffers)
+    {
+        glDeleteSync(pending.fence);
+        for (const auto & buffer : pending.buffers)
+        {
+            glDeleteBuffers(1, &buffer.first);
+        }
+    }
+    garbage._pending_buffers.clear();
+
+    garbage._trimmed_buffers.clear();
+    garbage._buffer_pool.trim(0, 0, garbage._trimmed_buffers);
+    glDeleteBuffers(garbage._trimmed_buffers.size(), garbage._trimmed_buffers.data());
+    garbage._trimmed_buffers.clear();
+
+    glDeleteVertexArrays(garbage._free_vertex_arrays.size(), garbage._free_vertex_arrays.data());
+    garbage._free_vertex_arrays.clear();
 }
 
 std::shared_ptr<GlGarbagePile> GlGarbageCollector::garbage() const
@@ -3,24 +3,93 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <cstdint>
+#include <deque>
 #include <vector>
 #include <memory>
 
+#include "buffer_pool.hpp"
+
 namespace merely3d
 {
+    /// The number of bytes of unused buffer storage that is kept around for reuse. Beyond this,
+    /// the least recently released buffers are deleted.
+    const size_t BUFFER_POOL_BUDGET = 64 * 1024 * 1024;
+
+    /// The number of frames after which unused buffers are deleted, even if the pool is within its budget.
+    const uint64_t BUFFER_POOL_MAX_AGE = 600;
+
+    /// The number of unused vertex arrays that are kept around for reuse.
+    const size_t VERTEX_ARRAY_POOL_SIZE = 256;
+
+    /// Collects the OpenGL objects that are no longer used, so that they may be deleted or recycled
+    /// at the end of the frame, when the context is known to be current.
+    ///
+    /// Buffers and vertex arrays are recycled rather than deleted: objects that create them acquire them
+    /// from the pile, which hands out previously released objects whenever possible. Released buffers are
+    /// only handed out again once a fence shows that the GPU has finished the commands that used them.
     class GlGarbagePile
     {
     public:
         void delete_vertex_array_later(GLuint vao);
         void delete_vertex_buffer_later(GLuint vbo);
         void delete_element_buffer_later(GLuint ebo);
+        void delete_texture_later(GLuint texture);
+        void delete_framebuffer_later(GLuint fbo);
+
+        /// Deletes a buffer of any other kind, such as a pixel pack buffer, which is not recycled.
+        void delete_buffer_later(GLuint buffer);
+
+        /// Returns a buffer whose storage holds pooled_buffer_size(size) bytes of undefined contents.
+        /// The buffer is not bound to any target, and is meant to be filled with glBufferSubData
+        /// rather than respecified with glBufferData.
+        ///
+        /// Must only be called when the context is current!
+        GLuint acquire_buffer(size_t size);
+
+        /// Releases a buffer obtained from acquire_buffer(), whose storage is `size` bytes.
+        void recycle_buffer_later(GLuint buffer, size_t size);
+
+        /// Returns a vertex array with no enabled attributes and no element buffer.
+        ///
+        /// Must only be called when the context is current!
+        GLuint acquire_vertex_array();
+
+        /// Releases a vertex array obtained from acquire_vertex_array().
+        void recycle_vertex_array_later(GLuint vao);
 
         // TODO: Delete programs/shaders
 
     private:
+        struct PendingBuffers
+        {
+            // Signaled once the GPU has finished all commands issued before the buffers were released
+            GLsync fence;
+            std::vector<std::pair<GLuint, size_t>> buffers;
+        };
+
         std::vector<GLuint> _vao;
         std::vector<GLuint> _vbo;
         std::vector<GLuint> _ebo;
+        std::vector<GLuint> _buffers;
+        std::vector<GLuint> _textures;
+        std::vector<GLuint> _framebuffers;
+
+        // Released since the last collection
+        std::vector<std::pair<GLuint, size_t>> _recycled_buffers;
+        std::vector<GLuint> _recycled_vertex_arrays;
+
+        // Released in earlier frames, in the order they were released, but possibly still in use by the GPU
+        std::deque<PendingBuffers> _pending_buffers;
+
+        BufferPool _buffer_pool;
+        std::vector<GLuint> _free_vertex_arrays;
+
+        // Scratch space for the buffers trimmed from the pool
+        std::vector<GLuint> _trimmed_buffers;
+
+        // Number of collections so far
+        uint64_t _frame = 0;
 
         friend class GlGarbageCollector;
     };
@@ -32,9 +101,21 @@ namespace merely3d
         GlGarbageCollector(GlGarbageCollector &&) noexcept = default;
         GlGarbageCollector(const GlGarbageCollector &) = delete;
 
+        /// Deletes the objects of the garbage pile, and returns the released buffers and vertex arrays
+        /// to their pools, trimming the buffer pool to BUFFER_POOL_BUDGET. The released vertex arrays are reset
+        /// by binding them directly, so any GlState of the context must be invalidated afterwards.
+        ///
         /// Must only be called when the context is current!
         void collect_garbage();
 
+        /// Deletes all objects of the garbage pile, including the pooled buffers and vertex arrays, and the buffers
+        /// that are still waiting for their fences, along with the fences. Meant for the teardown of the context:
+        /// the objects that release their OpenGL objects through the pile must all be gone beforehand, since
+        /// anything released afterwards is only deleted by the next collection.
+        ///
+        /// Must only be called when the context is current!
+        void release_all();
+
         std::shared_ptr<GlGarbagePile> garbage() const;
 
     private:
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "draw_queue.hpp"
+#include "gl_gc.hpp"
+#include "gl_errors.hpp"
+#include "gl_extensions.hpp"
+#include "gl_state.hpp"
+
+// Indirect draws are part of OpenGL 4.0 and GL_ARB_draw_indirect, neither of which GLAD was generated for
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+namespace merely3d
+{
+    /// glMultiDrawElementsIndirect, which is part of OpenGL 4.3 and GL_ARB_multi_draw_indirect.
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum, GLenum, const void *, GLsizei, GLsizei);
+
+    /// Looks up glMultiDrawElementsIndirect through `loader`, which looks up OpenGL entry points by name
+    /// (see ProgramCache::create_in_context). Returns nullptr if there is no loader, or if the current context
+    /// supports neither OpenGL 4.3 nor GL_ARB_multi_draw_indirect along with GL_ARB_base_instance, without which
+    /// the base instance of the commands is ignored.
+    inline MultiDrawElementsIndirectProc load_multi_draw_elements_indirect(GLADloadproc loader)
+    {
+        if (!loader)
+        {
+            return nullptr;
+        }
+        if (!has_gl_version(4, 3)
+            && !(has_gl_extension("GL_ARB_multi_draw_indirect") && has_gl_extension("GL_ARB_base_instance")))
+        {
+            return nullptr;
+        }
+        return reinterpret_cast<MultiDrawElementsIndirectProc>(loader("glMultiDrawElementsIndirect"));
+    }
+
+    /// Issues the draws of a vertex array that fetch their instances from an instance texture with a single call
+    /// to glMultiDrawElementsIndirect per shader program, rather than with one draw call per mesh.
+    ///
+    /// The commands are gathered from the sorted draws of each frame (see plan_indirect_batches) into a buffer
+    /// that is respecified every frame. Every command starts over at gl_InstanceID 0, and shaders of OpenGL 3.3
+    /// cannot read the base instance, so the index of the first record of each command reaches the shader through
+    /// the per-instance attribute at location 2 instead (see instance_attributes.glsl). The attribute reads
+    /// the sequence 0, 1, 2, ... with a divisor so large that every instance of a command reads the element
+    /// at its base instance. The sequence is stored as floats, which hold every index of an instance texture exactly.
+    class GlIndirectDraws
+    {
+    public:
+        GlIndirectDraws(GlIndirectDraws && other) noexcept
+            : _vao(other._vao),
+              _command_buffer(other._command_buffer),
+              _index_buffer(other._index_buffer),
+              _index_buffer_size(other._index_buffer_size),
+              _multi_draw(other._multi_draw),
+              _commands(std::move(other._commands)),
+              _batches(std::move(other._batches)),
+              _index_scratch(std::move(other._index_scratch)),
+              _garbage(other._garbage)
+        {
+            other._garbage.reset();
+        }
+
+        ~GlIndirectDraws()
+        {
+            if (_garbage)
+            {
+                _garbage->delete_buffer_later(_command_buffer);
+                if (_index_buffer != 0)
+                {
+                    _garbage->recycle_buffer_later(_index_buffer, _index_buffer_size);
+                }
+            }
+        }
+
+        GlIndirectDraws(const GlIndirectDraws & other) = delete;
+        GlIndirectDraws & operator=(const GlIndirectDraws & other) = delete;
+        GlIndirectDraws & operator=(GlIndirectDraws && other) = delete;
+
+        /// Creates the indirect draws of the given vertex array, which must outlive them.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlIndirectDraws create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                      MultiDrawElementsIndirectProc multi_draw,
+                                      GLuint vao)
+        {
+            assert(multi_draw);
+            GLuint command_buffer;
+            glGenBuffers(1, &command_buffer);
+            return GlIndirectDraws(garbage, multi_draw, vao, command_buffer);
+        }
+
+        GLuint vertex_array() const
+        {
+            return _vao;
+        }
+
+        /// The batches planned by the most recent call to prepare().
+        const std::vector<IndirectBatch> & batches() const
+        {
+            return _batches;
+        }
+
+        /// Plans the batches of the given sorted draws, transfers their commands, and points the base instance
+        /// attribute of the vertex array to a sequence that is long enough for all of them.
+        void prepare(GlState & state, const std::vector<OpaqueDraw> & draws);
+
+        /// Issues the commands of the given batch with the program in use. The vertex array must be bound.
+        void draw(const IndirectBatch & batch) const
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _command_buffer);
+            _multi_draw(GL_TRIANGLES, GL_UNSIGNED_INT,
+                        reinterpret_cast<const void *>(sizeof(DrawElementsIndirectCommand) * batch.first_command),
+                        static_cast<GLsizei>(batch.command_count), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+    private:
+        GlIndirectDraws(const std::shared_ptr<GlGarbagePile> & garbage,
+                        MultiDrawElementsIndirectProc multi_draw,
+                        GLuint vao,
+                        GLuint command_buffer)
+            : _vao(vao),
+              _command_buffer(command_buffer),
+              _index_buffer(0),
+              _index_buffer_size(0),
+              _multi_draw(multi_draw),
+              _garbage(garbage)
+        {}
+
+        /// The attribute location of the index of the first instance record of a command.
+        static const GLuint BASE_INSTANCE_LOCATION = 2;
+
+        /// Replaces the base instance sequence with one that holds at least the given number of indices.
+        void grow_indices(GlState & state, size_t count);
+
+        GLuint _vao;
+        GLuint _command_buffer;
+
+        // Holds the sequence 0, 1, 2, ... as floats, and is 0 until the first commands are prepared
+        GLuint _index_buffer;
+        size_t _index_buffer_size;
+
+        MultiDrawElementsIndirectProc _multi_draw;
+
+        std::vector<DrawElementsIndirectCommand> _commands;
+        std::vector<IndirectBatch> _batches;
+
+        // Scratch space for filling the base instance sequence
+        std::vector<float> _index_scratch;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+
+    inline void GlIndirectDraws::prepare(GlState & state, const std::vector<OpaqueDraw> & draws)
+    {
+        plan_indirect_batches(draws, _vao, _commands, _batches);
+        if (_commands.empty())
+        {
+            return;
+        }
+
+        GLuint max_base_instance = 0;
+        for (const auto & command : _commands)
+        {
+            max_base_instance = std::max(max_base_instance, command.base_instance);
+        }
+        if (sizeof(float) * (max_base_instance + size_t(1)) > _index_buffer_size)
+        {
+            grow_indices(state, max_base_instance + size_t(1));
+        }
+
+        // The commands are respecified rather than overwritten, like the frame uniforms (see GlUniformBuffer)
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                     static_cast<GLsizeiptr>(sizeof(DrawElementsIndirectCommand) * _commands.size()),
+                     _commands.data(),
+                     GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+    }
+
+    inline void GlIndirectDraws::grow_indices(GlState & state, size_t count)
+    {
+        // Grow geometrically, so that the sequence is rarely refilled as the number of instances grows
+        const auto buffer_size = pooled_buffer_size(sizeof(float) * std::max(count, 2 * _index_buffer_size / sizeof(float)));
+        const auto buffer = _garbage->acquire_buffer(buffer_size);
+        _index_scratch.resize(buffer_size / sizeof(float));
+        for (size_t i = 0; i < _index_scratch.size(); ++i)
+        {
+            _index_scratch[i] = static_cast<float>(i);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, static_cast<GLsizeiptr>(buffer_size), _index_scratch.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        if (_index_buffer != 0)
+        {
+            _garbage->recycle_buffer_later(_index_buffer, _index_buffer_size);
+        }
+        _index_buffer = buffer;
+        _index_buffer_size = buffer_size;
+
+        state.with_vertex_array(_vao, [this]
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, _index_buffer);
+            glVertexAttribPointer(BASE_INSTANCE_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
+            glVertexAttribDivisor(BASE_INSTANCE_LOCATION, std::numeric_limits<GLuint>::max());
+            glEnableVertexAttribArray(BASE_INSTANCE_LOCATION);
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        _index_scratch.clear();
+        MERELY_CHECK_GL_ERRORS();
+    }
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "gl_gc.hpp"
+#include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "dirty_ranges.hpp"
+#include "instance_data.hpp"
+
+namespace merely3d
+{
+    /// Copies the instance records [first, first + count) from one buffer to another on the GPU.
+    inline void copy_instance_records(GLuint source, GLuint destination, size_t first, size_t count)
+    {
+        const auto offset = static_cast<GLintptr>(sizeof(float) * FLOATS_PER_INSTANCE * first);
+        const auto size = static_cast<GLsizeiptr>(sizeof(float) * FLOATS_PER_INSTANCE * count);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, source);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, offset, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    /// A buffer of per-instance data for instanced rendering of a single piece of geometry,
+    /// together with a vertex array object that combines the geometry with the instance data.
+    ///
+    /// Each instance is a packed record of FLOATS_PER_INSTANCE floats (see instance_data.hpp),
+    /// whose components are bound to the attribute locations 2 through 12.
+    ///
+    /// The buffer also holds the previous snapshot of the instances, whose position, orientation and scale
+    /// are bound to the attribute locations 13 through 15, so that shaders can interpolate the transforms
+    /// of the instances (see instance_attributes.glsl). Every update that modifies any instance starts
+    /// a new snapshot, in which the instances of the last update become the previous snapshot. Instances
+    /// are identified by their index, and appended instances have no previous snapshot to interpolate from.
+    ///
+    /// When updated without a description of what changed, the buffer keeps a copy of the instances
+    /// that were last transferred to the GPU, so that subsequent updates only transfer the blocks
+    /// of instances that actually changed.
+    ///
+    /// The buffers and the vertex array are recycled through the garbage pile, so instance buffers
+    /// may be created and destroyed frequently without allocating new GPU storage every time.
+    class GlInstanceBuffer
+    {
+    public:
+        GlInstanceBuffer(GlInstanceBuffer && other) noexcept;
+        ~GlInstanceBuffer();
+
+        GlInstanceBuffer(const GlInstanceBuffer & other) = delete;
+        GlInstanceBuffer & operator=(const GlInstanceBuffer & other) = delete;
+        GlInstanceBuffer & operator=(GlInstanceBuffer && other) = delete;
+
+        /// Creates an instance buffer for the geometry stored in the given vertex buffer,
+        /// whose vertices consist of a position and a normal (see GlPrimitive and GlMeshArena).
+        /// If `element_buffer` is non-zero, it is bound as the index buffer of the geometry.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlInstanceBuffer create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                       GlState & state,
+                                       GLuint vertex_buffer,
+                                       GLuint element_buffer);
+
+        /// Replaces the instances with the given instances, transferring only
+        /// the blocks of instances that differ from the previous update.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        void update(GlState & state, const std::vector<float> & instances);
+
+        /// Replaces the instances with the given instances, of which only the instances in the
+        /// given ranges differ from the previous update. Only those instances are transferred,
+        /// and no copy of the instances is retained. The instances in `replaced`, which must also be
+        /// part of `changed`, are different instances than before, and have no previous snapshot.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        void update(GlState & state,
+                    const std::vector<float> & instances,
+                    const DirtyRanges & changed,
+                    const DirtyRanges & replaced);
+
+        size_t instance_count() const
+        {
+            return _count;
+        }
+
+        /// The vertex array that binds both the geometry and the instance attributes.
+        GLuint vertex_array() const
+        {
+            return _vao;
+        }
+
+    private:
+        GlInstanceBuffer(const std::shared_ptr<GlGarbagePile> & garbage,
+                         GLuint vao, GLuint vbo, GLuint previous_vbo, size_t buffer_size)
+            : _vao(vao), _vbo(vbo), _previous_vbo(previous_vbo), _buffer_size(buffer_size),
+              _capacity(buffer_size / RECORD_SIZE), _count(0), _garbage(garbage)
+        {}
+
+        /// Points the per-instance attributes of the currently bound vertex array to the current buffers.
+        void set_instance_attributes();
+
+        /// Makes room for the given number of instances, keeping the instances (and their previous snapshot)
+        /// that are already stored.
+        void reserve(GlState & state, size_t num_instances);
+
+        /// Transfers the given instances, of which the instances in the given ranges were modified or replaced.
+        void transfer_snapshot(GlState & state,
+                               const std::vector<float> & instances,
+                               const DirtyRanges & modified,
+                               const DirtyRanges & replaced);
+
+        // Number of instances compared as a single unit by update()
+        static const size_t INSTANCES_PER_BLOCK = 64;
+
+        static const size_t RECORD_SIZE = sizeof(float) * FLOATS_PER_INSTANCE;
+
+        GLuint _vao;
+        GLuint _vbo;
+        GLuint _previous_vbo;
+
+        // Size of the storage of each of the buffers, in bytes
+        size_t _buffer_size;
+
+        // Number of instances the GPU buffers have room for
+        size_t _capacity;
+        size_t _count;
+
+        // The instances currently stored on the GPU, unless the last update described its changes
+        std::vector<float> _instances;
+        DirtyRanges _modified;
+
+        // The instances that changed in the last snapshot, which are the only ones that differ
+        // from the previous snapshot
+        DirtyRanges _snapshot_changed;
+        SnapshotTransfers _transfers;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+
+    inline GlInstanceBuffer::GlInstanceBuffer(GlInstanceBuffer && other) noexcept
+        : _vao(other._vao),
+          _vbo(other._vbo),
+          _previous_vbo(other._previous_vbo),
+          _buffer_size(other._buffer_size),
+          _capacity(other._capacity),
+          _count(other._count),
+          _instances(std::move(other._instances)),
+          _modified(std::move(other._modified)),
+          _snapshot_changed(std::move(other._snapshot_changed)),
+          _transfers(std::move(other._transfers)),
+          _garbage(other._garbage)
+    {
+        other._garbage.reset();
+    }
+
+    inline GlInstanceBuffer::~GlInstanceBuffer()
+    {
+        if (_garbage)
+        {
+            _garbage->recycle_buffer_later(_vbo, _buffer_size);
+            _garbage->recycle_buffer_later(_previous_vbo, _buffer_size);
+            _garbage->recycle_vertex_array_later(_vao);
+        }
+    }
+
+    inline GlInstanceBuffer GlInstanceBuffer::create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                                     GlState & state,
+                                                     GLuint vertex_buffer,
+                                                     GLuint element_buffer)
+    {
+        // Start out with the smallest pooled buffers, which are replaced by larger ones as soon as they run out of room
+        const auto vao = garbage->acquire_vertex_array();
+        const auto vbo = garbage->acquire_buffer(0);
+        const auto previous_vbo = garbage->acquire_buffer(0);
+        auto buffer = GlInstanceBuffer(garbage, vao, vbo, previous_vbo, pooled_buffer_size(0));
+
+        state.with_vertex_array(vao, [&]
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+            if (element_buffer != 0)
+            {
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+            }
+
+            // Position attribute
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
+            glEnableVertexAttribArray(0);
+            // normal attribute
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+
+            buffer.set_instance_attributes();
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+
+        return buffer;
+    }
+
+    inline void GlInstanceBuffer::set_instance_attributes()
+    {
+        // Per-instance attributes, as (location, number of floats)
+        const GLint instance_attributes[][2] = { {2, 3}, {3, 4}, {4, 3}, {5, 3}, {6, 3}, {7, 1}, {8, 1}, {9, 1},
+                                                 {10, 3}, {11, 1}, {12, 1} };
+        const auto stride = static_cast<GLsizei>(RECORD_SIZE);
+        size_t offset = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+        for (const auto & attribute : instance_attributes)
+        {
+            glVertexAttribPointer(attribute[0], attribute[1], GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(offset * sizeof(float)));
+            glVertexAttribDivisor(attribute[0], 1);
+            glEnableVertexAttribArray(attribute[0]);
+            offset += attribute[1];
+        }
+        assert(offset == FLOATS_PER_INSTANCE);
+
+        // The position, orientation and scale of the previous snapshot, as (location, number of floats, offset)
+        const GLint previous_attributes[][3] = { {13, 3, 0}, {14, 4, 3}, {15, 3, 7} };
+        glBindBuffer(GL_ARRAY_BUFFER, _previous_vbo);
+        for (const auto & attribute : previous_attributes)
+        {
+            glVertexAttribPointer(attribute[0], attribute[1], GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(attribute[2] * sizeof(float)));
+            glVertexAttribDivisor(attribute[0], 1);
+            glEnableVertexAttribArray(attribute[0]);
+        }
+    }
+
+    inline void GlInstanceBuffer::reserve(GlState & state, size_t num_instances)
+    {
+        if (num_instances <= _capacity)
+        {
+            return;
+        }
+
+        // Grow geometrically, so that a slowly increasing number of instances
+        // does not cause a reallocation on every frame
+        const auto new_capacity = std::max(num_instances, _capacity + _capacity / 2);
+        const auto buffer_size = pooled_buffer_size(RECORD_SIZE * new_capacity);
+        const auto vbo = _garbage->acquire_buffer(buffer_size);
+        const auto previous_vbo = _garbage->acquire_buffer(buffer_size);
+
+        // The stored instances are copied on the GPU, so that they need not be transferred again,
+        // and their previous snapshot is kept
+        copy_instance_records(_vbo, vbo, 0, _count);
+        copy_instance_records(_previous_vbo, previous_vbo, 0, _count);
+
+        _garbage->recycle_buffer_later(_vbo, _buffer_size);
+        _garbage->recycle_buffer_later(_previous_vbo, _buffer_size);
+        _vbo = vbo;
+        _previous_vbo = previous_vbo;
+        _buffer_size = buffer_size;
+        _capacity = buffer_size / RECORD_SIZE;
+
+        // Point the vertex array to the new buffers
+        state.with_vertex_array(_vao, [this] { set_instance_attributes(); });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    inline void GlInstanceBuffer::transfer_snapshot(GlState & state,
+                                                    const std::vector<float> & instances,
+                                                    const DirtyRanges & modified,
+                                                    const DirtyRanges & replaced)
+    {
+        assert(instances.size() % FLOATS_PER_INSTANCE == 0);
+        const auto num_instances = instances.size() / FLOATS_PER_INSTANCE;
+        reserve(state, num_instances);
+
+        plan_snapshot_transfers(false, _snapshot_changed, modified, replaced, _count, num_instances, _transfers);
+        for_each_transfer_range(_transfers.copy_before_upload, [&] (size_t first, size_t count)
+        {
+            copy_instance_records(_vbo, _previous_vbo, first, count);
+        });
+
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+        for_each_transfer_range(_transfers.upload, [&] (size_t first, size_t count)
+        {
+            assert(first + count <= num_instances);
+            const auto offset = static_cast<GLintptr>(RECORD_SIZE * first);
+            const auto size = static_cast<GLsizeiptr>(RECORD_SIZE * count);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, instances.data() + FLOATS_PER_INSTANCE * first);
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for_each_transfer_range(_transfers.copy_after_upload, [&] (size_t first, size_t count)
+        {
+            copy_instance_records(_vbo, _previous_vbo, first, count);
+        });
+        MERELY_CHECK_GL_ERRORS();
+
+        if (!modified.empty())
+        {
+            _snapshot_changed = modified;
+        }
+        _snapshot_changed.truncate(num_instances);
+        _count = num_instances;
+    }
+
+    inline void GlInstanceBuffer::update(GlState & state, const std::vector<float> & instances)
+    {
+        find_changed_records(_instances, instances, FLOATS_PER_INSTANCE, INSTANCES_PER_BLOCK, _modified);
+        // Instances are identified by their index alone, so none of them is known to be replaced
+        transfer_snapshot(state, instances, _modified, DirtyRanges());
+        _instances.assign(instances.begin(), instances.end());
+    }
+
+    inline void GlInstanceBuffer::update(GlState & state,
+                                         const std::vector<float> & instances,
+                                         const DirtyRanges & changed,
+                                         const DirtyRanges & replaced)
+    {
+        transfer_snapshot(state, instances, changed, replaced);
+
+        // Without a retained copy, a subsequent update without a description of its changes
+        // compares against no instances at all, and therefore transfers all of them
+        _instances.clear();
+    }
+}
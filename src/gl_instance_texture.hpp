@@ -0,0 +1,241 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "gl_gc.hpp"
+#include "gl_errors.hpp"
+#include "gl_instance_buffer.hpp"
+#include "dirty_ranges.hpp"
+#include "instance_data.hpp"
+
+namespace merely3d
+{
+    /// The texture unit that GlInstanceTexture is bound to while drawing.
+    const GLuint INSTANCE_TEXTURE_UNIT = 4;
+
+    /// The texture unit that the previous snapshot of GlInstanceTexture is bound to while drawing.
+    const GLuint PREVIOUS_INSTANCE_TEXTURE_UNIT = 5;
+
+    /// Instance records (see instance_data.hpp) stored in a buffer texture, from which shaders fetch
+    /// the records of their instances by index (see instance_attributes.glsl).
+    ///
+    /// Unlike the per-instance attributes of GlInstanceBuffer, which are bound through a vertex array,
+    /// the records of many different pieces of geometry may be stored in the same texture, each draw
+    /// passing the index of its first record to the shader. Like GlInstanceBuffer, the texture keeps a copy
+    /// of the records last transferred to the GPU, so that updates only transfer the blocks that changed,
+    /// and a second texture holds the previous snapshot of the records.
+    class GlInstanceTexture
+    {
+    public:
+        GlInstanceTexture(GlInstanceTexture && other) noexcept
+            : _texture(other._texture),
+              _previous_texture(other._previous_texture),
+              _buffer(other._buffer),
+              _previous_buffer(other._previous_buffer),
+              _buffer_size(other._buffer_size),
+              _capacity(other._capacity),
+              _max_instances(other._max_instances),
+              _count(other._count),
+              _instances(std::move(other._instances)),
+              _modified(std::move(other._modified)),
+              _snapshot_changed(std::move(other._snapshot_changed)),
+              _transfers(std::move(other._transfers)),
+              _garbage(other._garbage)
+        {
+            other._garbage.reset();
+        }
+
+        ~GlInstanceTexture()
+        {
+            if (_garbage)
+            {
+                _garbage->delete_texture_later(_texture);
+                _garbage->delete_texture_later(_previous_texture);
+                _garbage->recycle_buffer_later(_buffer, _buffer_size);
+                _garbage->recycle_buffer_later(_previous_buffer, _buffer_size);
+            }
+        }
+
+        GlInstanceTexture(const GlInstanceTexture & other) = delete;
+        GlInstanceTexture & operator=(const GlInstanceTexture & other) = delete;
+        GlInstanceTexture & operator=(GlInstanceTexture && other) = delete;
+
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlInstanceTexture create(const std::shared_ptr<GlGarbagePile> & garbage)
+        {
+            const auto buffer_size = pooled_buffer_size(RECORD_SIZE * INITIAL_CAPACITY);
+            const auto buffer = garbage->acquire_buffer(buffer_size);
+            const auto previous_buffer = garbage->acquire_buffer(buffer_size);
+
+            // Each texel holds a single component of a record
+            GLuint textures[2];
+            glGenTextures(2, textures);
+            attach_buffer(textures[0], buffer);
+            attach_buffer(textures[1], previous_buffer);
+
+            GLint max_texels = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+            MERELY_CHECK_GL_ERRORS();
+
+            return GlInstanceTexture(garbage, textures[0], textures[1], buffer, previous_buffer, buffer_size,
+                                     static_cast<size_t>(max_texels) / FLOATS_PER_INSTANCE);
+        }
+
+        /// Replaces the records with the given records, transferring only the blocks of records
+        /// that differ from the previous update. If any record differs, a new snapshot is started,
+        /// in which the records of the previous update become the previous snapshot. The records in `replaced`
+        /// belong to different instances than before, and have no previous snapshot.
+        ///
+        /// Throws std::runtime_error if there are more records than a buffer texture can hold.
+        void update(const std::vector<float> & instances, const DirtyRanges & replaced = DirtyRanges());
+
+        /// The largest number of records the texture can hold.
+        size_t max_instances() const
+        {
+            return _max_instances;
+        }
+
+        /// Binds the texture of the current records and that of the previous snapshot to the given
+        /// texture units, and leaves texture unit 0 active.
+        void bind(GLuint unit, GLuint previous_unit) const
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_BUFFER, _texture);
+            glActiveTexture(GL_TEXTURE0 + previous_unit);
+            glBindTexture(GL_TEXTURE_BUFFER, _previous_texture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+    private:
+        GlInstanceTexture(const std::shared_ptr<GlGarbagePile> & garbage,
+                          GLuint texture, GLuint previous_texture, GLuint buffer, GLuint previous_buffer,
+                          size_t buffer_size, size_t max_instances)
+            : _texture(texture), _previous_texture(previous_texture),
+              _buffer(buffer), _previous_buffer(previous_buffer), _buffer_size(buffer_size),
+              _capacity(buffer_size / RECORD_SIZE), _max_instances(max_instances), _count(0),
+              _garbage(garbage)
+        {}
+
+        static void attach_buffer(GLuint texture, GLuint buffer)
+        {
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+
+        /// Makes room for the given number of records, keeping the records (and their previous snapshot)
+        /// that are already stored.
+        void reserve(size_t num_instances);
+
+        static const size_t INITIAL_CAPACITY = 1024;
+
+        static const size_t RECORD_SIZE = sizeof(float) * FLOATS_PER_INSTANCE;
+
+        // Number of instances compared as a single unit by update()
+        static const size_t INSTANCES_PER_BLOCK = 64;
+
+        GLuint _texture;
+        GLuint _previous_texture;
+        GLuint _buffer;
+        GLuint _previous_buffer;
+
+        // Size of the storage of each of the buffers, in bytes
+        size_t _buffer_size;
+
+        // Number of instances the GPU buffers have room for
+        size_t _capacity;
+
+        // Number of instances that fit within the maximum size of a buffer texture
+        size_t _max_instances;
+
+        // The instances currently stored on the GPU
+        size_t _count;
+        std::vector<float> _instances;
+        DirtyRanges _modified;
+
+        // The instances that changed in the last snapshot, which are the only ones that differ
+        // from the previous snapshot
+        DirtyRanges _snapshot_changed;
+        SnapshotTransfers _transfers;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+
+    inline void GlInstanceTexture::reserve(size_t num_instances)
+    {
+        if (num_instances <= _capacity)
+        {
+            return;
+        }
+
+        // Grow geometrically, so that a slowly increasing number of instances
+        // does not cause a reallocation on every frame. The textures are pointed to the new buffers,
+        // but may not address more texels than the maximum size of a buffer texture
+        const auto capacity = std::min(std::max(num_instances, _capacity + _capacity / 2), _max_instances);
+        const auto buffer_size = pooled_buffer_size(RECORD_SIZE * capacity);
+        const auto buffer = _garbage->acquire_buffer(buffer_size);
+        const auto previous_buffer = _garbage->acquire_buffer(buffer_size);
+
+        copy_instance_records(_buffer, buffer, 0, _count);
+        copy_instance_records(_previous_buffer, previous_buffer, 0, _count);
+
+        _garbage->recycle_buffer_later(_buffer, _buffer_size);
+        _garbage->recycle_buffer_later(_previous_buffer, _buffer_size);
+        _buffer = buffer;
+        _previous_buffer = previous_buffer;
+        _buffer_size = buffer_size;
+        _capacity = std::min(buffer_size / RECORD_SIZE, _max_instances);
+
+        attach_buffer(_texture, _buffer);
+        attach_buffer(_previous_texture, _previous_buffer);
+    }
+
+    inline void GlInstanceTexture::update(const std::vector<float> & instances, const DirtyRanges & replaced)
+    {
+        assert(instances.size() % FLOATS_PER_INSTANCE == 0);
+        const auto num_instances = instances.size() / FLOATS_PER_INSTANCE;
+        if (num_instances > _max_instances)
+        {
+            throw std::runtime_error("Too many mesh instances to fit in a buffer texture.");
+        }
+        reserve(num_instances);
+
+        find_changed_records(_instances, instances, FLOATS_PER_INSTANCE, INSTANCES_PER_BLOCK, _modified);
+        plan_snapshot_transfers(false, _snapshot_changed, _modified, replaced, _count, num_instances, _transfers);
+        for_each_transfer_range(_transfers.copy_before_upload, [&] (size_t first, size_t count)
+        {
+            copy_instance_records(_buffer, _previous_buffer, first, count);
+        });
+
+        glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+        for_each_transfer_range(_transfers.upload, [&] (size_t first, size_t count)
+        {
+            const auto offset = static_cast<GLintptr>(RECORD_SIZE * first);
+            const auto size = static_cast<GLsizeiptr>(RECORD_SIZE * count);
+            glBufferSubData(GL_TEXTURE_BUFFER, offset, size, instances.data() + FLOATS_PER_INSTANCE * first);
+        });
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        for_each_transfer_range(_transfers.copy_after_upload, [&] (size_t first, size_t count)
+        {
+            copy_instance_records(_buffer, _previous_buffer, first, count);
+        });
+        MERELY_CHECK_GL_ERRORS();
+
+        if (!_modified.empty())
+        {
+            _snapshot_changed = _modified;
+        }
+        _snapshot_changed.truncate(num_instances);
+        _count = num_instances;
+        _instances.assign(instances.begin(), instances.end());
+    }
+}
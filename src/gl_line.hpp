@@ -3,64 +3,123 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "gl_gc.hpp"
+#include "gl_state.hpp"
 
 namespace merely3d
 {
+    /// The number of floats in the instance record of a line: its end points followed by its color.
+    const size_t FLOATS_PER_LINE = 9;
+
+    /// Draws instances of the reference line from [0, 0, 0] to [1, 0, 0], each stretched between
+    /// the end points given by its instance record (see basic_vertex.glsl).
     class GlLine
     {
     public:
         GlLine(GlLine && other)
-            : vao(other.vao), vbo(other.vbo)
+            : vao(other.vao), vbo(other.vbo), instance_vbo(other.instance_vbo), instance_count(other.instance_count),
+              garbage(other.garbage)
         {
             other.vao = 0;
             other.vbo = 0;
+            other.instance_vbo = 0;
+            other.instance_count = 0;
+            other.garbage.reset();
+        }
+
+        ~GlLine()
+        {
+            if (garbage)
+            {
+                garbage->delete_vertex_array_later(vao);
+                garbage->delete_vertex_buffer_later(vbo);
+                garbage->delete_vertex_buffer_later(instance_vbo);
+            }
         }
 
         GlLine(const GlLine & other) = delete;
         GlLine & operator=(const GlLine & other) = delete;
 
-        static GlLine create();
+        static GlLine create(const std::shared_ptr<GlGarbagePile> & garbage, GlState & state);
+
+        /// Replaces the instances with the given instance records.
+        void update(const std::vector<float> & instances);
 
-        void bind();
-        void unbind();
+        /// Draws all instances with the currently active shader program.
+        void draw(GlState & state);
 
     private:
-        GlLine(GLuint vao, GLuint vbo)
-                : vao(vao), vbo(vbo)
+        GlLine(const std::shared_ptr<GlGarbagePile> & garbage, GLuint vao, GLuint vbo, GLuint instance_vbo)
+                : vao(vao), vbo(vbo), instance_vbo(instance_vbo), instance_count(0), garbage(garbage)
         {}
 
         GLuint vao;
         GLuint vbo;
+        GLuint instance_vbo;
+        GLsizei instance_count;
+
+        std::shared_ptr<GlGarbagePile> garbage;
     };
 
-    inline GlLine GlLine::create()
+    inline GlLine GlLine::create(const std::shared_ptr<GlGarbagePile> & garbage, GlState & state)
     {
-        GLuint vao, vbo;
+        GLuint vao, vbo, instance_vbo;
 
         const float buffer[] = { 0.0, 0.0, 0.0, 1.0, 0.0, 0.0 };
 
         glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
         glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6, buffer, GL_STATIC_DRAW);
-
-        // Position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(0);
-
-        glBindVertexArray(0);
-
-        return { vao, vbo };
+        glGenBuffers(1, &instance_vbo);
+        state.with_vertex_array(vao, [&]
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6, buffer, GL_STATIC_DRAW);
+
+            // Position attribute
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+            glEnableVertexAttribArray(0);
+
+            // Per-instance end points and color
+            glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+            const auto stride = static_cast<GLsizei>(FLOATS_PER_LINE * sizeof(float));
+            for (GLuint i = 0; i < 3; ++i)
+            {
+                const auto offset = reinterpret_cast<void *>(3 * i * sizeof(float));
+                glVertexAttribPointer(1 + i, 3, GL_FLOAT, GL_FALSE, stride, offset);
+                glEnableVertexAttribArray(1 + i);
+                glVertexAttribDivisor(1 + i, 1);
+            }
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        return GlLine(garbage, vao, vbo, instance_vbo);
     }
 
-    inline void GlLine::bind()
+    inline void GlLine::update(const std::vector<float> & instances)
     {
-        glBindVertexArray(vao);
+        assert(instances.size() % FLOATS_PER_LINE == 0);
+        instance_count = static_cast<GLsizei>(instances.size() / FLOATS_PER_LINE);
+        if (instance_count == 0)
+        {
+            return;
+        }
+
+        // Lines are typically rebuilt every frame, so the storage is simply respecified
+        glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    inline void GlLine::unbind()
+    inline void GlLine::draw(GlState & state)
     {
-        glBindVertexArray(vbo);
+        if (instance_count > 0)
+        {
+            state.bind_vertex_array(vao);
+            glDrawArraysInstanced(GL_LINES, 0, 2, instance_count);
+        }
     }
-}
\ No newline at end of file
+}
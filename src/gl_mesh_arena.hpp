@@ -0,0 +1,497 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gl_gc.hpp"
+#include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "range_allocator.hpp"
+
+namespace merely3d
+{
+    /// The smallest number of vertices or indices that a GlMeshArena allocates room for.
+    const size_t MIN_MESH_ARENA_CAPACITY = 1 << 16;
+
+    /// The number of bytes of meshes that are copied per frame while a GlMeshArena is being compacted.
+    const size_t MESH_ARENA_COMPACTION_BUDGET = 4 * 1024 * 1024;
+
+    /// The part of a GlMeshArena that holds the geometry of a single mesh.
+    ///
+    /// The indices of the mesh are relative to its first vertex, so they must be drawn
+    /// with `first_vertex` as the base vertex.
+    struct MeshArenaRange
+    {
+        size_t first_vertex;
+        size_t vertex_count;
+        size_t first_index;
+        size_t index_count;
+    };
+
+    /// Stores the geometry of many meshes in a single vertex buffer and a single element buffer,
+    /// so that all of them can be drawn with the same vertex array.
+    ///
+    /// Vertices consist of a position and a normal (see GlPrimitive), and meshes are indexed triangle lists.
+    /// The ranges of the buffers that hold each mesh are suballocated with a RangeAllocator. The buffers
+    /// grow as needed without moving any mesh, whereas compaction moves all meshes to the front of new buffers.
+    /// Compaction is spread over as many frames as it takes to copy the meshes a bounded number of bytes
+    /// at a time (see compact_step), during which the meshes are still drawn from the old buffers, so that
+    /// no single frame stalls on copying the whole arena. The buffers are acquired from, and returned to,
+    /// the pool of the garbage pile.
+    ///
+    /// The arena holds no vertex array, since the buffers may be shared by several contexts, whereas
+    /// vertex arrays may not. Instead, each context points a vertex array of its own to the buffers
+    /// through bind_buffers(), and does so again whenever the buffers have been replaced (see generation()).
+    class GlMeshArena
+    {
+    public:
+        GlMeshArena(GlMeshArena && other) noexcept
+            : _vbo(other._vbo), _ebo(other._ebo),
+              _vbo_size(other._vbo_size), _ebo_size(other._ebo_size), _generation(other._generation),
+              _vertices(other._vertices), _indices(other._indices),
+              _meshes(std::move(other._meshes)), _free_slots(std::move(other._free_slots)),
+              _compaction(std::move(other._compaction)),
+              _garbage(other._garbage)
+        {
+            other._garbage.reset();
+        }
+
+        ~GlMeshArena()
+        {
+            if (_garbage)
+            {
+                recycle_buffer(_ebo, _ebo_size);
+                recycle_buffer(_vbo, _vbo_size);
+                abort_compaction();
+            }
+        }
+
+        GlMeshArena(const GlMeshArena & other) = delete;
+        GlMeshArena & operator=(const GlMeshArena & other) = delete;
+        GlMeshArena & operator=(GlMeshArena && other) = delete;
+
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlMeshArena create(const std::shared_ptr<GlGarbagePile> & garbage)
+        {
+            return GlMeshArena(garbage);
+        }
+
+        /// Copies the given mesh into the arena, and returns the slot through which its range can be looked up.
+        /// The vertices and triangles are given in the format of StaticMesh.
+        size_t add(const std::vector<float> & vertices_and_normals, const std::vector<unsigned int> & triangles);
+
+        /// Frees the range of the mesh in the given slot, and makes the slot available for reuse.
+        void remove(size_t slot);
+
+        /// The current range of the mesh in the given slot, which changes when a compaction finishes.
+        const MeshArenaRange & range(size_t slot) const
+        {
+            assert(slot < _meshes.size());
+            return _meshes[slot];
+        }
+
+        /// Whether so much of the arena is free space, in between or after the meshes, that it should be compacted.
+        bool fragmented() const
+        {
+            return is_fragmented(_vertices, VERTEX_SIZE) || is_fragmented(_indices, INDEX_SIZE);
+        }
+
+        /// Whether a compaction has been started by compact_step(), but not yet finished.
+        bool compacting() const
+        {
+            return static_cast<bool>(_compaction);
+        }
+
+        /// Copies the meshes into new buffers that leave only a moderate amount of free space, starting
+        /// a compaction unless one is in progress. Once `max_bytes` have been copied, the remaining meshes are
+        /// left to the following calls, although a single mesh is always copied in full. The copying is done
+        /// by the GPU, so the cost of a call is that of the copies it queues.
+        ///
+        /// Meshes may be added and removed in between calls. Once the last mesh has been copied, the new buffers
+        /// replace the old ones, and the ranges of all meshes change, so this must only be called before
+        /// any draw of the frame refers to the ranges. Until then, the old and the new buffers take up memory
+        /// side by side.
+        void compact_step(size_t max_bytes);
+
+        /// Points the given vertex array to the current vertex and element buffers of the arena.
+        void bind_buffers(GlState & state, GLuint vao) const;
+
+        /// Counts the number of times the buffers have been replaced, by growing or compacting the arena.
+        /// Vertex arrays must be bound to the buffers again (see bind_buffers) whenever it changes.
+        uint64_t generation() const
+        {
+            return _generation;
+        }
+
+    private:
+        explicit GlMeshArena(const std::shared_ptr<GlGarbagePile> & garbage)
+            : _vbo(0), _ebo(0), _vbo_size(0), _ebo_size(0), _generation(0), _garbage(garbage)
+        {}
+
+        static const size_t FLOATS_PER_VERTEX = 6;
+        static const size_t VERTEX_SIZE = FLOATS_PER_VERTEX * sizeof(float);
+        static const size_t INDEX_SIZE = sizeof(unsigned int);
+
+        /// The size in bytes of a buffer that holds the allocated elements of the allocator after compaction.
+        static size_t compacted_size(const RangeAllocator & allocator, size_t element_size)
+        {
+            // Leave some room, so that a few meshes may be added without immediately growing again
+            const auto capacity = std::max(allocator.used() + allocator.used() / 2, MIN_MESH_ARENA_CAPACITY);
+            return pooled_buffer_size(element_size * capacity);
+        }
+
+        static bool is_fragmented(const RangeAllocator & allocator, size_t element_size)
+        {
+            const auto free_size = allocator.capacity() - allocator.used();
+            return free_size > allocator.used()
+                && element_size * allocator.capacity() > compacted_size(allocator, element_size);
+        }
+
+        /// Allocates a range of the given size, growing the buffer if there is no free range that is large enough.
+        size_t allocate(RangeAllocator & allocator, GLuint & buffer, size_t & buffer_size, size_t element_size, size_t count);
+
+        /// Transfers the given mesh into the given range of the given buffers.
+        static void write_mesh(GLuint vbo,
+                               GLuint ebo,
+                               const MeshArenaRange & range,
+                               const std::vector<float> & vertices_and_normals,
+                               const std::vector<unsigned int> & triangles);
+
+        /// Copies `count` elements of the given size from one buffer to another, which are bound to
+        /// the copy binding points.
+        static void copy_elements(GLuint source, GLuint target, size_t element_size, size_t from, size_t to, size_t count);
+
+        /// Acquires the new buffers of a compaction, which leave room for the meshes currently in the arena.
+        void begin_compaction();
+
+        /// Replaces the buffers and ranges of the arena with those of the compaction, once all meshes have been copied.
+        void finish_compaction();
+
+        /// Gives up on the compaction in progress, if any, and releases its buffers.
+        void abort_compaction();
+
+        void recycle_buffer(GLuint buffer, size_t buffer_size)
+        {
+            if (buffer != 0)
+            {
+                _garbage->recycle_buffer_later(buffer, buffer_size);
+            }
+        }
+
+        GLuint _vbo;
+        GLuint _ebo;
+
+        // Sizes of the storage of the vertex and element buffers, in bytes
+        size_t _vbo_size;
+        size_t _ebo_size;
+
+        uint64_t _generation;
+
+        // Allocators of vertices and indices, respectively
+        RangeAllocator _vertices;
+        RangeAllocator _indices;
+
+        std::vector<MeshArenaRange> _meshes;
+        std::vector<size_t> _free_slots;
+
+        /// The new buffers that the meshes are copied into while the arena is being compacted.
+        struct Compaction
+        {
+            GLuint vbo;
+            GLuint ebo;
+            size_t vbo_size;
+            size_t ebo_size;
+            RangeAllocator vertices;
+            RangeAllocator indices;
+
+            // The range of each slot in the new buffers, which is only valid once the slot has been copied.
+            // Meshes that are added during the compaction are written to both the old and the new buffers
+            std::vector<MeshArenaRange> meshes;
+            std::vector<bool> copied;
+
+            // The slot to copy next
+            size_t next_slot;
+        };
+
+        std::unique_ptr<Compaction> _compaction;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+
+    namespace detail
+    {
+        /// Acquires a buffer of the given size from the garbage pile, holding a copy of the given prefix
+        /// of the old buffer (which may be 0 if there is nothing to copy).
+        inline GLuint reallocate_buffer(GlGarbagePile & garbage, GLuint old_buffer, size_t old_size, size_t new_size)
+        {
+            assert(old_size <= new_size);
+            const auto buffer = garbage.acquire_buffer(new_size);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            if (old_buffer != 0 && old_size > 0)
+            {
+                glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(old_size));
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            return buffer;
+        }
+    }
+
+    inline size_t GlMeshArena::allocate(RangeAllocator & allocator,
+                                        GLuint & buffer,
+                                        size_t & buffer_size,
+                                        size_t element_size,
+                                        size_t count)
+    {
+        auto offset = allocator.allocate(count);
+        if (offset == NO_FREE_RANGE)
+        {
+            // Grow geometrically, so that adding meshes one at a time takes amortized constant time.
+            // Any free space at the end of the buffer is merged with the added space, so the allocation
+            // is guaranteed to succeed afterwards
+            const auto old_capacity = allocator.capacity();
+            const auto new_capacity = std::max(std::max(2 * old_capacity, old_capacity + count), MIN_MESH_ARENA_CAPACITY);
+            const auto new_size = pooled_buffer_size(element_size * new_capacity);
+            const auto new_buffer = detail::reallocate_buffer(*_garbage, buffer, element_size * old_capacity, new_size);
+            recycle_buffer(buffer, buffer_size);
+            buffer = new_buffer;
+            buffer_size = new_size;
+            allocator.grow(new_size / element_size);
+            ++_generation;
+
+            offset = allocator.allocate(count);
+            assert(offset != NO_FREE_RANGE);
+        }
+        return offset;
+    }
+
+    inline size_t GlMeshArena::add(const std::vector<float> & vertices_and_normals,
+                                   const std::vector<unsigned int> & triangles)
+    {
+        assert(vertices_and_normals.size() % FLOATS_PER_VERTEX == 0);
+        assert(triangles.size() % 3 == 0);
+
+        MeshArenaRange range;
+        range.vertex_count = vertices_and_normals.size() / FLOATS_PER_VERTEX;
+        range.index_count = triangles.size();
+        range.first_vertex = allocate(_vertices, _vbo, _vbo_size, VERTEX_SIZE, range.vertex_count);
+        range.first_index = allocate(_indices, _ebo, _ebo_size, INDEX_SIZE, range.index_count);
+        write_mesh(_vbo, _ebo, range, vertices_and_normals, triangles);
+
+        size_t slot;
+        if (_free_slots.empty())
+        {
+            _meshes.push_back(range);
+            slot = _meshes.size() - 1;
+        }
+        else
+        {
+            slot = _free_slots.back();
+            _free_slots.pop_back();
+            _meshes[slot] = range;
+        }
+
+        if (_compaction)
+        {
+            // The mesh is written to the new buffers right away, rather than copied later on. If it does not fit,
+            // the compaction starts over later with buffers that leave room for it
+            auto & compaction = *_compaction;
+            MeshArenaRange compacted = range;
+            compacted.first_vertex = compaction.vertices.allocate(range.vertex_count);
+            compacted.first_index = compaction.indices.allocate(range.index_count);
+            if (compacted.first_vertex == NO_FREE_RANGE || compacted.first_index == NO_FREE_RANGE)
+            {
+                abort_compaction();
+            }
+            else
+            {
+                write_mesh(compaction.vbo, compaction.ebo, compacted, vertices_and_normals, triangles);
+                compaction.meshes.resize(_meshes.size());
+                compaction.copied.resize(_meshes.size(), false);
+                compaction.meshes[slot] = compacted;
+                compaction.copied[slot] = true;
+            }
+        }
+        return slot;
+    }
+
+    inline void GlMeshArena::write_mesh(GLuint vbo,
+                                        GLuint ebo,
+                                        const MeshArenaRange & range,
+                                        const std::vector<float> & vertices_and_normals,
+                                        const std::vector<unsigned int> & triangles)
+    {
+        // The element buffer is bound to the vertex array, so transfers go through the copy binding point,
+        // which leaves the bindings of whatever vertex array happens to be bound untouched
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER,
+                        static_cast<GLintptr>(VERTEX_SIZE * range.first_vertex),
+                        static_cast<GLsizeiptr>(VERTEX_SIZE * range.vertex_count),
+                        vertices_and_normals.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER,
+                        static_cast<GLintptr>(INDEX_SIZE * range.first_index),
+                        static_cast<GLsizeiptr>(INDEX_SIZE * range.index_count),
+                        triangles.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+    }
+
+    inline void GlMeshArena::remove(size_t slot)
+    {
+        assert(slot < _meshes.size());
+        auto & range = _meshes[slot];
+        _vertices.free(range.first_vertex, range.vertex_count);
+        _indices.free(range.first_index, range.index_count);
+        range = MeshArenaRange { 0, 0, 0, 0 };
+        _free_slots.push_back(slot);
+
+        if (_compaction && slot < _compaction->copied.size() && _compaction->copied[slot])
+        {
+            auto & compacted = _compaction->meshes[slot];
+            _compaction->vertices.free(compacted.first_vertex, compacted.vertex_count);
+            _compaction->indices.free(compacted.first_index, compacted.index_count);
+            compacted = range;
+        }
+    }
+
+    inline void GlMeshArena::copy_elements(GLuint source,
+                                           GLuint target,
+                                           size_t element_size,
+                                           size_t from,
+                                           size_t to,
+                                           size_t count)
+    {
+        if (count > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, source);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                static_cast<GLintptr>(element_size * from),
+                                static_cast<GLintptr>(element_size * to),
+                                static_cast<GLsizeiptr>(element_size * count));
+        }
+    }
+
+    inline void GlMeshArena::begin_compaction()
+    {
+        assert(!_compaction);
+        const auto vbo_size = compacted_size(_vertices, VERTEX_SIZE);
+        const auto ebo_size = compacted_size(_indices, INDEX_SIZE);
+        _compaction.reset(new Compaction {
+            _garbage->acquire_buffer(vbo_size),
+            _garbage->acquire_buffer(ebo_size),
+            vbo_size,
+            ebo_size,
+            RangeAllocator(vbo_size / VERTEX_SIZE),
+            RangeAllocator(ebo_size / INDEX_SIZE),
+            std::vector<MeshArenaRange>(_meshes.size()),
+            std::vector<bool>(_meshes.size(), false),
+            0
+        });
+    }
+
+    inline void GlMeshArena::compact_step(size_t max_bytes)
+    {
+        assert(max_bytes > 0);
+        if (!_compaction)
+        {
+            begin_compaction();
+        }
+        auto & compaction = *_compaction;
+
+        // Allocating the meshes one after another from empty allocators packs them tightly.
+        // Free slots hold empty ranges, which take up no space
+        size_t copied_bytes = 0;
+        while (compaction.next_slot < _meshes.size() && copied_bytes < max_bytes)
+        {
+            const auto slot = compaction.next_slot++;
+            if (compaction.copied[slot])
+            {
+                continue;
+            }
+
+            const auto & range = _meshes[slot];
+            MeshArenaRange compacted = range;
+            compacted.first_vertex = compaction.vertices.allocate(range.vertex_count);
+            compacted.first_index = compaction.indices.allocate(range.index_count);
+            if (compacted.first_vertex == NO_FREE_RANGE || compacted.first_index == NO_FREE_RANGE)
+            {
+                // Meshes removed during the compaction may have left the new buffers too fragmented
+                abort_compaction();
+                return;
+            }
+
+            copy_elements(_vbo, compaction.vbo, VERTEX_SIZE, range.first_vertex, compacted.first_vertex, range.vertex_count);
+            copy_elements(_ebo, compaction.ebo, INDEX_SIZE, range.first_index, compacted.first_index, range.index_count);
+            compaction.meshes[slot] = compacted;
+            compaction.copied[slot] = true;
+            copied_bytes += VERTEX_SIZE * range.vertex_count + INDEX_SIZE * range.index_count;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+
+        if (compaction.next_slot == _meshes.size())
+        {
+            finish_compaction();
+        }
+    }
+
+    inline void GlMeshArena::finish_compaction()
+    {
+        // The copies are issued before any draw that reads the new buffers, so there is no need
+        // to wait for the GPU to finish them
+        auto & compaction = *_compaction;
+        recycle_buffer(_vbo, _vbo_size);
+        recycle_buffer(_ebo, _ebo_size);
+        _vbo = compaction.vbo;
+        _ebo = compaction.ebo;
+        _vbo_size = compaction.vbo_size;
+        _ebo_size = compaction.ebo_size;
+        _vertices = std::move(compaction.vertices);
+        _indices = std::move(compaction.indices);
+        _meshes = std::move(compaction.meshes);
+        _compaction.reset();
+        ++_generation;
+    }
+
+    inline void GlMeshArena::abort_compaction()
+    {
+        if (_compaction)
+        {
+            recycle_buffer(_compaction->vbo, _compaction->vbo_size);
+            recycle_buffer(_compaction->ebo, _compaction->ebo_size);
+            _compaction.reset();
+        }
+    }
+
+    inline void GlMeshArena::bind_buffers(GlState & state, GLuint vao) const
+    {
+        state.with_vertex_array(vao, [this]
+        {
+            // The vertex buffer does not exist until the first vertex has been added
+            if (_vbo != 0)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+                // Position attribute
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, nullptr);
+                glEnableVertexAttribArray(0);
+                // normal attribute
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (void*)(3 * sizeof(float)));
+                glEnableVertexAttribArray(1);
+            }
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
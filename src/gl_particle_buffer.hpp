@@ -3,15 +3,25 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <vector>
 #include <cassert>
 
 #include <merely3d/primitives.hpp>
 #include "gl_gc.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 
 namespace merely3d
 {
+    /// The layout of the particle records stored in a GlParticleBuffer.
+    enum class ParticleLayout
+    {
+        /// Position (3 floats), color (3 floats), radius (1 float), as pushed by CommandBuffer::push_particle.
+        Colored,
+        /// Position (3 floats), scalar (1 float), radius (1 float), as pushed by CommandBuffer::push_scalar_particle.
+        Scalar
+    };
 
     class GlParticleBuffer
     {
@@ -23,29 +33,82 @@ namespace merely3d
         GlParticleBuffer & operator=(const GlParticleBuffer & other) = delete;
         GlParticleBuffer & operator=(GlParticleBuffer && other) = delete;
 
-        /// Creates a new particle buffer.
+        /// Creates a new particle buffer for particles with the given layout.
+        ///
+        /// If `with_previous_snapshot` is true, the buffer additionally holds a second copy of the
+        /// particles, whose positions are bound to the previous position attribute (location 4), for
+        /// interpolation between snapshots. Otherwise, the previous position attribute refers
+        /// to the current positions.
         ///
         /// Note that the correct OpenGL context MUST be set prior to
         /// calling this function.
-        static GlParticleBuffer create(const std::shared_ptr<GlGarbagePile> & garbage);
+        static GlParticleBuffer create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                       GlState & state,
+                                       ParticleLayout layout = ParticleLayout::Colored,
+                                       bool with_previous_snapshot = false);
 
         /// Updates particle data on the GPU.
         ///
         /// Note that the correct OpenGL context MUST be set prior to
         /// calling this function.
-        void update_buffer(const float * particles, size_t num_particles);
+        void update_buffer(GlState & state, const float * particles, size_t num_particles);
+
+        /// Makes sure that the GPU buffer can hold at least the given number of particles.
+        ///
+        /// Returns true if the buffer had to be reallocated, in which case the first `num_kept` particles
+        /// and their previous snapshot are copied to the new buffers on the GPU, and the rest of its previous
+        /// contents are lost. Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        bool reserve(GlState & state, size_t num_particles, size_t num_kept = 0);
 
-        void bind();
+        /// Overwrites `num_particles` particles on the GPU, starting at particle index `first`.
+        ///
+        /// The buffer must already have room for the updated particles (see reserve()).
+        /// Note that the correct OpenGL context MUST be set prior to calling this function.
+        void update_range(const float * particles, size_t first, size_t num_particles);
 
-        void unbind();
+        /// Copies `num_particles` particles starting at index `first` from the current particles to the
+        /// previous snapshot. The copy happens entirely on the GPU.
+        ///
+        /// Requires the buffer to have been created with a previous snapshot.
+        /// Note that the correct OpenGL context MUST be set prior to calling this function.
+        void copy_to_previous(size_t first, size_t num_particles);
+
+        void bind(GlState & state);
+
+        /// The number of floats in each particle record.
+        size_t floats_per_particle() const { return _floats_per_particle; }
+
+        /// The offset (in floats) of the radius within each particle record.
+        size_t radius_offset() const { return _floats_per_particle - 1; }
 
     private:
-        GlParticleBuffer(const std::shared_ptr<GlGarbagePile> & garbage, GLuint vao, GLuint vbo)
-            : _vao(vao), _vbo(vbo), _garbage(garbage)
+        GlParticleBuffer(const std::shared_ptr<GlGarbagePile> & garbage,
+                         GLuint vao, GLuint vbo, GLuint previous_vbo, size_t buffer_size, ParticleLayout layout)
+            : _vao(vao), _vbo(vbo), _previous_vbo(previous_vbo), _buffer_size(buffer_size), _layout(layout),
+              _floats_per_particle(layout == ParticleLayout::Colored ? 7 : 5),
+              _capacity(buffer_size / (sizeof(float) * _floats_per_particle)), _garbage(garbage)
         {}
 
+        /// Points the attributes of the vertex array to the current buffers.
+        void set_attributes(GlState & state);
+
+        /// Points the attributes of the currently bound vertex array to the current buffers.
+        void set_vertex_array_attributes();
+
         GLuint _vao;
         GLuint _vbo;
+        // Zero if the buffer has no previous snapshot
+        GLuint _previous_vbo;
+
+        // Size of the storage of each of the buffers, in bytes
+        size_t _buffer_size;
+
+        ParticleLayout _layout;
+        size_t _floats_per_particle;
+
+        // Number of particles the GPU buffer has room for
+        size_t _capacity;
 
         std::shared_ptr<GlGarbagePile> _garbage;
     };
@@ -53,6 +116,11 @@ namespace merely3d
     inline GlParticleBuffer::GlParticleBuffer(GlParticleBuffer && other) noexcept
         : _vao(other._vao),
           _vbo(other._vbo),
+          _previous_vbo(other._previous_vbo),
+          _buffer_size(other._buffer_size),
+          _layout(other._layout),
+          _floats_per_particle(other._floats_per_particle),
+          _capacity(other._capacity),
           _garbage(other._garbage)
     {
         other._garbage.reset();
@@ -62,69 +130,152 @@ namespace merely3d
     {
         if (_garbage)
         {
-            _garbage->delete_vertex_buffer_later(_vbo);
-            _garbage->delete_vertex_array_later(_vao);
+            _garbage->recycle_buffer_later(_vbo, _buffer_size);
+            if (_previous_vbo != 0)
+            {
+                _garbage->recycle_buffer_later(_previous_vbo, _buffer_size);
+            }
+            _garbage->recycle_vertex_array_later(_vao);
         }
     }
 
-    inline GlParticleBuffer GlParticleBuffer::create(const std::shared_ptr<GlGarbagePile> & garbage)
+    inline GlParticleBuffer GlParticleBuffer::create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                                     GlState & state,
+                                                     ParticleLayout layout,
+                                                     bool with_previous_snapshot)
+    {
+        // Start out with the smallest pooled buffers, which are replaced as soon as they run out of room
+        const auto vao = garbage->acquire_vertex_array();
+        const auto vbo = garbage->acquire_buffer(0);
+        const auto previous_vbo = with_previous_snapshot ? garbage->acquire_buffer(0) : 0;
+
+        auto buffer = GlParticleBuffer(garbage, vao, vbo, previous_vbo, pooled_buffer_size(0), layout);
+        buffer.set_attributes(state);
+        return buffer;
+    }
+
+    inline void GlParticleBuffer::set_attributes(GlState & state)
+    {
+        state.with_vertex_array(_vao, [this] { set_vertex_array_attributes(); });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    inline void GlParticleBuffer::set_vertex_array_attributes()
     {
-        GLuint vao, vbo;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+        const auto stride = static_cast<GLsizei>(_floats_per_particle * sizeof(float));
 
         // Position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), NULL);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, NULL);
         glEnableVertexAttribArray(0);
-        // color attribute
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+        if (_layout == ParticleLayout::Colored)
+        {
+            // color attribute
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+        }
+        else
+        {
+            // scalar attribute
+            glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(3);
+        }
         // radius attribute
-        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(6 * sizeof(float)));
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)((_floats_per_particle - 1) * sizeof(float)));
         glEnableVertexAttribArray(2);
 
-        glBindVertexArray(0);
-
-        return { garbage, vao, vbo };
+        // Previous position attribute
+        if (_previous_vbo != 0)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, _previous_vbo);
+        }
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, NULL);
+        glEnableVertexAttribArray(4);
     }
 
-    inline void GlParticleBuffer::bind()
+    inline void GlParticleBuffer::bind(GlState & state)
     {
-        glBindVertexArray(_vao);
+        state.bind_vertex_array(_vao);
     }
 
-    inline void GlParticleBuffer::unbind()
+    inline bool GlParticleBuffer::reserve(GlState & state, size_t num_particles, size_t num_kept)
     {
-        glBindVertexArray(0);
+        if (num_particles <= _capacity)
+        {
+            return false;
+        }
+
+        // Grow geometrically, to avoid reallocating when a small number of particles
+        // are added at each time step (which would then cause a full reallocation
+        // on each time step).
+        const auto particle_size = sizeof(float) * _floats_per_particle;
+        const auto new_capacity = std::max(num_particles, _capacity + _capacity / 2);
+        const auto buffer_size = pooled_buffer_size(particle_size * new_capacity);
+        assert(num_kept <= _capacity);
+        const auto kept_size = static_cast<GLsizeiptr>(particle_size * num_kept);
+
+        // The kept particles are copied on the GPU, so that they need not be transferred again,
+        // and their previous snapshot is kept
+        const auto replace = [&] (GLuint & buffer)
+        {
+            const auto new_buffer = _garbage->acquire_buffer(buffer_size);
+            if (kept_size > 0)
+            {
+                glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, kept_size);
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            }
+            _garbage->recycle_buffer_later(buffer, _buffer_size);
+            buffer = new_buffer;
+        };
+        replace(_vbo);
+        if (_previous_vbo != 0)
+        {
+            replace(_previous_vbo);
+        }
+        _buffer_size = buffer_size;
+        _capacity = buffer_size / particle_size;
+
+        set_attributes(state);
+        MERELY_CHECK_GL_ERRORS();
+        return true;
     }
 
-    inline void GlParticleBuffer::update_buffer(const float * particle_data, size_t num_particles)
+    inline void GlParticleBuffer::update_range(const float * particle_data, size_t first, size_t num_particles)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-        MERELY_CHECK_GL_ERRORS();
+        assert(first + num_particles <= _capacity);
 
-        GLint current_gpu_buffer_size = 0;
-        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &current_gpu_buffer_size);
-        MERELY_CHECK_GL_ERRORS();
+        const auto offset = static_cast<GLintptr>(sizeof(float) * _floats_per_particle * first);
+        const auto size = static_cast<GLsizeiptr>(sizeof(float) * _floats_per_particle * num_particles);
 
-        constexpr size_t NUM_FLOATS_PER_PARTICLES = 7;
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, static_cast<const void*>(particle_data));
+        MERELY_CHECK_GL_ERRORS();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-        const auto buffer_size = static_cast<GLint>(sizeof(float) * NUM_FLOATS_PER_PARTICLES * num_particles);
+    inline void GlParticleBuffer::copy_to_previous(size_t first, size_t num_particles)
+    {
+        assert(_previous_vbo != 0);
+        assert(first + num_particles <= _capacity);
 
-        // TODO: Use geometric increments to avoid reallocating when a small number of
-        // particles are added at each time step (which would then cause a full reallocation
-        // on each time step).
-        if (current_gpu_buffer_size < buffer_size)
-        {
-            glBufferData(GL_ARRAY_BUFFER, buffer_size, nullptr, GL_STREAM_DRAW);
-            MERELY_CHECK_GL_ERRORS();
-        }
+        const auto offset = static_cast<GLintptr>(sizeof(float) * _floats_per_particle * first);
+        const auto size = static_cast<GLsizeiptr>(sizeof(float) * _floats_per_particle * num_particles);
 
-        glBufferSubData(GL_ARRAY_BUFFER, 0, buffer_size, static_cast<const void*>(particle_data));
+        glBindBuffer(GL_COPY_READ_BUFFER, _vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _previous_vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, offset, size);
         MERELY_CHECK_GL_ERRORS();
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    inline void GlParticleBuffer::update_buffer(GlState & state, const float * particle_data, size_t num_particles)
+    {
+        reserve(state, num_particles);
+        update_range(particle_data, 0, num_particles);
     }
 }
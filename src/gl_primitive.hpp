@@ -5,20 +5,34 @@
 
 #include <vector>
 #include <cassert>
+#include <memory>
+
+#include "gl_gc.hpp"
 
 namespace merely3d
 {
     /// Helper class for managing primitives represented as
     /// triangles with repeated vertices and associated normals.
+    ///
+    /// Only the vertex buffer is held, which, unlike a vertex array, may be shared between contexts
+    /// (see SharedResources). The geometry is drawn through the vertex arrays of GlInstanceBuffer.
     class GlPrimitive
     {
     public:
         GlPrimitive(GlPrimitive && other)
-            :   vao(other.vao), vbo(other.vbo), num_vertices(other.num_vertices)
+            :   vbo(other.vbo), num_vertices(other.num_vertices), garbage(other.garbage)
         {
-            other.vao = 0;
             other.vbo = 0;
             other.num_vertices = 0;
+            other.garbage.reset();
+        }
+
+        ~GlPrimitive()
+        {
+            if (garbage)
+            {
+                garbage->delete_vertex_buffer_later(vbo);
+            }
         }
 
         GlPrimitive(const GlPrimitive & other) = delete;
@@ -29,34 +43,33 @@ namespace merely3d
         /// { v1_x, v1_y, v1_z, n1_x, n1_y, n1_z, v2_x, ...}
         /// Note that the correct OpenGL context MUST be set prior to
         /// calling this function.
-        ///
-        /// Shader attributes are set up according to the format
-        /// description that was just presented.
-        static GlPrimitive create(const std::vector<float> & vertices_and_normals);
-
-        /// Binds the associated buffers of this primitive.
-        void bind();
-
-        /// Unbinds the associated buffers of this primitive.
-        void unbind();
+        static GlPrimitive create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                  const std::vector<float> & vertices_and_normals);
 
         size_t vertex_count() const
         {
             return num_vertices;
         }
 
+        GLuint vertex_buffer() const
+        {
+            return vbo;
+        }
+
     private:
-        GlPrimitive(GLuint vao, GLuint vbo, size_t num_vertices)
-            : vao(vao), vbo(vbo), num_vertices(num_vertices)
+        GlPrimitive(const std::shared_ptr<GlGarbagePile> & garbage, GLuint vbo, size_t num_vertices)
+            : vbo(vbo), num_vertices(num_vertices), garbage(garbage)
         {}
 
-        GLuint vao;
         GLuint vbo;
 
         size_t num_vertices;
+
+        std::shared_ptr<GlGarbagePile> garbage;
     };
 
-    inline GlPrimitive GlPrimitive::create(const std::vector<float> & vertices_and_normals)
+    inline GlPrimitive GlPrimitive::create(const std::shared_ptr<GlGarbagePile> & garbage,
+                                           const std::vector<float> & vertices_and_normals)
     {
         // Should be triangles of 3 vertices, each 3 floats,
         // plus 3 floats for each vertex corresponding to its normal vector
@@ -64,33 +77,14 @@ namespace merely3d
 
         const auto num_vertices = vertices_and_normals.size() / 6;
 
-        const auto & v = vertices_and_normals.data();
-        GLuint vao, vbo;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
+        // The copy binding point is used so that the bindings of the current vertex array are left untouched
+        GLuint vbo;
         glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices_and_normals.size(), v, GL_STATIC_DRAW);
-
-        // Position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(0);
-        // normal attribute
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        glBindVertexArray(0);
-
-        return GlPrimitive(vao, vbo, num_vertices);
-    }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(float) * vertices_and_normals.size(),
+                     vertices_and_normals.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 
-    inline void GlPrimitive::bind()
-    {
-        glBindVertexArray(vao);
-    }
-
-    inline void GlPrimitive::unbind()
-    {
-        glBindVertexArray(0);
+        return GlPrimitive(garbage, vbo, num_vertices);
     }
 }
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace merely3d
+{
+    struct GlViewport
+    {
+        GLint x;
+        GLint y;
+        GLsizei width;
+        GLsizei height;
+
+        bool operator==(const GlViewport & other) const
+        {
+            return x == other.x && y == other.y && width == other.width && height == other.height;
+        }
+    };
+
+    /// Counts of the state changes requested through a GlState.
+    struct GlStateCounters
+    {
+        GlStateCounters() : issued(0), skipped(0) {}
+
+        /// The number of state changes that were passed on to OpenGL.
+        size_t issued;
+
+        /// The number of state changes that were skipped, since they would not have changed anything.
+        size_t skipped;
+    };
+
+    /// Tracks the OpenGL state that is set through it, so that redundant state changes can be skipped,
+    /// and so that the state can be looked up without querying OpenGL, which may stall the pipeline.
+    ///
+    /// The tracker only knows about state that was set through it, and initially considers all state unknown.
+    /// The GL object wrappers (GlInstanceBuffer and friends) therefore bind vertex arrays and framebuffers
+    /// through the tracker when the objects are created or resized (see with_vertex_array), so that they
+    /// may be created at any point while rendering. State that is changed behind the back of the tracker,
+    /// e.g. by the garbage collector or by the application, requires a call to invalidate().
+    class GlState
+    {
+    public:
+        GlState()
+        {
+            invalidate();
+        }
+
+        /// Forgets all tracked state, so that the next change of every piece of state is passed on to OpenGL.
+        void invalidate()
+        {
+            _program.known = false;
+            _vertex_array.known = false;
+            _framebuffer.known = false;
+            _cull_face.known = false;
+            _polygon_mode.known = false;
+            _depth_func.known = false;
+            _color_mask.known = false;
+            _blend_func.known = false;
+            _viewport.known = false;
+            _capabilities.clear();
+        }
+
+        void use_program(GLuint program)
+        {
+            if (change(_program, program))
+            {
+                glUseProgram(program);
+            }
+        }
+
+        void bind_vertex_array(GLuint vertex_array)
+        {
+            if (change(_vertex_array, vertex_array))
+            {
+                glBindVertexArray(vertex_array);
+            }
+        }
+
+        void bind_framebuffer(GLuint framebuffer)
+        {
+            if (change(_framebuffer, framebuffer))
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            }
+        }
+
+        /// Binds the given vertex array while calling func, e.g. to set up its attributes, and binds the previously
+        /// bound vertex array again afterwards. If that is not known, vertex array 0 is bound instead, so that
+        /// the buffers bound later on, such as element array buffers, never end up in another vertex array.
+        template <typename Func>
+        void with_vertex_array(GLuint vertex_array, Func func)
+        {
+            const auto previous = _vertex_array;
+            bind_vertex_array(vertex_array);
+            func();
+            bind_vertex_array(previous.known ? previous.value : 0);
+        }
+
+        /// Binds the given framebuffer while calling func, e.g. to attach its textures, and binds the previously
+        /// bound framebuffer again afterwards, or framebuffer 0 if that is not known. The previous framebuffer
+        /// is bound again if func throws.
+        template <typename Func>
+        void with_framebuffer(GLuint framebuffer, Func func)
+        {
+            const auto previous = _framebuffer;
+            bind_framebuffer(framebuffer);
+            try
+            {
+                func();
+            }
+            catch (...)
+            {
+                bind_framebuffer(previous.known ? previous.value : 0);
+                throw;
+            }
+            bind_framebuffer(previous.known ? previous.value : 0);
+        }
+
+        /// Returns the currently bound framebuffer, which must have been bound through the tracker.
+        GLuint framebuffer() const
+        {
+            assert(_framebuffer.known);
+            return _framebuffer.value;
+        }
+
+        /// Enables or disables the given capability, i.e. GL_CULL_FACE, GL_DEPTH_TEST and so on.
+        void set_enabled(GLenum capability, bool enabled)
+        {
+            auto & tracked = capability_state(capability);
+            if (change(tracked, enabled))
+            {
+                if (enabled)
+                {
+                    glEnable(capability);
+                }
+                else
+                {
+                    glDisable(capability);
+                }
+            }
+        }
+
+        void cull_face(GLenum mode)
+        {
+            if (change(_cull_face, mode))
+            {
+                glCullFace(mode);
+            }
+        }
+
+        /// Sets the polygon mode of both front and back faces.
+        void polygon_mode(GLenum mode)
+        {
+            if (change(_polygon_mode, mode))
+            {
+                glPolygonMode(GL_FRONT_AND_BACK, mode);
+            }
+        }
+
+        void depth_func(GLenum func)
+        {
+            if (change(_depth_func, func))
+            {
+                glDepthFunc(func);
+            }
+        }
+
+        /// Enables or disables writing to all color channels.
+        void color_mask(bool enabled)
+        {
+            if (change(_color_mask, enabled))
+            {
+                const auto value = enabled ? GL_TRUE : GL_FALSE;
+                glColorMask(value, value, value, value);
+            }
+        }
+
+        void blend_func(GLenum source_factor, GLenum destination_factor)
+        {
+            if (change(_blend_func, std::make_pair(source_factor, destination_factor)))
+            {
+                glBlendFunc(source_factor, destination_factor);
+            }
+        }
+
+        void viewport(const GlViewport & viewport)
+        {
+            if (change(_viewport, viewport))
+            {
+                glViewport(viewport.x, viewport.y, viewport.width, viewport.height);
+            }
+        }
+
+        /// Returns the current viewport, which must have been set through the tracker.
+        const GlViewport & viewport() const
+        {
+            assert(_viewport.known);
+            return _viewport.value;
+        }
+
+        const GlStateCounters & counters() const
+        {
+            return _counters;
+        }
+
+        void reset_counters()
+        {
+            _counters = GlStateCounters();
+        }
+
+    private:
+        template <typename T>
+        struct Tracked
+        {
+            Tracked() : value(), known(false) {}
+
+            T value;
+            bool known;
+        };
+
+        /// Updates the tracked value, and returns whether the change must be passed on to OpenGL.
+        template <typename T>
+        bool change(Tracked<T> & tracked, const T & value)
+        {
+            if (tracked.known && tracked.value == value)
+            {
+                ++_counters.skipped;
+                return false;
+            }
+
+            tracked.value = value;
+            tracked.known = true;
+            ++_counters.issued;
+            return true;
+        }
+
+        Tracked<bool> & capability_state(GLenum capability)
+        {
+            // Only a handful of capabilities are ever used, so a linear search is fast enough
+            for (auto & entry : _capabilities)
+            {
+                if (entry.first == capability)
+                {
+                    return entry.second;
+                }
+            }
+            _capabilities.push_back(std::make_pair(capability, Tracked<bool>()));
+            return _capabilities.back().second;
+        }
+
+        Tracked<GLuint>                                 _program;
+        Tracked<GLuint>                                 _vertex_array;
+        Tracked<GLuint>                                 _framebuffer;
+        Tracked<GLenum>                                 _cull_face;
+        Tracked<GLenum>                                 _polygon_mode;
+        Tracked<GLenum>                                 _depth_func;
+        Tracked<bool>                                   _color_mask;
+        Tracked<std::pair<GLenum, GLenum>>              _blend_func;
+        Tracked<GlViewport>                             _viewport;
+        std::vector<std::pair<GLenum, Tracked<bool>>>   _capabilities;
+
+        GlStateCounters                                 _counters;
+    };
+}
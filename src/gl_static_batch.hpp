@@ -0,0 +1,159 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "gl_gc.hpp"
+#include "gl_errors.hpp"
+#include "gl_instance_texture.hpp"
+#include "gl_state.hpp"
+#include "static_batch.hpp"
+
+namespace merely3d
+{
+    /// GPU storage for a static batch (see static_batch.hpp).
+    ///
+    /// The vertices are bound to the attribute locations 0 and 1, like the geometry of GlInstanceBuffer,
+    /// and the index of the instance record of each vertex to location 2. The records are stored in
+    /// an instance texture, from which the shaders with InstanceSource::Texture fetch them.
+    class GlStaticBatch
+    {
+    public:
+        GlStaticBatch(GlStaticBatch && other) noexcept
+            : _vao(other._vao),
+              _vbo(other._vbo),
+              _buffer_size(other._buffer_size),
+              _vertex_count(other._vertex_count),
+              _instances(std::move(other._instances)),
+              _garbage(other._garbage)
+        {
+            other._garbage.reset();
+        }
+
+        ~GlStaticBatch()
+        {
+            if (_garbage)
+            {
+                _garbage->recycle_buffer_later(_vbo, _buffer_size);
+                _garbage->recycle_vertex_array_later(_vao);
+            }
+        }
+
+        GlStaticBatch(const GlStaticBatch & other) = delete;
+        GlStaticBatch & operator=(const GlStaticBatch & other) = delete;
+        GlStaticBatch & operator=(GlStaticBatch && other) = delete;
+
+        /// Creates an empty batch.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlStaticBatch create(const std::shared_ptr<GlGarbagePile> & garbage, GlState & state);
+
+        /// Replaces the contents of the batch. The storage of the batch is only replaced
+        /// if the new contents do not fit.
+        ///
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        void upload(GlState & state, const StaticBatchData & batch);
+
+        /// Empties the batch, without releasing its storage.
+        void clear()
+        {
+            _vertex_count = 0;
+        }
+
+        GLuint vertex_array() const { return _vao; }
+
+        size_t vertex_count() const { return _vertex_count; }
+
+        /// The instance records of the batch.
+        const GlInstanceTexture & instances() const { return _instances; }
+
+    private:
+        GlStaticBatch(const std::shared_ptr<GlGarbagePile> & garbage, GLuint vao, GLuint vbo, size_t buffer_size,
+                      GlInstanceTexture && instances)
+            : _vao(vao), _vbo(vbo), _buffer_size(buffer_size),
+              _vertex_count(0), _instances(std::move(instances)), _garbage(garbage)
+        {}
+
+        /// Points the attributes of the currently bound vertex array to the buffer currently bound to GL_ARRAY_BUFFER.
+        static void set_attributes();
+
+        GLuint _vao;
+        GLuint _vbo;
+
+        // Size of the storage of the buffer, in bytes
+        size_t _buffer_size;
+
+        size_t _vertex_count;
+
+        GlInstanceTexture _instances;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+
+    inline GlStaticBatch GlStaticBatch::create(const std::shared_ptr<GlGarbagePile> & garbage, GlState & state)
+    {
+        auto instances = GlInstanceTexture::create(garbage);
+
+        const auto vao = garbage->acquire_vertex_array();
+        const auto vbo = garbage->acquire_buffer(0);
+        state.with_vertex_array(vao, [vbo]
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            set_attributes();
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+
+        return GlStaticBatch(garbage, vao, vbo, pooled_buffer_size(0), std::move(instances));
+    }
+
+    inline void GlStaticBatch::set_attributes()
+    {
+        // Position, normal and instance index, as (location, number of floats)
+        const GLint attributes[][2] = { {0, 3}, {1, 3}, {2, 1} };
+        const auto stride = static_cast<GLsizei>(FLOATS_PER_BATCH_VERTEX * sizeof(float));
+        size_t offset = 0;
+        for (const auto & attribute : attributes)
+        {
+            glVertexAttribPointer(attribute[0], attribute[1], GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(offset * sizeof(float)));
+            glEnableVertexAttribArray(attribute[0]);
+            offset += attribute[1];
+        }
+        assert(offset == FLOATS_PER_BATCH_VERTEX);
+    }
+
+    inline void GlStaticBatch::upload(GlState & state, const StaticBatchData & batch)
+    {
+        const auto size = sizeof(float) * batch.vertices.size();
+        if (size > _buffer_size)
+        {
+            const auto buffer_size = pooled_buffer_size(size);
+            const auto vbo = _garbage->acquire_buffer(buffer_size);
+            _garbage->recycle_buffer_later(_vbo, _buffer_size);
+            _vbo = vbo;
+            _buffer_size = buffer_size;
+
+            // Point the vertex array to the new buffer
+            state.with_vertex_array(_vao, [this]
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+                set_attributes();
+            });
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(size), batch.vertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        MERELY_CHECK_GL_ERRORS();
+
+        _instances.update(batch.instances);
+        _vertex_count = batch.vertex_count;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <memory>
+
+#include "gl_gc.hpp"
+
+namespace merely3d
+{
+    /// A uniform buffer object of fixed size, bound to a single uniform buffer binding point.
+    ///
+    /// Shader programs read from the buffer through a uniform block that has been assigned
+    /// to the same binding point (see ShaderProgram::bind_uniform_block).
+    class GlUniformBuffer
+    {
+    public:
+        GlUniformBuffer(GlUniformBuffer && other) noexcept
+            : _ubo(other._ubo), _size(other._size), _binding(other._binding), _garbage(other._garbage)
+        {
+            other._garbage.reset();
+        }
+
+        ~GlUniformBuffer()
+        {
+            if (_garbage)
+            {
+                _garbage->delete_vertex_buffer_later(_ubo);
+            }
+        }
+
+        GlUniformBuffer(const GlUniformBuffer & other) = delete;
+        GlUniformBuffer & operator=(const GlUniformBuffer & other) = delete;
+        GlUniformBuffer & operator=(GlUniformBuffer && other) = delete;
+
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static GlUniformBuffer create(const std::shared_ptr<GlGarbagePile> & garbage, GLsizeiptr size, GLuint binding)
+        {
+            GLuint ubo;
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            return GlUniformBuffer(garbage, ubo, size, binding);
+        }
+
+        /// Replaces the entire contents of the buffer, which must be `size` bytes, and binds
+        /// the buffer to its binding point.
+        ///
+        /// The storage is respecified rather than overwritten, so that the driver may hand out fresh storage
+        /// instead of waiting for draws of the previous frame that still read from the old contents.
+        void update(const void * data)
+        {
+            glBindBufferBase(GL_UNIFORM_BUFFER, _binding, _ubo);
+            glBufferData(GL_UNIFORM_BUFFER, _size, data, GL_STREAM_DRAW);
+        }
+
+    private:
+        GlUniformBuffer(const std::shared_ptr<GlGarbagePile> & garbage, GLuint ubo, GLsizeiptr size, GLuint binding)
+            : _ubo(ubo), _size(size), _binding(binding), _garbage(garbage)
+        {}
+
+        GLuint _ubo;
+        GLsizeiptr _size;
+        GLuint _binding;
+
+        std::shared_ptr<GlGarbagePile> _garbage;
+    };
+}
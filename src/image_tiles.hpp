@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cassert>
+
+namespace merely3d
+{
+    /// A rectangle of the pixels of an image, whose coordinates are measured from the lower left corner
+    /// of the image, as are the window coordinates of OpenGL.
+    struct ImageTile
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    /// Splits an image into square tiles of the given size, which can be rendered one at a time.
+    ///
+    /// The tiles are laid out from the lower left corner of the image, so that the offsets of all tiles
+    /// are multiples of the tile size, and the tiles of the top row and of the right column are smaller
+    /// if the size of the image is not a multiple of the tile size. Rows are numbered from the top,
+    /// which is the order in which images are stored.
+    class TileGrid
+    {
+    public:
+        TileGrid(int image_width, int image_height, int tile_size)
+            : _image_width(image_width), _image_height(image_height), _tile_size(tile_size)
+        {
+            assert(image_width > 0 && image_height > 0 && tile_size > 0);
+        }
+
+        int image_width() const { return _image_width; }
+        int image_height() const { return _image_height; }
+        int tile_size() const { return _tile_size; }
+
+        int columns() const { return (_image_width + _tile_size - 1) / _tile_size; }
+        int rows() const { return (_image_height + _tile_size - 1) / _tile_size; }
+
+        /// Returns the tile in the given column, counted from the left, and the given row, counted from the top.
+        ImageTile tile(int column, int row) const
+        {
+            assert(column >= 0 && column < columns());
+            assert(row >= 0 && row < rows());
+            const int x = column * _tile_size;
+            const int y = (rows() - 1 - row) * _tile_size;
+            return ImageTile { x, y, std::min(_tile_size, _image_width - x), std::min(_tile_size, _image_height - y) };
+        }
+
+        /// Returns the given tile extended by the given margin on every side, but not beyond the image.
+        ImageTile padded(const ImageTile & tile, int margin) const
+        {
+            const int x = std::max(tile.x - margin, 0);
+            const int y = std::max(tile.y - margin, 0);
+            const int x_end = std::min(tile.x + tile.width + margin, _image_width);
+            const int y_end = std::min(tile.y + tile.height + margin, _image_height);
+            return ImageTile { x, y, x_end - x, y_end - y };
+        }
+
+        /// Returns the projection of the sub-frustum of the given tile (which may be padded), which maps the part
+        /// of the view that the given projection maps to the tile onto the whole of normalized device coordinates.
+        ///
+        /// Only the x and y rows of the projection are changed, so depth is identical in every tile,
+        /// and a pixel in a tile is rendered exactly like the corresponding pixel of the whole image.
+        Eigen::Matrix4f tile_projection(const Eigen::Matrix4f & projection, const ImageTile & tile) const
+        {
+            // The tile covers NDC x in [x0, x1], where x0 = 2 x / W - 1 and x1 = 2 (x + w) / W - 1,
+            // which the sub-frustum scales and translates to [-1, 1]. The translation is applied
+            // in clip space, i.e. multiplied by the w row of the projection
+            const Eigen::Matrix4d p = projection.cast<double>();
+            const double scale_x = static_cast<double>(_image_width) / tile.width;
+            const double scale_y = static_cast<double>(_image_height) / tile.height;
+            const double offset_x = static_cast<double>(_image_width - 2 * tile.x - tile.width) / tile.width;
+            const double offset_y = static_cast<double>(_image_height - 2 * tile.y - tile.height) / tile.height;
+
+            Eigen::Matrix4d result = p;
+            result.row(0) = scale_x * p.row(0) + offset_x * p.row(3);
+            result.row(1) = scale_y * p.row(1) + offset_y * p.row(3);
+            return result.cast<float>();
+        }
+
+    private:
+        int _image_width;
+        int _image_height;
+        int _tile_size;
+    };
+}
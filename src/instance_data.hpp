@@ -0,0 +1,167 @@
+#pragma once
+
+#include <merely3d/material.hpp>
+#include <merely3d/primitives.hpp>
+#include <merely3d/mesh.hpp>
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace merely3d
+{
+    /// Instances of primitives and meshes are packed into records of FLOATS_PER_INSTANCE floats:
+    /// position (3), orientation quaternion (x, y, z, w), scale (3), reference scale (3),
+    /// color (3), pattern grid size (1), specular strength (1), lighting (1, which is 0 for unlit instances),
+    /// edge color (3), edge width (1) and edge mode (1, see EDGE_MODE_NONE and friends).
+    ///
+    /// The scale is the total scale of the instance, whereas the reference scale is the part of the scale
+    /// that takes the reference primitive (i.e. a unit cube) into the actual shape of the object
+    /// (i.e. a box with certain extents), which is needed for correct scaling of the pattern.
+    const size_t FLOATS_PER_INSTANCE = 24;
+    const size_t INSTANCE_POSITION_OFFSET = 0;
+    const size_t INSTANCE_ORIENTATION_OFFSET = 3;
+    const size_t INSTANCE_SCALE_OFFSET = 7;
+    const size_t INSTANCE_REFERENCE_SCALE_OFFSET = 10;
+    const size_t INSTANCE_COLOR_OFFSET = 13;
+    const size_t INSTANCE_PATTERN_OFFSET = 16;
+    const size_t INSTANCE_SPECULAR_OFFSET = 17;
+    const size_t INSTANCE_LIGHTING_OFFSET = 18;
+    const size_t INSTANCE_EDGE_COLOR_OFFSET = 19;
+    const size_t INSTANCE_EDGE_WIDTH_OFFSET = 22;
+    const size_t INSTANCE_EDGE_MODE_OFFSET = 23;
+
+    /// The edge modes of instances: shaded surfaces without edges, shaded surfaces with edges on top,
+    /// and wireframes, which consist of nothing but the edges.
+    const float EDGE_MODE_NONE = 0.0f;
+    const float EDGE_MODE_FILLED = 1.0f;
+    const float EDGE_MODE_WIREFRAME = 2.0f;
+
+    /// Optional features of the shading of filled geometry, as bit flags. The mesh shader is compiled in variants
+    /// without some of the features (see ShaderCollection::mesh_shader), and each draw uses the variant
+    /// with only the features that its instances use (see shading_features).
+    const unsigned int SHADING_PATTERN = 1;
+    const unsigned int SHADING_LIGHTING = 2;
+
+    /// Specular highlights are part of the lighting, and are never used without SHADING_LIGHTING.
+    const unsigned int SHADING_SPECULAR = 4;
+
+    /// Edges, either on top of shaded surfaces or as wireframes.
+    const unsigned int SHADING_EDGES = 8;
+
+    const unsigned int SHADING_ALL = SHADING_PATTERN | SHADING_LIGHTING | SHADING_SPECULAR | SHADING_EDGES;
+    const unsigned int SHADING_FEATURE_BITS = 4;
+
+    inline void write_instance_transform(float * record,
+                                         const Eigen::Vector3f & position,
+                                         const Eigen::Quaternionf & orientation)
+    {
+        std::copy(position.data(), position.data() + 3, record + INSTANCE_POSITION_OFFSET);
+        std::copy(orientation.coeffs().data(), orientation.coeffs().data() + 4, record + INSTANCE_ORIENTATION_OFFSET);
+    }
+
+    inline void write_instance_scale(float * record,
+                                     const Eigen::Vector3f & scale,
+                                     const Eigen::Vector3f & reference_scale)
+    {
+        std::copy(scale.data(), scale.data() + 3, record + INSTANCE_SCALE_OFFSET);
+        std::copy(reference_scale.data(), reference_scale.data() + 3, record + INSTANCE_REFERENCE_SCALE_OFFSET);
+    }
+
+    inline void write_instance_material(float * record, const Material & material)
+    {
+        const auto & color = material.color;
+        record[INSTANCE_COLOR_OFFSET + 0] = color.r();
+        record[INSTANCE_COLOR_OFFSET + 1] = color.g();
+        record[INSTANCE_COLOR_OFFSET + 2] = color.b();
+        record[INSTANCE_PATTERN_OFFSET] = std::max(0.0f, material.pattern_grid_size);
+        record[INSTANCE_SPECULAR_OFFSET] = std::max(0.0f, material.specular_strength);
+        record[INSTANCE_LIGHTING_OFFSET] = material.unlit ? 0.0f : 1.0f;
+
+        const auto & edge_color = material.edge_color;
+        record[INSTANCE_EDGE_COLOR_OFFSET + 0] = edge_color.r();
+        record[INSTANCE_EDGE_COLOR_OFFSET + 1] = edge_color.g();
+        record[INSTANCE_EDGE_COLOR_OFFSET + 2] = edge_color.b();
+        record[INSTANCE_EDGE_WIDTH_OFFSET] = std::max(0.0f, material.edge_width);
+        record[INSTANCE_EDGE_MODE_OFFSET] = material.wireframe ? EDGE_MODE_WIREFRAME
+                                          : material.edges ? EDGE_MODE_FILLED
+                                          : EDGE_MODE_NONE;
+    }
+
+    /// Returns the shading features used by the given instance record.
+    inline unsigned int shading_features(const float * record)
+    {
+        // Wireframes are drawn in the plain color of the material
+        const auto edge_mode = record[INSTANCE_EDGE_MODE_OFFSET];
+        if (edge_mode == EDGE_MODE_WIREFRAME)
+        {
+            return SHADING_EDGES;
+        }
+
+        unsigned int features = edge_mode == EDGE_MODE_FILLED ? SHADING_EDGES : 0;
+        if (record[INSTANCE_PATTERN_OFFSET] > 0.0f)
+        {
+            features |= SHADING_PATTERN;
+        }
+        if (record[INSTANCE_LIGHTING_OFFSET] != 0.0f)
+        {
+            features |= SHADING_LIGHTING;
+            if (record[INSTANCE_SPECULAR_OFFSET] > 0.0f)
+            {
+                features |= SHADING_SPECULAR;
+            }
+        }
+        return features;
+    }
+
+    /// Returns the shading features used by any of the given packed instance records.
+    inline unsigned int shading_features(const std::vector<float> & instances)
+    {
+        unsigned int features = 0;
+        for (size_t i = 0; i < instances.size() && features != SHADING_ALL; i += FLOATS_PER_INSTANCE)
+        {
+            features |= shading_features(instances.data() + i);
+        }
+        return features;
+    }
+
+    /// Appends an instance record to the given packed instances.
+    inline void append_instance(std::vector<float> & instances,
+                                const Eigen::Vector3f & position,
+                                const Eigen::Quaternionf & orientation,
+                                const Eigen::Vector3f & scale,
+                                const Eigen::Vector3f & reference_scale,
+                                const Material & material)
+    {
+        const auto offset = instances.size();
+        instances.resize(offset + FLOATS_PER_INSTANCE);
+        float * record = instances.data() + offset;
+        write_instance_transform(record, position, orientation);
+        write_instance_scale(record, scale, reference_scale);
+        write_instance_material(record, material);
+    }
+
+    inline Eigen::Vector3f reference_scale(const Box & box)
+    {
+        return box.extents;
+    }
+
+    inline Eigen::Vector3f reference_scale(const Rectangle & rectangle)
+    {
+        const auto & extents = rectangle.extents;
+        return Eigen::Vector3f(extents.x(), extents.y(), 1.0f);
+    }
+
+    inline Eigen::Vector3f reference_scale(const Sphere & sphere)
+    {
+        const auto r = sphere.radius;
+        return Eigen::Vector3f(r, r, r);
+    }
+
+    inline Eigen::Vector3f reference_scale(const StaticMesh &)
+    {
+        return Eigen::Vector3f(1.0f, 1.0f, 1.0f);
+    }
+}
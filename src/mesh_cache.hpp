@@ -0,0 +1,80 @@
+#pragma once
+
+#include <merely3d/mesh.hpp>
+
+#include <cassert>
+#include <memory>
+#include <unordered_map>
+
+#include "gl_gc.hpp"
+#include "gl_mesh_arena.hpp"
+
+namespace merely3d
+{
+    /// The geometry of the meshes drawn by one or more renderers, stored in a single GlMeshArena.
+    ///
+    /// Each renderer holds a reference to every mesh it draws, and a mesh is removed from the arena
+    /// once no renderer references it any longer. Renderers whose contexts share objects may thus share
+    /// the same cache (see SharedResources), in which case each mesh is only uploaded once.
+    class MeshCache
+    {
+    public:
+        /// Note that the correct OpenGL context MUST be set prior to
+        /// calling this function.
+        static MeshCache create(const std::shared_ptr<GlGarbagePile> & garbage)
+        {
+            return MeshCache(GlMeshArena::create(garbage));
+        }
+
+        /// Adds a reference to the given mesh, copying the mesh into the arena if it is not already there,
+        /// and returns the slot of the mesh in the arena.
+        size_t acquire(const detail::StaticMeshData & mesh_data)
+        {
+            auto it = _meshes.find(mesh_data.id);
+            if (it == _meshes.end())
+            {
+                const auto slot = _arena.add(mesh_data.vertices_and_normals, mesh_data.faces);
+                it = _meshes.insert(std::make_pair(mesh_data.id, CachedMesh { slot, 0 })).first;
+            }
+            ++it->second.references;
+            return it->second.slot;
+        }
+
+        /// Removes a reference obtained through acquire(), and removes the mesh from the arena
+        /// if this was the last reference.
+        void release(detail::UniqueMeshId id)
+        {
+            const auto it = _meshes.find(id);
+            assert(it != _meshes.end() && it->second.references > 0);
+            if (--it->second.references == 0)
+            {
+                _arena.remove(it->second.slot);
+                _meshes.erase(it);
+            }
+        }
+
+        GlMeshArena & arena()
+        {
+            return _arena;
+        }
+
+        const GlMeshArena & arena() const
+        {
+            return _arena;
+        }
+
+    private:
+        explicit MeshCache(GlMeshArena && arena)
+            : _arena(std::move(arena))
+        {}
+
+        struct CachedMesh
+        {
+            size_t slot;
+            size_t references;
+        };
+
+        GlMeshArena                                             _arena;
+        std::unordered_map<detail::UniqueMeshId, CachedMesh>    _meshes;
+    };
+}
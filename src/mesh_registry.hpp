@@ -0,0 +1,111 @@
+#pragma once
+
+#include <merely3d/mesh.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "instance_data.hpp"
+
+namespace merely3d
+{
+    /// Instances of registered meshes (see MeshHandle), in submission order.
+    struct MeshHandleInstances
+    {
+        /// The handle index of the mesh of each instance.
+        std::vector<uint32_t>   meshes;
+
+        /// Packed instance records (see instance_data.hpp).
+        std::vector<float>      instances;
+
+        void clear()
+        {
+            meshes.clear();
+            instances.clear();
+        }
+    };
+
+    /// Groups the instance records of the given instances by mesh, with a stable counting sort.
+    ///
+    /// On return, the records of the mesh with handle index i occupy the records
+    /// offsets[i] (inclusive) through offsets[i + 1] (exclusive) of sorted,
+    /// in the order in which they were submitted. All mesh indices must be less than mesh_count.
+    inline void sort_by_mesh(const MeshHandleInstances & instances,
+                             size_t mesh_count,
+                             std::vector<size_t> & offsets,
+                             std::vector<float> & sorted)
+    {
+        assert(instances.instances.size() == FLOATS_PER_INSTANCE * instances.meshes.size());
+
+        offsets.assign(mesh_count + 1, 0);
+        for (const auto mesh : instances.meshes)
+        {
+            assert(mesh < mesh_count);
+            ++offsets[mesh + 1];
+        }
+        for (size_t i = 0; i < mesh_count; ++i)
+        {
+            offsets[i + 1] += offsets[i];
+        }
+
+        // Use the offsets as insertion cursors, and restore them afterwards
+        sorted.resize(instances.instances.size());
+        for (size_t i = 0; i < instances.meshes.size(); ++i)
+        {
+            auto & cursor = offsets[instances.meshes[i]];
+            const float * record = instances.instances.data() + FLOATS_PER_INSTANCE * i;
+            std::copy(record, record + FLOATS_PER_INSTANCE, sorted.data() + FLOATS_PER_INSTANCE * cursor);
+            ++cursor;
+        }
+        for (size_t i = mesh_count; i > 0; --i)
+        {
+            offsets[i] = offsets[i - 1];
+        }
+        offsets[0] = 0;
+    }
+
+    /// The meshes registered with a window, indexed by their handles.
+    class MeshRegistry
+    {
+    public:
+        MeshHandle add(const StaticMesh & mesh)
+        {
+            _meshes.push_back(mesh._data);
+            return MeshHandle(static_cast<uint32_t>(_meshes.size() - 1));
+        }
+
+        void remove(MeshHandle handle)
+        {
+            if (!contains(handle))
+            {
+                throw std::invalid_argument("Mesh handle does not refer to a registered mesh.");
+            }
+            _meshes[handle.index].reset();
+        }
+
+        bool contains(MeshHandle handle) const
+        {
+            return handle.index < _meshes.size() && _meshes[handle.index];
+        }
+
+        /// Returns the mesh data of the given handle index, or null if the mesh has been unregistered.
+        const detail::StaticMeshData * get(uint32_t index) const
+        {
+            return index < _meshes.size() ? _meshes[index].get() : nullptr;
+        }
+
+        /// Returns the number of handles handed out, including those of unregistered meshes.
+        size_t handle_count() const
+        {
+            return _meshes.size();
+        }
+
+    private:
+        // Since handles are never reused, unregistered meshes leave an empty entry behind
+        std::vector<std::shared_ptr<const detail::StaticMeshData>> _meshes;
+    };
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace merely3d
+{
+    /// Returns the number of worker threads to use for data-parallel work on `n` items.
+    ///
+    /// Small workloads are processed on the calling thread only, since the cost of
+    /// spawning threads would otherwise dominate.
+    inline unsigned int parallel_thread_count(size_t n, size_t min_items_per_thread = 1 << 15)
+    {
+        const auto hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+        const auto max_useful = std::max<size_t>(1, n / min_items_per_thread);
+        return static_cast<unsigned int>(std::min<size_t>(hardware_threads, max_useful));
+    }
+
+    /// Splits the range [0, n) into `num_blocks` contiguous blocks and calls
+    /// `func(block_index, begin, end)` for each block, with each block
+    /// processed on its own thread. The first block is processed on the calling thread.
+    ///
+    /// Blocks are ordered, so that block i covers indices before block i + 1.
+    template <typename Func>
+    void parallel_for_blocks(size_t n, unsigned int num_blocks, Func && func)
+    {
+        num_blocks = std::max(1u, num_blocks);
+        const size_t block_size = (n + num_blocks - 1) / num_blocks;
+
+        auto block_range = [&] (unsigned int block, size_t & begin, size_t & end)
+        {
+            begin = std::min(n, block * block_size);
+            end = std::min(n, begin + block_size);
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(num_blocks - 1);
+        for (unsigned int block = 1; block < num_blocks; ++block)
+        {
+            size_t begin, end;
+            block_range(block, begin, end);
+            threads.emplace_back([&func, block, begin, end] { func(block, begin, end); });
+        }
+
+        size_t begin, end;
+        block_range(0, begin, end);
+        func(0u, begin, end);
+
+        for (auto & thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
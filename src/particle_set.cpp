@@ -0,0 +1,90 @@
+#include <merely3d/particle_set.hpp>
+
+#include "particle_set_data.hpp"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace merely3d
+{
+    namespace
+    {
+        const size_t FLOATS_PER_PARTICLE = 7;
+
+        detail::UniqueParticleSetId next_particle_set_id()
+        {
+            static std::atomic<detail::UniqueParticleSetId> next_id(0);
+            return next_id++;
+        }
+
+        void write_particle(float * record, const Particle & particle)
+        {
+            record[0] = particle.position.x();
+            record[1] = particle.position.y();
+            record[2] = particle.position.z();
+            record[3] = particle.color.r();
+            record[4] = particle.color.g();
+            record[5] = particle.color.b();
+            record[6] = particle.radius;
+        }
+    }
+
+    ParticleSet::ParticleSet()
+        : _data(std::make_shared<detail::ParticleSetData>(next_particle_set_id()))
+    {}
+
+    ParticleSet::ParticleSet(const std::vector<Particle> & particles)
+        : ParticleSet()
+    {
+        resize(particles.size());
+        update(0, particles);
+    }
+
+    size_t ParticleSet::size() const
+    {
+        std::lock_guard<std::mutex> lock(_data->mutex);
+        return _data->records.size() / FLOATS_PER_PARTICLE;
+    }
+
+    void ParticleSet::resize(size_t num_particles)
+    {
+        std::lock_guard<std::mutex> lock(_data->mutex);
+        const auto old_size = _data->records.size() / FLOATS_PER_PARTICLE;
+        if (num_particles < old_size)
+        {
+            _data->records.resize(FLOATS_PER_PARTICLE * num_particles);
+            _data->history.truncate(num_particles);
+        }
+        else if (num_particles > old_size)
+        {
+            _data->records.resize(FLOATS_PER_PARTICLE * num_particles);
+            const auto default_particle = Particle();
+            for (size_t i = old_size; i < num_particles; ++i)
+            {
+                write_particle(&_data->records[FLOATS_PER_PARTICLE * i], default_particle);
+            }
+            _data->history.add(old_size, num_particles);
+        }
+    }
+
+    void ParticleSet::update(size_t first, const Particle * particles, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(_data->mutex);
+        const auto size = _data->records.size() / FLOATS_PER_PARTICLE;
+        if (first > size || count > size - first)
+        {
+            throw std::out_of_range("Updated particles must lie within the particle set.");
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            write_particle(&_data->records[FLOATS_PER_PARTICLE * (first + i)], particles[i]);
+        }
+        _data->history.add(first, first + count);
+    }
+
+    void ParticleSet::update(size_t first, const std::vector<Particle> & particles)
+    {
+        update(first, particles.data(), particles.size());
+    }
+}
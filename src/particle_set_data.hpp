@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "dirty_ranges.hpp"
+
+namespace merely3d
+{
+    namespace detail
+    {
+        typedef uint64_t UniqueParticleSetId;
+
+        struct ParticleSetData
+        {
+            /// Particle records, with the same layout of 7 floats per particle
+            /// as CommandBuffer::push_particle.
+            std::vector<float> records;
+
+            /// The modified particles, from which every renderer that draws the set derives
+            /// the particles modified since it last uploaded the set.
+            DirtyHistory history;
+
+            /// Guards the records and the history, which the renderers of several windows
+            /// may read at the same time as the set is modified (see WindowGroup).
+            std::mutex mutex;
+
+            /// Globally unique ID for this particle set, used as the key of the GPU cache
+            /// (see the corresponding comment on StaticMeshData).
+            const UniqueParticleSetId id;
+
+            explicit ParticleSetData(UniqueParticleSetId id) : id(id) {}
+        };
+    }
+}
@@ -0,0 +1,193 @@
+#include "particle_sort.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using Eigen::AlignedBox3f;
+using Eigen::Map;
+using Eigen::Vector3f;
+
+namespace merely3d
+{
+    /// Spreads the lower 10 bits of x so that there are two zero bits between each bit.
+    static uint32_t spread_bits_by_two(uint32_t x)
+    {
+        x &= 0x000003ff;
+        x = (x | (x << 16)) & 0x030000ff;
+        x = (x | (x << 8))  & 0x0300f00f;
+        x = (x | (x << 4))  & 0x030c30c3;
+        x = (x | (x << 2))  & 0x09249249;
+        return x;
+    }
+
+    uint32_t morton_encode(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return spread_bits_by_two(x) | (spread_bits_by_two(y) << 1) | (spread_bits_by_two(z) << 2);
+    }
+
+    void radix_sort_by_key(std::vector<uint32_t> & keys,
+                           std::vector<uint32_t> & values,
+                           std::vector<uint32_t> & key_scratch,
+                           std::vector<uint32_t> & value_scratch,
+                           unsigned int key_bits,
+                           unsigned int num_threads)
+    {
+        assert(keys.size() == values.size());
+
+        const unsigned int RADIX_BITS = 8;
+        const size_t RADIX = 1 << RADIX_BITS;
+
+        const auto n = keys.size();
+        num_threads = std::max(1u, num_threads);
+
+        key_scratch.resize(n);
+        value_scratch.resize(n);
+
+        // offsets[RADIX * b + d] holds the number of keys with digit d in block b,
+        // which is subsequently turned into the output position of the first such key
+        std::vector<size_t> offsets(RADIX * num_threads);
+
+        for (unsigned int shift = 0; shift < key_bits; shift += RADIX_BITS)
+        {
+            std::fill(offsets.begin(), offsets.end(), 0);
+
+            parallel_for_blocks(n, num_threads, [&] (unsigned int block, size_t begin, size_t end)
+            {
+                size_t * counts = &offsets[RADIX * block];
+                for (size_t i = begin; i < end; ++i)
+                {
+                    ++counts[(keys[i] >> shift) & (RADIX - 1)];
+                }
+            });
+
+            // Visiting blocks in order for each digit makes the scatter stable,
+            // which is required for the correctness of LSD radix sort
+            size_t running_offset = 0;
+            for (size_t digit = 0; digit < RADIX; ++digit)
+            {
+                for (unsigned int block = 0; block < num_threads; ++block)
+                {
+                    auto & offset = offsets[RADIX * block + digit];
+                    const auto count = offset;
+                    offset = running_offset;
+                    running_offset += count;
+                }
+            }
+
+            parallel_for_blocks(n, num_threads, [&] (unsigned int block, size_t begin, size_t end)
+            {
+                size_t * block_offsets = &offsets[RADIX * block];
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const auto target = block_offsets[(keys[i] >> shift) & (RADIX - 1)]++;
+                    key_scratch[target] = keys[i];
+                    value_scratch[target] = values[i];
+                }
+            });
+
+            keys.swap(key_scratch);
+            values.swap(value_scratch);
+        }
+    }
+
+    void ParticleSorter::invalidate()
+    {
+        _sorted.clear();
+        _previous.clear();
+    }
+
+    void ParticleSorter::sort(const std::vector<float> & records, size_t stride, size_t radius_offset)
+    {
+        assert(stride >= 3);
+        assert(radius_offset < stride);
+        assert(records.size() % stride == 0);
+
+        const auto n = records.size() / stride;
+        const auto num_threads = parallel_thread_count(n);
+
+        // Determine the bounding box of all particle centers,
+        // which defines the grid on which we compute the Morton codes
+        std::vector<AlignedBox3f> block_bounds(num_threads);
+        parallel_for_blocks(n, num_threads, [&] (unsigned int block, size_t begin, size_t end)
+        {
+            AlignedBox3f box;
+            for (size_t i = begin; i < end; ++i)
+            {
+                box.extend(Map<const Vector3f>(&records[stride * i]));
+            }
+            block_bounds[block] = box;
+        });
+
+        AlignedBox3f bounds;
+        for (const auto & box : block_bounds)
+        {
+            bounds.extend(box);
+        }
+
+        const float MAX_CELL = 1023.0f;
+        const Vector3f origin = bounds.isEmpty() ? Vector3f::Zero() : bounds.min();
+        const Vector3f extents = bounds.isEmpty() ? Vector3f::Zero() : Vector3f(bounds.sizes());
+        const Vector3f cell_scale = extents.unaryExpr([MAX_CELL] (float e)
+        {
+            return e > 0.0f ? MAX_CELL / e : 0.0f;
+        });
+
+        _keys.resize(n);
+        _indices.resize(n);
+        parallel_for_blocks(n, num_threads, [&] (unsigned int, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const Vector3f p = Map<const Vector3f>(&records[stride * i]);
+                const Vector3f cell = (p - origin).cwiseProduct(cell_scale).cwiseMax(0.0f).cwiseMin(MAX_CELL);
+                _keys[i] = morton_encode(static_cast<uint32_t>(cell.x()),
+                                         static_cast<uint32_t>(cell.y()),
+                                         static_cast<uint32_t>(cell.z()));
+                _indices[i] = static_cast<uint32_t>(i);
+            }
+        });
+
+        radix_sort_by_key(_keys, _indices, _key_scratch, _index_scratch, 30, num_threads);
+
+        // Keep the previous result around so that we can detect which chunks changed
+        _sorted.swap(_previous);
+        _sorted.resize(records.size());
+        parallel_for_blocks(n, num_threads, [&] (unsigned int, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const auto source = records.data() + stride * _indices[i];
+                std::copy(source, source + stride, _sorted.data() + stride * i);
+            }
+        });
+
+        const auto num_chunks = (n + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE;
+        _chunks.resize(num_chunks);
+        const auto num_chunk_threads = static_cast<unsigned int>(std::min<size_t>(num_threads, num_chunks));
+        parallel_for_blocks(num_chunks, num_chunk_threads, [&] (unsigned int, size_t begin, size_t end)
+        {
+            for (size_t c = begin; c < end; ++c)
+            {
+                auto & chunk = _chunks[c];
+                chunk.first = c * PARTICLE_CHUNK_SIZE;
+                chunk.count = std::min(PARTICLE_CHUNK_SIZE, n - chunk.first);
+                chunk.bounds.setEmpty();
+
+                for (size_t i = chunk.first; i < chunk.first + chunk.count; ++i)
+                {
+                    const Vector3f p = Map<const Vector3f>(&_sorted[stride * i]);
+                    const float r = _sorted[stride * i + radius_offset];
+                    chunk.bounds.extend(p - Vector3f::Constant(r));
+                    chunk.bounds.extend(p + Vector3f::Constant(r));
+                }
+
+                const auto offset = stride * chunk.first;
+                const auto size = stride * chunk.count;
+                chunk.changed = offset + size > _previous.size()
+                                || std::memcmp(&_sorted[offset], &_previous[offset], sizeof(float) * size) != 0;
+            }
+        });
+    }
+}
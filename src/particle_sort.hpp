@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Eigen/Geometry>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace merely3d
+{
+    /// The number of particles in each chunk produced by ParticleSorter.
+    const size_t PARTICLE_CHUNK_SIZE = 4096;
+
+    /// Interleaves the lower 10 bits of each of x, y and z into a 30-bit Morton code,
+    /// with the bits of x occupying the least significant position.
+    uint32_t morton_encode(uint32_t x, uint32_t y, uint32_t z);
+
+    /// Sorts `keys` in ascending order by considering only the `key_bits` least significant bits
+    /// of each key, and applies the same permutation to `values`.
+    ///
+    /// The sort is a stable LSD radix sort with 8-bit digits, in which histogram construction and
+    /// scattering is distributed across `num_threads` threads. The scratch vectors are resized
+    /// as needed, and can be kept around to avoid reallocation between invocations.
+    void radix_sort_by_key(std::vector<uint32_t> & keys,
+                           std::vector<uint32_t> & values,
+                           std::vector<uint32_t> & key_scratch,
+                           std::vector<uint32_t> & value_scratch,
+                           unsigned int key_bits,
+                           unsigned int num_threads);
+
+    /// A contiguous range of spatially sorted particles.
+    struct ParticleChunk
+    {
+        size_t first;
+        size_t count;
+
+        /// Bounding box of the spheres represented by the particles in the chunk.
+        Eigen::AlignedBox3f bounds;
+
+        /// Whether the records in this chunk differ from the records at the same
+        /// location in the result of the previous sort.
+        bool changed;
+    };
+
+    /// Reorders particle records along a Morton (Z-order) curve and partitions
+    /// the result into fixed-size chunks with associated bounding boxes.
+    ///
+    /// The sorter keeps the result of the previous invocation of sort() around,
+    /// so that it can determine which chunks have changed since then.
+    class ParticleSorter
+    {
+    public:
+        /// Sorts the given particle records.
+        ///
+        /// Each record consists of `stride` floats, of which the first three must represent
+        /// the position of the particle, and the float at `radius_offset` its radius.
+        void sort(const std::vector<float> & records, size_t stride, size_t radius_offset);
+
+        /// Forgets the result of the previous sort, so that every chunk is reported as
+        /// changed by the next invocation of sort().
+        void invalidate();
+
+        const std::vector<float> &          sorted_records() const;
+        const std::vector<ParticleChunk> &  chunks() const;
+
+    private:
+        std::vector<float>          _sorted;
+        std::vector<float>          _previous;
+        std::vector<ParticleChunk>  _chunks;
+
+        std::vector<uint32_t>       _keys;
+        std::vector<uint32_t>       _indices;
+        std::vector<uint32_t>       _key_scratch;
+        std::vector<uint32_t>       _index_scratch;
+    };
+
+    inline const std::vector<float> & ParticleSorter::sorted_records() const
+    {
+        return _sorted;
+    }
+
+    inline const std::vector<ParticleChunk> & ParticleSorter::chunks() const
+    {
+        return _chunks;
+    }
+}
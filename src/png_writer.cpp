@@ -0,0 +1,186 @@
+#include "png_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace merely3d
+{
+    namespace
+    {
+        /// The largest amount of data in a stored (uncompressed) deflate block.
+        const size_t MAX_STORED_BLOCK_SIZE = 65535;
+
+        std::array<uint32_t, 256> make_crc_table()
+        {
+            std::array<uint32_t, 256> table;
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return table;
+        }
+
+        void store_big_endian(unsigned char * bytes, uint32_t value)
+        {
+            bytes[0] = static_cast<unsigned char>(value >> 24);
+            bytes[1] = static_cast<unsigned char>(value >> 16);
+            bytes[2] = static_cast<unsigned char>(value >> 8);
+            bytes[3] = static_cast<unsigned char>(value);
+        }
+
+        void append_big_endian(std::vector<unsigned char> & bytes, uint32_t value)
+        {
+            unsigned char stored[4];
+            store_big_endian(stored, value);
+            bytes.insert(bytes.end(), stored, stored + 4);
+        }
+    }
+
+    uint32_t crc32(const unsigned char * data, size_t size, uint32_t crc)
+    {
+        static const auto table = make_crc_table();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t adler32(const unsigned char * data, size_t size, uint32_t adler)
+    {
+        // The sums are reduced in blocks small enough that they cannot overflow in between
+        const uint32_t modulus = 65521;
+        const size_t max_block = 5552;
+        uint32_t a = adler & 0xffff;
+        uint32_t b = adler >> 16;
+        while (size > 0)
+        {
+            const auto block = std::min(size, max_block);
+            for (size_t i = 0; i < block; ++i)
+            {
+                a += data[i];
+                b += a;
+            }
+            a %= modulus;
+            b %= modulus;
+            data += block;
+            size -= block;
+        }
+        return (b << 16) | a;
+    }
+
+    PngWriter::PngWriter(std::ostream & out, int width, int height)
+        : _out(out),
+          _row_size(3 * static_cast<size_t>(width)),
+          _rows_left(height),
+          _first_block(true),
+          _adler(1)
+    {
+        assert(width > 0 && height > 0);
+
+        const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        _out.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+        // 8-bit RGB, without interlacing
+        std::vector<unsigned char> header;
+        append_big_endian(header, static_cast<uint32_t>(width));
+        append_big_endian(header, static_cast<uint32_t>(height));
+        header.insert(header.end(), { 8, 2, 0, 0, 0 });
+        write_chunk("IHDR", header.data(), header.size());
+    }
+
+    void PngWriter::write_row(const unsigned char * rgb)
+    {
+        assert(_rows_left > 0);
+        --_rows_left;
+
+        // Every row starts with the type of its filter, which is none
+        _pending.push_back(0);
+        _pending.insert(_pending.end(), rgb, rgb + _row_size);
+        while (_pending.size() >= MAX_STORED_BLOCK_SIZE)
+        {
+            write_block(false);
+        }
+    }
+
+    void PngWriter::finish()
+    {
+        assert(_rows_left == 0);
+        write_block(true);
+
+        write_chunk("IEND", nullptr, 0);
+        _out.flush();
+    }
+
+    void PngWriter::write_block(bool final_block)
+    {
+        const auto size = std::min(_pending.size(), MAX_STORED_BLOCK_SIZE);
+        assert(!final_block || size == _pending.size());
+
+        _chunk.clear();
+        if (_first_block)
+        {
+            // The zlib header: deflate with a 32K window, no preset dictionary and the fastest "compression"
+            _chunk.push_back(0x78);
+            _chunk.push_back(0x01);
+            _first_block = false;
+        }
+
+        _chunk.push_back(final_block ? 1 : 0);
+        _chunk.push_back(static_cast<unsigned char>(size & 0xff));
+        _chunk.push_back(static_cast<unsigned char>(size >> 8));
+        _chunk.push_back(static_cast<unsigned char>(~size & 0xff));
+        _chunk.push_back(static_cast<unsigned char>((~size >> 8) & 0xff));
+        _chunk.insert(_chunk.end(), _pending.begin(), _pending.begin() + size);
+
+        _adler = adler32(_pending.data(), size, _adler);
+        _pending.erase(_pending.begin(), _pending.begin() + size);
+
+        if (final_block)
+        {
+            append_big_endian(_chunk, _adler);
+        }
+        write_chunk("IDAT", _chunk.data(), _chunk.size());
+    }
+
+    void PngWriter::write_chunk(const char * type, const unsigned char * data, size_t size)
+    {
+        unsigned char length[4];
+        store_big_endian(length, static_cast<uint32_t>(size));
+        _out.write(reinterpret_cast<const char *>(length), 4);
+
+        const auto type_bytes = reinterpret_cast<const unsigned char *>(type);
+        _out.write(type, 4);
+        if (size > 0)
+        {
+            _out.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+        }
+
+        unsigned char crc[4];
+        store_big_endian(crc, crc32(data, size, crc32(type_bytes, 4)));
+        _out.write(reinterpret_cast<const char *>(crc), 4);
+    }
+
+    void rgba_to_rgb_top_down(const unsigned char * rgba, int width, int height, unsigned char * rgb)
+    {
+        const auto row_pixels = static_cast<size_t>(width);
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char * source = rgba + 4 * row_pixels * static_cast<size_t>(height - 1 - y);
+            unsigned char * target = rgb + 3 * row_pixels * static_cast<size_t>(y);
+            for (size_t x = 0; x < row_pixels; ++x)
+            {
+                target[3 * x] = source[4 * x];
+                target[3 * x + 1] = source[4 * x + 1];
+                target[3 * x + 2] = source[4 * x + 2];
+            }
+        }
+    }
+}
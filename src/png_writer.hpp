@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace merely3d
+{
+    /// Returns the CRC-32 of the given bytes, as used by PNG and zlib, continuing from the given CRC.
+    uint32_t crc32(const unsigned char * data, size_t size, uint32_t crc = 0);
+
+    /// Returns the Adler-32 checksum of the given bytes, as used by zlib, continuing from the given checksum.
+    uint32_t adler32(const unsigned char * data, size_t size, uint32_t adler = 1);
+
+    /// Writes an 8-bit RGB image to a stream in the PNG format, one row at a time, top row first,
+    /// so that images larger than the available memory can be written.
+    ///
+    /// The image data is stored without compression, which is much faster than compressing it,
+    /// but makes the files as large as the raw pixels. The rows are written to the stream in blocks,
+    /// so the stream should be opened in binary mode.
+    class PngWriter
+    {
+    public:
+        /// Writes the header of an image of the given size.
+        PngWriter(std::ostream & out, int width, int height);
+
+        PngWriter(const PngWriter & other) = delete;
+        PngWriter & operator=(const PngWriter & other) = delete;
+
+        /// Writes the next row of the image, which consists of `3 * width` bytes.
+        void write_row(const unsigned char * rgb);
+
+        /// Writes the end of the image. Must be called once all rows have been written.
+        void finish();
+
+    private:
+        /// Writes the pending image data as a stored deflate block in a chunk of its own.
+        void write_block(bool final_block);
+
+        void write_chunk(const char * type, const unsigned char * data, size_t size);
+
+        std::ostream &              _out;
+        size_t                      _row_size;
+        int                         _rows_left;
+        bool                        _first_block;
+        uint32_t                    _adler;
+        std::vector<unsigned char>  _pending;
+        std::vector<unsigned char>  _chunk;
+    };
+
+    /// Converts RGBA pixels whose bottom row comes first, as read by glReadPixels, into RGB pixels
+    /// whose top row comes first, as stored in image files. `rgb` must hold `3 * width * height` bytes.
+    void rgba_to_rgb_top_down(const unsigned char * rgba, int width, int height, unsigned char * rgb);
+}
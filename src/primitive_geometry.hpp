@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cassert>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "mesh_util.hpp"
+#include "scene_data.hpp"
+
+namespace merely3d
+{
+    /// The vertices and normals of the unit primitives (see mesh_util.hpp), generated on a worker thread.
+    ///
+    /// Subdividing the sphere takes a noticeable amount of time, so the vertices are generated in the background
+    /// while the renderer is being set up, and each consumer waits for them only when it first needs a primitive.
+    /// Copies share the same vertices, which are immutable and may safely be used from any thread.
+    class PrimitiveGeometry
+    {
+    public:
+        typedef std::shared_ptr<const std::vector<float>> Vertices;
+
+        /// Starts generating the vertices on a worker thread.
+        static PrimitiveGeometry generate_async()
+        {
+            return PrimitiveGeometry(std::async(std::launch::async, [] ()
+            {
+                return AllVertices {
+                    std::make_shared<const std::vector<float>>(unit_cube_vertices_and_normals()),
+                    std::make_shared<const std::vector<float>>(unit_rectangle_vertices_and_normals()),
+                    std::make_shared<const std::vector<float>>(unit_sphere_vertices_and_normals())
+                };
+            }).share());
+        }
+
+        /// Returns the vertices and normals of the given shape, which must not be a mesh,
+        /// waiting for them to be generated if necessary.
+        const Vertices & vertices(detail::SceneShape shape) const
+        {
+            const auto & all = _vertices.get();
+            switch (shape)
+            {
+                case detail::SceneShape::Box: return all.cube;
+                case detail::SceneShape::Rectangle: return all.rectangle;
+                case detail::SceneShape::Sphere: return all.sphere;
+                case detail::SceneShape::Mesh: break;
+            }
+            assert(false && "Meshes are not primitives");
+            return all.cube;
+        }
+
+    private:
+        struct AllVertices
+        {
+            Vertices cube;
+            Vertices rectangle;
+            Vertices sphere;
+        };
+
+        explicit PrimitiveGeometry(std::shared_future<AllVertices> vertices)
+            : _vertices(std::move(vertices))
+        {}
+
+        std::shared_future<AllVertices> _vertices;
+    };
+}
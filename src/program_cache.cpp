@@ -0,0 +1,304 @@
+#include "program_cache.hpp"
+#include "gl_extensions.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Program binaries are part of OpenGL 4.1 and GL_ARB_get_program_binary, neither of which GLAD was generated for
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// Likewise for GL_KHR_parallel_shader_compile, whose value is shared with GL_ARB_parallel_shader_compile
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+
+namespace merely3d
+{
+    // Identifies the files written by ProgramCache, followed by the binary format and the binary itself
+    static const uint32_t PROGRAM_CACHE_MAGIC = 0x5044334d;
+
+    static std::string gl_string(GLenum name)
+    {
+        const auto str = glGetString(name);
+        return str ? std::string(reinterpret_cast<const char *>(str)) : std::string();
+    }
+
+    static bool supports_program_binaries()
+    {
+        return has_gl_version(4, 1) || has_gl_extension("GL_ARB_get_program_binary");
+    }
+
+    /// Returns the name of a temporary file next to the given path, which is unique to this process and call.
+    static std::string temporary_file_name(const std::string & path)
+    {
+        static std::atomic<unsigned long> counter(0);
+#ifdef _WIN32
+        const auto pid = _getpid();
+#else
+        const auto pid = getpid();
+#endif
+        return path + "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+    }
+
+    static GLenum shader_type(size_t index)
+    {
+        const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+        return types[index];
+    }
+
+    ProgramCache::ProgramCache(ProgramCache && other)
+        : _directory(std::move(other._directory)),
+          _driver(std::move(other._driver)),
+          _get_program_binary(other._get_program_binary),
+          _program_binary(other._program_binary),
+          _program_parameteri(other._program_parameteri),
+          _parallel(other._parallel),
+          _pending(std::move(other._pending))
+    {
+        other._pending.clear();
+    }
+
+    ProgramCache::~ProgramCache()
+    {
+        for (const auto & pair : _pending)
+        {
+            const auto & pending = pair.second;
+            for (const auto shader : pending.shaders)
+            {
+                glDetachShader(pending.program, shader);
+                glDeleteShader(shader);
+            }
+            glDeleteProgram(pending.program);
+        }
+    }
+
+    ProgramCache ProgramCache::create_in_context(const std::string & directory, GLADloadproc loader)
+    {
+        ProgramCache cache;
+
+        // Without a call to glMaxShaderCompilerThreadsKHR, drivers may compile on a single thread of their own,
+        // or not on their own threads at all
+        MaxShaderCompilerThreadsProc max_shader_compiler_threads = nullptr;
+        if (loader && has_gl_extension("GL_KHR_parallel_shader_compile"))
+        {
+            max_shader_compiler_threads = reinterpret_cast<MaxShaderCompilerThreadsProc>(
+                        loader("glMaxShaderCompilerThreadsKHR"));
+        }
+        else if (loader && has_gl_extension("GL_ARB_parallel_shader_compile"))
+        {
+            max_shader_compiler_threads = reinterpret_cast<MaxShaderCompilerThreadsProc>(
+                        loader("glMaxShaderCompilerThreadsARB"));
+        }
+        if (max_shader_compiler_threads)
+        {
+            // The largest value leaves the number of threads up to the driver
+            max_shader_compiler_threads(0xFFFFFFFF);
+            cache._parallel = true;
+        }
+
+        if (directory.empty() || !loader || !supports_program_binaries())
+        {
+            return cache;
+        }
+
+        // Drivers that support program binaries may still not support any binary formats
+        GLint num_formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+        const auto get_program_binary = reinterpret_cast<GetProgramBinaryProc>(loader("glGetProgramBinary"));
+        const auto program_binary = reinterpret_cast<ProgramBinaryProc>(loader("glProgramBinary"));
+        const auto program_parameteri = reinterpret_cast<ProgramParameteriProc>(loader("glProgramParameteri"));
+        if (num_formats <= 0 || !get_program_binary || !program_binary || !program_parameteri)
+        {
+            return cache;
+        }
+
+        cache._directory = directory;
+        if (cache._directory.back() != '/' && cache._directory.back() != '\\')
+        {
+            cache._directory += '/';
+        }
+        cache._driver = gl_string(GL_VENDOR) + '\n' + gl_string(GL_RENDERER) + '\n' + gl_string(GL_VERSION);
+        cache._get_program_binary = get_program_binary;
+        cache._program_binary = program_binary;
+        cache._program_parameteri = program_parameteri;
+        return cache;
+    }
+
+    void ProgramCache::prepare(const ProgramSources & sources)
+    {
+        const auto name = file_name(sources);
+        if (_pending.count(name) > 0)
+        {
+            return;
+        }
+
+        PendingProgram pending;
+        pending.program = enabled() ? load(_directory + name) : 0;
+        if (pending.program == 0)
+        {
+            // Nothing is queried here, since that would wait for the compilation to finish
+            pending.program = glCreateProgram();
+            const std::string * shader_sources[] = { &sources.vertex, &sources.fragment, &sources.geometry };
+            for (size_t i = 0; i < 3; ++i)
+            {
+                if (!shader_sources[i]->empty())
+                {
+                    const auto shader = glCreateShader(shader_type(i));
+                    const auto source_c_str = shader_sources[i]->c_str();
+                    glShaderSource(shader, 1, &source_c_str, NULL);
+                    glCompileShader(shader);
+                    glAttachShader(pending.program, shader);
+                    pending.shaders.push_back(shader);
+                }
+            }
+            if (enabled())
+            {
+                _program_parameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+            glLinkProgram(pending.program);
+        }
+        _pending.insert(std::make_pair(name, pending));
+    }
+
+    ShaderProgram ProgramCache::link(const ProgramSources & sources)
+    {
+        const auto name = file_name(sources);
+        prepare(sources);
+        const auto pending_iter = _pending.find(name);
+        const auto pending = pending_iter->second;
+        _pending.erase(pending_iter);
+
+        ShaderProgram program;
+        program._id = pending.program;
+        if (pending.shaders.empty())
+        {
+            return program;
+        }
+
+        GLint success = 0;
+        glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
+
+        // Report the first shader that failed to compile, if any, rather than the resulting link error
+        std::string error_msg;
+        for (const auto shader : pending.shaders)
+        {
+            GLint compiled = 0;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+            if (!compiled && error_msg.empty())
+            {
+                char info_log[512];
+                glGetShaderInfoLog(shader, 512, NULL, info_log);
+                error_msg = "Shader compilation error: " + std::string(info_log);
+            }
+            glDetachShader(pending.program, shader);
+            glDeleteShader(shader);
+        }
+        if (error_msg.empty() && !success)
+        {
+            char info_log[512];
+            glGetProgramInfoLog(pending.program, 512, NULL, info_log);
+            error_msg = "Program link error: " + std::string(info_log);
+        }
+        if (!error_msg.empty())
+        {
+            glDeleteProgram(pending.program);
+            throw std::runtime_error(error_msg);
+        }
+
+        if (enabled())
+        {
+            store(_directory + name, pending.program);
+        }
+        return program;
+    }
+
+    GLuint ProgramCache::load(const std::string & path) const
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return 0;
+        }
+        const std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        uint32_t header[2];
+        if (contents.size() <= sizeof(header))
+        {
+            return 0;
+        }
+        std::memcpy(header, contents.data(), sizeof(header));
+        if (header[0] != PROGRAM_CACHE_MAGIC)
+        {
+            return 0;
+        }
+
+        // The driver rejects binaries it can no longer use, e.g. after an update that kept its version string
+        const auto id = glCreateProgram();
+        _program_binary(id, static_cast<GLenum>(header[1]), contents.data() + sizeof(header),
+                        static_cast<GLsizei>(contents.size() - sizeof(header)));
+        GLint success = 0;
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // A rejected binary may also have raised an error (e.g. for an unknown format), which must not
+            // be mistaken for an error of whatever happens next
+            while (glGetError() != GL_NO_ERROR) {}
+            glDeleteProgram(id);
+            return 0;
+        }
+        return id;
+    }
+
+    void ProgramCache::store(const std::string & path, GLuint program) const
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+        {
+            return;
+        }
+
+        std::vector<char> binary(static_cast<size_t>(length));
+        GLenum format = 0;
+        _get_program_binary(program, length, nullptr, &format, binary.data());
+        const uint32_t header[2] = { PROGRAM_CACHE_MAGIC, static_cast<uint32_t>(format) };
+
+        // Other processes may be reading or writing the same file, so the file is written under a temporary name
+        // and then renamed, which leaves either the complete old file or the complete new file in place
+        const auto temporary_path = temporary_file_name(path);
+        {
+            std::ofstream file(temporary_path, std::ios::binary);
+            file.write(reinterpret_cast<const char *>(header), sizeof(header));
+            file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+            if (!file)
+            {
+                file.close();
+                std::remove(temporary_path.c_str());
+                return;
+            }
+        }
+        if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary_path.c_str());
+        }
+    }
+}
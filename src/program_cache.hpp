@@ -0,0 +1,162 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.hpp"
+
+namespace merely3d
+{
+    /// Returns the 64-bit FNV-1a hash of the given bytes, continuing from the given hash.
+    inline uint64_t fnv1a_hash(const std::string & bytes, uint64_t hash = 14695981039346656037ull)
+    {
+        for (const auto c : bytes)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    /// Returns the name of the cache file of a program linked from the given shader sources (of which the geometry
+    /// source may be empty) by the given driver, which is identified by its vendor, renderer and version strings.
+    inline std::string program_cache_file_name(const std::string & driver,
+                                               const std::string & vertex_source,
+                                               const std::string & fragment_source,
+                                               const std::string & geometry_source)
+    {
+        // The separators make sure that moving text from one source to the next changes the hash
+        auto hash = fnv1a_hash(driver);
+        for (const auto * source : { &vertex_source, &fragment_source, &geometry_source })
+        {
+            hash = fnv1a_hash(*source, fnv1a_hash(std::string(1, '\0'), hash));
+        }
+
+        const char digits[] = "0123456789abcdef";
+        std::string name(16, '0');
+        for (size_t i = 0; i < 16; ++i)
+        {
+            name[15 - i] = digits[(hash >> (4 * i)) & 0xf];
+        }
+        return name + ".bin";
+    }
+
+    /// The sources of the shaders of a program, of which the geometry source may be empty.
+    struct ProgramSources
+    {
+        ProgramSources(std::string vertex, std::string fragment, std::string geometry = std::string())
+            : vertex(std::move(vertex)), fragment(std::move(fragment)), geometry(std::move(geometry))
+        {}
+
+        std::string vertex;
+        std::string fragment;
+        std::string geometry;
+    };
+
+    /// Links shader programs, storing their binaries in a directory on disk, so that subsequent links
+    /// of the same sources by the same driver load the binary rather than compiling the sources.
+    ///
+    /// Program binaries are not part of OpenGL 3.3, so the cache looks up the entry points of
+    /// GL_ARB_get_program_binary (or OpenGL 4.1) itself. If these are unavailable, if no directory is given,
+    /// or if a cached binary is rejected by the driver, programs are simply compiled from source.
+    /// Failure to read or write cache files is never an error.
+    ///
+    /// Compilation and linking are split into prepare() and link(), so that drivers that support
+    /// GL_KHR_parallel_shader_compile (or GL_ARB_parallel_shader_compile) may compile many programs on
+    /// their own threads at once: the status of a prepared program is not queried until it is linked,
+    /// which is what makes the driver wait for its compilation to finish.
+    class ProgramCache
+    {
+    public:
+        ProgramCache(ProgramCache && other);
+
+        /// Deletes the programs that have been prepared, but not linked. The context (or a context
+        /// sharing objects with it) must be current.
+        ~ProgramCache();
+
+        ProgramCache(const ProgramCache & other) = delete;
+        ProgramCache & operator=(const ProgramCache & other) = delete;
+        ProgramCache & operator=(ProgramCache && other) = delete;
+
+        /// Creates a cache that stores its files in the given directory, which must already exist.
+        /// An empty directory disables the cache. `loader` looks up OpenGL entry points by name,
+        /// like the loader given to GLAD (e.g. glfwGetProcAddress).
+        ///
+        /// The context *must* have correctly been set beforehand.
+        static ProgramCache create_in_context(const std::string & directory, GLADloadproc loader);
+
+        /// Whether programs are stored on disk, or merely compiled from source.
+        bool enabled() const
+        {
+            return _get_program_binary != nullptr;
+        }
+
+        /// Whether the driver compiles programs on its own threads, in which case
+        /// preparing programs well before they are linked pays off.
+        bool parallel() const
+        {
+            return _parallel;
+        }
+
+        /// Begins compiling and linking a program from the given sources (or loading it from the cache),
+        /// without waiting for the result. Does nothing if the program has already been prepared.
+        ///
+        /// The context *must* have correctly been set beforehand.
+        void prepare(const ProgramSources & sources);
+
+        /// Returns a program linked from the given sources, loaded from the cache if possible, finishing
+        /// the program if it has been prepared. The geometry shader is omitted if its source is empty.
+        /// Throws std::runtime_error if the sources fail to compile or link.
+        ///
+        /// The context *must* have correctly been set beforehand.
+        ShaderProgram link(const ProgramSources & sources);
+
+    private:
+        typedef void (APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+        typedef void (APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void *, GLsizei);
+        typedef void (APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+        typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint);
+
+        /// A program that has been prepared, but not yet linked.
+        struct PendingProgram
+        {
+            GLuint program;
+
+            // The shaders of a program that is being compiled, or empty if it was loaded from the cache
+            std::vector<GLuint> shaders;
+        };
+
+        ProgramCache()
+            : _get_program_binary(nullptr), _program_binary(nullptr), _program_parameteri(nullptr), _parallel(false)
+        {}
+
+        std::string file_name(const ProgramSources & sources) const
+        {
+            return program_cache_file_name(_driver, sources.vertex, sources.fragment, sources.geometry);
+        }
+
+        /// Attempts to load the program from the given cache file. Returns 0 on failure.
+        GLuint load(const std::string & path) const;
+
+        void store(const std::string & path, GLuint program) const;
+
+        std::string _directory;
+
+        // The vendor, renderer and version strings of the driver
+        std::string _driver;
+
+        GetProgramBinaryProc _get_program_binary;
+        ProgramBinaryProc _program_binary;
+        ProgramParameteriProc _program_parameteri;
+
+        bool _parallel;
+
+        // The programs that have been prepared but not yet linked, by the name of their cache file
+        std::unordered_map<std::string, PendingProgram> _pending;
+    };
+}
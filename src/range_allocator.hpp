@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <map>
+
+namespace merely3d
+{
+    /// Returned by RangeAllocator::allocate() when no free range is large enough.
+    const size_t NO_FREE_RANGE = std::numeric_limits<size_t>::max();
+
+    /// Suballocates ranges of elements from a fixed capacity, keeping track of the free ranges in a free list.
+    ///
+    /// Allocation picks the first free range that is large enough, and freed ranges are merged with
+    /// adjacent free ranges, so that the free list never holds two ranges that could form a larger one.
+    class RangeAllocator
+    {
+    public:
+        explicit RangeAllocator(size_t capacity = 0)
+            : _capacity(0), _used(0)
+        {
+            grow(capacity);
+        }
+
+        /// Allocates a range of the given size, and returns its offset, or NO_FREE_RANGE if there is
+        /// no free range that is large enough. Empty ranges are always allocated at offset 0.
+        size_t allocate(size_t size)
+        {
+            if (size == 0)
+            {
+                return 0;
+            }
+
+            for (auto it = _free.begin(); it != _free.end(); ++it)
+            {
+                if (it->second >= size)
+                {
+                    const auto offset = it->first;
+                    const auto remaining = it->second - size;
+                    _free.erase(it);
+                    if (remaining > 0)
+                    {
+                        _free.insert(std::make_pair(offset + size, remaining));
+                    }
+                    _used += size;
+                    return offset;
+                }
+            }
+            return NO_FREE_RANGE;
+        }
+
+        /// Frees a range previously returned by allocate().
+        void free(size_t offset, size_t size)
+        {
+            if (size == 0)
+            {
+                return;
+            }
+
+            assert(offset + size <= _capacity);
+            assert(_used >= size);
+            _used -= size;
+
+            auto next = _free.lower_bound(offset);
+            assert(next == _free.end() || offset + size <= next->first);
+
+            // Merge with the free range that ends where this one begins, if any
+            if (next != _free.begin())
+            {
+                auto previous = std::prev(next);
+                assert(previous->first + previous->second <= offset);
+                if (previous->first + previous->second == offset)
+                {
+                    offset = previous->first;
+                    size += previous->second;
+                    _free.erase(previous);
+                }
+            }
+
+            // Merge with the free range that begins where this one ends, if any
+            if (next != _free.end() && next->first == offset + size)
+            {
+                size += next->second;
+                _free.erase(next);
+            }
+
+            _free.insert(std::make_pair(offset, size));
+        }
+
+        /// Increases the capacity, adding the new elements at the end as free space.
+        void grow(size_t capacity)
+        {
+            assert(capacity >= _capacity);
+            const auto old_capacity = _capacity;
+            const auto added = capacity - old_capacity;
+            _capacity = capacity;
+            _used += added;
+            free(old_capacity, added);
+        }
+
+        /// Frees all ranges, and sets the capacity to the given capacity.
+        void reset(size_t capacity)
+        {
+            _free.clear();
+            _capacity = 0;
+            _used = 0;
+            grow(capacity);
+        }
+
+        size_t capacity() const
+        {
+            return _capacity;
+        }
+
+        /// The total size of the allocated ranges.
+        size_t used() const
+        {
+            return _used;
+        }
+
+        /// The number of free ranges, which is a measure of fragmentation.
+        size_t free_range_count() const
+        {
+            return _free.size();
+        }
+
+    private:
+        size_t _capacity;
+        size_t _used;
+
+        // Offset -> size of each free range
+        std::map<size_t, size_t> _free;
+    };
+}
@@ -1,5 +1,16 @@
 #include "renderer.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "image_tiles.hpp"
+#include "png_writer.hpp"
+
 using Eigen::Quaternionf;
 using Eigen::Vector3f;
 using Eigen::Affine3f;
@@ -10,62 +21,301 @@ using Eigen::Scaling;
 
 namespace merely3d
 {
-    Renderer Renderer::build()
+    /// Whether any meshes are to be rendered, either from the command buffer or from the scene.
+    static bool has_meshes(const CommandBuffer & buffer, detail::SceneData & scene)
+    {
+        if (!buffer.meshes().empty() || !buffer.mesh_handle_instances().meshes.empty())
+        {
+            return true;
+        }
+        const auto & groups = scene.groups();
+        return std::any_of(groups.cbegin(), groups.cend(), [] (const detail::SceneData::GroupMap::value_type & pair)
+        {
+            return pair.second.shape == detail::SceneShape::Mesh;
+        });
+    }
+
+    Renderer Renderer::build(const std::shared_ptr<SharedResources> & shared)
     {
+        assert(shared);
         auto glgc = GlGarbageCollector();
         assert(glgc.garbage());
-        auto mesh_renderer = MeshRenderer::build(glgc.garbage());
-        auto particle_renderer = ParticleRenderer::build(glgc.garbage());
-        return Renderer(ShaderCollection::create_in_context(),
-                        TrianglePrimitiveRenderer::build(),
-                        std::move(mesh_renderer),
-                        std::move(particle_renderer),
-                        GlLine::create(),
-                        std::move(glgc));
+        auto frame_uniforms = GlUniformBuffer::create(glgc.garbage(), sizeof(FrameUniformData), FRAME_UNIFORMS_BINDING);
+        return Renderer(shared, std::move(frame_uniforms), std::move(glgc));
+    }
+
+    Renderer::~Renderer()
+    {
+        // Moved-from renderers hold nothing
+        if (!shared)
+        {
+            return;
+        }
+
+        // Everything that releases objects into the garbage pile must be gone before the pile is emptied.
+        // Moving from the members that are not held by pointer leaves them with nothing to release
+        {
+            const auto primitives = std::move(primitive_renderer);
+            const auto uniforms = std::move(frame_uniforms);
+            static_batch_renderer.reset();
+            mesh_renderer.reset();
+            particle_renderer.reset();
+            gl_line.reset();
+            offscreen_target.reset();
+            capture.reset();
+        }
+        gc.release_all();
+    }
+
+    void Renderer::advance_static_batch(const detail::SceneData & scene)
+    {
+        // Any group of the scene may be batched once it has remained unchanged for long enough,
+        // which the renderer must be around to count
+        if (!static_batch_renderer && !scene.groups().empty())
+        {
+            static_batch_renderer.reset(new StaticBatchRenderer(
+                        StaticBatchRenderer::build(gc.garbage(), gl_state, shared->primitive_geometry())));
+        }
+        if (static_batch_renderer)
+        {
+            static_batch_renderer->advance_frame(scene);
+        }
+    }
+
+    void Renderer::bind_target()
+    {
+        if (!offscreen || viewport.width <= 0 || viewport.height <= 0)
+        {
+            gl_state.bind_framebuffer(0);
+            return;
+        }
+
+        if (!offscreen_target)
+        {
+            offscreen_target.reset(new GlFramebuffer(GlFramebuffer::create(gc.garbage(), gl_state, GL_RGBA8, true)));
+        }
+        offscreen_target->ensure_size(gl_state, viewport.width, viewport.height);
+        offscreen_target->bind(gl_state);
+    }
+
+    void Renderer::start_capture(const CaptureTarget & target)
+    {
+        // The new capture is created first, so that the capture in progress continues if the target cannot be opened
+        std::unique_ptr<GlFrameCapture> previous(new GlFrameCapture(GlFrameCapture::create(gc.garbage(), target)));
+        std::swap(capture, previous);
+        if (previous)
+        {
+            try
+            {
+                previous->finish();
+            }
+            catch (const std::runtime_error & e)
+            {
+                throw std::runtime_error(std::string("The previous capture failed: ") + e.what());
+            }
+        }
+    }
+
+    void Renderer::stop_capture()
+    {
+        if (capture)
+        {
+            // The capture is gone even if finishing it fails
+            std::unique_ptr<GlFrameCapture> finished(std::move(capture));
+            finished->finish();
+        }
     }
 
     void Renderer::render(CommandBuffer & buffer,
+                          detail::SceneData & scene,
+                          const MeshRegistry & meshes,
                           const Camera & camera,
                           const Matrix4f & projection)
     {
-        // TODO: Make clear color configurable
-        glEnable(GL_DEPTH_TEST);
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Renderers that share resources may render on different threads, but only one at a time may use them
+        std::lock_guard<std::mutex> shared_lock(shared->mutex());
 
-        primitive_renderer.render(shader_collection, buffer, camera, projection);
-        mesh_renderer.render(shader_collection, buffer, camera, projection);
-        particle_renderer.render(shader_collection, buffer, camera, projection);
+        // The state of the context may have been changed in between frames, e.g. through the GLFW window
+        gl_state.invalidate();
+        gl_state.reset_counters();
+        gl_state.viewport(viewport);
+        bind_target();
 
-        // TODO: Create a LineRenderer class or similar to encapsulate
-        // line rendering
-        gl_line.bind();
+        scene.update_transforms();
+        advance_static_batch(scene);
+        draw_commands(buffer, scene, meshes, camera, projection);
+
+        // The frame is read back from the framebuffer it was rendered into, which is still bound
+        if (capture)
+        {
+            assert(gl_state.framebuffer() == target_framebuffer());
+            capture->capture(viewport.width, viewport.height);
+        }
 
-        auto & line_shader = shader_collection.line_shader();
+        gc.collect_garbage();
+        shared->collect_garbage();
 
-        line_shader.use();
+        // Changes to shared objects are only guaranteed to be visible to other contexts once they are flushed
+        glFlush();
+    }
 
-        const Affine3f view = camera.transform().inverse();
+    void Renderer::render_tiled(CommandBuffer & buffer,
+                                detail::SceneData & scene,
+                                const MeshRegistry & meshes,
+                                const Camera & camera,
+                                const Matrix4f & projection,
+                                const TiledImage & image,
+                                std::ostream & out)
+    {
+        std::lock_guard<std::mutex> shared_lock(shared->mutex());
 
-        const Vector3f e1 = Vector3f::UnitX();
+        gl_state.invalidate();
+        gl_state.reset_counters();
+
+        // A tile and its margins must fit into both a texture and a viewport
+        GLint max_texture_size = 0;
+        GLint max_viewport_dims[2] = { 0, 0 };
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+        glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport_dims);
+        const int max_size = std::min(max_texture_size, std::min(max_viewport_dims[0], max_viewport_dims[1]));
+        const int margin = image.tile_margin();
+        int tile_size = std::min(image.tile_size(), max_size - 2 * margin);
+        tile_size -= tile_size % 4;
+        if (tile_size < 4)
+        {
+            throw std::invalid_argument("The tile margin is too large for the framebuffers of the context.");
+        }
+        const TileGrid grid(image.width(), image.height(), tile_size);
+
+        // The tiles are parts of a single frame
+        scene.update_transforms();
+        advance_static_batch(scene);
 
-        for (const auto & line : buffer.lines())
         {
-            const Eigen::Vector3f c = line.to - line.from;
+            // Every (padded) tile is rendered into the lower left corner of the same framebuffer
+            auto tile_target = GlFramebuffer::create(gc.garbage(), gl_state, GL_RGBA8, true);
+            tile_target.ensure_size(gl_state,
+                                    std::min(tile_size + 2 * margin, image.width()),
+                                    std::min(tile_size + 2 * margin, image.height()));
+
+            // The pixels of a row of tiles are read straight into the rows of the image, bottom row first
+            const auto row_size = 3 * static_cast<size_t>(image.width());
+            std::vector<unsigned char> rows(row_size * static_cast<size_t>(std::min(tile_size, image.height())));
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glPixelStorei(GL_PACK_ROW_LENGTH, image.width());
 
-            // The reference line is defined to be e1, i.e. [1, 0, 0], so we need the
-            // rotation which rotates e1 into the direction of c.
-            const Quaternionf rotation = Quaternionf::FromTwoVectors(e1, c);
-            const Eigen::Affine3f model = Eigen::Translation3f(line.from) * rotation * Eigen::Scaling(c.norm());
+            PngWriter png(out, image.width(), image.height());
+            for (int row = 0; row < grid.rows(); ++row)
+            {
+                const int rows_in_tile = grid.tile(0, row).height;
+                for (int column = 0; column < grid.columns(); ++column)
+                {
+                    // Everything that reaches into the tile from its margins is drawn, but only the tile is kept
+                    const auto tile = grid.tile(column, row);
+                    const auto padded = grid.padded(tile, margin);
 
-            line_shader.set_projection_transform(projection);
-            line_shader.set_view_transform(view);
-            line_shader.set_model_transform(model);
-            line_shader.set_object_color(line.color);
-            glDrawArrays(GL_LINES, 0, 2);
+                    // Collecting garbage after the previous tile bound vertex arrays behind the back of the tracker
+                    gl_state.invalidate();
+                    gl_state.viewport(GlViewport { 0, 0, padded.width, padded.height });
+                    tile_target.bind(gl_state);
+                    draw_commands(buffer, scene, meshes, camera, grid.tile_projection(projection, padded));
+
+                    // The tile is read back from the framebuffer it was rendered into, which is still bound
+                    assert(gl_state.framebuffer() == tile_target.framebuffer());
+                    glReadPixels(tile.x - padded.x, tile.y - padded.y, tile.width, tile.height,
+                                 GL_RGB, GL_UNSIGNED_BYTE, rows.data() + 3 * static_cast<size_t>(tile.x));
+                    MERELY_CHECK_GL_ERRORS();
+
+                    gc.collect_garbage();
+                }
+
+                for (int y = rows_in_tile - 1; y >= 0; --y)
+                {
+                    png.write_row(rows.data() + row_size * static_cast<size_t>(y));
+                }
+            }
+            png.finish();
+
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            gl_state.bind_framebuffer(0);
         }
 
         gc.collect_garbage();
+        shared->collect_garbage();
+        glFlush();
+    }
+
+    void Renderer::draw_commands(CommandBuffer & buffer,
+                                 detail::SceneData & scene,
+                                 const MeshRegistry & meshes,
+                                 const Camera & camera,
+                                 const Matrix4f & projection)
+    {
+        // TODO: Make clear color configurable
+        gl_state.set_enabled(GL_DEPTH_TEST, true);
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        const Affine3f view = camera.transform().inverse();
 
+        // Camera and lighting data is shared by all shader programs, so it is only written once per frame
+        const auto frame_data = make_frame_uniforms(camera, projection);
+        frame_uniforms.update(&frame_data);
+
+        // Opaque geometry is queued first and drawn in sorted order, roughly front to back,
+        // so that as many fragments as possible are rejected by the depth test before shading
+        opaque_queue.clear();
+        if (static_batch_renderer)
+        {
+            static_batch_renderer->queue_draws(opaque_queue, gl_state, scene, view);
+        }
+        primitive_renderer.queue_draws(opaque_queue, gl_state, buffer, scene, *shared, view);
+        if (!mesh_renderer && has_meshes(buffer, scene))
+        {
+            mesh_renderer.reset(new MeshRenderer(MeshRenderer::build(gc.garbage(),
+                                                                     shared->mesh_cache(),
+                                                                     shared->multi_draw_elements_indirect())));
+        }
+        if (mesh_renderer)
+        {
+            mesh_renderer->queue_draws(opaque_queue, gl_state, buffer, scene, meshes, view);
+        }
+        opaque_queue.sort();
+        auto & shader_collection = shared->shaders();
+        draw_opaque(opaque_queue, shader_collection, gl_state, buffer.interpolation(), depth_prepass,
+                    mesh_renderer ? mesh_renderer->indirect_draws() : nullptr);
+
+        if (!particle_renderer && has_particles(buffer))
+        {
+            particle_renderer.reset(new ParticleRenderer(ParticleRenderer::build(gc.garbage(), gl_state)));
+        }
+        if (particle_renderer)
+        {
+            particle_renderer->render(shader_collection, gl_state, buffer, camera, projection);
+        }
+
+        // TODO: Create a LineRenderer class or similar to encapsulate
+        // line rendering
+        line_instances.clear();
+        for (const auto & line : buffer.lines())
+        {
+            const auto color = line.color.into_array();
+            line_instances.insert(line_instances.end(), line.from.data(), line.from.data() + 3);
+            line_instances.insert(line_instances.end(), line.to.data(), line.to.data() + 3);
+            line_instances.insert(line_instances.end(), color.begin(), color.end());
+        }
+
+        // All lines are drawn with a single instanced draw call
+        if (!gl_line && !line_instances.empty())
+        {
+            gl_line.reset(new GlLine(GlLine::create(gc.garbage(), gl_state)));
+        }
+        if (gl_line)
+        {
+            gl_line->update(line_instances);
+            shader_collection.line_shader().use(gl_state);
+            gl_line->draw(gl_state);
+        }
     }
 }
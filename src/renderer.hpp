@@ -4,50 +4,158 @@
 #include <GLFW/glfw3.h>
 
 #include <merely3d/camera.hpp>
+#include <merely3d/capture.hpp>
 
 #include "command_buffer.hpp"
+#include "gl_frame_capture.hpp"
+#include "gl_framebuffer.hpp"
 #include "gl_line.hpp"
+#include "gl_uniform_buffer.hpp"
+#include "frame_uniforms.hpp"
 #include "shader_collection.hpp"
 
 #include "renderers.hpp"
+#include "draw_queue.hpp"
+#include "gl_state.hpp"
+#include "scene_data.hpp"
+#include "mesh_registry.hpp"
 #include "gl_gc.hpp"
+#include "shared_resources.hpp"
+
+#include <memory>
+#include <ostream>
 
 namespace merely3d
 {
-    // TODO: Cleanup of resources
     class Renderer
     {
     public:
         Renderer(const Renderer & other) = delete;
         Renderer(Renderer && other) = default;
 
+        /// Deletes the OpenGL objects of the renderer (see GlGarbageCollector::release_all).
+        /// The context of the renderer must be current.
+        ~Renderer();
+
         void render(CommandBuffer & buffer,
+                    detail::SceneData & scene,
+                    const MeshRegistry & meshes,
                     const Camera & camera,
                     const Eigen::Matrix4f & projection);
 
-        static Renderer build();
+        /// Renders the commands into a single image of the given size, which is written to the given stream
+        /// as a PNG file, by rendering the image one tile at a time into an offscreen framebuffer with
+        /// the sub-frustum of the tile (see TiledImage). The projection is that of the whole image.
+        ///
+        /// Throws std::invalid_argument if the tile margin leaves no room for the tiles.
+        void render_tiled(CommandBuffer & buffer,
+                          detail::SceneData & scene,
+                          const MeshRegistry & meshes,
+                          const Camera & camera,
+                          const Eigen::Matrix4f & projection,
+                          const TiledImage & image,
+                          std::ostream & out);
+
+        /// Enables or disables the depth pre-pass of opaque geometry (see draw_opaque).
+        void set_depth_prepass(bool enabled) { depth_prepass = enabled; }
+        bool depth_prepass_enabled() const { return depth_prepass; }
+
+        /// Sets the size of the viewport, in pixels, used from the next frame on.
+        void set_viewport_size(int width, int height) { viewport = GlViewport { 0, 0, width, height }; }
+
+        /// Enables or disables rendering into an offscreen framebuffer of the size of the viewport,
+        /// instead of the default framebuffer of the context, which is disabled by default.
+        void set_offscreen(bool enabled)
+        {
+            offscreen = enabled;
+            if (!enabled)
+            {
+                offscreen_target.reset();
+            }
+        }
+        bool offscreen_enabled() const { return offscreen; }
+
+        /// The framebuffer that the most recent frame was rendered into: the offscreen framebuffer,
+        /// or 0 for the default framebuffer.
+        GLuint target_framebuffer() const { return offscreen_target ? offscreen_target->framebuffer() : 0; }
+
+        /// Starts capturing every rendered frame into the given target (see GlFrameCapture), and then stops
+        /// any capture in progress. Throws std::runtime_error if the target cannot be opened, in which case
+        /// the capture in progress continues, or if the previous capture failed, in which case the new
+        /// capture has started nonetheless.
+        void start_capture(const CaptureTarget & target);
+
+        /// Stops capturing, waiting for the captured frames to be written.
+        /// Throws std::runtime_error if any frame could not be written.
+        void stop_capture();
+
+        bool capturing() const { return static_cast<bool>(capture); }
+
+        /// Counts of the state changes made while rendering the most recent frame.
+        const GlStateCounters & state_counters() const { return gl_state.counters(); }
+
+        /// The resources that the renderer may share with other renderers (see SharedResources).
+        const std::shared_ptr<SharedResources> & shared_resources() const { return shared; }
+
+        /// Builds a renderer for the current context, which uses the given shared resources. These must have been
+        /// created in the current context, or in a context that shares objects with it. Shader programs and
+        /// the resources of the individual renderers are created on first use, so that building is quick.
+        static Renderer build(const std::shared_ptr<SharedResources> & shared);
 
     private:
-        Renderer(ShaderCollection && shader_collection,
-                 TrianglePrimitiveRenderer && primitive_renderer,
-                 MeshRenderer && mesh_renderer,
-                 ParticleRenderer && particle_renderer,
-                 GlLine && gl_line,
+        Renderer(const std::shared_ptr<SharedResources> & shared,
+                 GlUniformBuffer && frame_uniforms,
                  GlGarbageCollector && gc)
-            : shader_collection(std::move(shader_collection)),
-              primitive_renderer(std::move(primitive_renderer)),
-              mesh_renderer(std::move(mesh_renderer)),
-              particle_renderer(std::move(particle_renderer)),
-              gl_line(std::move(gl_line)),
-              gc(std::move(gc))
+            : shared(shared),
+              primitive_renderer(TrianglePrimitiveRenderer::build(gc.garbage())),
+              frame_uniforms(std::move(frame_uniforms)),
+              gc(std::move(gc)),
+              viewport(GlViewport { 0, 0, 0, 0 }),
+              depth_prepass(false),
+              offscreen(false)
         {}
 
-        ShaderCollection            shader_collection;
+        /// Draws the commands into the bound framebuffer and viewport with the given projection. The transforms
+        /// of the scene must have been updated, and the static batch advanced to the frame (see advance_static_batch).
+        void draw_commands(CommandBuffer & buffer,
+                           detail::SceneData & scene,
+                           const MeshRegistry & meshes,
+                           const Camera & camera,
+                           const Eigen::Matrix4f & projection);
+
+        /// Advances the static batch to the frame (see StaticBatchRenderer::advance_frame), creating its renderer
+        /// once the scene has groups that may be batched. Must be called once per frame.
+        void advance_static_batch(const detail::SceneData & scene);
+
+        /// Binds the framebuffer to render the frame into, creating the offscreen framebuffer if necessary.
+        void bind_target();
+
+        std::shared_ptr<SharedResources>    shared;
+
+        // Declared before the objects that are created through it
+        GlState                     gl_state;
+
         TrianglePrimitiveRenderer   primitive_renderer;
-        MeshRenderer                mesh_renderer;
-        ParticleRenderer            particle_renderer;
-        GlLine                      gl_line;
+
+        // Created when first needed, so that applications do not pay for the resources of features they do not use
+        std::unique_ptr<StaticBatchRenderer>    static_batch_renderer;
+        std::unique_ptr<MeshRenderer>           mesh_renderer;
+        std::unique_ptr<ParticleRenderer>       particle_renderer;
+        std::unique_ptr<GlLine>                 gl_line;
+        std::unique_ptr<GlFramebuffer>          offscreen_target;
+        std::unique_ptr<GlFrameCapture>         capture;
+
+        // Objects of the context of the renderer, which are not shared
+        GlUniformBuffer             frame_uniforms;
         GlGarbageCollector          gc;
+
+        GlViewport                  viewport;
+        DrawQueue                   opaque_queue;
+        bool                        depth_prepass;
+        bool                        offscreen;
+
+        // Scratch space for gathering the instance records of lines
+        std::vector<float>          line_instances;
     };
 
 }
@@ -5,6 +5,8 @@
 #include <Eigen/Dense>
 
 #include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <unordered_set>
 
 using Eigen::Affine3f;
@@ -15,256 +17,508 @@ using Eigen::Translation3f;
 
 namespace merely3d
 {
-    template <typename Shape>
-    Affine3f build_model_transform(const Renderable<Shape> & renderable)
+    static int resolution_divisor(ParticleResolution resolution)
     {
-        return Translation3f(renderable.position)
-               * renderable.orientation
-               * Scaling(renderable.scale);
+        switch (resolution)
+        {
+            case ParticleResolution::Full: return 1;
+            case ParticleResolution::Half: return 2;
+            case ParticleResolution::Quarter: return 4;
+        }
+        return 1;
     }
 
-    static void enable_wireframe_rendering(bool enable)
+    /// Returns the size of a reduced-resolution render target covering `full_size` pixels.
+    static int reduced_size(int full_size, int divisor)
     {
-        if (enable)
-        {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        }
-        else
+        return (full_size + divisor - 1) / divisor;
+    }
+
+    bool has_particles(const CommandBuffer & buffer)
+    {
+        return !buffer.particle_data().empty()
+            || !buffer.scalar_particle_data().empty()
+            || !buffer.particle_sets().empty();
+    }
+
+    /// Gathers the instances of the given renderables. Wireframes are gathered along with filled geometry,
+    /// since the edge mode of each instance record determines how the instance is drawn.
+    template <typename Iterator>
+    void gather_instances(Iterator begin, Iterator end, std::vector<float> & instances)
+    {
+        instances.clear();
+        for (auto it = begin; it != end; ++it)
         {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            const auto & renderable = *it;
+            const Vector3f ref_scale = reference_scale(renderable.shape);
+            const Vector3f scale = renderable.scale.cwiseProduct(ref_scale);
+            append_instance(instances, renderable.position, renderable.orientation, scale, ref_scale, renderable.material);
         }
     }
 
-    /// Renders a set of static meshes that all share the same GlTriangleMesh. This is useful if the same 3D model
-    /// is being rendered many times, but with different transforms or materials.
+    static InstanceSource instance_source(const OpaqueDraw & draw)
+    {
+        return draw.instance_base >= 0 ? InstanceSource::Texture : InstanceSource::Attributes;
+    }
+
+    /// The interpolation of the transforms of the given draw. Non-instanced draws (i.e. static batches) have
+    /// no previous snapshot, and are always drawn as they are.
+    static float draw_interpolation(const OpaqueDraw & draw, float interpolation)
+    {
+        return draw.instance_count > 0 ? interpolation : 1.0f;
+    }
+
+    /// Sets up the state for drawing the given draw with the mesh shader variant of its shading features.
     ///
-    /// NB! Assumes that the uniforms not specific
-    /// to the individual renderable are all correctly set.
-    void render_static_meshes(std::vector<Renderable<StaticMesh>> & renderables,
-                              GlTriangleMesh & gl_mesh,
-                              ShaderCollection & shaders)
+    /// NB! Assumes that the frame uniforms have been written for the current frame.
+    static void set_shading(const OpaqueDraw & draw, float interpolation, ShaderCollection & shaders, GlState & state)
     {
-        gl_mesh.bind();
-        auto & line_shader = shaders.line_shader();
-        auto & mesh_shader = shaders.mesh_shader();
+        const auto source = instance_source(draw);
 
-        auto draw_primitive = [&] (const Renderable<StaticMesh> & renderable)
+        // Back faces are culled for everything but wireframes (Note: this is absolutely necessary for rectangles,
+        // and especially important for correct rendering of "flat" meshes, in which a given triangle has two faces
+        // pointing opposite directions). Draws with edges may contain wireframes, so their geometry shader culls
+        // the back faces of the other instances instead, and their edges are blended for anti-aliasing.
+        const bool edges = (draw.shading & SHADING_EDGES) != 0;
+        state.set_enabled(GL_CULL_FACE, !edges);
+        state.cull_face(GL_BACK);
+        state.set_enabled(GL_BLEND, edges);
+        if (edges)
         {
-            const auto ref_transform = Eigen::Matrix3f::Identity();
-            const auto model = build_model_transform(renderable);
+            state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
 
-            if (renderable.material.wireframe)
+        auto & shader = shaders.mesh_shader(source, draw.shading);
+        shader.use(state);
+        shader.set_interpolation(draw_interpolation(draw, interpolation));
+        if (source == InstanceSource::Texture)
+        {
+            shader.set_instance_base(draw.instance_base);
+        }
+    }
+
+    /// Binds the instance texture of the draw, unless it is `bound_texture`, which is the instance texture
+    /// bound by the previous draw.
+    static void bind_instance_texture(const OpaqueDraw & draw, const GlInstanceTexture * & bound_texture)
+    {
+        if (draw.instance_texture && draw.instance_texture != bound_texture)
+        {
+            draw.instance_texture->bind(INSTANCE_TEXTURE_UNIT, PREVIOUS_INSTANCE_TEXTURE_UNIT);
+            bound_texture = draw.instance_texture;
+        }
+    }
+
+    /// Issues the draw call with the currently active shader. `bound_texture` is the instance texture
+    /// bound by the previous draw, which is replaced by that of the draw if necessary.
+    static void issue_draw(GlState & state, const OpaqueDraw & draw, const GlInstanceTexture * & bound_texture)
+    {
+        bind_instance_texture(draw, bound_texture);
+
+        state.bind_vertex_array(draw.vertex_array);
+        if (draw.indexed)
+        {
+            const auto indices = reinterpret_cast<const void *>(sizeof(GLuint) * draw.first);
+            if (draw.instance_count > 0)
             {
-                line_shader.set_model_transform(model);
-                line_shader.set_object_color(renderable.material.color);
-                glDrawElements(GL_TRIANGLES, gl_mesh.index_count(), GL_UNSIGNED_INT, 0);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, indices,
+                                                  draw.instance_count, draw.base_vertex);
             }
             else
             {
-                const auto normal_transform = Matrix3f(model.linear().inverse().transpose());
-                mesh_shader.set_model_transform(model);
-                mesh_shader.set_normal_transform(normal_transform);
-                mesh_shader.set_object_color(renderable.material.color);
-                mesh_shader.set_reference_transform(ref_transform);
-                mesh_shader.set_pattern_grid_size(std::max(0.0f, renderable.material.pattern_grid_size));
-                glDrawElements(GL_TRIANGLES, gl_mesh.index_count(), GL_UNSIGNED_INT, 0);
+                glDrawElementsBaseVertex(GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, indices, draw.base_vertex);
             }
-        };
+        }
+        else
+        {
+            if (draw.instance_count > 0)
+            {
+                glDrawArraysInstanced(GL_TRIANGLES, draw.first, draw.count, draw.instance_count);
+            }
+            else
+            {
+                glDrawArrays(GL_TRIANGLES, draw.first, draw.count);
+            }
+        }
+    }
 
-        // Partition vector so that renderables that are to be rendered as wireframes
-        // come first
-        auto filled_begin = std::partition(renderables.begin(), renderables.end(),
-                                           [] (const Renderable<StaticMesh> & renderable)
-                                           {
-                                               return renderable.material.wireframe;
-                                           });
-
-        // Don't cull faces when rendering wireframes
-        glDisable(GL_CULL_FACE);
-        line_shader.use();
-        enable_wireframe_rendering(true);
-        std::for_each(renderables.begin(), filled_begin, draw_primitive);
-
-        // But do cull back faces for everything else
-        // (Note: This is especially important for correct rendering of "flat" meshes,
-        // in which a given triangle has two faces pointing opposite directions)
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-        mesh_shader.use();
-        enable_wireframe_rendering(false);
-        std::for_each(filled_begin, renderables.end(), draw_primitive);
-    }
-
-    /// Render primitives.
+    /// Calls `function` with each draw of the queue in sorted order, and the indirect batch that the draw issues,
+    /// or nullptr if it is issued on its own. The draws covered by the batches of the indirect draws (if any)
+    /// are skipped, except for the first draw of each batch.
+    template <typename Function>
+    static void for_each_draw(const DrawQueue & queue, const GlIndirectDraws * indirect_draws, Function function)
+    {
+        const auto & draws = queue.draws();
+        size_t next_batch = 0;
+        for (size_t i = 0; i < draws.size(); ++i)
+        {
+            const IndirectBatch * batch = nullptr;
+            if (indirect_draws && is_indirect_draw(draws[i], indirect_draws->vertex_array()))
+            {
+                const auto & batches = indirect_draws->batches();
+                if (next_batch == batches.size() || batches[next_batch].first_draw != i)
+                {
+                    continue;
+                }
+                batch = &batches[next_batch++];
+            }
+            function(draws[i], batch);
+        }
+    }
+
+    /// Issues the given draw with the currently active shader, either on its own or as the given indirect batch.
+    static void issue_draw(GlState & state,
+                           const OpaqueDraw & draw,
+                           const IndirectBatch * batch,
+                           const GlIndirectDraws * indirect_draws,
+                           const GlInstanceTexture * & bound_texture)
+    {
+        if (batch)
+        {
+            bind_instance_texture(draw, bound_texture);
+            state.bind_vertex_array(draw.vertex_array);
+            indirect_draws->draw(*batch);
+        }
+        else
+        {
+            issue_draw(state, draw, bound_texture);
+        }
+    }
+
+    /// Queues a draw of the instances in the given buffer.
     ///
-    /// NB! Assumes that the uniforms not specific
-    /// to the individual renderable are all correctly set.
-    template <typename ReferenceTransform, typename Shape>
-    void render_primitives(std::vector<Renderable<Shape>> & renderables,
-                           ShaderCollection & shaders,
-                           GlPrimitive & primitive,
-                           ReferenceTransform && reference_transform)
+    /// `geometry` describes the geometry of the buffer (see OpaqueDraw::arrays and OpaqueDraw::elements),
+    /// and `instances` holds the instance records that were last transferred to the buffer.
+    static void queue_instances(DrawQueue & queue,
+                                const GlInstanceBuffer & buffer,
+                                OpaqueDraw geometry,
+                                const std::vector<float> & instances,
+                                const Affine3f & view)
     {
-        primitive.bind();
-        auto & line_shader = shaders.line_shader();
-        auto & mesh_shader = shaders.mesh_shader();
+        if (buffer.instance_count() == 0)
+        {
+            return;
+        }
+
+        geometry.vertex_array = buffer.vertex_array();
+        geometry.instance_count = static_cast<GLsizei>(buffer.instance_count());
+        geometry.shading = shading_features(instances);
+        queue.push(geometry, nearest_view_depth(instances, view));
+    }
 
-        auto draw_primitive = [&] (const Renderable<Shape> & renderable)
+    /// Transfers the modified instances of the scene group to the given instance buffer, and queues their draw.
+    /// Groups that are part of the static batch are skipped, but their instance buffers are left intact,
+    /// since a group that has been batched has no modified instances.
+    static void queue_scene_group(DrawQueue & queue,
+                                  GlState & state,
+                                  detail::SceneGroup & group,
+                                  GlInstanceBuffer & instances,
+                                  const OpaqueDraw & geometry,
+                                  const Affine3f & view)
+    {
+        if (group.batched)
         {
-            const auto ref_transform = reference_transform(renderable.shape);
-            const auto model = build_model_transform(renderable) * ref_transform;
+            assert(group.dirty.empty());
+            return;
+        }
 
-            if (renderable.material.wireframe)
-            {
-                line_shader.set_model_transform(model);
-                line_shader.set_object_color(renderable.material.color);
-                glDrawArrays(GL_TRIANGLES, 0, primitive.vertex_count());
-            }
-            else
+        instances.update(state, group.instances, group.dirty, group.replaced);
+        group.dirty.clear();
+        group.replaced.clear();
+        queue_instances(queue, instances, geometry, group.instances, view);
+    }
+
+    /// Removes the entries of the cache whose keys are not in the given set.
+    template <typename Cache, typename Key>
+    void evict_unused(Cache & cache, const std::unordered_set<Key> & used)
+    {
+        for (auto it = cache.begin(); it != cache.end(); )
+        {
+            it = used.count(it->first) == 0 ? cache.erase(it) : std::next(it);
+        }
+    }
+
+    void draw_opaque(const DrawQueue & queue,
+                     ShaderCollection & shaders,
+                     GlState & state,
+                     float interpolation,
+                     bool depth_prepass,
+                     GlIndirectDraws * indirect_draws)
+    {
+        if (queue.draws().empty())
+        {
+            return;
+        }
+
+        if (indirect_draws)
+        {
+            indirect_draws->prepare(state, queue.draws());
+        }
+
+        // Texture bindings are not tracked by GlState, so the instance textures are bound as they change
+        const GlInstanceTexture * bound_texture = nullptr;
+
+        // The records of the commands of a batch are found through their base instance instead of the instance base
+        const auto shaded_draw = [] (const OpaqueDraw & draw, const IndirectBatch * batch)
+        {
+            auto shaded = draw;
+            if (batch)
             {
-                const auto normal_transform = Matrix3f(model.linear().inverse().transpose());
-                mesh_shader.set_model_transform(model);
-                mesh_shader.set_normal_transform(normal_transform);
-                mesh_shader.set_object_color(renderable.material.color);
-                mesh_shader.set_reference_transform(Matrix3f(ref_transform));
-                mesh_shader.set_pattern_grid_size(std::max(0.0f, renderable.material.pattern_grid_size));
-                glDrawArrays(GL_TRIANGLES, 0, primitive.vertex_count());
+                shaded.instance_base = 0;
             }
+            return shaded;
         };
 
-        // Partition vector so that renderables that are to be rendered as wireframes
-        // come first
-        auto filled_begin = std::partition(renderables.begin(), renderables.end(),
-            [] (const Renderable<Shape> & renderable)
+        if (depth_prepass)
+        {
+            state.color_mask(false);
+            state.set_enabled(GL_CULL_FACE, true);
+            state.cull_face(GL_BACK);
+            for_each_draw(queue, indirect_draws, [&] (const OpaqueDraw & draw, const IndirectBatch * batch)
             {
-                return renderable.material.wireframe;
+                // Draws with edges may contain wireframes, which must not write the depth of their faces.
+                // The pre-pass could only cover their filled instances by splitting them off into separate draws,
+                // which would defeat the purpose of drawing them together.
+                if ((draw.shading & SHADING_EDGES) == 0)
+                {
+                    const auto source = instance_source(draw);
+                    auto & shader = shaders.depth_shader(source);
+                    shader.use(state);
+                    shader.set_interpolation(draw_interpolation(draw, interpolation));
+                    if (source == InstanceSource::Texture)
+                    {
+                        shader.set_instance_base(shaded_draw(draw, batch).instance_base);
+                    }
+                    issue_draw(state, draw, batch, indirect_draws, bound_texture);
+                }
             });
+            state.color_mask(true);
 
-        // Don't cull faces when rendering wireframes
-        glDisable(GL_CULL_FACE);
-        line_shader.use();
-        enable_wireframe_rendering(true);
-        std::for_each(renderables.begin(), filled_begin, draw_primitive);
+            // The fragments of the filled geometry that survive are those whose depth equals the final depth
+            state.depth_func(GL_LEQUAL);
+        }
+
+        // The draws are sorted by shader program first, so the program changes at most a few times
+        for_each_draw(queue, indirect_draws, [&] (const OpaqueDraw & draw, const IndirectBatch * batch)
+        {
+            set_shading(shaded_draw(draw, batch), interpolation, shaders, state);
+            issue_draw(state, draw, batch, indirect_draws, bound_texture);
+        });
 
-        // But do cull back faces for everything else
-        // (Note: this is absolutely necessary for rectangles)
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-        mesh_shader.use();
-        enable_wireframe_rendering(false);
-        std::for_each(filled_begin, renderables.end(), draw_primitive);
+        // Leave back face culling enabled and blending disabled for the other renderers
+        state.set_enabled(GL_BLEND, false);
+        state.set_enabled(GL_CULL_FACE, true);
+        state.cull_face(GL_BACK);
+        state.depth_func(GL_LESS);
+        MERELY_CHECK_GL_ERRORS();
     }
 
-    /// Returns the linear transformation that
-    /// transforms a reference cube into the provided Box.
-    Eigen::AlignedScaling3f box_reference_transform(const Box & box)
+    TrianglePrimitiveRenderer TrianglePrimitiveRenderer::build(const std::shared_ptr<GlGarbagePile> & garbage)
     {
-        return Scaling(box.extents);
+        return TrianglePrimitiveRenderer(garbage);
     }
 
-    Eigen::AlignedScaling3f rectangle_reference_transform(const Rectangle & rectangle)
+    std::unique_ptr<TrianglePrimitiveRenderer::Primitive> & TrianglePrimitiveRenderer::primitive_slot(
+                detail::SceneShape shape)
     {
-        const auto & extents = rectangle.extents;
-        return Scaling(extents.x(), extents.y(), 1.0f);
+        switch (shape)
+        {
+            case detail::SceneShape::Box: return cube;
+            case detail::SceneShape::Rectangle: return rectangle;
+            case detail::SceneShape::Sphere: return sphere;
+            case detail::SceneShape::Mesh: break;
+        }
+        assert(false && "Meshes are not primitives");
+        return cube;
     }
 
-    Eigen::AlignedScaling3f sphere_reference_transform(const Sphere & sphere)
+    TrianglePrimitiveRenderer::Primitive & TrianglePrimitiveRenderer::primitive(detail::SceneShape shape,
+                                                                                SharedResources & shared,
+                                                                                GlState & state)
     {
-        const auto r = sphere.radius;
-        return Scaling(r, r, r);
+        auto & slot = primitive_slot(shape);
+        if (!slot)
+        {
+            const auto & gl_primitive = shared.primitive(shape);
+            auto instances = GlInstanceBuffer::create(garbage, state, gl_primitive.vertex_buffer(), 0);
+            slot.reset(new Primitive { static_cast<GLsizei>(gl_primitive.vertex_count()), std::move(instances) });
+        }
+        return *slot;
     }
 
-    TrianglePrimitiveRenderer TrianglePrimitiveRenderer::build()
+    template <typename Iterator>
+    void TrianglePrimitiveRenderer::queue_primitives(DrawQueue & queue,
+                                                     GlState & state,
+                                                     detail::SceneShape shape,
+                                                     Iterator begin, Iterator end,
+                                                     SharedResources & shared,
+                                                     const Eigen::Affine3f & view)
     {
-        const auto cube_verts = unit_cube_vertices_and_normals();
-        auto gl_cube = GlPrimitive::create(cube_verts);
+        gather_instances(begin, end, instance_scratch);
 
-        const auto rect_verts = unit_rectangle_vertices_and_normals();
-        auto gl_rect = GlPrimitive::create(rect_verts);
-
-        const auto sphere_verts = unit_sphere_vertices_and_normals();
-        auto gl_sphere = GlPrimitive::create(sphere_verts);
+        // The primitive is not created until there is something to draw, but once created,
+        // its instance buffer must be updated even when empty, so that it does not hold stale instances
+        if (!primitive_slot(shape) && instance_scratch.empty())
+        {
+            return;
+        }
 
-        return TrianglePrimitiveRenderer(std::move(gl_cube),
-                                         std::move(gl_rect),
-                                         std::move(gl_sphere));
+        auto & prim = primitive(shape, shared, state);
+        prim.instances.update(state, instance_scratch);
+        queue_instances(queue, prim.instances, OpaqueDraw::arrays(0, prim.vertex_count), instance_scratch, view);
     }
 
-    void TrianglePrimitiveRenderer::render(
-                ShaderCollection & shaders,
+    void TrianglePrimitiveRenderer::queue_draws(
+                DrawQueue & queue,
+                GlState & state,
                 CommandBuffer & buffer,
-                const Camera & camera,
-                const Eigen::Matrix4f & projection)
+                detail::SceneData & scene,
+                SharedResources & shared,
+                const Eigen::Affine3f & view)
     {
-        auto & mesh_shader = shaders.mesh_shader();
-        auto & line_shader = shaders.line_shader();
+        queue_primitives(queue, state, detail::SceneShape::Rectangle,
+                         buffer.rectangles().cbegin(), buffer.rectangles().cend(), shared, view);
+        queue_primitives(queue, state, detail::SceneShape::Box,
+                         buffer.boxes().cbegin(), buffer.boxes().cend(), shared, view);
+        queue_primitives(queue, state, detail::SceneShape::Sphere,
+                         buffer.spheres().cbegin(), buffer.spheres().cend(), shared, view);
 
-        const Eigen::Affine3f view = camera.transform().inverse();
+        std::unordered_set<detail::SceneGroupId> rendered_groups;
+        for (auto & pair : scene.groups())
+        {
+            auto & group = pair.second;
+            if (group.shape == detail::SceneShape::Mesh)
+            {
+                continue;
+            }
 
-        // TODO: Make lighting configurable rather than hard-coded
-        const auto light_color = Color(1.0, 1.0, 1.0);
-        const Eigen::Vector3f light_dir = Eigen::Vector3f(0.9, 1.2, -0.8).normalized();
+            const auto & gl_primitive = shared.primitive(group.shape);
+            auto cache_iter = scene_instances.find(group.id);
+            if (cache_iter == scene_instances.end())
+            {
+                auto instances = GlInstanceBuffer::create(garbage, state, gl_primitive.vertex_buffer(), 0);
+                cache_iter = scene_instances.insert(std::make_pair(group.id, std::move(instances))).first;
+            }
 
-        // Set up uniforms that are invariant across renderables
-        mesh_shader.use();
-        mesh_shader.set_light_color(light_color);
-        mesh_shader.set_light_direction(light_dir);
-        mesh_shader.set_view_transform(view);
-        mesh_shader.set_projection_transform(projection);
-        mesh_shader.set_camera_position(camera.position());
-        line_shader.use();
-        line_shader.set_projection_transform(projection);
-        line_shader.set_view_transform(view);
+            const auto vertex_count = static_cast<GLsizei>(gl_primitive.vertex_count());
+            queue_scene_group(queue, state, group, cache_iter->second, OpaqueDraw::arrays(0, vertex_count), view);
+            rendered_groups.insert(group.id);
+        }
 
-        render_primitives(buffer.rectangles(), shaders, gl_rectangle, rectangle_reference_transform);
-        render_primitives(buffer.boxes(), shaders, gl_cube, box_reference_transform);
-        render_primitives(buffer.spheres(), shaders, gl_sphere, sphere_reference_transform);
+        evict_unused(scene_instances, rendered_groups);
     }
 
-    MeshRenderer MeshRenderer::build(const std::shared_ptr<GlGarbagePile> & garbage)
+    MeshRenderer MeshRenderer::build(const std::shared_ptr<GlGarbagePile> & garbage,
+                                     const std::shared_ptr<MeshCache> & cache,
+                                     MultiDrawElementsIndirectProc multi_draw)
     {
-        return MeshRenderer(garbage);
+        return MeshRenderer(garbage, cache, GlInstanceTexture::create(garbage), multi_draw);
     }
 
-    void MeshRenderer::render(ShaderCollection &shaders,
-                              CommandBuffer &buffer,
-                              const Camera &camera,
-                              const Eigen::Matrix4f &projection)
+    MeshRenderer::~MeshRenderer()
     {
-        // TODO: Merge some of the code here with the code in TrianglePrimitiveRenderer
-        auto & mesh_shader = shaders.mesh_shader();
-        auto & line_shader = shaders.line_shader();
+        // Moved-from renderers hold nothing
+        if (_cache)
+        {
+            for (const auto & pair : _mesh_slots)
+            {
+                _cache->release(pair.first);
+            }
+            _garbage->recycle_vertex_array_later(_vao);
+        }
+    }
 
-        const Eigen::Affine3f view = camera.transform().inverse();
+    const MeshArenaRange & MeshRenderer::cached_mesh(const detail::StaticMeshData & mesh_data)
+    {
+        auto cache_iter = _mesh_slots.find(mesh_data.id);
+        if (cache_iter == _mesh_slots.end())
+        {
+            const auto slot = _cache->acquire(mesh_data);
+            cache_iter = _mesh_slots.insert(std::make_pair(mesh_data.id, slot)).first;
+        }
+        return _cache->arena().range(cache_iter->second);
+    }
+
+    void MeshRenderer::queue_instances(DrawQueue & queue,
+                                       const MeshArenaRange & range,
+                                       const std::vector<float> & instances,
+                                       const Eigen::Affine3f & view)
+    {
+        if (instances.empty())
+        {
+            return;
+        }
+
+        const auto instance_base = _frame_instances.size() / FLOATS_PER_INSTANCE;
+        _frame_instances.insert(_frame_instances.end(), instances.begin(), instances.end());
+
+        auto draw = OpaqueDraw::elements(static_cast<GLint>(range.first_index),
+                                         static_cast<GLsizei>(range.index_count),
+                                         static_cast<GLint>(range.first_vertex));
+        draw.vertex_array = _vao;
+        draw.instance_count = static_cast<GLsizei>(instances.size() / FLOATS_PER_INSTANCE);
+        draw.instance_base = static_cast<GLint>(instance_base);
+        draw.instance_texture = &_instance_texture;
+        draw.shading = shading_features(instances);
+        queue.push(draw, nearest_view_depth(instances, view));
+    }
+
+    void MeshRenderer::queue_registered(DrawQueue & queue,
+                                        const CommandBuffer & buffer,
+                                        const MeshRegistry & registry,
+                                        const Eigen::Affine3f & view,
+                                        std::unordered_set<detail::UniqueMeshId> & rendered_meshes)
+    {
+        const auto mesh_count = registry.handle_count();
+        sort_by_mesh(buffer.mesh_handle_instances(), mesh_count, _handle_offsets, _handle_sorted);
+
+        for (size_t i = 0; i < mesh_count; ++i)
+        {
+            const auto num_instances = _handle_offsets[i + 1] - _handle_offsets[i];
+            const auto mesh_data = registry.get(static_cast<uint32_t>(i));
+
+            // Draws of meshes that were unregistered after submission are skipped
+            if (num_instances == 0 || !mesh_data)
+            {
+                continue;
+            }
+
+            const auto & range = cached_mesh(*mesh_data);
 
-        // TODO: Make lighting configurable rather than hard-coded
-        const auto light_color = Color(1.0, 1.0, 1.0);
-        const Eigen::Vector3f light_dir = Eigen::Vector3f(0.9, 1.2, -0.8).normalized();
-
-        // Set up uniforms that are invariant across renderables
-        mesh_shader.use();
-        mesh_shader.set_light_color(light_color);
-        mesh_shader.set_light_direction(light_dir);
-        mesh_shader.set_view_transform(view);
-        mesh_shader.set_projection_transform(projection);
-        mesh_shader.set_camera_position(camera.position());
-        line_shader.use();
-        line_shader.set_projection_transform(projection);
-        line_shader.set_view_transform(view);
+            _instance_scratch.assign(_handle_sorted.begin() + FLOATS_PER_INSTANCE * _handle_offsets[i],
+                                     _handle_sorted.begin() + FLOATS_PER_INSTANCE * _handle_offsets[i + 1]);
+            queue_instances(queue, range, _instance_scratch, view);
+            rendered_meshes.insert(mesh_data->id);
+        }
+    }
+
+    void MeshRenderer::queue_draws(DrawQueue & queue,
+                                   GlState & state,
+                                   CommandBuffer & buffer,
+                                   detail::SceneData & scene,
+                                   const MeshRegistry & registry,
+                                   const Eigen::Affine3f & view)
+    {
+        // Compacting moves every mesh once it finishes, so it must happen before any draw refers to the ranges
+        // of the meshes. Meshes are only removed from the arena at the end of a frame, so fragmentation builds up
+        // slowly. The meshes are copied a bounded number of bytes per frame, so that compacting a large arena
+        // spreads its GPU copies over several frames rather than stalling a single one
+        auto & arena = _cache->arena();
+        if (arena.compacting() || arena.fragmented())
+        {
+            arena.compact_step(MESH_ARENA_COMPACTION_BUDGET);
+        }
 
         auto & meshes = buffer.meshes();
 
-        // Make sure that meshes that share the same underlying data are consecutive in the buffer
-        std::sort(meshes.begin(), meshes.end(),
-                  [] (const Renderable<StaticMesh> & mesh1, const Renderable<StaticMesh> & mesh2)
+        // Make sure that meshes that share the same underlying data are consecutive in the buffer.
+        // The sort must be stable, so that the instances of a mesh keep their order from frame to frame,
+        // which in turn means that only the instances that actually changed need to be transferred.
+        std::stable_sort(meshes.begin(), meshes.end(),
+                         [] (const Renderable<StaticMesh> & mesh1, const Renderable<StaticMesh> & mesh2)
         {
-            const auto ptr1 = mesh1.shape._data.get();
-            const auto ptr2 = mesh2.shape._data.get();
-            return ptr1 < ptr2;
+            return mesh1.shape._data->id < mesh2.shape._data->id;
         });
 
-        std::vector<Renderable<StaticMesh>> consecutive_meshes;
-
         auto outer_iter = meshes.cbegin();
         auto inner_iter = meshes.cbegin();
 
@@ -272,6 +526,11 @@ namespace merely3d
         // the rest from our cache
         std::unordered_set<detail::UniqueMeshId> rendered_meshes;
 
+        // The instances of all meshes are gathered into a single instance texture, from which
+        // each draw reads the records starting at its instance base
+        _frame_instances.clear();
+        _frame_replaced.clear();
+
         while (outer_iter != meshes.cend())
         {
             const auto outer_id = outer_iter->shape._data->id;
@@ -279,98 +538,626 @@ namespace merely3d
             {
                 ++inner_iter;
             }
-            consecutive_meshes.assign(outer_iter, inner_iter);
 
-            auto cache_iter = _mesh_cache.find(outer_id);
-            if (cache_iter == _mesh_cache.end())
+            const auto & range = cached_mesh(*outer_iter->shape._data);
+
+            gather_instances(outer_iter, inner_iter, _instance_scratch);
+            queue_instances(queue, range, _instance_scratch, view);
+            rendered_meshes.insert(outer_id);
+
+            outer_iter = inner_iter;
+        }
+
+        queue_registered(queue, buffer, registry, view, rendered_meshes);
+
+        for (auto & pair : scene.groups())
+        {
+            auto & group = pair.second;
+            if (group.shape != detail::SceneShape::Mesh)
             {
-                const auto & mesh_data = *outer_iter->shape._data;
-                auto gl_mesh = GlTriangleMesh::create(_garbage, mesh_data.vertices_and_normals, mesh_data.faces);
-                _mesh_cache.insert(std::make_pair(outer_id, std::move(gl_mesh)));
+                continue;
             }
 
-            cache_iter = _mesh_cache.find(outer_id);
-            auto & gl_mesh = cache_iter->second;
+            // The mesh of a batched group must stay cached, since the group is drawn individually
+            // again as soon as it changes
+            rendered_meshes.insert(group.mesh->id);
+            if (group.batched)
+            {
+                assert(group.dirty.empty());
+                continue;
+            }
 
-            render_static_meshes(consecutive_meshes, gl_mesh, shaders);
-            rendered_meshes.insert(outer_id);
+            // The instance texture detects changed records by itself, so the modified ranges of the group are not needed,
+            // but it can not tell which records belong to other objects than before
+            const auto instance_base = _frame_instances.size() / FLOATS_PER_INSTANCE;
+            for (const auto & range : group.replaced.ranges())
+            {
+                _frame_replaced.add(instance_base + range.begin, instance_base + range.end);
+            }
+            group.dirty.clear();
+            group.replaced.clear();
+            queue_instances(queue, cached_mesh(*group.mesh), group.instances, view);
+        }
 
-            outer_iter = inner_iter;
+        _instance_texture.update(_frame_instances, _frame_replaced);
+
+        // Adding meshes may have replaced the buffers of the arena, as may other renderers sharing the cache
+        if (!_buffers_bound || _bound_generation != arena.generation())
+        {
+            arena.bind_buffers(state, _vao);
+            _bound_generation = arena.generation();
+            _buffers_bound = true;
         }
 
-        std::vector<detail::UniqueMeshId> meshes_to_remove;
-        for (const auto & pair : _mesh_cache)
+        for (auto it = _mesh_slots.begin(); it != _mesh_slots.end(); )
         {
-            const auto & id = pair.first;
-            if (rendered_meshes.count(id) == 0)
+            if (rendered_meshes.count(it->first) == 0)
+            {
+                _cache->release(it->first);
+                it = _mesh_slots.erase(it);
+            }
+            else
             {
-                meshes_to_remove.push_back(id);
+                ++it;
             }
         }
+    }
 
-        for (const auto & id : meshes_to_remove)
+    StaticBatchRenderer StaticBatchRenderer::build(const std::shared_ptr<GlGarbagePile> & garbage,
+                                                   GlState & state,
+                                                   const PrimitiveGeometry & geometry)
+    {
+        return StaticBatchRenderer(GlStaticBatch::create(garbage, state), geometry);
+    }
+
+    StaticBatchSource StaticBatchRenderer::batch_source(const detail::SceneGroup & group) const
+    {
+        StaticBatchSource source;
+        switch (group.shape)
         {
-            _mesh_cache.erase(id);
+            case detail::SceneShape::Box:
+            case detail::SceneShape::Rectangle:
+            case detail::SceneShape::Sphere:
+                source.vertices_and_normals = _geometry.vertices(group.shape);
+                break;
+            case detail::SceneShape::Mesh:
+                // The mesh data is immutable, so it may safely be shared with the thread building the batch
+                source.vertices_and_normals = std::shared_ptr<const std::vector<float>>(
+                            group.mesh, &group.mesh->vertices_and_normals);
+                source.faces = std::shared_ptr<const std::vector<unsigned int>>(group.mesh, &group.mesh->faces);
+                break;
         }
+        return source;
+    }
+
+    void StaticBatchRenderer::advance_frame(const detail::SceneData & scene)
+    {
+        const auto & groups = scene.groups();
 
+        // Count the number of consecutive frames in which each group has remained unchanged.
+        // Rebuilding the map also forgets the groups that no longer exist.
+        std::unordered_map<detail::SceneGroupId, unsigned int> unchanged_frames;
+        for (const auto & pair : groups)
+        {
+            const auto & group = pair.second;
+            const auto previous = _unchanged_frames.find(group.id);
+            const auto frames = previous != _unchanged_frames.end() ? previous->second + 1 : 0;
+            unchanged_frames[group.id] = group.dirty.empty() ? frames : 0;
+        }
+        _unchanged_frames = std::move(unchanged_frames);
+
+        const auto unchanged = [&] (detail::SceneGroupId id)
+        {
+            const auto it = _unchanged_frames.find(id);
+            return it != _unchanged_frames.end() && it->second > 0;
+        };
+
+        // Any change to a member invalidates the batch, and its members are drawn individually until
+        // a new batch has been built. The same goes for a batch that is currently being built.
+        if (!std::all_of(_members.begin(), _members.end(), unchanged))
+        {
+            _members.clear();
+            _batch.clear();
+        }
+        if (_pending.valid() && !std::all_of(_pending_members.begin(), _pending_members.end(), unchanged))
+        {
+            _pending_stale = true;
+        }
+    }
+
+    void StaticBatchRenderer::queue_draws(DrawQueue & queue,
+                                          GlState & state,
+                                          detail::SceneData & scene,
+                                          const Eigen::Affine3f & view)
+    {
+        auto & groups = scene.groups();
+
+        if (_pending.valid() && _pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            const auto data = _pending.get();
+            if (!_pending_stale)
+            {
+                _batch.upload(state, data);
+                _members = std::move(_pending_members);
+            }
+            _pending_members.clear();
+        }
+
+        // Groups that have been unchanged for long enough, and whose geometry is small enough
+        // that merging it pays off, are candidates for the batch
+        std::vector<detail::SceneGroupId> candidates;
+        std::vector<const detail::SceneGroup *> candidate_groups;
+        size_t batch_vertices = 0;
+        size_t batch_instances = 0;
+        for (const auto & pair : groups)
+        {
+            const auto & group = pair.second;
+            if (_unchanged_frames[group.id] < FRAMES_BEFORE_BATCHING)
+            {
+                continue;
+            }
+
+            const auto source = batch_source(group);
+            const auto vertices_per_instance = source.faces
+                                               ? source.faces->size()
+                                               : source.vertices_and_normals->size() / 6;
+            const auto vertex_count = vertices_per_instance * group.size();
+            if (vertices_per_instance <= MAX_VERTICES_PER_INSTANCE
+                && batch_vertices + vertex_count <= MAX_BATCH_VERTICES
+                && batch_instances + group.size() <= _batch.instances().max_instances())
+            {
+                candidates.push_back(group.id);
+                candidate_groups.push_back(&group);
+                batch_vertices += vertex_count;
+                batch_instances += group.size();
+            }
+        }
+
+        if (candidates != _members && !_pending.valid())
+        {
+            if (candidates.empty())
+            {
+                _members.clear();
+                _batch.clear();
+            }
+            else
+            {
+                // Building the batch may take a while, so do it in the background. The instances are copied,
+                // since the scene may be modified while the batch is being built.
+                std::vector<StaticBatchSource> sources;
+                for (const auto group : candidate_groups)
+                {
+                    sources.push_back(batch_source(*group));
+                    sources.back().instances = group->instances;
+                }
+                _pending = std::async(std::launch::async, [sources] { return build_static_batch(sources); });
+                _pending_members = std::move(candidates);
+                _pending_stale = false;
+            }
+        }
+
+        // The batch is ordered among the other draws by its nearest member instance,
+        // and drawn with the shading features of all its members
+        float depth = std::numeric_limits<float>::infinity();
+        unsigned int shading = 0;
+        for (auto & pair : groups)
+        {
+            auto & group = pair.second;
+            group.batched = std::find(_members.begin(), _members.end(), group.id) != _members.end();
+            if (group.batched)
+            {
+                depth = std::min(depth, nearest_view_depth(group.instances, view));
+                shading |= shading_features(group.instances);
+            }
+        }
+
+        const auto vertex_count = static_cast<GLsizei>(_batch.vertex_count());
+        if (vertex_count > 0)
+        {
+            auto draw = OpaqueDraw::arrays(0, vertex_count);
+            draw.vertex_array = _batch.vertex_array();
+            draw.instance_base = 0;
+            draw.instance_texture = &_batch.instances();
+            draw.shading = shading;
+            queue.push(draw, depth);
+        }
     }
 
     void ParticleRenderer::render(ShaderCollection & shaders,
+                                  GlState & state,
                                   CommandBuffer & buffer,
                                   const Camera & camera,
                                   const Eigen::Matrix4f & projection)
     {
-        auto & shader = shaders.particle_shader();
-
         const Eigen::Affine3f view = camera.transform().inverse();
 
-        GLint viewport[4];
-        glGetIntegerv(GL_VIEWPORT, viewport);
-        const float viewport_width = static_cast<float>(viewport[2]);
-        const float viewport_height = static_cast<float>(viewport[3]);
-
-        // Compute the distance to the near plane by transforming from a point on the near plane in
-        // NDC to view space. We have that
-        //  n = P * X / N,
-        // where N is the distance to the near plane, X = [x, 1] and x are the coordinate in
-        // view space, and n represents the coordinates in NDC. Letting Y = X / N,
-        // we have that N = 1 / Y_w, where Y = P^-1 * n.
-        const float near_plane_dist = 1.0 / (projection.inverse() * Eigen::Vector4f(0.0, 0.0, -1.0, 1.0)).w();
-
-        // TODO: Make lighting configurable rather than hard-coded
-        const auto light_color = Color(1.0, 1.0, 1.0);
-        const Eigen::Vector3f light_dir_world = Eigen::Vector3f(0.9, 1.2, -0.8).normalized();
-        const Eigen::Vector3f light_dir_eye = view.linear() * light_dir_world;
-
-        shader.use();
-        shader.set_view_transform(view);
-        shader.set_projection_transform(projection);
-        shader.set_viewport_dimensions(viewport_width, viewport_height);
-        shader.set_near_plane_dist(near_plane_dist);
-        shader.set_light_color(light_color);
-        shader.set_light_eye_direction(light_dir_eye);
-
-        assert(buffer.particle_data().size() % 7 == 0);
-        const auto num_particles = buffer.particle_data().size() / 7;
-        _particle_buffer.update_buffer(buffer.particle_data().data(), num_particles);
-        _particle_buffer.bind();
+        const int viewport_width = state.viewport().width;
+        const int viewport_height = state.viewport().height;
 
-        MERELY_CHECK_GL_ERRORS();
+        // Passes that render into offscreen buffers composite their results onto the target of the frame,
+        // which is not necessarily the default framebuffer
+        const GLuint target_framebuffer = state.framebuffer();
 
-        glEnable(GL_PROGRAM_POINT_SIZE);
+        state.set_enabled(GL_PROGRAM_POINT_SIZE, true);
         // The following line MAY be required on Windows, or in some configurations. On the other hand,
         // this caused an error on my Linux machine. TODO: Remove this once we know whether or not we need it.
         // glEnable(0x8861/*GL_POINT_SPRITE*/); // should be enabled by default in OpenGL 3.3, but isn't
         glPointParameteri(GL_POINT_SPRITE_COORD_ORIGIN, GL_LOWER_LEFT);
         MERELY_CHECK_GL_ERRORS();
 
-        glDrawArrays(GL_POINTS, 0, num_particles);
+        update_particle_sets(state, buffer);
+
+        switch (buffer.particle_options().render_mode)
+        {
+            case ParticleRenderMode::Spheres:
+                render_spheres(shaders, state, buffer, view, projection,
+                               target_framebuffer, viewport_width, viewport_height);
+                break;
+            case ParticleRenderMode::Density:
+                render_density(shaders, state, buffer, view, projection,
+                               target_framebuffer, viewport_width, viewport_height);
+                break;
+        }
+    }
+
+    void ParticleRenderer::render_spheres(ShaderCollection & shaders,
+                                          GlState & state,
+                                          const CommandBuffer & buffer,
+                                          const Eigen::Affine3f & view,
+                                          const Eigen::Matrix4f & projection,
+                                          GLuint target_framebuffer,
+                                          int viewport_width,
+                                          int viewport_height)
+    {
+        auto & shader = shaders.particle_shader();
+
+        const int divisor = resolution_divisor(buffer.particle_options().resolution);
+        const int target_width = reduced_size(viewport_width, divisor);
+        const int target_height = reduced_size(viewport_height, divisor);
+
+        if (divisor > 1)
+        {
+            if (!has_particles(buffer) || viewport_width <= 0 || viewport_height <= 0)
+            {
+                return;
+            }
+
+            _low_resolution_buffer.ensure_size(state, target_width, target_height);
+            _low_resolution_buffer.bind(state);
+            state.viewport(GlViewport { 0, 0, target_width, target_height });
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        shader.use(state);
+        shader.set_viewport(state.viewport());
+        shader.set_scalar_coloring(false, 0);
+        shader.set_interpolation(buffer.particle_options().interpolation);
+
+        MERELY_CHECK_GL_ERRORS();
+
+        const auto & options = buffer.particle_options();
+        draw_particles(state, _particle_buffer, _sorter, buffer.particle_data(), options.spatial_sorting, view, projection);
+        draw_particle_sets(state, buffer);
+
+        if (!buffer.scalar_particle_data().empty())
+        {
+            // The colormap lookup happens on the GPU, so that changing the colormap or the range does not
+            // require uploading any particle data
+            _scalar_colormap_texture.set_colormap(options.scalar_colormap);
+            _scalar_colormap_texture.bind(GL_TEXTURE0);
+            shader.set_scalar_coloring(true, 0);
+            shader.set_scalar_range(options.scalar_min, options.scalar_max);
+            draw_particles(state, _scalar_particle_buffer, _scalar_sorter, buffer.scalar_particle_data(),
+                           options.spatial_sorting, view, projection);
+            glBindTexture(GL_TEXTURE_1D, 0);
+        }
+
+        if (divisor > 1)
+        {
+            state.bind_framebuffer(target_framebuffer);
+            state.viewport(GlViewport { 0, 0, viewport_width, viewport_height });
+
+            // Upsample the particles and blend them on top of the scene. The composite pass writes
+            // the depth of the particles, so that they are correctly occluded by (and occlude)
+            // the full-resolution geometry
+            state.set_enabled(GL_BLEND, true);
+            state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, _low_resolution_buffer.color_texture());
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, _low_resolution_buffer.depth_texture());
+
+            auto & upsample_shader = shaders.particle_upsample_shader();
+            upsample_shader.use(state);
+            upsample_shader.set_texture_units(0, 1);
+            upsample_shader.set_resolution_divisor(divisor);
+            _fullscreen_triangle.draw(state);
+
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            state.set_enabled(GL_BLEND, false);
+            MERELY_CHECK_GL_ERRORS();
+        }
+    }
+
+    void ParticleRenderer::render_density(ShaderCollection & shaders,
+                                          GlState & state,
+                                          const CommandBuffer & buffer,
+                                          const Eigen::Affine3f & view,
+                                          const Eigen::Matrix4f & projection,
+                                          GLuint target_framebuffer,
+                                          int viewport_width,
+                                          int viewport_height)
+    {
+        if (!has_particles(buffer) || viewport_width <= 0 || viewport_height <= 0)
+        {
+            return;
+        }
+
+        const auto & options = buffer.particle_options();
+        const int divisor = resolution_divisor(options.resolution);
+        const int target_width = reduced_size(viewport_width, divisor);
+        const int target_height = reduced_size(viewport_height, divisor);
+
+        // Accumulate density additively into the offscreen buffer. Particles do not occlude each other,
+        // so there is no need for depth testing
+        _density_buffer.ensure_size(state, target_width, target_height);
+        _density_buffer.bind(state);
+        state.viewport(GlViewport { 0, 0, target_width, target_height });
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        state.set_enabled(GL_DEPTH_TEST, false);
+        state.set_enabled(GL_BLEND, true);
+        state.blend_func(GL_ONE, GL_ONE);
+
+        auto & splat_shader = shaders.density_splat_shader();
+        splat_shader.use(state);
+        splat_shader.set_viewport_height(static_cast<float>(target_height));
+        splat_shader.set_interpolation(options.interpolation);
+        draw_particles(state, _particle_buffer, _sorter, buffer.particle_data(), options.spatial_sorting, view, projection);
+        draw_particles(state, _scalar_particle_buffer, _scalar_sorter, buffer.scalar_particle_data(),
+                       options.spatial_sorting, view, projection);
+        draw_particle_sets(state, buffer);
+
+        // Tone map the density through the colormap and blend the result on top of the scene
+        state.bind_framebuffer(target_framebuffer);
+        state.viewport(GlViewport { 0, 0, viewport_width, viewport_height });
+        state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        _colormap_texture.set_colormap(options.density_colormap);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, _density_buffer.color_texture());
+        _colormap_texture.bind(GL_TEXTURE1);
+
+        auto & resolve_shader = shaders.density_resolve_shader();
+        resolve_shader.use(state);
+        resolve_shader.set_texture_units(0, 1);
+        resolve_shader.set_exposure(options.density_exposure);
+        resolve_shader.set_resolution_divisor(divisor);
+        _fullscreen_triangle.draw(state);
+
+        glBindTexture(GL_TEXTURE_1D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        state.set_enabled(GL_BLEND, false);
+        state.set_enabled(GL_DEPTH_TEST, true);
+        MERELY_CHECK_GL_ERRORS();
+    }
+
+    void ParticleRenderer::update_particle_sets(GlState & state, const CommandBuffer & buffer)
+    {
+        std::unordered_set<detail::UniqueParticleSetId> drawn_sets;
+        for (const auto & particle_set : buffer.particle_sets())
+        {
+            auto & data = *particle_set._data;
+            drawn_sets.insert(data.id);
+
+            auto cache_iter = _particle_set_cache.find(data.id);
+            bool upload_all = false;
+            if (cache_iter == _particle_set_cache.end())
+            {
+                auto gl_buffer = GlParticleBuffer::create(_garbage, state, ParticleLayout::Colored, true);
+                auto entry = CachedParticleSet { std::move(gl_buffer), DirtyRanges(), 0, 0 };
+                cache_iter = _particle_set_cache.insert(std::make_pair(data.id, std::move(entry))).first;
+                upload_all = true;
+            }
+
+            auto & cached = cache_iter->second;
+            auto & gl_buffer = cached.buffer;
+            const auto stride = gl_buffer.floats_per_particle();
+
+            // The set may be modified, and drawn by other renderers, while it is uploaded
+            std::lock_guard<std::mutex> lock(data.mutex);
+            const auto num_particles = data.records.size() / stride;
+
+            // Every renderer that draws the set keeps track of the version it last uploaded. If the changes
+            // since then are no longer known, everything is uploaded. Growing the buffer keeps the uploaded particles
+            size_t min_size = 0;
+            upload_all = !data.history.changes_since(cached.version, _set_changes, min_size) || upload_all;
+            gl_buffer.reserve(state, num_particles, cached.size);
+            cached.version = data.history.latest_version();
+
+            // Particles beyond the smallest size of the set since the last upload were removed and added again
+            _set_replaced.clear();
+            _set_replaced.add(std::min(min_size, num_particles), num_particles);
+
+            // A new snapshot is started whenever the set was modified, in which the current particles
+            // become the previous snapshot. Only the particles that changed in the last snapshot need to be copied
+            plan_snapshot_transfers(upload_all, cached.changed, _set_changes, _set_replaced, cached.size, num_particles,
+                                    _set_transfers);
+            for_each_transfer_range(_set_transfers.copy_before_upload, [&] (size_t first, size_t count)
+            {
+                gl_buffer.copy_to_previous(first, count);
+            });
+            for_each_transfer_range(_set_transfers.upload, [&] (size_t first, size_t count)
+            {
+                gl_buffer.update_range(&data.records[stride * first], first, count);
+            });
+            for_each_transfer_range(_set_transfers.copy_after_upload, [&] (size_t first, size_t count)
+            {
+                gl_buffer.copy_to_previous(first, count);
+            });
+
+            if (upload_all)
+            {
+                cached.changed.clear();
+            }
+            else if (!_set_changes.empty())
+            {
+                cached.changed = _set_changes;
+            }
+            cached.size = num_particles;
+        }
+
+        std::vector<detail::UniqueParticleSetId> sets_to_remove;
+        for (const auto & pair : _particle_set_cache)
+        {
+            if (drawn_sets.count(pair.first) == 0)
+            {
+                sets_to_remove.push_back(pair.first);
+            }
+        }
+
+        for (const auto & id : sets_to_remove)
+        {
+            _particle_set_cache.erase(id);
+        }
+    }
+
+    void ParticleRenderer::draw_particle_sets(GlState & state, const CommandBuffer & buffer)
+    {
+        for (const auto & particle_set : buffer.particle_sets())
+        {
+            // The size of the set as uploaded, since the set may have been modified since
+            auto & cached = _particle_set_cache.find(particle_set._data->id)->second;
+            if (cached.size == 0)
+            {
+                continue;
+            }
+
+            cached.buffer.bind(state);
+            glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(cached.size));
+            MERELY_CHECK_GL_ERRORS();
+        }
+    }
+
+    void ParticleRenderer::draw_particles(GlState & state,
+                                          GlParticleBuffer & gpu_buffer,
+                                          ParticleSorter & sorter,
+                                          const std::vector<float> & particle_data,
+                                          bool spatial_sorting,
+                                          const Eigen::Affine3f & view,
+                                          const Eigen::Matrix4f & projection)
+    {
+        // Note that skipping an empty set leaves both the GPU buffer and the sorter untouched,
+        // so they remain consistent with each other
+        if (particle_data.empty())
+        {
+            return;
+        }
+
+        const auto stride = gpu_buffer.floats_per_particle();
+        assert(particle_data.size() % stride == 0);
+
+        if (spatial_sorting)
+        {
+            const Eigen::Matrix4f view_projection = projection * view.matrix();
+            draw_sorted(state, gpu_buffer, sorter, particle_data, Frustum::from_view_projection(view_projection));
+        }
+        else
+        {
+            // The GPU buffer is about to be overwritten in submission order
+            sorter.invalidate();
+
+            const auto num_particles = particle_data.size() / stride;
+            gpu_buffer.update_buffer(state, particle_data.data(), num_particles);
+            gpu_buffer.bind(state);
+
+            glDrawArrays(GL_POINTS, 0, num_particles);
+            MERELY_CHECK_GL_ERRORS();
+        }
+    }
+
+    void ParticleRenderer::draw_sorted(GlState & state,
+                                       GlParticleBuffer & gpu_buffer,
+                                       ParticleSorter & sorter,
+                                       const std::vector<float> & particle_data,
+                                       const Frustum & frustum)
+    {
+        const auto stride = gpu_buffer.floats_per_particle();
+        sorter.sort(particle_data, stride, gpu_buffer.radius_offset());
+
+        const auto & sorted = sorter.sorted_records();
+        const auto & chunks = sorter.chunks();
+
+        // If the buffer had to be reallocated, its contents are lost and every chunk must be uploaded
+        const bool reallocated = gpu_buffer.reserve(state, sorted.size() / stride);
+
+        // Upload each run of consecutive changed chunks with a single call
+        size_t begin = 0;
+        while (begin < chunks.size())
+        {
+            if (!reallocated && !chunks[begin].changed)
+            {
+                ++begin;
+                continue;
+            }
+
+            auto end = begin + 1;
+            while (end < chunks.size() && (reallocated || chunks[end].changed))
+            {
+                ++end;
+            }
+
+            const auto first = chunks[begin].first;
+            const auto count = chunks[end - 1].first + chunks[end - 1].count - first;
+            gpu_buffer.update_range(&sorted[stride * first], first, count);
+            begin = end;
+        }
+
+        // Cull chunks outside of the view frustum, and merge consecutive visible
+        // chunks into a single draw
+        _draw_firsts.clear();
+        _draw_counts.clear();
+        for (const auto & chunk : chunks)
+        {
+            if (!frustum.intersects(chunk.bounds))
+            {
+                continue;
+            }
+
+            const auto first = static_cast<GLint>(chunk.first);
+            const auto count = static_cast<GLsizei>(chunk.count);
+            if (!_draw_firsts.empty() && _draw_firsts.back() + _draw_counts.back() == first)
+            {
+                _draw_counts.back() += count;
+            }
+            else
+            {
+                _draw_firsts.push_back(first);
+                _draw_counts.push_back(count);
+            }
+        }
+
+        gpu_buffer.bind(state);
+        glMultiDrawArrays(GL_POINTS,
+                          _draw_firsts.data(),
+                          _draw_counts.data(),
+                          static_cast<GLsizei>(_draw_firsts.size()));
         MERELY_CHECK_GL_ERRORS();
-        _particle_buffer.unbind();
     }
 
-    ParticleRenderer ParticleRenderer::build(const std::shared_ptr<GlGarbagePile> & garbage)
+    ParticleRenderer ParticleRenderer::build(const std::shared_ptr<GlGarbagePile> & garbage, GlState & state)
     {
-        return ParticleRenderer(GlParticleBuffer::create(garbage));
+        return ParticleRenderer(garbage,
+                                GlParticleBuffer::create(garbage, state, ParticleLayout::Colored),
+                                GlParticleBuffer::create(garbage, state, ParticleLayout::Scalar),
+                                GlColormapTexture::create(garbage, ParticleOptions().scalar_colormap),
+                                GlFramebuffer::create(garbage, state, GL_R32F, false),
+                                GlFramebuffer::create(garbage, state, GL_RGBA8, true),
+                                GlColormapTexture::create(garbage, ParticleOptions().density_colormap),
+                                GlFullscreenTriangle::create(garbage));
     }
 }
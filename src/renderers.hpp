@@ -1,80 +1,393 @@
 #pragma once
 
 #include "gl_line.hpp"
-#include "gl_primitive.hpp"
-#include "gl_triangle_mesh.hpp"
 #include "gl_particle_buffer.hpp"
+#include "gl_framebuffer.hpp"
+#include "gl_colormap_texture.hpp"
+#include "gl_fullscreen_triangle.hpp"
+#include "gl_instance_buffer.hpp"
+#include "gl_instance_texture.hpp"
+#include "gl_indirect_draws.hpp"
+#include "mesh_cache.hpp"
+#include "gl_static_batch.hpp"
+#include "draw_queue.hpp"
+#include "gl_state.hpp"
 #include "shader.hpp"
 #include "shader_collection.hpp"
 #include "command_buffer.hpp"
+#include "particle_sort.hpp"
+#include "frustum.hpp"
+#include "particle_set_data.hpp"
+#include "scene_data.hpp"
+#include "mesh_registry.hpp"
+#include "primitive_geometry.hpp"
+#include "shared_resources.hpp"
 
 #include <merely3d/camera.hpp>
 #include <merely3d/mesh.hpp>
 
+#include <future>
+#include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace merely3d
 {
 
+/// Issues the draws of the queue in sorted order (see DrawQueue::sort), optionally preceded by
+/// a pass that only writes the depth of the draws without edges, so that the more expensive shading
+/// is only done for the visible fragments. The frame uniforms must have been written for the current frame.
+///
+/// The transforms of instanced draws are blended by the given interpolation (see Frame::set_interpolation).
+///
+/// If indirect draws are given, the draws they cover are issued in batches (see GlIndirectDraws),
+/// each in the place of its first draw.
+void draw_opaque(const DrawQueue & queue,
+                 ShaderCollection & shaders,
+                 GlState & state,
+                 float interpolation,
+                 bool depth_prepass,
+                 GlIndirectDraws * indirect_draws);
+
+/// Draws the boxes, rectangles and spheres of the command buffer and of the scene.
+///
+/// The vertex buffers of the primitives are shared resources, whereas the instance buffers, whose vertex arrays
+/// bind the vertex buffers, belong to the renderer. The GPU buffers of each kind of primitive are only created
+/// once the first primitive of its kind is drawn.
 class TrianglePrimitiveRenderer
 {
 public:
-    void render(ShaderCollection & shaders,
-                CommandBuffer & buffer,
-                const Camera & camera,
-                const Eigen::Matrix4f & projection);
+    /// Transfers the instances of the primitives of the command buffer, as well as the primitives of the scene,
+    /// and queues their draws.
+    void queue_draws(DrawQueue & queue,
+                     GlState & state,
+                     CommandBuffer & buffer,
+                     detail::SceneData & scene,
+                     SharedResources & shared,
+                     const Eigen::Affine3f & view);
 
-    static TrianglePrimitiveRenderer build();
+    static TrianglePrimitiveRenderer build(const std::shared_ptr<GlGarbagePile> & garbage);
 
 private:
+    /// The instances of the command buffer drawn with a single kind of primitive.
+    struct Primitive
+    {
+        GLsizei vertex_count;
+
+        // The instance buffer is retained across frames, so that only
+        // the instances that changed since the previous frame are transferred
+        GlInstanceBuffer instances;
+    };
 
-    TrianglePrimitiveRenderer(GlPrimitive && gl_cube,
-                              GlPrimitive && gl_rectangle,
-                              GlPrimitive && gl_sphere)
-        : gl_cube(std::move(gl_cube)),
-          gl_rectangle(std::move(gl_rectangle)),
-          gl_sphere(std::move(gl_sphere))
+    explicit TrianglePrimitiveRenderer(const std::shared_ptr<GlGarbagePile> & garbage)
+        : garbage(garbage)
     {}
 
-    GlPrimitive gl_cube;
-    GlPrimitive gl_rectangle;
-    GlPrimitive gl_sphere;
+    std::unique_ptr<Primitive> & primitive_slot(detail::SceneShape shape);
+
+    /// Returns the primitive of the given shape, creating its GPU buffers if necessary.
+    Primitive & primitive(detail::SceneShape shape, SharedResources & shared, GlState & state);
+
+    /// Queues the draws of the given primitives of the command buffer.
+    template <typename Iterator>
+    void queue_primitives(DrawQueue & queue,
+                          GlState & state,
+                          detail::SceneShape shape,
+                          Iterator begin, Iterator end,
+                          SharedResources & shared,
+                          const Eigen::Affine3f & view);
+
+    std::shared_ptr<GlGarbagePile> garbage;
+
+    std::unique_ptr<Primitive> cube;
+    std::unique_ptr<Primitive> rectangle;
+    std::unique_ptr<Primitive> sphere;
+
+    // Scratch space for gathering instances
+    std::vector<float> instance_scratch;
+
+    // Instance buffers for the groups of the scene
+    std::unordered_map<detail::SceneGroupId, GlInstanceBuffer> scene_instances;
 };
 
+/// Draws the meshes of the command buffer and of the scene.
+///
+/// The geometry of all meshes is stored in the arena of a MeshCache, which may be shared with other renderers,
+/// and the instance records of all meshes are gathered into a single GlInstanceTexture, so that every mesh draw
+/// uses the same vertex array. If the context supports glMultiDrawElementsIndirect, the mesh draws of each
+/// shader program are issued with a single call (see GlIndirectDraws), and otherwise one by one.
 class MeshRenderer
 {
 public:
-    void render(ShaderCollection & shaders,
-                CommandBuffer & buffer,
-                const Camera & camera,
-                const Eigen::Matrix4f & projection);
+    MeshRenderer(MeshRenderer && other) = default;
+    MeshRenderer(const MeshRenderer & other) = delete;
 
-    static MeshRenderer build(const std::shared_ptr<GlGarbagePile> & garbage);
+    /// Releases the meshes of the renderer from the cache.
+    ~MeshRenderer();
+
+    /// Transfers the instances of the meshes of the command buffer, as well as the meshes of the scene,
+    /// and queues their draws.
+    void queue_draws(DrawQueue & queue,
+                     GlState & state,
+                     CommandBuffer & buffer,
+                     detail::SceneData & scene,
+                     const MeshRegistry & registry,
+                     const Eigen::Affine3f & view);
+
+    /// The indirect draws of the mesh draws, to be passed to draw_opaque, or nullptr if they are not supported.
+    GlIndirectDraws * indirect_draws()
+    {
+        return _indirect_draws.get();
+    }
+
+    /// Builds a renderer, which issues its draws through glMultiDrawElementsIndirect if `multi_draw` is given
+    /// (see load_multi_draw_elements_indirect).
+    static MeshRenderer build(const std::shared_ptr<GlGarbagePile> & garbage,
+                              const std::shared_ptr<MeshCache> & cache,
+                              MultiDrawElementsIndirectProc multi_draw);
 
 private:
-    MeshRenderer(const std::shared_ptr<GlGarbagePile> & garbage)
-        : _garbage(garbage) { }
+    MeshRenderer(const std::shared_ptr<GlGarbagePile> & garbage,
+                 const std::shared_ptr<MeshCache> & cache,
+                 GlInstanceTexture && instance_texture,
+                 MultiDrawElementsIndirectProc multi_draw)
+        : _garbage(garbage),
+          _cache(cache),
+          _vao(garbage->acquire_vertex_array()),
+          _bound_generation(0),
+          _buffers_bound(false),
+          _instance_texture(std::move(instance_texture)),
+          _indirect_draws(multi_draw ? new GlIndirectDraws(GlIndirectDraws::create(garbage, multi_draw, _vao)) : nullptr)
+    { }
+
+    /// Returns the range of the arena that holds the given mesh, adding the mesh to the cache if necessary.
+    const MeshArenaRange & cached_mesh(const detail::StaticMeshData & mesh_data);
+
+    /// Appends the given instances of the mesh in the given range to the instances of the frame,
+    /// and queues their draw.
+    void queue_instances(DrawQueue & queue,
+                         const MeshArenaRange & range,
+                         const std::vector<float> & instances,
+                         const Eigen::Affine3f & view);
+
+    void queue_registered(DrawQueue & queue,
+                          const CommandBuffer & buffer,
+                          const MeshRegistry & registry,
+                          const Eigen::Affine3f & view,
+                          std::unordered_set<detail::UniqueMeshId> & rendered_meshes);
 
-    std::unordered_map<detail::UniqueMeshId, GlTriangleMesh> _mesh_cache;
     std::shared_ptr<GlGarbagePile>                           _garbage;
+    std::shared_ptr<MeshCache>                               _cache;
+
+    // Binds the buffers of the arena in the context of the renderer, as of the given generation of the arena
+    GLuint                                                   _vao;
+    uint64_t                                                 _bound_generation;
+    bool                                                     _buffers_bound;
+
+    GlInstanceTexture                                        _instance_texture;
+    std::unique_ptr<GlIndirectDraws>                         _indirect_draws;
+
+    // The arena slot of each mesh that the renderer holds a reference to in the cache
+    std::unordered_map<detail::UniqueMeshId, size_t>         _mesh_slots;
+
+    // The instance records of all mesh draws of the current frame, and those that belong to other objects
+    // than in the previous frame
+    std::vector<float>                                       _frame_instances;
+    DirtyRanges                                              _frame_replaced;
+
+    // Scratch space for gathering instances
+    std::vector<float>                                       _instance_scratch;
+
+    // Scratch space for grouping the instances of registered meshes
+    std::vector<size_t>                                      _handle_offsets;
+    std::vector<float>                                       _handle_sorted;
 };
 
+/// Merges the groups of the scene that have remained unchanged for a number of frames into a static batch,
+/// which is drawn with a single draw call, rather than one instanced draw call per group.
+///
+/// The batch is rebuilt on a background thread whenever its membership changes. Any change to a member
+/// of the batch immediately removes all groups from the batch, so that they are drawn individually
+/// until the batch has been rebuilt.
+class StaticBatchRenderer
+{
+public:
+    /// Counts the consecutive frames in which each group of the scene has remained unchanged, and removes
+    /// all groups from the batch if any of them changed. Must be called once per frame, however many times
+    /// the frame is drawn (e.g. once per tile), after the transforms of the scene have been updated and before
+    /// any renderer queues the draws of the scene, since these clear the modifications of the groups.
+    void advance_frame(const detail::SceneData & scene);
+
+    /// Queues the draws of the static batch, and marks the groups of the scene that are part of it as batched,
+    /// so that the other renderers skip them. Must be called before the other renderers queue the draws of the scene.
+    void queue_draws(DrawQueue & queue,
+                     GlState & state,
+                     detail::SceneData & scene,
+                     const Eigen::Affine3f & view);
+
+    static StaticBatchRenderer build(const std::shared_ptr<GlGarbagePile> & garbage,
+                                     GlState & state,
+                                     const PrimitiveGeometry & geometry);
+
+private:
+    StaticBatchRenderer(GlStaticBatch && batch, const PrimitiveGeometry & geometry)
+        : _batch(std::move(batch)),
+          _geometry(geometry),
+          _pending_stale(false)
+    {}
+
+    /// Returns a source for the geometry of the group, without any instances.
+    StaticBatchSource batch_source(const detail::SceneGroup & group) const;
+
+    // The number of consecutive frames a group must remain unchanged before it is batched
+    static const unsigned int FRAMES_BEFORE_BATCHING = 60;
+
+    // Instancing is already efficient for geometry with many vertices, and
+    // replicating it for every instance would take up a lot of memory
+    static const size_t MAX_VERTICES_PER_INSTANCE = 256;
+    static const size_t MAX_BATCH_VERTICES = 1 << 19;
+
+    GlStaticBatch                                           _batch;
+
+    PrimitiveGeometry                                       _geometry;
+
+    std::unordered_map<detail::SceneGroupId, unsigned int>  _unchanged_frames;
+
+    // The groups in the batch
+    std::vector<detail::SceneGroupId>                       _members;
+
+    // The batch currently being built in the background, if any, and its groups.
+    // If any of the groups changes while the batch is being built, the result is discarded.
+    std::future<StaticBatchData>                            _pending;
+    std::vector<detail::SceneGroupId>                       _pending_members;
+    bool                                                    _pending_stale;
+};
+
+/// Whether the command buffer holds any particles to be rendered.
+bool has_particles(const CommandBuffer & buffer);
+
 class ParticleRenderer
 {
 public:
+    /// Renders the particles of the command buffer. The target framebuffer must have been bound and the viewport
+    /// must have been set through `state`, and the frame uniforms must have been written for the current frame.
     void render(ShaderCollection & shaders,
+                GlState & state,
                 CommandBuffer & buffer,
                 const Camera & camera,
                 const Eigen::Matrix4f & projection);
 
-    static ParticleRenderer build(const std::shared_ptr<GlGarbagePile> & garbage);
+    static ParticleRenderer build(const std::shared_ptr<GlGarbagePile> & garbage, GlState & state);
 
 private:
-    ParticleRenderer(GlParticleBuffer && buffer)
-        : _particle_buffer(std::move(buffer)) { }
+    ParticleRenderer(const std::shared_ptr<GlGarbagePile> & garbage,
+                     GlParticleBuffer && buffer,
+                     GlParticleBuffer && scalar_buffer,
+                     GlColormapTexture && scalar_colormap_texture,
+                     GlFramebuffer && density_buffer,
+                     GlFramebuffer && low_resolution_buffer,
+                     GlColormapTexture && colormap_texture,
+                     GlFullscreenTriangle && fullscreen_triangle)
+        : _garbage(garbage),
+          _particle_buffer(std::move(buffer)),
+          _scalar_particle_buffer(std::move(scalar_buffer)),
+          _scalar_colormap_texture(std::move(scalar_colormap_texture)),
+          _density_buffer(std::move(density_buffer)),
+          _colormap_texture(std::move(colormap_texture)),
+          _low_resolution_buffer(std::move(low_resolution_buffer)),
+          _fullscreen_triangle(std::move(fullscreen_triangle)) { }
+
+    void render_spheres(ShaderCollection & shaders,
+                        GlState & state,
+                        const CommandBuffer & buffer,
+                        const Eigen::Affine3f & view,
+                        const Eigen::Matrix4f & projection,
+                        GLuint target_framebuffer,
+                        int viewport_width,
+                        int viewport_height);
+
+    void render_density(ShaderCollection & shaders,
+                        GlState & state,
+                        const CommandBuffer & buffer,
+                        const Eigen::Affine3f & view,
+                        const Eigen::Matrix4f & projection,
+                        GLuint target_framebuffer,
+                        int viewport_width,
+                        int viewport_height);
+
+    /// Uploads the modified particles of every particle set in the command buffer,
+    /// and evicts the GPU buffers of particle sets that are no longer drawn.
+    void update_particle_sets(GlState & state, const CommandBuffer & buffer);
+
+    /// Draws the particle sets of the command buffer with the currently active shader.
+    /// The sets must have been uploaded by update_particle_sets().
+    void draw_particle_sets(GlState & state, const CommandBuffer & buffer);
+
+    /// Uploads the given particles to the GPU buffer and draws them with the currently active shader.
+    /// The particle data must have the layout of the GPU buffer.
+    void draw_particles(GlState & state,
+                        GlParticleBuffer & gpu_buffer,
+                        ParticleSorter & sorter,
+                        const std::vector<float> & particle_data,
+                        bool spatial_sorting,
+                        const Eigen::Affine3f & view,
+                        const Eigen::Matrix4f & projection);
+
+    /// Sorts the particles spatially, uploads the chunks that changed since the previous
+    /// frame and draws the chunks that intersect the view frustum.
+    void draw_sorted(GlState & state,
+                     GlParticleBuffer & gpu_buffer,
+                     ParticleSorter & sorter,
+                     const std::vector<float> & particle_data,
+                     const Frustum & frustum);
+
+    std::shared_ptr<GlGarbagePile>      _garbage;
 
     GlParticleBuffer                    _particle_buffer;
+
+    // Particles colored by a scalar field through a colormap
+    GlParticleBuffer                    _scalar_particle_buffer;
+    GlColormapTexture                   _scalar_colormap_texture;
+
+    // Resources for the Density render mode
+    GlFramebuffer                       _density_buffer;
+    GlColormapTexture                   _colormap_texture;
+
+    // Color and depth target for spheres rendered at reduced resolution
+    GlFramebuffer                       _low_resolution_buffer;
+
+    // Shared by the passes that composite offscreen targets onto the scene
+    GlFullscreenTriangle                _fullscreen_triangle;
+
+    // The sorters retain the sorted particles of the previous frame, which at all times
+    // must correspond to the contents of their respective GPU buffers (or be invalidated)
+    ParticleSorter                      _sorter;
+    ParticleSorter                      _scalar_sorter;
+    struct CachedParticleSet
+    {
+        // Always holds the contents of the set as of the uploaded version,
+        // as well as the previous snapshot of the set
+        GlParticleBuffer buffer;
+
+        // The particles that changed in the current snapshot, which are the only
+        // particles in which the previous snapshot differs from the current
+        DirtyRanges changed;
+
+        // The version of the set that was last uploaded (see DirtyHistory), and its number of particles
+        uint64_t version;
+        size_t size;
+    };
+
+    std::unordered_map<detail::UniqueParticleSetId, CachedParticleSet> _particle_set_cache;
+
+    // Scratch space for the particles of a set modified and replaced since it was last uploaded, and their transfers
+    DirtyRanges                         _set_changes;
+    DirtyRanges                         _set_replaced;
+    SnapshotTransfers                   _set_transfers;
+
+    std::vector<GLint>                  _draw_firsts;
+    std::vector<GLsizei>                _draw_counts;
 };
 
 }
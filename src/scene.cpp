@@ -0,0 +1,478 @@
+#include <merely3d/scene.hpp>
+
+#include "scene_data.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+
+namespace merely3d
+{
+    namespace detail
+    {
+        namespace
+        {
+            SceneGroupId next_scene_group_id()
+            {
+                static std::atomic<SceneGroupId> next_id(0);
+                return next_id++;
+            }
+
+            std::tuple<SceneShape, UniqueMeshId> group_key(SceneShape shape,
+                                                           const std::shared_ptr<const StaticMeshData> & mesh)
+            {
+                return std::make_tuple(shape, mesh ? mesh->id : UniqueMeshId(0));
+            }
+        }
+
+        SceneData::Slot & SceneData::slot(SceneHandle handle)
+        {
+            if (!contains(handle))
+            {
+                throw std::invalid_argument("Handle does not refer to an object in the scene.");
+            }
+            return _slots[handle.index];
+        }
+
+        bool SceneData::contains(SceneHandle handle) const
+        {
+            return handle.index < _slots.size()
+                && _slots[handle.index].group != nullptr
+                && _slots[handle.index].generation == handle.generation;
+        }
+
+        SceneGroup & SceneData::find_or_create_group(SceneShape shape,
+                                                     const std::shared_ptr<const StaticMeshData> & mesh)
+        {
+            const auto key = group_key(shape, mesh);
+            auto it = _groups.find(key);
+            if (it == _groups.end())
+            {
+                auto group = SceneGroup(next_scene_group_id(), shape, mesh);
+                it = _groups.insert(std::make_pair(key, std::move(group))).first;
+            }
+            return it->second;
+        }
+
+        void SceneData::insert_instance(SceneGroup & group, uint32_t slot_index, const float * record)
+        {
+            const auto instance = group.size();
+            group.instances.insert(group.instances.end(), record, record + FLOATS_PER_INSTANCE);
+            group.slots.push_back(slot_index);
+            group.dirty.add(instance, instance + 1);
+            group.replaced.add(instance, instance + 1);
+
+            auto & slot = _slots[slot_index];
+            slot.group = &group;
+            slot.instance = static_cast<uint32_t>(instance);
+        }
+
+        void SceneData::remove_instance(SceneGroup & group, uint32_t instance)
+        {
+            assert(instance < group.size());
+            const auto last = group.size() - 1;
+            if (instance != last)
+            {
+                std::copy(group.instances.begin() + FLOATS_PER_INSTANCE * last,
+                          group.instances.begin() + FLOATS_PER_INSTANCE * (last + 1),
+                          group.instances.begin() + FLOATS_PER_INSTANCE * instance);
+                group.slots[instance] = group.slots[last];
+                _slots[group.slots[instance]].instance = instance;
+                group.dirty.add(instance, instance + 1);
+                group.replaced.add(instance, instance + 1);
+            }
+
+            group.instances.resize(FLOATS_PER_INSTANCE * last);
+            group.slots.pop_back();
+            group.dirty.truncate(last);
+            group.replaced.truncate(last);
+
+            if (group.size() == 0)
+            {
+                _groups.erase(group_key(group.shape, group.mesh));
+            }
+        }
+
+        SceneHandle SceneData::add(SceneShape shape,
+                                   std::shared_ptr<const StaticMeshData> mesh,
+                                   NodeHandle node,
+                                   const Eigen::Vector3f & position,
+                                   const Eigen::Quaternionf & orientation,
+                                   const Eigen::Vector3f & scale,
+                                   const Eigen::Vector3f & reference_scale,
+                                   const Material & material)
+        {
+            const auto node_idx = node_index(node);
+
+            uint32_t slot_index;
+            if (_free_slots.empty())
+            {
+                slot_index = static_cast<uint32_t>(_slots.size());
+                _slots.push_back(Slot());
+            }
+            else
+            {
+                slot_index = _free_slots.back();
+                _free_slots.pop_back();
+            }
+
+            std::vector<float> record;
+            append_instance(record, position, orientation, scale.cwiseProduct(reference_scale), reference_scale, material);
+
+            auto & group = find_or_create_group(shape, mesh);
+            insert_instance(group, slot_index, record.data());
+            ++_num_objects;
+
+            auto & s = _slots[slot_index];
+            s.node = node_idx;
+            s.local_position = position;
+            s.local_orientation = orientation;
+            if (node_idx != NO_NODE)
+            {
+                _nodes[node_idx].objects.push_back(slot_index);
+                write_world_transform(slot_index);
+            }
+
+            SceneHandle handle;
+            handle.index = slot_index;
+            handle.generation = _slots[slot_index].generation;
+            return handle;
+        }
+
+        void SceneData::set_transform(SceneHandle handle,
+                                      const Eigen::Vector3f & position,
+                                      const Eigen::Quaternionf & orientation)
+        {
+            auto & s = slot(handle);
+            s.local_position = position;
+            s.local_orientation = orientation;
+            write_world_transform(handle.index);
+        }
+
+        void SceneData::write_world_transform(uint32_t slot_index)
+        {
+            const auto & s = _slots[slot_index];
+            Eigen::Vector3f position = s.local_position;
+            Eigen::Quaternionf orientation = s.local_orientation;
+            if (s.node != NO_NODE)
+            {
+                // If the node is dirty, this is overwritten by the next update_transforms()
+                const auto & node = _nodes[s.node];
+                position = node.world_position + node.world_orientation * position;
+                orientation = node.world_orientation * orientation;
+            }
+
+            auto & group = *s.group;
+            write_instance_transform(&group.instances[FLOATS_PER_INSTANCE * s.instance], position, orientation);
+            group.dirty.add(s.instance, s.instance + 1);
+        }
+
+        void SceneData::set_scale(SceneHandle handle, const Eigen::Vector3f & scale)
+        {
+            auto & s = slot(handle);
+            auto & group = *s.group;
+            float * record = &group.instances[FLOATS_PER_INSTANCE * s.instance];
+            const Eigen::Vector3f reference_scale = Eigen::Map<const Eigen::Vector3f>(
+                        record + INSTANCE_REFERENCE_SCALE_OFFSET);
+            write_instance_scale(record, scale.cwiseProduct(reference_scale), reference_scale);
+            group.dirty.add(s.instance, s.instance + 1);
+        }
+
+        void SceneData::set_material(SceneHandle handle, const Material & material)
+        {
+            auto & s = slot(handle);
+            auto & group = *s.group;
+            float * record = &group.instances[FLOATS_PER_INSTANCE * s.instance];
+            write_instance_material(record, material);
+            group.dirty.add(s.instance, s.instance + 1);
+        }
+
+        void SceneData::remove(SceneHandle handle)
+        {
+            auto & s = slot(handle);
+            if (s.node != NO_NODE)
+            {
+                auto & objects = _nodes[s.node].objects;
+                objects.erase(std::find(objects.begin(), objects.end(), handle.index));
+            }
+            release_slot(handle.index);
+        }
+
+        void SceneData::release_slot(uint32_t slot_index)
+        {
+            auto & s = _slots[slot_index];
+            remove_instance(*s.group, s.instance);
+            s.group = nullptr;
+            s.node = NO_NODE;
+            // Skip generation 0, so that default-constructed handles never refer to an object
+            s.generation = s.generation + 1 == 0 ? 1 : s.generation + 1;
+            _free_slots.push_back(slot_index);
+            --_num_objects;
+        }
+
+        bool SceneData::contains(NodeHandle node) const
+        {
+            return node.index < _nodes.size()
+                && _nodes[node.index].alive
+                && _nodes[node.index].generation == node.generation;
+        }
+
+        uint32_t SceneData::node_index(NodeHandle node) const
+        {
+            if (node == NodeHandle())
+            {
+                return NO_NODE;
+            }
+            if (!contains(node))
+            {
+                throw std::invalid_argument("Handle does not refer to a node in the scene.");
+            }
+            return node.index;
+        }
+
+        NodeHandle SceneData::add_node(const Eigen::Vector3f & position,
+                                       const Eigen::Quaternionf & orientation,
+                                       NodeHandle parent)
+        {
+            const auto parent_idx = node_index(parent);
+
+            uint32_t node_idx;
+            if (_free_nodes.empty())
+            {
+                node_idx = static_cast<uint32_t>(_nodes.size());
+                _nodes.push_back(Node());
+            }
+            else
+            {
+                node_idx = _free_nodes.back();
+                _free_nodes.pop_back();
+            }
+
+            auto & node = _nodes[node_idx];
+            node.alive = true;
+            node.dirty = true;
+            node.parent = parent_idx;
+            node.local_position = position;
+            node.local_orientation = orientation;
+            node.world_position = position;
+            node.world_orientation = orientation;
+
+            // The parent already precedes the end of the order
+            _node_order.push_back(node_idx);
+            _transforms_dirty = true;
+
+            NodeHandle handle;
+            handle.index = node_idx;
+            handle.generation = node.generation;
+            return handle;
+        }
+
+        void SceneData::set_node_transform(NodeHandle handle,
+                                           const Eigen::Vector3f & position,
+                                           const Eigen::Quaternionf & orientation)
+        {
+            const auto node_idx = node_index(handle);
+            if (node_idx == NO_NODE)
+            {
+                throw std::invalid_argument("The world frame can not be transformed.");
+            }
+
+            auto & node = _nodes[node_idx];
+            node.local_position = position;
+            node.local_orientation = orientation;
+            node.dirty = true;
+            _transforms_dirty = true;
+        }
+
+        void SceneData::remove_node(NodeHandle handle)
+        {
+            const auto node_idx = node_index(handle);
+            if (node_idx == NO_NODE)
+            {
+                throw std::invalid_argument("The world frame can not be removed.");
+            }
+
+            // Since every node comes after its parent, a single pass over the order
+            // finds all the descendants of the node
+            std::vector<bool> removed(_nodes.size(), false);
+            removed[node_idx] = true;
+            for (const auto idx : _node_order)
+            {
+                auto & node = _nodes[idx];
+                if (node.parent != NO_NODE && removed[node.parent])
+                {
+                    removed[idx] = true;
+                }
+
+                if (removed[idx])
+                {
+                    for (const auto slot_index : node.objects)
+                    {
+                        release_slot(slot_index);
+                    }
+                    node.objects.clear();
+                    node.alive = false;
+                    node.generation = node.generation + 1 == 0 ? 1 : node.generation + 1;
+                    _free_nodes.push_back(idx);
+                }
+            }
+
+            _node_order.erase(std::remove_if(_node_order.begin(), _node_order.end(),
+                                             [&] (uint32_t idx) { return removed[idx]; }),
+                              _node_order.end());
+        }
+
+        void SceneData::update_transforms()
+        {
+            if (!_transforms_dirty)
+            {
+                return;
+            }
+
+            for (const auto idx : _node_order)
+            {
+                auto & node = _nodes[idx];
+                const bool parent_updated = node.parent != NO_NODE && _nodes[node.parent].updated;
+                node.updated = node.dirty || parent_updated;
+                if (!node.updated)
+                {
+                    continue;
+                }
+
+                if (node.parent == NO_NODE)
+                {
+                    node.world_position = node.local_position;
+                    node.world_orientation = node.local_orientation;
+                }
+                else
+                {
+                    const auto & parent = _nodes[node.parent];
+                    node.world_position = parent.world_position + parent.world_orientation * node.local_position;
+                    node.world_orientation = parent.world_orientation * node.local_orientation;
+                }
+                node.dirty = false;
+
+                for (const auto slot_index : node.objects)
+                {
+                    write_world_transform(slot_index);
+                }
+            }
+
+            _transforms_dirty = false;
+        }
+
+        void SceneData::clear()
+        {
+            for (uint32_t i = 0; i < _slots.size(); ++i)
+            {
+                if (_slots[i].group != nullptr)
+                {
+                    release_slot(i);
+                }
+            }
+
+            for (const auto idx : _node_order)
+            {
+                auto & node = _nodes[idx];
+                node.objects.clear();
+                node.alive = false;
+                node.generation = node.generation + 1 == 0 ? 1 : node.generation + 1;
+                _free_nodes.push_back(idx);
+            }
+            _node_order.clear();
+            _transforms_dirty = false;
+        }
+    }
+
+    Scene::Scene() : _d(new detail::SceneData) {}
+
+    Scene::Scene(Scene && other) : _d(std::move(other._d)) {}
+
+    Scene::~Scene() {}
+
+    SceneHandle Scene::add(const Renderable<Box> & r, NodeHandle node)
+    {
+        return _d->add(detail::SceneShape::Box, nullptr, node, r.position, r.orientation, r.scale,
+                       reference_scale(r.shape), r.material);
+    }
+
+    SceneHandle Scene::add(const Renderable<Rectangle> & r, NodeHandle node)
+    {
+        return _d->add(detail::SceneShape::Rectangle, nullptr, node, r.position, r.orientation, r.scale,
+                       reference_scale(r.shape), r.material);
+    }
+
+    SceneHandle Scene::add(const Renderable<Sphere> & r, NodeHandle node)
+    {
+        return _d->add(detail::SceneShape::Sphere, nullptr, node, r.position, r.orientation, r.scale,
+                       reference_scale(r.shape), r.material);
+    }
+
+    SceneHandle Scene::add(const Renderable<StaticMesh> & r, NodeHandle node)
+    {
+        return _d->add(detail::SceneShape::Mesh, r.shape._data, node, r.position, r.orientation, r.scale,
+                       reference_scale(r.shape), r.material);
+    }
+
+    void Scene::set_transform(SceneHandle handle,
+                              const Eigen::Vector3f & position,
+                              const Eigen::Quaternionf & orientation)
+    {
+        _d->set_transform(handle, position, orientation);
+    }
+
+    void Scene::set_scale(SceneHandle handle, const Eigen::Vector3f & scale)
+    {
+        _d->set_scale(handle, scale);
+    }
+
+    void Scene::set_material(SceneHandle handle, const Material & material)
+    {
+        _d->set_material(handle, material);
+    }
+
+    void Scene::remove(SceneHandle handle)
+    {
+        _d->remove(handle);
+    }
+
+    bool Scene::contains(SceneHandle handle) const
+    {
+        return _d->contains(handle);
+    }
+
+    NodeHandle Scene::add_node(const Eigen::Vector3f & position,
+                               const Eigen::Quaternionf & orientation,
+                               NodeHandle parent)
+    {
+        return _d->add_node(position, orientation, parent);
+    }
+
+    void Scene::set_node_transform(NodeHandle node,
+                                   const Eigen::Vector3f & position,
+                                   const Eigen::Quaternionf & orientation)
+    {
+        _d->set_node_transform(node, position, orientation);
+    }
+
+    void Scene::remove_node(NodeHandle node)
+    {
+        _d->remove_node(node);
+    }
+
+    bool Scene::contains(NodeHandle node) const
+    {
+        return _d->contains(node);
+    }
+
+    size_t Scene::size() const
+    {
+        return _d->size();
+    }
+
+    void Scene::clear()
+    {
+        _d->clear();
+    }
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <merely3d/scene.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "dirty_ranges.hpp"
+#include "instance_data.hpp"
+
+namespace merely3d
+{
+    namespace detail
+    {
+        enum class SceneShape
+        {
+            Box,
+            Rectangle,
+            Sphere,
+            Mesh
+        };
+
+        typedef uint64_t SceneGroupId;
+
+        /// The objects of a scene that share geometry, which are drawn together regardless of their materials,
+        /// stored as packed instance records (see instance_data.hpp).
+        struct SceneGroup
+        {
+            SceneGroup(SceneGroupId id,
+                       SceneShape shape,
+                       std::shared_ptr<const StaticMeshData> mesh)
+                : id(id), shape(shape), mesh(std::move(mesh)), batched(false)
+            {}
+
+            /// Unique among the groups of all scenes, used as the key of the GPU cache.
+            /// A group that becomes empty is removed, so a group with the same shape
+            /// that is created later has a different id.
+            const SceneGroupId id;
+            const SceneShape shape;
+
+            /// The mesh shared by all objects of the group, or null if the shape is not SceneShape::Mesh.
+            const std::shared_ptr<const StaticMeshData> mesh;
+
+            std::vector<float> instances;
+
+            /// The slot of the object corresponding to each instance.
+            std::vector<uint32_t> slots;
+
+            /// Instances modified since the group was last uploaded to the GPU.
+            DirtyRanges dirty;
+
+            /// The dirty instances that belong to a different object than at the last upload, since they were
+            /// added, or moved into the place of a removed instance. They have no previous snapshot to
+            /// interpolate from (see GlInstanceBuffer).
+            DirtyRanges replaced;
+
+            /// Whether the group is currently drawn as part of a static batch (see StaticBatchRenderer),
+            /// rather than from its own instance buffer. Maintained by the renderer.
+            bool batched;
+
+            size_t size() const { return slots.size(); }
+        };
+
+        class SceneData
+        {
+        public:
+            SceneData() : _num_objects(0), _transforms_dirty(false) {}
+
+            /// Adds an object attached to the given node, with a position and orientation relative to the node.
+            SceneHandle add(SceneShape shape,
+                            std::shared_ptr<const StaticMeshData> mesh,
+                            NodeHandle node,
+                            const Eigen::Vector3f & position,
+                            const Eigen::Quaternionf & orientation,
+                            const Eigen::Vector3f & scale,
+                            const Eigen::Vector3f & reference_scale,
+                            const Material & material);
+
+            void set_transform(SceneHandle handle,
+                               const Eigen::Vector3f & position,
+                               const Eigen::Quaternionf & orientation);
+
+            void set_scale(SceneHandle handle, const Eigen::Vector3f & scale);
+
+            void set_material(SceneHandle handle, const Material & material);
+
+            void remove(SceneHandle handle);
+
+            bool contains(SceneHandle handle) const;
+
+            size_t size() const { return _num_objects; }
+
+            NodeHandle add_node(const Eigen::Vector3f & position,
+                                const Eigen::Quaternionf & orientation,
+                                NodeHandle parent);
+
+            void set_node_transform(NodeHandle node,
+                                    const Eigen::Vector3f & position,
+                                    const Eigen::Quaternionf & orientation);
+
+            void remove_node(NodeHandle node);
+
+            bool contains(NodeHandle node) const;
+
+            void clear();
+
+            /// Recomputes the world transforms of the nodes whose transform changed, and of all of their
+            /// descendants, and writes the resulting transforms of their attached objects to the groups.
+            /// Must be called before the groups are transferred to the GPU.
+            void update_transforms();
+
+            typedef std::map<std::tuple<SceneShape, UniqueMeshId>, SceneGroup> GroupMap;
+
+            /// The renderer is responsible for clearing the dirty ranges of the groups
+            /// once they have been transferred to the GPU.
+            GroupMap & groups() { return _groups; }
+            const GroupMap & groups() const { return _groups; }
+
+        private:
+            static const uint32_t NO_NODE = UINT32_MAX;
+
+            struct Slot
+            {
+                Slot() : generation(1), group(nullptr), instance(0), node(NO_NODE) {}
+
+                uint32_t    generation;
+                // Null if the slot is not in use
+                SceneGroup * group;
+                uint32_t    instance;
+
+                // The transform of the object relative to its node
+                uint32_t                node;
+                Eigen::Vector3f         local_position;
+                UnalignedQuaternionf    local_orientation;
+            };
+
+            struct Node
+            {
+                Node() : generation(1), alive(false), dirty(false), updated(false), parent(NO_NODE) {}
+
+                uint32_t    generation;
+                bool        alive;
+                // Whether the local transform changed since the world transform was last computed
+                bool        dirty;
+                // Whether the world transform was recomputed in the current call to update_transforms()
+                bool        updated;
+                uint32_t    parent;
+
+                Eigen::Vector3f         local_position;
+                UnalignedQuaternionf    local_orientation;
+                Eigen::Vector3f         world_position;
+                UnalignedQuaternionf    world_orientation;
+
+                // The slots of the objects attached to the node
+                std::vector<uint32_t>   objects;
+            };
+
+            Slot & slot(SceneHandle handle);
+
+            /// Returns the index of the node, or NO_NODE for the world frame.
+            uint32_t node_index(NodeHandle node) const;
+
+            /// Writes the world transform of the object in the given slot to its instance record.
+            void write_world_transform(uint32_t slot_index);
+
+            void release_slot(uint32_t slot_index);
+
+            SceneGroup & find_or_create_group(SceneShape shape,
+                                              const std::shared_ptr<const StaticMeshData> & mesh);
+
+            /// Appends a record to the group and assigns it to the given slot.
+            void insert_instance(SceneGroup & group, uint32_t slot_index, const float * record);
+
+            /// Removes the instance by moving the last instance of the group into its place,
+            /// and removes the group if it becomes empty.
+            void remove_instance(SceneGroup & group, uint32_t instance);
+
+            std::vector<Slot>       _slots;
+            std::vector<uint32_t>   _free_slots;
+            GroupMap                _groups;
+            size_t                  _num_objects;
+
+            std::vector<Node>       _nodes;
+            std::vector<uint32_t>   _free_nodes;
+            // The indices of all nodes, ordered such that every node comes after its parent
+            std::vector<uint32_t>   _node_order;
+            bool                    _transforms_dirty;
+        };
+    }
+}
@@ -68,14 +68,18 @@ namespace merely3d
         }
     }
 
-    void ShaderProgram::use()
+    GLint ShaderProgram::get_uniform_loc(const std::string & name) const
     {
-        glUseProgram(_id);
+        return glGetUniformLocation(_id, name.c_str());
     }
 
-    GLint ShaderProgram::get_uniform_loc(const std::string & name) const
+    void ShaderProgram::bind_uniform_block(const std::string & name, GLuint binding)
     {
-        return glGetUniformLocation(_id, name.c_str());
+        const auto index = glGetUniformBlockIndex(_id, name.c_str());
+        if (index != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(_id, index, binding);
+        }
     }
 
     void ShaderProgram::set_mat3_uniform(GLint location, const float * value)
@@ -97,4 +101,9 @@ namespace merely3d
     {
         glUniform1f(location, value);
     }
+
+    void ShaderProgram::set_int_uniform(GLint location, int value)
+    {
+        glUniform1i(location, value);
+    }
 }
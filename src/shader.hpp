@@ -46,20 +46,26 @@ namespace merely3d
         /// Links the current program. The context *must* have correctly been set beforehand.
         void link();
 
-        /// Makes GL use the current program. The context *must* have correctly been set beforehand.
-        void use();
+        /// The name of the program, to be made current through GlState::use_program.
+        GLuint id() const { return _id; }
 
         // TODO: This kinda breaks encapsulation, but this class needs a redesign in any case
         GLint get_uniform_loc(const std::string & name) const;
 
+        /// Assigns the uniform block with the given name to the given uniform buffer binding point.
+        /// Does nothing if the program has no active block with the name. The program must have been linked.
+        void bind_uniform_block(const std::string & name, GLuint binding);
+
         void set_mat3_uniform(GLint location, const float * value);
         void set_mat4_uniform(GLint location, const float * value);
         void set_vec3_uniform(GLint location, const float * value);
         void set_float_uniform(GLint location, float value);
+        void set_int_uniform(GLint location, int value);
 
     private:
         ShaderProgram() : _id(0) {}
 
         GLuint _id;
+        friend class ProgramCache;
     };
 }
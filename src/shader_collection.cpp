@@ -5,242 +5,450 @@
 // folder structure like merely3d/configured/
 #include <shaders.hpp>
 
+#include "frame_uniforms.hpp"
+#include "gl_instance_texture.hpp"
+#include "instance_data.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <initializer_list>
+#include <string>
+
 namespace merely3d
 {
-    void set_current_shader_object_color(ShaderProgram & program, GLint loc, const Color & color)
+    /// Inserts the given text right after the #version directive of the given shader source.
+    static std::string insert_after_version(const std::string & source, const std::string & text)
     {
-        auto color_array = color.into_array();
-        program.set_vec3_uniform(loc, color_array.data());
+        const auto version_line_end = source.find('\n', source.find("#version"));
+        assert(version_line_end != std::string::npos);
+
+        // Restore the line numbering of the source, so that compile errors refer to the correct lines
+        const auto next_line = std::count(source.begin(), source.begin() + version_line_end, '\n') + 2;
+        return source.substr(0, version_line_end + 1)
+             + text
+             + "\n#line " + std::to_string(next_line) + "\n"
+             + source.substr(version_line_end + 1);
     }
 
-    void set_current_shader_model_transform(ShaderProgram & program, GLint loc, const Eigen::Affine3f & model)
+    /// Inserts the declaration of the FrameUniforms block (see frame_uniforms.glsl) into the given shader source.
+    static std::string with_frame_uniforms(const std::string & source)
     {
-        program.set_mat4_uniform(loc, model.data());
+        return insert_after_version(source, shaders::frame_uniforms);
     }
 
-    void set_current_shader_view_transform(ShaderProgram & program, GLint loc, const Eigen::Affine3f & view)
+    /// Inserts the given declarations (e.g. defines), followed by the declarations of both the FrameUniforms block
+    /// and the per-instance data (see instance_attributes.glsl), into the given vertex shader source.
+    static std::string with_instance_attributes(const std::string & source,
+                                                InstanceSource instance_source,
+                                                const std::string & declarations = std::string())
     {
-        program.set_mat4_uniform(loc, view.data());
+        std::string text = declarations + shaders::frame_uniforms;
+        if (instance_source == InstanceSource::Texture)
+        {
+            text += "\n#define INSTANCE_TEXTURE\n#define FLOATS_PER_INSTANCE " + std::to_string(FLOATS_PER_INSTANCE) + "\n";
+        }
+        text += shaders::instance_attributes;
+        return insert_after_version(source, text);
     }
 
-    void set_current_shader_projection_transform(ShaderProgram & program, GLint loc, const Eigen::Matrix4f & projection)
+    /// Returns the defines that enable the given shading features in default_vertex.glsl, edges_geometry.glsl,
+    /// default_fragment.glsl and mesh_vertex.glsl.
+    static std::string shading_defines(unsigned int features)
     {
-        program.set_mat4_uniform(loc, projection.data());
+        std::string defines;
+        if (features & SHADING_PATTERN)
+        {
+            defines += "#define PATTERN\n";
+        }
+        if (features & SHADING_LIGHTING)
+        {
+            defines += "#define LIGHTING\n";
+        }
+        if (features & SHADING_SPECULAR)
+        {
+            defines += "#define SPECULAR\n";
+        }
+        if (features & SHADING_EDGES)
+        {
+            defines += "#define EDGES\n";
+            defines += "#define EDGE_MODE_FILLED " + std::to_string(EDGE_MODE_FILLED) + "\n";
+            defines += "#define EDGE_MODE_WIREFRAME " + std::to_string(EDGE_MODE_WIREFRAME) + "\n";
+        }
+        return defines;
+    }
+
+    /// Declares the MeshVertex interface block (see mesh_vertex.glsl) with the given storage qualifier
+    /// and instance name.
+    static std::string mesh_vertex_block(const std::string & qualifier, const std::string & name)
+    {
+        return qualifier + " MeshVertex\n{\n" + shaders::mesh_vertex + "\n} " + name + ";\n";
     }
 
-    void MeshShader::set_normal_transform(const Eigen::Matrix3f & transform)
+    /// Variants with edges pass the triangles through a geometry shader (see edges_geometry.glsl),
+    /// which adds the barycentric coordinates of the vertices.
+    static ProgramSources mesh_sources(InstanceSource instance_source, unsigned int features)
     {
-        shader.set_mat3_uniform(normal_transform_loc, transform.data());
+        const auto defines = shading_defines(features);
+        const auto vertex = with_instance_attributes(shaders::default_vertex, instance_source,
+                                                     defines + mesh_vertex_block("out", "mesh"));
+        const auto fragment = insert_after_version(shaders::default_fragment,
+                                                   defines + shaders::frame_uniforms + mesh_vertex_block("in", "mesh"));
+        if (features & SHADING_EDGES)
+        {
+            const auto geometry = insert_after_version(shaders::edges_geometry,
+                                                       defines
+                                                       + mesh_vertex_block("in", "vertices[]")
+                                                       + mesh_vertex_block("out", "mesh"));
+            return ProgramSources(vertex, fragment, geometry);
+        }
+        return ProgramSources(vertex, fragment);
     }
 
-    void MeshShader::set_reference_transform(const Eigen::Matrix3f & transform)
+    /// Specular highlights are part of the lighting, so there are no variants with one but not the other.
+    static unsigned int valid_shading_features(unsigned int features)
     {
-        shader.set_mat3_uniform(reference_transform_loc, transform.data());
+        return (features & SHADING_LIGHTING) ? features : features & ~SHADING_SPECULAR;
     }
 
-    void MeshShader::set_light_color(const Color & color)
+    static ProgramSources depth_sources(InstanceSource instance_source)
     {
-        const auto color_array = color.into_array();
-        shader.set_vec3_uniform(light_color_loc, color_array.data());
+        return ProgramSources(with_instance_attributes(shaders::depth_vertex, instance_source),
+                              shaders::depth_fragment);
     }
 
-    void MeshShader::set_light_direction(const Eigen::Vector3f & direction)
+    static ProgramSources line_sources()
     {
-        shader.set_vec3_uniform(light_dir_loc, direction.data());
+        return ProgramSources(with_frame_uniforms(shaders::basic_vertex), shaders::basic_fragment);
     }
 
-    void MeshShader::set_camera_position(const Eigen::Vector3f & position)
+    static ProgramSources particle_sources()
     {
-        shader.set_vec3_uniform(camera_pos_loc, position.data());
+        return ProgramSources(with_frame_uniforms(shaders::particle_vertex),
+                              with_frame_uniforms(shaders::particle_fragment),
+                              with_frame_uniforms(shaders::particle_geometry));
     }
 
-    void MeshShader::set_pattern_grid_size(float size)
+    static ProgramSources density_splat_sources()
     {
-        if (size < 0)
+        return ProgramSources(with_frame_uniforms(shaders::density_vertex), shaders::density_fragment);
+    }
+
+    static ProgramSources density_resolve_sources()
+    {
+        return ProgramSources(shaders::fullscreen_vertex, shaders::density_resolve_fragment);
+    }
+
+    static ProgramSources particle_upsample_sources()
+    {
+        return ProgramSources(shaders::fullscreen_vertex, with_frame_uniforms(shaders::particle_upsample_fragment));
+    }
+
+    /// Links a program for instanced geometry, with instances from the given source.
+    static ShaderProgram create_instanced_program(ProgramCache & cache,
+                                                  const ProgramSources & sources,
+                                                  InstanceSource instance_source)
+    {
+        auto program = cache.link(sources);
+        program.bind_uniform_block(FRAME_UNIFORMS_BLOCK, FRAME_UNIFORMS_BINDING);
+
+        if (instance_source == InstanceSource::Texture)
         {
-            throw std::invalid_argument("Pattern grid size must be non-negative.");
+            // The samplers never change, so they are set once and for all, outside of any GlState. Programs are
+            // created while rendering, so the current program is restored for the GlState to remain correct
+            GLint current_program = 0;
+            glGetIntegerv(GL_CURRENT_PROGRAM, &current_program);
+            glUseProgram(program.id());
+            program.set_int_uniform(program.get_uniform_loc("instance_records"), INSTANCE_TEXTURE_UNIT);
+            program.set_int_uniform(program.get_uniform_loc("previous_instance_records"),
+                                    PREVIOUS_INSTANCE_TEXTURE_UNIT);
+            glUseProgram(static_cast<GLuint>(current_program));
         }
 
-        shader.set_float_uniform(pattern_grid_size_loc, size);
+        return program;
     }
 
-    void MeshShader::set_model_transform(const Eigen::Affine3f & model)
+    /// Returns the given shader, creating it first if necessary.
+    template <typename ShaderType, typename Create>
+    static ShaderType & created(std::unique_ptr<ShaderType> & shader, Create && create)
     {
-        set_current_shader_model_transform(shader, model_loc, model);
+        if (!shader)
+        {
+            shader.reset(new ShaderType(create()));
+        }
+        return *shader;
     }
 
-    void MeshShader::set_view_transform(const Eigen::Affine3f & view)
+    void MeshShader::use(GlState & state)
     {
-        set_current_shader_view_transform(shader, view_loc, view);
+        state.use_program(shader.id());
     }
 
-    void MeshShader::set_projection_transform(const Eigen::Matrix4f & projection)
+    void MeshShader::set_instance_base(int base)
     {
-        set_current_shader_projection_transform(shader, projection_loc, projection);
+        shader.set_int_uniform(instance_base_loc, base);
     }
 
-    void MeshShader::set_object_color(const Color & color)
+    void MeshShader::set_interpolation(float interpolation)
     {
-        set_current_shader_object_color(shader, object_color_loc, color);
+        shader.set_float_uniform(interpolation_loc, interpolation);
     }
 
-    void MeshShader::use()
+    MeshShader MeshShader::create_in_context(ProgramCache & cache,
+                                             InstanceSource instance_source,
+                                             unsigned int shading_features)
     {
-        shader.use();
+        auto program = create_instanced_program(cache, mesh_sources(instance_source, shading_features), instance_source);
+        auto shader = MeshShader(std::move(program));
+        shader.instance_base_loc = shader.shader.get_uniform_loc("instance_base");
+        shader.interpolation_loc = shader.shader.get_uniform_loc("instance_interpolation");
+        return shader;
     }
 
-    MeshShader MeshShader::create_in_context()
+    void DepthShader::use(GlState & state)
     {
-        const auto fragment_shader = Shader::compile(ShaderType::Fragment, shaders::default_fragment);
-        const auto vertex_shader = Shader::compile(ShaderType::Vertex, shaders::default_vertex);
-        auto mesh_program = ShaderProgram::create();
-        mesh_program.attach(fragment_shader);
-        mesh_program.attach(vertex_shader);
-        mesh_program.link();
+        state.use_program(shader.id());
+    }
 
-        auto shader = MeshShader(std::move(mesh_program));
+    void DepthShader::set_instance_base(int base)
+    {
+        shader.set_int_uniform(instance_base_loc, base);
+    }
 
-        shader.projection_loc = shader.shader.get_uniform_loc("projection");
-        shader.model_loc = shader.shader.get_uniform_loc("model");
-        shader.view_loc = shader.shader.get_uniform_loc("view");
-        shader.object_color_loc = shader.shader.get_uniform_loc("object_color");
-        shader.light_color_loc = shader.shader.get_uniform_loc("light_color");
-        shader.light_dir_loc = shader.shader.get_uniform_loc("light_dir");
-        shader.normal_transform_loc = shader.shader.get_uniform_loc("normal_transform");
-        shader.camera_pos_loc = shader.shader.get_uniform_loc("view_pos");
-        shader.reference_transform_loc = shader.shader.get_uniform_loc("reference_transform");
-        shader.pattern_grid_size_loc = shader.shader.get_uniform_loc("pattern_grid_size");
+    void DepthShader::set_interpolation(float interpolation)
+    {
+        shader.set_float_uniform(interpolation_loc, interpolation);
+    }
 
+    DepthShader DepthShader::create_in_context(ProgramCache & cache, InstanceSource instance_source)
+    {
+        auto program = create_instanced_program(cache, depth_sources(instance_source), instance_source);
+        auto shader = DepthShader(std::move(program));
+        shader.instance_base_loc = shader.shader.get_uniform_loc("instance_base");
+        shader.interpolation_loc = shader.shader.get_uniform_loc("instance_interpolation");
         return shader;
     }
 
-    void LineShader::set_model_transform(const Eigen::Affine3f & model)
+    void LineShader::use(GlState & state)
     {
-        set_current_shader_model_transform(shader, model_loc, model);
+        state.use_program(shader.id());
     }
 
-    void LineShader::set_view_transform(const Eigen::Affine3f & view)
+    LineShader LineShader::create_in_context(ProgramCache & cache)
     {
-        set_current_shader_view_transform(shader, view_loc, view);
+        auto line_program = cache.link(line_sources());
+        line_program.bind_uniform_block(FRAME_UNIFORMS_BLOCK, FRAME_UNIFORMS_BINDING);
+
+        return LineShader(std::move(line_program));
     }
 
-    void LineShader::set_projection_transform(const Eigen::Matrix4f & projection)
+
+    void ParticleShader::set_viewport(const GlViewport & viewport)
     {
-        set_current_shader_projection_transform(shader, projection_loc, projection);
+        shader.set_float_uniform(viewport_x_loc, static_cast<float>(viewport.x));
+        shader.set_float_uniform(viewport_y_loc, static_cast<float>(viewport.y));
+        shader.set_float_uniform(viewport_width_loc, static_cast<float>(viewport.width));
+        shader.set_float_uniform(viewport_height_loc, static_cast<float>(viewport.height));
     }
 
-    void LineShader::set_object_color(const Color & color)
+    void ParticleShader::set_scalar_coloring(bool enabled, int colormap_unit)
     {
-        set_current_shader_object_color(shader, object_color_loc, color);
+        shader.set_int_uniform(use_colormap_loc, enabled ? 1 : 0);
+        shader.set_int_uniform(colormap_loc, colormap_unit);
     }
 
-    void LineShader::use()
+    void ParticleShader::set_scalar_range(float min, float max)
     {
-        shader.use();
+        shader.set_float_uniform(scalar_min_loc, min);
+        shader.set_float_uniform(scalar_max_loc, max);
     }
 
-    LineShader LineShader::create_in_context()
+    void ParticleShader::set_interpolation(float interpolation)
     {
-        const auto basic_fragment_shader = Shader::compile(ShaderType::Fragment, shaders::basic_fragment);
-        const auto basic_vertex_shader = Shader::compile(ShaderType::Vertex, shaders::basic_vertex);
-        auto line_program = ShaderProgram::create();
-        line_program.attach(basic_fragment_shader);
-        line_program.attach(basic_vertex_shader);
-        line_program.link();
+        shader.set_float_uniform(interpolation_loc, interpolation);
+    }
+
+    void ParticleShader::use(GlState & state)
+    {
+        state.use_program(shader.id());
+    }
+
+    ParticleShader ParticleShader::create_in_context(ProgramCache & cache) {
+
+        auto particle_program = cache.link(particle_sources());
+        particle_program.bind_uniform_block(FRAME_UNIFORMS_BLOCK, FRAME_UNIFORMS_BINDING);
 
-        auto shader = LineShader(std::move(line_program));
+        auto shader = ParticleShader(std::move(particle_program));
 
-        shader.projection_loc = shader.shader.get_uniform_loc("projection");
-        shader.model_loc = shader.shader.get_uniform_loc("model");
-        shader.view_loc = shader.shader.get_uniform_loc("view");
-        shader.object_color_loc = shader.shader.get_uniform_loc("object_color");
+        shader.viewport_x_loc = shader.shader.get_uniform_loc("viewport_x");
+        shader.viewport_y_loc = shader.shader.get_uniform_loc("viewport_y");
+        shader.viewport_width_loc = shader.shader.get_uniform_loc("viewport_width");
+        shader.viewport_height_loc = shader.shader.get_uniform_loc("viewport_height");
+        shader.use_colormap_loc = shader.shader.get_uniform_loc("use_colormap");
+        shader.colormap_loc = shader.shader.get_uniform_loc("colormap");
+        shader.scalar_min_loc = shader.shader.get_uniform_loc("scalar_min");
+        shader.scalar_max_loc = shader.shader.get_uniform_loc("scalar_max");
+        shader.interpolation_loc = shader.shader.get_uniform_loc("interpolation");
 
         return shader;
     }
 
+    void DensitySplatShader::set_viewport_height(float height)
+    {
+        shader.set_float_uniform(viewport_height_loc, height);
+    }
 
-    void ParticleShader::set_view_transform(const Eigen::Affine3f &view)
+    void DensitySplatShader::set_interpolation(float interpolation)
     {
-        set_current_shader_view_transform(shader, view_loc, view);
+        shader.set_float_uniform(interpolation_loc, interpolation);
     }
 
-    void ParticleShader::set_projection_transform(const Eigen::Matrix4f &projection)
+    void DensitySplatShader::use(GlState & state)
     {
-        set_current_shader_projection_transform(shader, projection_loc, projection);
-        const Eigen::Matrix4f inv_projection = projection.inverse();
-        shader.set_mat4_uniform(inv_projection_loc, inv_projection.data());
+        state.use_program(shader.id());
     }
 
-    void ParticleShader::set_viewport_dimensions(float width, float height)
+    DensitySplatShader DensitySplatShader::create_in_context(ProgramCache & cache)
     {
-        shader.set_float_uniform(viewport_width_loc, width);
-        shader.set_float_uniform(viewport_height_loc, height);
+        auto program = cache.link(density_splat_sources());
+        program.bind_uniform_block(FRAME_UNIFORMS_BLOCK, FRAME_UNIFORMS_BINDING);
+
+        auto shader = DensitySplatShader(std::move(program));
+
+        shader.viewport_height_loc = shader.shader.get_uniform_loc("viewport_height");
+        shader.interpolation_loc = shader.shader.get_uniform_loc("interpolation");
+
+        return shader;
     }
 
-    void ParticleShader::set_near_plane_dist(float dist)
+    void DensityResolveShader::set_texture_units(int density_unit, int colormap_unit)
     {
-        shader.set_float_uniform(near_plane_dist_loc, dist);
+        shader.set_int_uniform(density_texture_loc, density_unit);
+        shader.set_int_uniform(colormap_loc, colormap_unit);
     }
 
-    void ParticleShader::set_light_color(const Color & color)
+    void DensityResolveShader::set_exposure(float exposure)
     {
-        const auto color_array = color.into_array();
-        shader.set_vec3_uniform(light_color_loc, color_array.data());
+        shader.set_float_uniform(exposure_loc, exposure);
     }
 
-    void ParticleShader::set_light_eye_direction(const Eigen::Vector3f & direction)
+    void DensityResolveShader::set_resolution_divisor(int divisor)
     {
-        shader.set_vec3_uniform(light_eye_dir_loc, direction.data());
+        shader.set_int_uniform(resolution_divisor_loc, divisor);
     }
 
-    void ParticleShader::use()
+    void DensityResolveShader::use(GlState & state)
     {
-        shader.use();
+        state.use_program(shader.id());
     }
 
-    ParticleShader ParticleShader::create_in_context() {
+    DensityResolveShader DensityResolveShader::create_in_context(ProgramCache & cache)
+    {
+        auto program = cache.link(density_resolve_sources());
 
-        const auto particle_fragment_shader = Shader::compile(ShaderType::Fragment, shaders::particle_fragment);
-        const auto particle__vertex_shader = Shader::compile(ShaderType::Vertex, shaders::particle_vertex);
-        const auto particle_geometry_shader = Shader::compile(ShaderType::Geometry, shaders::particle_geometry);
-        auto line_program = ShaderProgram::create();
-        line_program.attach(particle_fragment_shader);
-        line_program.attach(particle__vertex_shader);
-        line_program.attach(particle_geometry_shader);
-        line_program.link();
+        auto shader = DensityResolveShader(std::move(program));
 
-        auto shader = ParticleShader(std::move(line_program));
+        shader.density_texture_loc = shader.shader.get_uniform_loc("density_texture");
+        shader.colormap_loc = shader.shader.get_uniform_loc("colormap");
+        shader.exposure_loc = shader.shader.get_uniform_loc("exposure");
+        shader.resolution_divisor_loc = shader.shader.get_uniform_loc("resolution_divisor");
 
-        shader.projection_loc = shader.shader.get_uniform_loc("projection");
-        shader.inv_projection_loc = shader.shader.get_uniform_loc("inv_projection");
-        shader.view_loc = shader.shader.get_uniform_loc("view");
-        shader.viewport_width_loc = shader.shader.get_uniform_loc("viewport_width");
-        shader.viewport_height_loc = shader.shader.get_uniform_loc("viewport_height");
-        shader.near_plane_dist_loc = shader.shader.get_uniform_loc("near_plane_dist");
-        shader.light_color_loc = shader.shader.get_uniform_loc("light_color");
-        shader.light_eye_dir_loc = shader.shader.get_uniform_loc("light_dir_eye");
+        return shader;
+    }
+
+    void ParticleUpsampleShader::set_texture_units(int color_unit, int depth_unit)
+    {
+        shader.set_int_uniform(color_texture_loc, color_unit);
+        shader.set_int_uniform(depth_texture_loc, depth_unit);
+    }
+
+    void ParticleUpsampleShader::set_resolution_divisor(int divisor)
+    {
+        shader.set_int_uniform(resolution_divisor_loc, divisor);
+    }
+
+    void ParticleUpsampleShader::use(GlState & state)
+    {
+        state.use_program(shader.id());
+    }
+
+    ParticleUpsampleShader ParticleUpsampleShader::create_in_context(ProgramCache & cache)
+    {
+        auto program = cache.link(particle_upsample_sources());
+        program.bind_uniform_block(FRAME_UNIFORMS_BLOCK, FRAME_UNIFORMS_BINDING);
+
+        auto shader = ParticleUpsampleShader(std::move(program));
+
+        shader.color_texture_loc = shader.shader.get_uniform_loc("color_texture");
+        shader.depth_texture_loc = shader.shader.get_uniform_loc("depth_texture");
+        shader.resolution_divisor_loc = shader.shader.get_uniform_loc("resolution_divisor");
 
         return shader;
     }
 
-    MeshShader & ShaderCollection::mesh_shader()
+    MeshShader & ShaderCollection::mesh_shader(InstanceSource instance_source, unsigned int shading_features)
     {
-        return _mesh_shader;
+        const auto features = valid_shading_features(shading_features & SHADING_ALL);
+        auto & variants = instance_source == InstanceSource::Texture ? _textured_mesh_shaders : _mesh_shaders;
+        return created(variants[features], [&]
+        {
+            return MeshShader::create_in_context(_cache, instance_source, features);
+        });
     }
 
     LineShader & ShaderCollection::line_shader()
     {
-        return _line_shader;
+        return created(_line_shader, [&] { return LineShader::create_in_context(_cache); });
+    }
+
+    DepthShader & ShaderCollection::depth_shader(InstanceSource instance_source)
+    {
+        auto & shader = instance_source == InstanceSource::Texture ? _textured_depth_shader : _depth_shader;
+        return created(shader, [&] { return DepthShader::create_in_context(_cache, instance_source); });
+    }
+
+    ParticleShader & ShaderCollection::particle_shader()
+    {
+        return created(_particle_shader, [&] { return ParticleShader::create_in_context(_cache); });
+    }
+
+    DensitySplatShader & ShaderCollection::density_splat_shader()
+    {
+        return created(_density_splat_shader, [&] { return DensitySplatShader::create_in_context(_cache); });
     }
 
-    ParticleShader &ShaderCollection::particle_shader() {
-        return _particle_shader;
+    DensityResolveShader & ShaderCollection::density_resolve_shader()
+    {
+        return created(_density_resolve_shader, [&] { return DensityResolveShader::create_in_context(_cache); });
     }
 
-    ShaderCollection ShaderCollection::create_in_context()
+    ParticleUpsampleShader & ShaderCollection::particle_upsample_shader()
     {
-        return { MeshShader::create_in_context(),
-                 LineShader::create_in_context(),
-                 ParticleShader::create_in_context() };
+        return created(_particle_upsample_shader, [&] { return ParticleUpsampleShader::create_in_context(_cache); });
+    }
+
+    ShaderCollection ShaderCollection::create_in_context(ProgramCache && cache)
+    {
+        // Without parallel compilation, each program is compiled when it is first used. Otherwise, all programs
+        // are prepared right away, so that the driver compiles them in the background until they are needed
+        if (cache.parallel())
+        {
+            for (const auto instance_source : { InstanceSource::Attributes, InstanceSource::Texture })
+            {
+                for (unsigned int features = 0; features <= SHADING_ALL; ++features)
+                {
+                    if (valid_shading_features(features) == features)
+                    {
+                        cache.prepare(mesh_sources(instance_source, features));
+                    }
+                }
+                cache.prepare(depth_sources(instance_source));
+            }
+            cache.prepare(line_sources());
+            cache.prepare(particle_sources());
+            cache.prepare(density_splat_sources());
+            cache.prepare(density_resolve_sources());
+            cache.prepare(particle_upsample_sources());
+        }
+        return ShaderCollection(std::move(cache));
     }
 }
@@ -1,74 +1,101 @@
 #pragma once
 
-#include <Eigen/Dense>
-
-#include <merely3d/color.hpp>
-
 #include "shader.hpp"
+#include "gl_state.hpp"
+#include "program_cache.hpp"
+#include "instance_data.hpp"
+
+#include <memory>
 
 // TODO: Remove this, can we somehow forward-declare a typedef?
 typedef int GLint;
 
 namespace merely3d
 {
+    /// Where the shaders of instanced geometry read the records of their instances from.
+    enum class InstanceSource
+    {
+        /// Per-instance vertex attributes, bound through a vertex array (see GlInstanceBuffer).
+        Attributes,
+
+        /// A buffer texture, starting at the record given by set_instance_base (see GlInstanceTexture).
+        Texture
+    };
+
+    /// Renders instances of primitives and meshes with lighting, as well as wireframes and edges.
+    ///
+    /// Transforms and materials are given by per-instance records (see InstanceSource). The shader is
+    /// compiled in variants with subsets of the shading features (see SHADING_PATTERN and friends),
+    /// of which a variant can only render instances that use no other features. Variants with SHADING_EDGES
+    /// draw wireframes and filled instances alike, and must be drawn with blending enabled and face culling disabled.
     class MeshShader
     {
     public:
-        void set_model_transform(const Eigen::Affine3f & model);
-        void set_view_transform(const Eigen::Affine3f & view);
-        void set_projection_transform(const Eigen::Matrix4f & projection);
-        void set_normal_transform(const Eigen::Matrix3f & transform);
-        void set_reference_transform(const Eigen::Matrix3f & transform);
-        void set_object_color(const Color & color);
-        void set_light_color(const Color & color);
-        void set_light_direction(const Eigen::Vector3f & direction);
-        void set_camera_position(const Eigen::Vector3f & position);
-        void set_pattern_grid_size(float size);
+        /// Sets the index of the first instance record of the next draw. Only used with InstanceSource::Texture.
+        void set_instance_base(int base);
 
-        void use();
+        /// Blends the transforms of the instances of the next draw between their previous (0)
+        /// and their current (1) snapshot (see GlInstanceBuffer).
+        void set_interpolation(float interpolation);
 
-        static MeshShader create_in_context();
+        void use(GlState & state);
+
+        static MeshShader create_in_context(ProgramCache & cache,
+                                            InstanceSource instance_source,
+                                            unsigned int shading_features = SHADING_ALL);
 
     private:
         explicit MeshShader(ShaderProgram && shader)
             : shader(std::move(shader))
         {}
 
-        GLint projection_loc = 0;
-        GLint model_loc = 0;
-        GLint view_loc = 0;
-        GLint normal_transform_loc = 0;
-        GLint object_color_loc = 0;
-        GLint light_color_loc = 0;
-        GLint light_dir_loc = 0;
-        GLint camera_pos_loc = 0;
-        GLint reference_transform_loc = 0;
-        GLint pattern_grid_size_loc = 0;
+        GLint instance_base_loc = -1;
+        GLint interpolation_loc = -1;
 
         ShaderProgram shader;
     };
 
-    class LineShader
+    /// Writes only the depth of instances of primitives and meshes, for use in a depth pre-pass.
+    ///
+    /// Produces exactly the same depth as the variants of MeshShader without edges.
+    class DepthShader
     {
     public:
-        void set_model_transform(const Eigen::Affine3f & model);
-        void set_view_transform(const Eigen::Affine3f & view);
-        void set_projection_transform(const Eigen::Matrix4f & projection);
-        void set_object_color(const Color & color);
+        /// Sets the index of the first instance record of the next draw. Only used with InstanceSource::Texture.
+        void set_instance_base(int base);
 
-        void use();
+        /// Blends the transforms of the instances of the next draw between their previous (0)
+        /// and their current (1) snapshot (see GlInstanceBuffer).
+        void set_interpolation(float interpolation);
 
-        static LineShader create_in_context();
+        void use(GlState & state);
+
+        static DepthShader create_in_context(ProgramCache & cache, InstanceSource instance_source);
 
     private:
-        explicit LineShader(ShaderProgram && shader)
+        explicit DepthShader(ShaderProgram && shader)
             : shader(std::move(shader))
         {}
 
-        GLint projection_loc = 0;
-        GLint model_loc = 0;
-        GLint view_loc = 0;
-        GLint object_color_loc = 0;
+        GLint instance_base_loc = -1;
+        GLint interpolation_loc = -1;
+
+        ShaderProgram shader;
+    };
+
+    /// Renders instances of lines, whose end points and colors are given by
+    /// per-instance attributes (see GlLine).
+    class LineShader
+    {
+    public:
+        void use(GlState & state);
+
+        static LineShader create_in_context(ProgramCache & cache);
+
+    private:
+        explicit LineShader(ShaderProgram && shader)
+            : shader(std::move(shader))
+        {}
 
         ShaderProgram shader;
     };
@@ -76,55 +103,147 @@ namespace merely3d
     class ParticleShader
     {
     public:
-        void set_view_transform(const Eigen::Affine3f & view);
-        void set_projection_transform(const Eigen::Matrix4f & projection);
-        void set_viewport_dimensions(float width, float height);
-        void set_near_plane_dist(float dist);
-        void set_light_color(const Color & color);
-        void set_light_eye_direction(const Eigen::Vector3f & direction);
+        /// Sets the viewport that the particles are rendered into, from which rays are cast through the fragments.
+        void set_viewport(const GlViewport & viewport);
+
+        /// Enables or disables coloring of particles by mapping their scalar attribute
+        /// through the colormap bound to the given texture unit.
+        void set_scalar_coloring(bool enabled, int colormap_unit);
+        void set_scalar_range(float min, float max);
+        void set_interpolation(float interpolation);
 
-        void use();
+        void use(GlState & state);
 
-        static ParticleShader create_in_context();
+        static ParticleShader create_in_context(ProgramCache & cache);
 
     private:
         explicit ParticleShader(ShaderProgram && shader)
             : shader(std::move(shader))
         {}
 
-        GLint projection_loc = 0;
-        GLint inv_projection_loc = 0;
-        GLint view_loc = 0;
+        GLint viewport_x_loc = 0;
+        GLint viewport_y_loc = 0;
         GLint viewport_width_loc = 0;
         GLint viewport_height_loc = 0;
-        GLint near_plane_dist_loc = 0;
-        GLint light_color_loc = 0;
-        GLint light_eye_dir_loc = 0;
+        GLint use_colormap_loc = 0;
+        GLint colormap_loc = 0;
+        GLint scalar_min_loc = 0;
+        GLint scalar_max_loc = 0;
+        GLint interpolation_loc = 0;
 
         ShaderProgram shader;
     };
 
-    class ShaderCollection
+    /// Splats particles as point sprites into a density buffer.
+    class DensitySplatShader
+    {
+    public:
+        void set_viewport_height(float height);
+        void set_interpolation(float interpolation);
+
+        void use(GlState & state);
+
+        static DensitySplatShader create_in_context(ProgramCache & cache);
+
+    private:
+        explicit DensitySplatShader(ShaderProgram && shader)
+            : shader(std::move(shader))
+        {}
+
+        GLint viewport_height_loc = 0;
+        GLint interpolation_loc = 0;
+
+        ShaderProgram shader;
+    };
+
+    /// Maps an accumulated density buffer to colors in a full-screen pass.
+    class DensityResolveShader
     {
     public:
-        MeshShader &     mesh_shader();
-        LineShader &     line_shader();
-        ParticleShader & particle_shader();
+        /// Sets the texture units from which the density and colormap textures are sampled.
+        void set_texture_units(int density_unit, int colormap_unit);
+        void set_exposure(float exposure);
+        void set_resolution_divisor(int divisor);
+
+        void use(GlState & state);
+
+        static DensityResolveShader create_in_context(ProgramCache & cache);
+
+    private:
+        explicit DensityResolveShader(ShaderProgram && shader)
+            : shader(std::move(shader))
+        {}
+
+        GLint density_texture_loc = 0;
+        GLint colormap_loc = 0;
+        GLint exposure_loc = 0;
+        GLint resolution_divisor_loc = 0;
+
+        ShaderProgram shader;
+    };
 
-        static ShaderCollection create_in_context();
+    class ParticleUpsampleShader
+    {
+    public:
+        /// Sets the texture units from which the reduced-resolution color and depth textures are sampled.
+        void set_texture_units(int color_unit, int depth_unit);
+        void set_resolution_divisor(int divisor);
+
+        void use(GlState & state);
+
+        static ParticleUpsampleShader create_in_context(ProgramCache & cache);
+
+    private:
+        explicit ParticleUpsampleShader(ShaderProgram && shader)
+            : shader(std::move(shader))
+        {}
+
+        GLint color_texture_loc = 0;
+        GLint depth_texture_loc = 0;
+        GLint resolution_divisor_loc = 0;
+
+        ShaderProgram shader;
+    };
+
+    /// The shader programs used by the renderers.
+    ///
+    /// Camera and lighting data is not set per program, but read by all programs from a single uniform buffer
+    /// at FRAME_UNIFORMS_BINDING, which must be written before drawing (see FrameUniformData).
+    class ShaderCollection
+    {
+    public:
+        /// The variant of the mesh shader with only the given shading features, which is the cheapest variant
+        /// for instances that use no other features (see shading_features).
+        MeshShader &            mesh_shader(InstanceSource instance_source = InstanceSource::Attributes,
+                                            unsigned int shading_features = SHADING_ALL);
+        LineShader &            line_shader();
+        DepthShader &           depth_shader(InstanceSource instance_source = InstanceSource::Attributes);
+        ParticleShader &        particle_shader();
+        DensitySplatShader &    density_splat_shader();
+        DensityResolveShader &  density_resolve_shader();
+        ParticleUpsampleShader & particle_upsample_shader();
+
+        /// Creates a collection whose programs are linked through the given cache. Each program is created
+        /// when it is first used, so that no time is spent on programs that are never used.
+        static ShaderCollection create_in_context(ProgramCache && cache);
 
     private:
-        ShaderCollection(MeshShader && mesh_shader,
-                         LineShader && line_shader,
-                         ParticleShader && particle_shader)
-            : _mesh_shader(std::move(mesh_shader)),
-              _line_shader(std::move(line_shader)),
-              _particle_shader(std::move(particle_shader))
+        explicit ShaderCollection(ProgramCache && cache)
+            : _cache(std::move(cache))
         {}
 
-        MeshShader      _mesh_shader;
-        LineShader      _line_shader;
-        ParticleShader  _particle_shader;
+        ProgramCache                             _cache;
+
+        // The variants of the mesh shader, by shading features
+        std::unique_ptr<MeshShader>              _mesh_shaders[SHADING_ALL + 1];
+        std::unique_ptr<MeshShader>              _textured_mesh_shaders[SHADING_ALL + 1];
+        std::unique_ptr<LineShader>              _line_shader;
+        std::unique_ptr<DepthShader>             _depth_shader;
+        std::unique_ptr<DepthShader>             _textured_depth_shader;
+        std::unique_ptr<ParticleShader>          _particle_shader;
+        std::unique_ptr<DensitySplatShader>      _density_splat_shader;
+        std::unique_ptr<DensityResolveShader>    _density_resolve_shader;
+        std::unique_ptr<ParticleUpsampleShader>  _particle_upsample_shader;
     };
 
 
@@ -0,0 +1,56 @@
+#include "shared_resources.hpp"
+
+#include <cassert>
+
+namespace merely3d
+{
+    std::shared_ptr<SharedResources> SharedResources::create_in_context(const std::string & program_cache_directory,
+                                                                        GLADloadproc loader)
+    {
+        // Generating the primitives takes a while, so it is started first, and overlaps with compiling the shaders
+        const auto primitive_geometry = PrimitiveGeometry::generate_async();
+        auto program_cache = ProgramCache::create_in_context(program_cache_directory, loader);
+        return std::shared_ptr<SharedResources>(
+                    new SharedResources(ShaderCollection::create_in_context(std::move(program_cache)),
+                                        primitive_geometry,
+                                        load_multi_draw_elements_indirect(loader)));
+    }
+
+    SharedResources::~SharedResources()
+    {
+        // The renderers that used the resources are gone, so this releases the arena and the primitives into the pile
+        _mesh_cache.reset();
+        _cube.reset();
+        _rectangle.reset();
+        _sphere.reset();
+        _gc.release_all();
+    }
+
+    const GlPrimitive & SharedResources::primitive(detail::SceneShape shape)
+    {
+        std::unique_ptr<GlPrimitive> * slot = nullptr;
+        switch (shape)
+        {
+            case detail::SceneShape::Box: slot = &_cube; break;
+            case detail::SceneShape::Rectangle: slot = &_rectangle; break;
+            case detail::SceneShape::Sphere: slot = &_sphere; break;
+            case detail::SceneShape::Mesh: break;
+        }
+        assert(slot && "Meshes are not primitives");
+
+        if (!*slot)
+        {
+            slot->reset(new GlPrimitive(GlPrimitive::create(_gc.garbage(), *_primitive_geometry.vertices(shape))));
+        }
+        return **slot;
+    }
+
+    const std::shared_ptr<MeshCache> & SharedResources::mesh_cache()
+    {
+        if (!_mesh_cache)
+        {
+            _mesh_cache = std::make_shared<MeshCache>(MeshCache::create(_gc.garbage()));
+        }
+        return _mesh_cache;
+    }
+}
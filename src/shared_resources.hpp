@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "gl_gc.hpp"
+#include "gl_indirect_draws.hpp"
+#include "gl_primitive.hpp"
+#include "mesh_cache.hpp"
+#include "primitive_geometry.hpp"
+#include "scene_data.hpp"
+#include "shader_collection.hpp"
+
+namespace merely3d
+{
+    /// The resources of a Renderer that may be shared by all renderers whose contexts share objects:
+    /// the shader programs, the vertex buffers of the primitives and the geometry of cached meshes.
+    ///
+    /// Renderers hold the resources through a shared pointer, so they live for as long as any renderer
+    /// that uses them. Since vertex arrays and framebuffers can not be shared between contexts, each renderer
+    /// binds the shared buffers with vertex arrays of its own. Consequently, the shared objects are released
+    /// through a garbage pile of their own, which must never be used for vertex arrays or framebuffers.
+    ///
+    /// All functions must be called with the context of one of the renderers current. Renderers may render
+    /// on different threads at the same time (see WindowGroup), so they hold the lock returned by mutex()
+    /// for as long as they use the resources.
+    class SharedResources
+    {
+    public:
+        SharedResources(const SharedResources & other) = delete;
+        SharedResources & operator=(const SharedResources & other) = delete;
+
+        /// Deletes the shared objects (see GlGarbageCollector::release_all). Since the resources outlive
+        /// the renderers that use them, this happens as the last of them is destroyed, with its context current.
+        ~SharedResources();
+
+        /// Creates the resources in the current context. Like the renderer, the resources are created on first use.
+        /// If a program cache directory is given, linked shader programs are stored there and reused later
+        /// (see ProgramCache), in which case `loader` must look up OpenGL entry points by name. The loader is also
+        /// used to look up the entry points of indirect draws (see GlIndirectDraws), which are not used without it.
+        static std::shared_ptr<SharedResources> create_in_context(const std::string & program_cache_directory,
+                                                                  GLADloadproc loader);
+
+        ShaderCollection & shaders()
+        {
+            return _shaders;
+        }
+
+        const PrimitiveGeometry & primitive_geometry() const
+        {
+            return _primitive_geometry;
+        }
+
+        /// Returns the vertex buffer of the primitive of the given shape, which must not be a mesh,
+        /// creating it if necessary.
+        const GlPrimitive & primitive(detail::SceneShape shape);
+
+        /// glMultiDrawElementsIndirect, or nullptr if the context does not support it.
+        MultiDrawElementsIndirectProc multi_draw_elements_indirect() const
+        {
+            return _multi_draw_elements_indirect;
+        }
+
+        /// Returns the cache of meshes, creating it if necessary.
+        const std::shared_ptr<MeshCache> & mesh_cache();
+
+        /// The lock that serializes the use of the resources by renderers on different threads.
+        std::mutex & mutex()
+        {
+            return _mutex;
+        }
+
+        /// Deletes or recycles the shared objects that have been released (see GlGarbageCollector).
+        /// Called by every renderer at the end of each of its frames.
+        void collect_garbage()
+        {
+            _gc.collect_garbage();
+        }
+
+    private:
+        SharedResources(ShaderCollection && shaders,
+                        const PrimitiveGeometry & primitive_geometry,
+                        MultiDrawElementsIndirectProc multi_draw_elements_indirect)
+            : _shaders(std::move(shaders)),
+              _primitive_geometry(primitive_geometry),
+              _multi_draw_elements_indirect(multi_draw_elements_indirect)
+        {}
+
+        ShaderCollection                _shaders;
+        PrimitiveGeometry               _primitive_geometry;
+        GlGarbageCollector              _gc;
+
+        MultiDrawElementsIndirectProc   _multi_draw_elements_indirect;
+
+        std::unique_ptr<GlPrimitive>    _cube;
+        std::unique_ptr<GlPrimitive>    _rectangle;
+        std::unique_ptr<GlPrimitive>    _sphere;
+
+        std::shared_ptr<MeshCache>      _mesh_cache;
+
+        std::mutex                      _mutex;
+    };
+}
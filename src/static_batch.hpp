@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "instance_data.hpp"
+
+namespace merely3d
+{
+    /// A static batch merges the geometry of many instances into a single vertex buffer, so that
+    /// all of them can be drawn with a single (non-instanced) draw call.
+    ///
+    /// Each vertex of the batch consists of the position and normal of the reference geometry
+    /// (i.e. a unit cube), followed by the index of the record of the instance it belongs to.
+    /// The records themselves are stored once per instance, in an instance texture from which the vertex shader
+    /// fetches the record of each vertex (see GlStaticBatch), so the batch is drawn with the same shaders,
+    /// and transformed in the vertex shader like any other instance.
+    ///
+    /// The index is stored as a float, which represents every index exactly, since a buffer texture
+    /// holds far fewer than 2^24 records.
+    const size_t FLOATS_PER_BATCH_VERTEX = 7;
+
+    /// Instances of a single piece of geometry to be merged into a static batch.
+    struct StaticBatchSource
+    {
+        /// Vertices of the geometry, as positions and normals (see GlPrimitive and GlMeshArena).
+        std::shared_ptr<const std::vector<float>> vertices_and_normals;
+
+        /// Indices of the triangles of the geometry, or null if the vertices form consecutive triangles.
+        std::shared_ptr<const std::vector<unsigned int>> faces;
+
+        /// Packed instance records (see instance_data.hpp).
+        std::vector<float> instances;
+
+        size_t vertex_count() const
+        {
+            const auto vertices_per_instance = faces ? faces->size() : vertices_and_normals->size() / 6;
+            return vertices_per_instance * (instances.size() / FLOATS_PER_INSTANCE);
+        }
+    };
+
+    struct StaticBatchData
+    {
+        /// Vertices of the batch, in the order of the sources and their instances.
+        std::vector<float> vertices;
+        size_t vertex_count;
+
+        /// Instance records of the batch (see instance_data.hpp), in the same order.
+        std::vector<float> instances;
+    };
+
+    /// Appends the vertices of the instances of the given source, whose records start at the given index.
+    inline void append_batch_vertices(std::vector<float> & vertices,
+                                      const StaticBatchSource & source,
+                                      size_t first_instance)
+    {
+        const auto & geometry = *source.vertices_and_normals;
+        const auto num_instances = source.instances.size() / FLOATS_PER_INSTANCE;
+        const auto vertices_per_instance = source.faces ? source.faces->size() : geometry.size() / 6;
+
+        for (size_t i = 0; i < num_instances; ++i)
+        {
+            const auto instance_index = static_cast<float>(first_instance + i);
+            for (size_t v = 0; v < vertices_per_instance; ++v)
+            {
+                const auto index = source.faces ? (*source.faces)[v] : v;
+                assert(6 * index + 6 <= geometry.size());
+                const float * vertex = geometry.data() + 6 * index;
+                vertices.insert(vertices.end(), vertex, vertex + 6);
+                vertices.push_back(instance_index);
+            }
+        }
+    }
+
+    /// Merges the instances of the given sources into a single batch.
+    ///
+    /// Does not depend on any OpenGL state, and may therefore be called on any thread.
+    inline StaticBatchData build_static_batch(const std::vector<StaticBatchSource> & sources)
+    {
+        StaticBatchData batch;
+        batch.vertex_count = 0;
+
+        for (const auto & source : sources)
+        {
+            batch.vertex_count += source.vertex_count();
+        }
+        batch.vertices.reserve(FLOATS_PER_BATCH_VERTEX * batch.vertex_count);
+
+        for (const auto & source : sources)
+        {
+            append_batch_vertices(batch.vertices, source, batch.instances.size() / FLOATS_PER_INSTANCE);
+            batch.instances.insert(batch.instances.end(), source.instances.begin(), source.instances.end());
+        }
+
+        return batch;
+    }
+}
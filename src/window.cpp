@@ -4,12 +4,16 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <fstream>
+#include <stdexcept>
 #include <vector>
 #include <chrono>
 
 #include "shader.hpp"
 #include "command_buffer.hpp"
 #include "renderer.hpp"
+#include "scene_data.hpp"
+#include "mesh_registry.hpp"
 #include "event_convert.hpp"
 
 typedef void(*GlfwWindowDestroyFunc)(GLFWwindow *);
@@ -81,6 +85,8 @@ namespace merely3d
         std::pair<int, int> viewport_size;
 
         Camera camera;
+        Scene scene;
+        MeshRegistry meshes;
 
         CommandBuffer command_buffer;
         Renderer renderer;
@@ -101,7 +107,6 @@ namespace merely3d
         {
             viewport_width = fb_width;
             viewport_height = fb_height;
-            glViewport(0, 0, viewport_width, viewport_height);
         }
     }
 
@@ -265,7 +270,7 @@ namespace merely3d
         // Must check for valid data because data might have been moved
         if (_d)
         {
-            // TODO: Destroy ALL vertex buffers/objects and so forth
+            // The renderer deletes its OpenGL objects as it is destroyed, which requires its context to be current
             make_current();
             delete _d;
         }
@@ -283,19 +288,66 @@ namespace merely3d
         MERELY_UNUSED(frame);
         assert(_d);
 
+        const auto projection = update_viewport();
+        render_commands(projection);
+        end_frame();
+        swap_buffers();
+    }
+
+    void Window::render_tiled_impl(const TiledImage & image, Frame & frame)
+    {
+        MERELY_UNUSED(frame);
+        assert(_d);
+
+        std::ofstream file(image.file_name(), std::ios::binary);
+        if (file)
+        {
+            const auto projection = projection_matrix(static_cast<double>(_d->fovy), NEAR_PLANE,
+                                                      image.width(), image.height()).cast<float>();
+            try
+            {
+                _d->renderer.render_tiled(_d->command_buffer, *_d->scene._d, _d->meshes, _d->camera,
+                                          projection, image, file);
+            }
+            catch (...)
+            {
+                get_command_buffer()->clear();
+                throw;
+            }
+            file.close();
+        }
+        get_command_buffer()->clear();
+        end_frame();
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write the image " + image.file_name());
+        }
+    }
+
+    Eigen::Matrix4f Window::update_viewport()
+    {
         auto & vp_width = _d->viewport_size.first;
         auto & vp_height = _d->viewport_size.second;
 
         check_and_update_viewport_size(_d->glfw_window.get(), vp_width, vp_height);
-        const auto projection = projection_matrix(static_cast<double>(_d->fovy), NEAR_PLANE, vp_width, vp_height);
-
-        _d->renderer.render(_d->command_buffer, _d->camera, projection.cast<float>());
+        _d->renderer.set_viewport_size(vp_width, vp_height);
+        return projection_matrix(static_cast<double>(_d->fovy), NEAR_PLANE, vp_width, vp_height).cast<float>();
+    }
 
+    void Window::render_commands(const Eigen::Matrix4f & projection)
+    {
+        _d->renderer.render(_d->command_buffer, *_d->scene._d, _d->meshes, _d->camera, projection);
         get_command_buffer()->clear();
+    }
 
-        end_frame();
-
-        glfwSwapBuffers(_d->glfw_window.get());
+    void Window::swap_buffers()
+    {
+        // Headless windows have nothing to present, so they do not wait for vertical sync
+        if (!headless())
+        {
+            glfwSwapBuffers(_d->glfw_window.get());
+        }
     }
 
     bool Window::should_close() const
@@ -313,6 +365,67 @@ namespace merely3d
         return _d->camera;
     }
 
+    FrameStatistics Window::frame_statistics() const
+    {
+        const auto & counters = _d->renderer.state_counters();
+        FrameStatistics statistics;
+        statistics.state_changes = counters.issued;
+        statistics.redundant_state_changes = counters.skipped;
+        return statistics;
+    }
+
+    void Window::start_capture(const CaptureTarget & target)
+    {
+        make_current();
+        _d->renderer.start_capture(target);
+    }
+
+    void Window::stop_capture()
+    {
+        make_current();
+        _d->renderer.stop_capture();
+    }
+
+    bool Window::capturing() const
+    {
+        return _d->renderer.capturing();
+    }
+
+    bool Window::headless() const
+    {
+        return _d->renderer.offscreen_enabled();
+    }
+
+    void Window::set_depth_prepass(bool enabled)
+    {
+        _d->renderer.set_depth_prepass(enabled);
+    }
+
+    bool Window::depth_prepass() const
+    {
+        return _d->renderer.depth_prepass_enabled();
+    }
+
+    MeshHandle Window::register_mesh(const StaticMesh & mesh)
+    {
+        return _d->meshes.add(mesh);
+    }
+
+    void Window::unregister_mesh(MeshHandle handle)
+    {
+        _d->meshes.remove(handle);
+    }
+
+    Scene & Window::scene()
+    {
+        return _d->scene;
+    }
+
+    const Scene & Window::scene() const
+    {
+        return _d->scene;
+    }
+
     void Window::add_event_handler(std::shared_ptr<EventHandler> handler)
     {
         _d->event_handlers.push_back(std::move(handler));
@@ -329,7 +442,7 @@ namespace merely3d
         }
         _d->previous_frame_time = now;
 
-        Frame frame(get_command_buffer(), time_since_previous_frame);
+        Frame frame(get_command_buffer(), &_d->meshes, time_since_previous_frame);
         for (auto & handler : _d->event_handlers)
         {
             handler->before_frame(*this, frame);
@@ -446,9 +559,12 @@ namespace merely3d
         // This is apparently needed on Mac OS X. Can we simply set it for all platforms...?
         glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
-        glfwWindowHint(GLFW_SAMPLES, _samples);
+        glfwWindowHint(GLFW_SAMPLES, _headless ? 0 : _samples);
+        glfwWindowHint(GLFW_VISIBLE, _headless ? GLFW_FALSE : GLFW_TRUE);
 
-        GLFWwindow * glfw_window = glfwCreateWindow(_width, _height, _title.c_str(), NULL, NULL);
+        // The contexts of windows that share resources must share objects
+        GLFWwindow * share_window = _share ? _share->_d->glfw_window.get() : NULL;
+        GLFWwindow * glfw_window = glfwCreateWindow(_width, _height, _title.c_str(), NULL, share_window);
 
         if (!glfw_window)
         {
@@ -473,7 +589,12 @@ namespace merely3d
         glfwSetCursorEnterCallback(glfw_window, cursor_enter_callback);
         glfwSetFramebufferSizeCallback(glfw_window, framebuffer_resize_callback);
 
-        auto renderer = Renderer::build();
+        const auto shared = _share
+                            ? _share->_d->renderer.shared_resources()
+                            : SharedResources::create_in_context(_program_cache_directory,
+                                                                 (GLADloadproc) glfwGetProcAddress);
+        auto renderer = Renderer::build(shared);
+        renderer.set_offscreen(_headless);
         auto window_ptr = GlfwWindowPtr(glfw_window, glfwDestroyWindow);
         auto window_data = new Window::WindowData(std::move(window_ptr), std::move(renderer));
         auto window = Window(window_data);
@@ -0,0 +1,211 @@
+#include <merely3d/window_group.hpp>
+
+#include <GLFW/glfw3.h>
+
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "command_buffer.hpp"
+#include "worker_thread.hpp"
+
+namespace merely3d
+{
+    typedef std::chrono::steady_clock Clock;
+
+    static double seconds_between(Clock::time_point from, Clock::time_point to)
+    {
+        const std::chrono::duration<double> duration = to - from;
+        return duration.count();
+    }
+
+    /// A window of the group along with the thread that renders it.
+    struct GroupedWindow
+    {
+        explicit GroupedWindow(Window & window)
+            : window(&window),
+              buffer(nullptr),
+              meshes(nullptr),
+              time_since_prev_frame(0.0),
+              timings(FrameTimings { 0.0, 0.0, 0.0, 0.0 })
+        {}
+
+        Window * window;
+
+        // The frame begun on the calling thread, which is continued on the thread of the window
+        CommandBuffer * buffer;
+        const MeshRegistry * meshes;
+        double time_since_prev_frame;
+        Eigen::Matrix<float, 4, 4, Eigen::DontAlign> projection;
+
+        FrameTimings timings;
+
+        // Declared last, so that the thread is stopped before the rest of the window is destroyed
+        WorkerThread thread;
+    };
+
+    class WindowGroup::WindowGroupData
+    {
+    public:
+        std::vector<std::unique_ptr<GroupedWindow>> windows;
+    };
+
+    WindowGroup::WindowGroup()
+        : _d(new WindowGroupData)
+    {}
+
+    WindowGroup::WindowGroup(WindowGroup && other)
+        : _d(other._d)
+    {
+        other._d = nullptr;
+    }
+
+    WindowGroup::~WindowGroup()
+    {
+        // Must check for valid data because data might have been moved
+        if (_d)
+        {
+            for (auto & grouped : _d->windows)
+            {
+                grouped->thread.start([] { glfwMakeContextCurrent(NULL); });
+            }
+            for (auto & grouped : _d->windows)
+            {
+                grouped->thread.wait();
+            }
+            delete _d;
+        }
+    }
+
+    void WindowGroup::add(Window & window)
+    {
+        for (const auto & grouped : _d->windows)
+        {
+            if (grouped->window == &window)
+            {
+                throw std::invalid_argument("The window is already in the group.");
+            }
+        }
+
+        // A context can only be current on a single thread at a time, and
+        // the most recently built window is usually current on the calling thread
+        GLFWwindow * glfw_window = window.glfw_window();
+        if (glfwGetCurrentContext() == glfw_window)
+        {
+            glfwMakeContextCurrent(NULL);
+        }
+
+        std::unique_ptr<GroupedWindow> grouped(new GroupedWindow(window));
+        grouped->thread.start([glfw_window] { glfwMakeContextCurrent(glfw_window); });
+        grouped->thread.wait();
+        _d->windows.push_back(std::move(grouped));
+    }
+
+    size_t WindowGroup::size() const
+    {
+        return _d->windows.size();
+    }
+
+    Window & WindowGroup::window(size_t index)
+    {
+        return *_d->windows.at(index)->window;
+    }
+
+    const Window & WindowGroup::window(size_t index) const
+    {
+        return *_d->windows.at(index)->window;
+    }
+
+    bool WindowGroup::any_should_close() const
+    {
+        for (const auto & grouped : _d->windows)
+        {
+            if (grouped->window->should_close())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const FrameTimings & WindowGroup::frame_timings(size_t index) const
+    {
+        return _d->windows.at(index)->timings;
+    }
+
+    void WindowGroup::render_frame_impl(const std::function<void(Window &, Frame &)> & record_func)
+    {
+        assert(_d);
+        const auto start = Clock::now();
+
+        // GLFW requires events to be processed, and window sizes to be queried, on the main thread only
+        glfwPollEvents();
+        for (auto & grouped : _d->windows)
+        {
+            auto frame = grouped->window->begin_frame();
+            grouped->buffer = frame._buffer;
+            grouped->meshes = frame._meshes;
+            grouped->time_since_prev_frame = frame._delta_time;
+            grouped->projection = grouped->window->update_viewport();
+        }
+
+        for (auto & grouped_ptr : _d->windows)
+        {
+            GroupedWindow * grouped = grouped_ptr.get();
+            grouped->thread.start([grouped, start, &record_func]
+            {
+                Frame frame(grouped->buffer, grouped->meshes, grouped->time_since_prev_frame);
+                const auto record_start = Clock::now();
+                try
+                {
+                    record_func(*grouped->window, frame);
+                }
+                catch (...)
+                {
+                    // Discard the partially recorded frame, so that it is not rendered along with the next one
+                    grouped->buffer->clear();
+                    throw;
+                }
+                const auto render_start = Clock::now();
+                grouped->window->render_commands(grouped->projection);
+                const auto swap_start = Clock::now();
+                grouped->window->swap_buffers();
+                const auto presented = Clock::now();
+
+                grouped->timings.record = seconds_between(record_start, render_start);
+                grouped->timings.render = seconds_between(render_start, swap_start);
+                grouped->timings.swap = seconds_between(swap_start, presented);
+                grouped->timings.presented = seconds_between(start, presented);
+            });
+        }
+
+        // Every window must be done before returning, even if some of them failed
+        std::exception_ptr exception;
+        for (auto & grouped : _d->windows)
+        {
+            try
+            {
+                grouped->thread.wait();
+            }
+            catch (...)
+            {
+                if (!exception)
+                {
+                    exception = std::current_exception();
+                }
+            }
+        }
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+
+        for (auto & grouped : _d->windows)
+        {
+            grouped->window->end_frame();
+        }
+    }
+}
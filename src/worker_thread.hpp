@@ -0,0 +1,104 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace merely3d
+{
+    /// A thread that runs one task at a time, handed to it by another thread.
+    ///
+    /// Unlike threads spawned per task (see parallel_for_blocks), the thread persists between tasks,
+    /// which is needed for work that is bound to the thread, such as rendering with an OpenGL context
+    /// that is current on it.
+    class WorkerThread
+    {
+    public:
+        WorkerThread()
+            : _has_task(false), _stop(false)
+        {
+            _thread = std::thread([this] { run(); });
+        }
+
+        WorkerThread(const WorkerThread & other) = delete;
+        WorkerThread & operator=(const WorkerThread & other) = delete;
+
+        /// Waits for the current task to complete, if any, before stopping the thread.
+        ~WorkerThread()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _wake.notify_one();
+            _thread.join();
+        }
+
+        /// Starts running the given task on the thread. Any previous task must have been waited for.
+        void start(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _task = std::move(task);
+                _has_task = true;
+            }
+            _wake.notify_one();
+        }
+
+        /// Waits for the current task to complete. If the task threw an exception, it is rethrown here.
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [this] { return !_has_task; });
+
+            if (_exception)
+            {
+                auto exception = _exception;
+                _exception = nullptr;
+                std::rethrow_exception(exception);
+            }
+        }
+
+    private:
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true)
+            {
+                _wake.wait(lock, [this] { return _has_task || _stop; });
+                if (!_has_task)
+                {
+                    return;
+                }
+
+                auto task = std::move(_task);
+                lock.unlock();
+                std::exception_ptr exception;
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+                lock.lock();
+
+                _exception = exception;
+                _has_task = false;
+                _done.notify_all();
+            }
+        }
+
+        std::mutex                  _mutex;
+        std::condition_variable     _wake;
+        std::condition_variable     _done;
+        std::function<void()>       _task;
+        std::exception_ptr          _exception;
+        bool                        _has_task;
+        bool                        _stop;
+        std::thread                 _thread;
+    };
+}
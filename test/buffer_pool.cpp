@@ -0,0 +1,62 @@
+#include <catch.hpp>
+
+#include <buffer_pool.hpp>
+
+#include <vector>
+
+using merely3d::BufferPool;
+using merely3d::pooled_buffer_size;
+using merely3d::MIN_POOLED_BUFFER_SIZE;
+
+TEST_CASE("Pooled buffer sizes are powers of two", "[buffer_pool]")
+{
+    REQUIRE(pooled_buffer_size(0) == MIN_POOLED_BUFFER_SIZE);
+    REQUIRE(pooled_buffer_size(MIN_POOLED_BUFFER_SIZE) == MIN_POOLED_BUFFER_SIZE);
+    REQUIRE(pooled_buffer_size(MIN_POOLED_BUFFER_SIZE + 1) == 2 * MIN_POOLED_BUFFER_SIZE);
+    REQUIRE(pooled_buffer_size(1000000) == 1048576);
+}
+
+TEST_CASE("Buffer pool hands out buffers of the requested bucket", "[buffer_pool]")
+{
+    BufferPool pool;
+    REQUIRE(pool.take(256) == 0);
+
+    pool.add(1, 256, 0);
+    pool.add(2, 512, 0);
+    pool.add(3, 256, 1);
+    REQUIRE(pool.buffer_count() == 3);
+    REQUIRE(pool.size_in_bytes() == 1024);
+
+    // The most recently added buffer comes first
+    REQUIRE(pool.take(256) == 3);
+    REQUIRE(pool.take(256) == 1);
+    REQUIRE(pool.take(256) == 0);
+    REQUIRE(pool.take(1024) == 0);
+    REQUIRE(pool.take(512) == 2);
+    REQUIRE(pool.buffer_count() == 0);
+    REQUIRE(pool.size_in_bytes() == 0);
+}
+
+TEST_CASE("Buffer pool trims old buffers first", "[buffer_pool]")
+{
+    BufferPool pool;
+    pool.add(1, 512, 0);
+    pool.add(2, 256, 1);
+    pool.add(3, 1024, 2);
+    pool.add(4, 256, 3);
+
+    std::vector<GLuint> removed;
+    pool.trim(4096, 0, removed);
+    REQUIRE(removed.empty());
+
+    // Buffers older than the given frame are removed regardless of the budget
+    pool.trim(4096, 1, removed);
+    REQUIRE(removed == std::vector<GLuint>({ 1 }));
+
+    // Then buffers are removed, oldest first, until the pool fits the budget
+    removed.clear();
+    pool.trim(1024, 1, removed);
+    REQUIRE(removed == std::vector<GLuint>({ 2, 3 }));
+    REQUIRE(pool.size_in_bytes() == 256);
+    REQUIRE(pool.take(256) == 4);
+}
@@ -0,0 +1,40 @@
+#include <catch.hpp>
+
+#include <merely3d/colormap.hpp>
+
+using merely3d::Colormap;
+using merely3d::evaluate_colormap;
+
+namespace
+{
+    bool approx_equal(const merely3d::Color & color, float r, float g, float b)
+    {
+        const float tol = 0.03f;
+        return std::abs(color.r() - r) < tol
+            && std::abs(color.g() - g) < tol
+            && std::abs(color.b() - b) < tol;
+    }
+}
+
+TEST_CASE("Colormaps match reference values", "[colormap]")
+{
+    // Reference values from the matplotlib colormap tables
+    REQUIRE(approx_equal(evaluate_colormap(Colormap::Viridis, 0.0f), 0.267004f, 0.004874f, 0.329415f));
+    REQUIRE(approx_equal(evaluate_colormap(Colormap::Viridis, 0.5f), 0.127568f, 0.566949f, 0.550556f));
+    REQUIRE(approx_equal(evaluate_colormap(Colormap::Viridis, 1.0f), 0.993248f, 0.906157f, 0.143936f));
+    REQUIRE(approx_equal(evaluate_colormap(Colormap::Plasma, 0.0f), 0.050383f, 0.029803f, 0.527975f));
+    REQUIRE(approx_equal(evaluate_colormap(Colormap::Magma, 0.0f), 0.001462f, 0.000466f, 0.013866f));
+    REQUIRE(approx_equal(evaluate_colormap(Colormap::Inferno, 1.0f), 0.988362f, 0.998364f, 0.644924f));
+    REQUIRE(approx_equal(evaluate_colormap(Colormap::Grayscale, 0.25f), 0.25f, 0.25f, 0.25f));
+}
+
+TEST_CASE("Colormap arguments are clamped", "[colormap]")
+{
+    const auto below = evaluate_colormap(Colormap::Viridis, -3.0f);
+    const auto lowest = evaluate_colormap(Colormap::Viridis, 0.0f);
+    const auto above = evaluate_colormap(Colormap::Plasma, 7.0f);
+    const auto highest = evaluate_colormap(Colormap::Plasma, 1.0f);
+
+    REQUIRE(below.into_array() == lowest.into_array());
+    REQUIRE(above.into_array() == highest.into_array());
+}
@@ -0,0 +1,231 @@
+#include <catch.hpp>
+
+#include <draw_queue.hpp>
+
+#include <limits>
+
+using merely3d::DrawQueue;
+using merely3d::OpaqueDraw;
+using merely3d::quantize_view_depth;
+
+namespace
+{
+    OpaqueDraw draw_with_vertex_array(GLuint vertex_array, unsigned int shading = merely3d::SHADING_ALL)
+    {
+        auto draw = OpaqueDraw::arrays(0, 3);
+        draw.vertex_array = vertex_array;
+        draw.shading = shading;
+        return draw;
+    }
+}
+
+TEST_CASE("View depth quantization preserves order", "[draw_queue]")
+{
+    REQUIRE(quantize_view_depth(-1.0f) == 0);
+    REQUIRE(quantize_view_depth(std::numeric_limits<float>::quiet_NaN()) == 0);
+    REQUIRE(quantize_view_depth(0.0f) == 0);
+    REQUIRE(quantize_view_depth(0.01f) < quantize_view_depth(0.02f));
+    REQUIRE(quantize_view_depth(1.0f) < quantize_view_depth(1.01f));
+    REQUIRE(quantize_view_depth(1000.0f) < quantize_view_depth(1e6f));
+    REQUIRE(quantize_view_depth(std::numeric_limits<float>::infinity()) < (1u << merely3d::DRAW_KEY_DEPTH_BITS));
+}
+
+TEST_CASE("Draw queue orders draws by program, then front to back", "[draw_queue]")
+{
+    const auto lit = merely3d::SHADING_LIGHTING;
+
+    DrawQueue queue;
+    queue.push(draw_with_vertex_array(1, lit), 10.0f);
+    queue.push(draw_with_vertex_array(2), 1.0f);
+    queue.push(draw_with_vertex_array(3, lit), 2.0f);
+    queue.push(draw_with_vertex_array(4, lit), -5.0f);
+    queue.push(draw_with_vertex_array(5, lit), 2.0f);
+    queue.sort();
+
+    REQUIRE(queue.draws().size() == 5);
+    REQUIRE(queue.draws()[0].vertex_array == 4);
+    // Draws with equal keys keep their order
+    REQUIRE(queue.draws()[1].vertex_array == 3);
+    REQUIRE(queue.draws()[2].vertex_array == 5);
+    REQUIRE(queue.draws()[3].vertex_array == 1);
+    REQUIRE(queue.draws()[4].vertex_array == 2);
+
+    queue.clear();
+    REQUIRE(queue.draws().empty());
+}
+
+TEST_CASE("Draw queue groups draws by instance source, with all draws with edges last", "[draw_queue]")
+{
+    auto textured = draw_with_vertex_array(1, merely3d::SHADING_LIGHTING);
+    textured.instance_base = 0;
+    auto textured_edges = draw_with_vertex_array(2, merely3d::SHADING_EDGES);
+    textured_edges.instance_base = 10;
+
+    DrawQueue queue;
+    queue.push(textured_edges, 1.0f);
+    queue.push(textured, 1.0f);
+    queue.push(draw_with_vertex_array(3, merely3d::SHADING_EDGES), 5.0f);
+    queue.push(draw_with_vertex_array(4, merely3d::SHADING_LIGHTING), 5.0f);
+    queue.sort();
+
+    REQUIRE(queue.draws().size() == 4);
+    REQUIRE(queue.draws()[0].vertex_array == 4);
+    REQUIRE(queue.draws()[1].vertex_array == 1);
+    REQUIRE(queue.draws()[2].vertex_array == 3);
+    REQUIRE(queue.draws()[3].vertex_array == 2);
+    REQUIRE(queue.draws()[3].instance_base == 10);
+}
+
+TEST_CASE("Nearest view depth of instances", "[draw_queue]")
+{
+    // The camera is at the origin, looking along the negative z-axis
+    const Eigen::Affine3f view = Eigen::Affine3f::Identity();
+    std::vector<float> instances;
+    const Eigen::Vector3f unit(1.0f, 1.0f, 1.0f);
+    merely3d::append_instance(instances, Eigen::Vector3f(0.0f, 0.0f, -5.0f), Eigen::Quaternionf::Identity(),
+                              unit, unit, merely3d::Material());
+    merely3d::append_instance(instances, Eigen::Vector3f(1.0f, 2.0f, -3.0f), Eigen::Quaternionf::Identity(),
+                              unit, unit, merely3d::Material());
+
+    REQUIRE(merely3d::nearest_view_depth(instances, view) == Approx(3.0f));
+    REQUIRE(merely3d::nearest_view_depth(std::vector<float>(), view) == std::numeric_limits<float>::infinity());
+}
+
+TEST_CASE("Draw queue groups draws by shading features", "[draw_queue]")
+{
+    // Draws with edges, including wireframes, come after all draws without edges
+    DrawQueue queue;
+    queue.push(draw_with_vertex_array(4, merely3d::SHADING_ALL & ~merely3d::SHADING_EDGES), 1.0f);
+    queue.push(draw_with_vertex_array(3, merely3d::SHADING_EDGES), 1.0f);
+    queue.push(draw_with_vertex_array(2, merely3d::SHADING_LIGHTING), 2.0f);
+    queue.push(draw_with_vertex_array(1, 0), 3.0f);
+    queue.sort();
+
+    REQUIRE(queue.draws().size() == 4);
+    REQUIRE(queue.draws()[0].vertex_array == 1);
+    REQUIRE(queue.draws()[1].vertex_array == 2);
+    REQUIRE(queue.draws()[2].vertex_array == 4);
+    REQUIRE(queue.draws()[3].vertex_array == 3);
+}
+
+TEST_CASE("Shading features of instances", "[draw_queue]")
+{
+    using merely3d::Material;
+    using merely3d::shading_features;
+
+    const Eigen::Vector3f unit(1.0f, 1.0f, 1.0f);
+    const auto append = [&] (std::vector<float> & instances, const Material & material)
+    {
+        merely3d::append_instance(instances, Eigen::Vector3f::Zero(), Eigen::Quaternionf::Identity(),
+                                  unit, unit, material);
+    };
+
+    std::vector<float> instances;
+    REQUIRE(shading_features(instances) == 0);
+
+    append(instances, Material().with_pattern_grid_size(0.0f).with_unlit(true));
+    REQUIRE(shading_features(instances) == 0);
+
+    // Specular highlights are part of the lighting, so unlit instances never use them
+    append(instances, Material().with_pattern_grid_size(0.0f).with_specular_strength(1.0f).with_unlit(true));
+    REQUIRE(shading_features(instances) == 0);
+
+    append(instances, Material().with_pattern_grid_size(0.0f).with_specular_strength(0.0f));
+    REQUIRE(shading_features(instances) == merely3d::SHADING_LIGHTING);
+
+    append(instances, Material().with_pattern_grid_size(0.0f));
+    REQUIRE(shading_features(instances) == (merely3d::SHADING_LIGHTING | merely3d::SHADING_SPECULAR));
+
+    append(instances, Material());
+    REQUIRE(shading_features(instances) == (merely3d::SHADING_ALL & ~merely3d::SHADING_EDGES));
+
+    append(instances, Material().with_edges(true));
+    REQUIRE(shading_features(instances) == merely3d::SHADING_ALL);
+}
+
+TEST_CASE("Shading features of wireframe and edge instances", "[draw_queue]")
+{
+    using merely3d::Material;
+    using merely3d::shading_features;
+
+    const Eigen::Vector3f unit(1.0f, 1.0f, 1.0f);
+    const auto record = [&] (const Material & material)
+    {
+        std::vector<float> instances;
+        merely3d::append_instance(instances, Eigen::Vector3f::Zero(), Eigen::Quaternionf::Identity(),
+                                  unit, unit, material);
+        return instances;
+    };
+
+    // Wireframes consist of nothing but edges, so the shading of the surface does not apply
+    const auto wireframe = record(Material().with_wireframe(true).with_edges(true));
+    REQUIRE(wireframe[merely3d::INSTANCE_EDGE_MODE_OFFSET] == merely3d::EDGE_MODE_WIREFRAME);
+    REQUIRE(shading_features(wireframe) == merely3d::SHADING_EDGES);
+
+    const auto edges = record(Material().with_pattern_grid_size(0.0f).with_unlit(true)
+                                        .with_edges(true).with_edge_width(-1.0f));
+    REQUIRE(edges[merely3d::INSTANCE_EDGE_MODE_OFFSET] == merely3d::EDGE_MODE_FILLED);
+    REQUIRE(edges[merely3d::INSTANCE_EDGE_WIDTH_OFFSET] == 0.0f);
+    REQUIRE(shading_features(edges) == merely3d::SHADING_EDGES);
+
+    REQUIRE(record(Material())[merely3d::INSTANCE_EDGE_MODE_OFFSET] == merely3d::EDGE_MODE_NONE);
+}
+
+TEST_CASE("Indirect batches gather the mesh draws of each program", "[draw_queue]")
+{
+    using merely3d::DrawElementsIndirectCommand;
+    using merely3d::IndirectBatch;
+
+    const GLuint arena = 7;
+    const auto lit = merely3d::SHADING_LIGHTING;
+    const auto mesh = [&] (GLint first_index, GLint base_vertex, GLint instance_base, unsigned int shading)
+    {
+        auto draw = OpaqueDraw::elements(first_index, 30, base_vertex);
+        draw.vertex_array = arena;
+        draw.instance_count = 2;
+        draw.instance_base = instance_base;
+        draw.shading = shading;
+        return draw;
+    };
+
+    // A static batch reads from an instance texture as well, but is not an indexed draw of the arena
+    auto batch = draw_with_vertex_array(3, lit);
+    batch.instance_base = 0;
+
+    DrawQueue queue;
+    queue.push(mesh(0, 0, 0, lit), 4.0f);
+    queue.push(draw_with_vertex_array(1, lit), 1.0f);
+    queue.push(mesh(30, 10, 2, merely3d::SHADING_ALL), 1.0f);
+    queue.push(batch, 2.0f);
+    queue.push(mesh(60, 20, 4, lit), 1.0f);
+    queue.sort();
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<IndirectBatch> batches;
+    merely3d::plan_indirect_batches(queue.draws(), arena, commands, batches);
+
+    // The lit mesh draws are issued in the place of the nearest one, and still in order of depth
+    REQUIRE(batches.size() == 2);
+    REQUIRE(merely3d::is_indirect_draw(queue.draws()[batches[0].first_draw], arena));
+    REQUIRE(queue.draws()[batches[0].first_draw].first == 60);
+    REQUIRE(batches[0].first_command == 0);
+    REQUIRE(batches[0].command_count == 2);
+    REQUIRE(batches[1].first_command == 2);
+    REQUIRE(batches[1].command_count == 1);
+
+    REQUIRE(commands.size() == 3);
+    REQUIRE(commands[0].first_index == 60);
+    REQUIRE(commands[0].base_vertex == 20);
+    REQUIRE(commands[0].base_instance == 4);
+    REQUIRE(commands[0].count == 30);
+    REQUIRE(commands[0].instance_count == 2);
+    REQUIRE(commands[1].first_index == 0);
+    REQUIRE(commands[1].base_instance == 0);
+    REQUIRE(commands[2].first_index == 30);
+    REQUIRE(commands[2].base_instance == 2);
+
+    // Without any mesh draws, there is nothing to batch
+    merely3d::plan_indirect_batches(queue.draws(), 9, commands, batches);
+    REQUIRE(commands.empty());
+    REQUIRE(batches.empty());
+}
@@ -0,0 +1,50 @@
+#include <catch.hpp>
+
+#include <frame_uniforms.hpp>
+
+#include <cstddef>
+
+using merely3d::Camera;
+using merely3d::FrameUniformData;
+
+TEST_CASE("Frame uniforms follow the std140 layout", "[frame_uniforms]")
+{
+    // The offsets of the members of the FrameUniforms block in frame_uniforms.glsl
+    REQUIRE(offsetof(FrameUniformData, view) == 0);
+    REQUIRE(offsetof(FrameUniformData, projection) == 64);
+    REQUIRE(offsetof(FrameUniformData, inv_projection) == 128);
+    REQUIRE(offsetof(FrameUniformData, camera_position) == 192);
+    REQUIRE(offsetof(FrameUniformData, near_plane_dist) == 204);
+    REQUIRE(offsetof(FrameUniformData, light_color) == 208);
+    REQUIRE(offsetof(FrameUniformData, light_dir) == 224);
+    REQUIRE(offsetof(FrameUniformData, light_dir_eye) == 240);
+}
+
+TEST_CASE("Frame uniforms are computed from the camera and projection", "[frame_uniforms]")
+{
+    // Infinite projection with a near plane at distance 0.5, as used by merely3d
+    const float n = 0.5f;
+    Eigen::Matrix4f projection;
+    projection << 1.5f, 0.0f,  0.0f,      0.0f,
+                  0.0f, 2.0f,  0.0f,      0.0f,
+                  0.0f, 0.0f, -1.0f, -2.0f * n,
+                  0.0f, 0.0f, -1.0f,      0.0f;
+
+    Camera camera;
+    camera.set_position(Eigen::Vector3f(1.0f, 2.0f, 3.0f));
+
+    const auto data = merely3d::make_frame_uniforms(camera, projection);
+
+    const Eigen::Map<const Eigen::Matrix4f> inv_projection(data.inv_projection);
+    REQUIRE((inv_projection * projection).isApprox(Eigen::Matrix4f::Identity(), 1e-5f));
+    REQUIRE(data.near_plane_dist == Approx(n));
+
+    const Eigen::Map<const Eigen::Matrix4f> view(data.view);
+    REQUIRE((view * Eigen::Vector4f(1.0f, 2.0f, 3.0f, 1.0f)).isApprox(Eigen::Vector4f(0.0f, 0.0f, 0.0f, 1.0f)));
+    REQUIRE(data.camera_position[2] == 3.0f);
+
+    const Eigen::Map<const Eigen::Vector3f> light_dir(data.light_dir);
+    const Eigen::Map<const Eigen::Vector3f> light_dir_eye(data.light_dir_eye);
+    REQUIRE(light_dir.norm() == Approx(1.0f));
+    REQUIRE((view.topLeftCorner<3, 3>() * light_dir).isApprox(light_dir_eye));
+}
@@ -0,0 +1,101 @@
+#include <catch.hpp>
+
+#include <frame_writer.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using merely3d::CaptureFormat;
+using merely3d::CaptureTarget;
+using merely3d::FrameWriter;
+using merely3d::capture_file_name;
+
+namespace
+{
+    std::string read_file(const std::string & name)
+    {
+        std::ifstream file(name, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    /// A frame of 2x1 RGBA pixels, filled with the given value.
+    std::vector<unsigned char> frame_pixels(unsigned char value)
+    {
+        return std::vector<unsigned char>(8, value);
+    }
+}
+
+TEST_CASE("Capture file names replace the last run of '#' with the frame index", "[frame_writer]")
+{
+    REQUIRE(capture_file_name("frame_####.png", 7) == "frame_0007.png");
+    REQUIRE(capture_file_name("frame_#.png", 123) == "frame_123.png");
+    REQUIRE(capture_file_name("#/frame_##.png", 5) == "#/frame_05.png");
+    REQUIRE(capture_file_name("###", 42) == "042");
+    REQUIRE_THROWS_AS(CaptureTarget::image_files("frame.png"), std::invalid_argument);
+}
+
+TEST_CASE("Frame writer writes raw frames and releases their slots", "[frame_writer]")
+{
+    const auto pattern = std::string("frame_writer_test_#.raw");
+    const auto first = frame_pixels(1);
+    const auto second = frame_pixels(2);
+
+    FrameWriter writer(CaptureTarget::image_files(pattern, CaptureFormat::Raw));
+    writer.submit(first.data(), 2, 1, 4);
+    writer.submit(second.data(), 2, 1, 5);
+
+    std::vector<size_t> released;
+    size_t slot;
+    while (writer.take_released(slot, true))
+    {
+        released.push_back(slot);
+    }
+    REQUIRE(released.size() == 2);
+    REQUIRE(!writer.take_released(slot, false));
+
+    writer.finish();
+    REQUIRE(writer.frames_written() == 2);
+    REQUIRE(writer.frames_skipped() == 0);
+
+    REQUIRE(read_file(capture_file_name(pattern, 0)) == std::string(6, '\x01'));
+    REQUIRE(read_file(capture_file_name(pattern, 1)) == std::string(6, '\x02'));
+    std::remove(capture_file_name(pattern, 0).c_str());
+    std::remove(capture_file_name(pattern, 1).c_str());
+}
+
+TEST_CASE("Frame writer reports frames that could not be written", "[frame_writer]")
+{
+    const auto pixels = frame_pixels(0);
+
+    FrameWriter writer(CaptureTarget::image_files("no_such_directory/frame_#.png"));
+    writer.submit(pixels.data(), 2, 1, 0);
+    writer.submit(pixels.data(), 2, 1, 1);
+    REQUIRE_THROWS_AS(writer.finish(), std::runtime_error);
+    REQUIRE(writer.frames_written() == 0);
+    REQUIRE(writer.frames_skipped() == 2);
+}
+
+#ifndef _WIN32
+TEST_CASE("Frame writer streams frames of the size of the first frame into a pipe", "[frame_writer]")
+{
+    const auto output = std::string("frame_writer_test_pipe.raw");
+    const auto first = frame_pixels(1);
+    const auto second = std::vector<unsigned char>(16, 2);
+    const auto third = frame_pixels(3);
+
+    FrameWriter writer(CaptureTarget::pipe("cat > " + output));
+    writer.submit(first.data(), 2, 1, 0);
+    writer.submit(second.data(), 2, 2, 1);
+    writer.submit(third.data(), 2, 1, 2);
+    writer.finish();
+
+    REQUIRE(writer.frames_written() == 2);
+    REQUIRE(writer.frames_skipped() == 1);
+    REQUIRE(read_file(output) == std::string(6, '\x01') + std::string(6, '\x03'));
+    std::remove(output.c_str());
+}
+#endif
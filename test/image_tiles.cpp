@@ -0,0 +1,133 @@
+#include <catch.hpp>
+
+#include <image_tiles.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using merely3d::ImageTile;
+using merely3d::TileGrid;
+
+namespace
+{
+    Eigen::Matrix4f infinite_projection()
+    {
+        const float n = 0.1f;
+        Eigen::Matrix4f projection;
+        projection << 1.2f, 0.0f,  0.0f,      0.0f,
+                      0.0f, 1.6f,  0.0f,      0.0f,
+                      0.0f, 0.0f, -1.0f, -2.0f * n,
+                      0.0f, 0.0f, -1.0f,      0.0f;
+        return projection;
+    }
+
+    /// The window coordinates of the given view space point in a viewport of the given size at the origin.
+    Eigen::Vector3f window_coords(const Eigen::Matrix4f & projection, const Eigen::Vector3f & point, int width, int height)
+    {
+        const Eigen::Vector4f clip = projection * point.homogeneous();
+        const Eigen::Vector3f ndc = clip.head<3>() / clip.w();
+        return Eigen::Vector3f(0.5f * (ndc.x() + 1.0f) * width, 0.5f * (ndc.y() + 1.0f) * height, 0.5f * (ndc.z() + 1.0f));
+    }
+}
+
+TEST_CASE("Tile grids cover the image exactly once", "[image_tiles]")
+{
+    const TileGrid grid(250, 130, 64);
+    REQUIRE(grid.columns() == 4);
+    REQUIRE(grid.rows() == 3);
+
+    std::vector<int> coverage(250 * 130, 0);
+    for (int row = 0; row < grid.rows(); ++row)
+    {
+        for (int column = 0; column < grid.columns(); ++column)
+        {
+            const auto tile = grid.tile(column, row);
+            REQUIRE(tile.x % 64 == 0);
+            REQUIRE(tile.y % 64 == 0);
+            REQUIRE(tile.width > 0);
+            REQUIRE(tile.height > 0);
+            for (int y = tile.y; y < tile.y + tile.height; ++y)
+            {
+                for (int x = tile.x; x < tile.x + tile.width; ++x)
+                {
+                    coverage[y * 250 + x] += 1;
+                }
+            }
+        }
+    }
+    REQUIRE(std::count(coverage.begin(), coverage.end(), 1) == static_cast<long>(coverage.size()));
+
+    // Rows are counted from the top, so the partial row comes first
+    REQUIRE(grid.tile(0, 0).y == 128);
+    REQUIRE(grid.tile(0, 0).height == 2);
+    REQUIRE(grid.tile(3, 2).x == 192);
+    REQUIRE(grid.tile(3, 2).y == 0);
+    REQUIRE(grid.tile(3, 2).width == 58);
+}
+
+TEST_CASE("A tile covering the whole image has the projection of the image", "[image_tiles]")
+{
+    const TileGrid grid(300, 200, 512);
+    REQUIRE(grid.columns() == 1);
+    REQUIRE(grid.rows() == 1);
+
+    const auto projection = infinite_projection();
+    REQUIRE(grid.tile_projection(projection, grid.tile(0, 0)).isApprox(projection));
+}
+
+TEST_CASE("Tile projections map points to the pixels of the whole image", "[image_tiles]")
+{
+    const int width = 1000;
+    const int height = 700;
+    const TileGrid grid(width, height, 256);
+    const auto projection = infinite_projection();
+
+    const std::vector<Eigen::Vector3f> points = {
+        Eigen::Vector3f(0.0f, 0.0f, -1.0f),
+        Eigen::Vector3f(-3.0f, 2.0f, -5.0f),
+        Eigen::Vector3f(4.0f, -1.5f, -7.5f),
+        Eigen::Vector3f(0.05f, 0.02f, -0.1f),
+        Eigen::Vector3f(100.0f, 60.0f, -120.0f)
+    };
+
+    for (const auto & point : points)
+    {
+        const auto expected = window_coords(projection, point, width, height);
+        for (int row = 0; row < grid.rows(); ++row)
+        {
+            for (int column = 0; column < grid.columns(); ++column)
+            {
+                const auto tile = grid.tile(column, row);
+                const auto tile_projection = grid.tile_projection(projection, tile);
+                const auto coords = window_coords(tile_projection, point, tile.width, tile.height);
+
+                REQUIRE(coords.x() + tile.x == Approx(expected.x()).epsilon(1e-4));
+                REQUIRE(coords.y() + tile.y == Approx(expected.y()).epsilon(1e-4));
+                REQUIRE(coords.z() == Approx(expected.z()));
+            }
+        }
+    }
+}
+
+TEST_CASE("Padded tiles are extended into their neighbors, but not beyond the image", "[image_tiles]")
+{
+    const TileGrid grid(250, 200, 64);
+
+    const auto corner = grid.padded(grid.tile(0, 3), 8);
+    REQUIRE(corner.x == 0);
+    REQUIRE(corner.y == 0);
+    REQUIRE(corner.width == 72);
+    REQUIRE(corner.height == 72);
+
+    const auto inner = grid.padded(grid.tile(1, 1), 8);
+    REQUIRE(inner.x == 56);
+    REQUIRE(inner.y == 120);
+    REQUIRE(inner.width == 80);
+    REQUIRE(inner.height == 80);
+
+    const auto top_right = grid.padded(grid.tile(3, 0), 8);
+    REQUIRE(top_right.x == 184);
+    REQUIRE(top_right.y == 184);
+    REQUIRE(top_right.width == 66);
+    REQUIRE(top_right.height == 16);
+}
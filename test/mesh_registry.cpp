@@ -0,0 +1,63 @@
+#include <catch.hpp>
+
+#include <mesh_registry.hpp>
+
+#include <stdexcept>
+
+using merely3d::MeshRegistry;
+using merely3d::MeshHandle;
+using merely3d::MeshHandleInstances;
+using merely3d::StaticMesh;
+using merely3d::FLOATS_PER_INSTANCE;
+
+TEST_CASE("Mesh registry handles", "[mesh_registry]")
+{
+    const auto mesh = StaticMesh({ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+                                 { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f },
+                                 { 0, 1, 2 });
+
+    MeshRegistry registry;
+    REQUIRE(!registry.contains(MeshHandle()));
+
+    const auto first = registry.add(mesh);
+    const auto second = registry.add(mesh);
+    REQUIRE(first != second);
+    REQUIRE(registry.contains(first));
+    REQUIRE(registry.get(second.index) != nullptr);
+
+    registry.remove(first);
+    REQUIRE(!registry.contains(first));
+    REQUIRE(registry.get(first.index) == nullptr);
+    REQUIRE(registry.contains(second));
+    REQUIRE_THROWS_AS(registry.remove(first), std::invalid_argument);
+
+    // Handles are never reused
+    const auto third = registry.add(mesh);
+    REQUIRE(third != first);
+    REQUIRE(registry.handle_count() == 3);
+}
+
+TEST_CASE("Instances are grouped by mesh in submission order", "[mesh_registry]")
+{
+    MeshHandleInstances instances;
+    const uint32_t meshes[] = { 2, 0, 2, 2, 0 };
+    for (size_t i = 0; i < 5; ++i)
+    {
+        instances.meshes.push_back(meshes[i]);
+        instances.instances.insert(instances.instances.end(), FLOATS_PER_INSTANCE, static_cast<float>(i));
+    }
+
+    std::vector<size_t> offsets;
+    std::vector<float> sorted;
+    merely3d::sort_by_mesh(instances, 4, offsets, sorted);
+
+    REQUIRE(offsets == std::vector<size_t>({ 0, 2, 2, 5, 5 }));
+    REQUIRE(sorted.size() == instances.instances.size());
+
+    const float expected[] = { 1.0f, 4.0f, 0.0f, 2.0f, 3.0f };
+    for (size_t i = 0; i < 5; ++i)
+    {
+        REQUIRE(sorted[FLOATS_PER_INSTANCE * i] == expected[i]);
+        REQUIRE(sorted[FLOATS_PER_INSTANCE * i + FLOATS_PER_INSTANCE - 1] == expected[i]);
+    }
+}
@@ -0,0 +1,316 @@
+#include <catch.hpp>
+
+#include <dirty_ranges.hpp>
+#include <particle_set_data.hpp>
+#include <merely3d/particle_set.hpp>
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using merely3d::DirtyRanges;
+using merely3d::ParticleSet;
+using merely3d::Particle;
+
+namespace
+{
+    typedef std::vector<std::pair<size_t, size_t>> Pairs;
+
+    Pairs as_pairs(const DirtyRanges & dirty)
+    {
+        Pairs result;
+        for (const auto & range : dirty.ranges())
+        {
+            result.emplace_back(range.begin, range.end);
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Dirty ranges are kept sorted and disjoint", "[particle_set]")
+{
+    DirtyRanges dirty;
+    REQUIRE(dirty.empty());
+
+    dirty.add(10, 20);
+    dirty.add(0, 5);
+    dirty.add(30, 40);
+    REQUIRE(as_pairs(dirty) == Pairs({ {0, 5}, {10, 20}, {30, 40} }));
+
+    SECTION("Empty ranges are ignored")
+    {
+        dirty.add(7, 7);
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 5}, {10, 20}, {30, 40} }));
+    }
+
+    SECTION("Adjacent ranges are merged")
+    {
+        dirty.add(5, 10);
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 20}, {30, 40} }));
+    }
+
+    SECTION("Overlapping ranges are merged")
+    {
+        dirty.add(15, 35);
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 5}, {10, 40} }));
+    }
+
+    SECTION("A range covering several ranges absorbs them")
+    {
+        dirty.add(2, 100);
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 100} }));
+    }
+
+    SECTION("Contained ranges do not change the set")
+    {
+        dirty.add(12, 18);
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 5}, {10, 20}, {30, 40} }));
+    }
+
+    SECTION("Truncation removes and shortens ranges")
+    {
+        dirty.truncate(15);
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 5}, {10, 15} }));
+        dirty.truncate(10);
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 5} }));
+    }
+
+    SECTION("Clear")
+    {
+        dirty.clear();
+        REQUIRE(dirty.empty());
+    }
+}
+
+TEST_CASE("Changed records are detected in blocks", "[particle_set]")
+{
+    using merely3d::find_changed_records;
+
+    // 10 records of 2 floats each, compared in blocks of 3 records
+    std::vector<float> previous(20, 0.0f);
+    std::vector<float> current = previous;
+    DirtyRanges changed;
+    changed.add(0, 1);
+
+    find_changed_records(previous, current, 2, 3, changed);
+    REQUIRE(changed.empty());
+
+    current[2 * 4 + 1] = 1.0f;
+    current[2 * 9] = 1.0f;
+    find_changed_records(previous, current, 2, 3, changed);
+    REQUIRE(as_pairs(changed) == Pairs({ {3, 6}, {9, 10} }));
+
+    SECTION("Appended records are changed")
+    {
+        current = previous;
+        current.resize(26, 0.0f);
+        find_changed_records(previous, current, 2, 3, changed);
+        REQUIRE(as_pairs(changed) == Pairs({ {10, 13} }));
+    }
+
+    SECTION("Removed records are not reported")
+    {
+        current = previous;
+        current.resize(8);
+        find_changed_records(previous, current, 2, 3, changed);
+        REQUIRE(changed.empty());
+    }
+}
+
+TEST_CASE("Particle set updates", "[particle_set]")
+{
+    ParticleSet set(std::vector<Particle>(10));
+    REQUIRE(set.size() == 10);
+
+    set.update(8, std::vector<Particle>(2));
+    REQUIRE_THROWS_AS(set.update(9, std::vector<Particle>(2)), std::out_of_range);
+    REQUIRE_THROWS_AS(set.update(11, std::vector<Particle>()), std::out_of_range);
+
+    set.resize(20);
+    REQUIRE(set.size() == 20);
+    set.update(15, std::vector<Particle>(5));
+
+    set.resize(5);
+    REQUIRE(set.size() == 5);
+    REQUIRE_THROWS_AS(set.update(5, std::vector<Particle>(1)), std::out_of_range);
+}
+
+TEST_CASE("Dirty histories give every consumer the changes since its own version", "[particle_set]")
+{
+    using merely3d::DirtyHistory;
+
+    DirtyHistory history;
+    DirtyRanges dirty;
+    REQUIRE(history.latest_version() == 0);
+
+    history.add(0, 10);
+    const auto first = history.latest_version();
+    REQUIRE(first == 1);
+
+    history.add(20, 30);
+    REQUIRE(history.changes_since(first, dirty));
+    REQUIRE(as_pairs(dirty) == Pairs({ {20, 30} }));
+    const auto second = history.latest_version();
+    REQUIRE(second == 2);
+
+    SECTION("A consumer that is up to date sees no changes")
+    {
+        REQUIRE(history.changes_since(second, dirty));
+        REQUIRE(dirty.empty());
+        REQUIRE(history.latest_version() == second);
+    }
+
+    SECTION("A consumer that is behind sees all changes since its version")
+    {
+        REQUIRE(history.changes_since(0, dirty));
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 10}, {20, 30} }));
+
+        // Asking does not consume the changes
+        REQUIRE(history.changes_since(0, dirty));
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 10}, {20, 30} }));
+    }
+
+    SECTION("Truncation applies to all versions")
+    {
+        history.truncate(25);
+        REQUIRE(history.changes_since(0, dirty));
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, 10}, {20, 25} }));
+    }
+
+    SECTION("Changes of versions that are no longer kept are unknown")
+    {
+        const size_t max_versions = DirtyHistory::MAX_VERSIONS;
+        for (size_t i = 0; i < max_versions; ++i)
+        {
+            history.add(i, i + 1);
+            history.latest_version();
+        }
+        REQUIRE_FALSE(history.changes_since(0, dirty));
+        REQUIRE_FALSE(history.changes_since(first, dirty));
+        REQUIRE(history.changes_since(second, dirty));
+        REQUIRE(as_pairs(dirty) == Pairs({ {0, max_versions} }));
+    }
+}
+
+TEST_CASE("Snapshot transfers keep the previous snapshot consistent", "[particle_set]")
+{
+    using merely3d::SnapshotTransfers;
+    using merely3d::plan_snapshot_transfers;
+
+    SnapshotTransfers transfers;
+    DirtyRanges changed;
+    DirtyRanges modified;
+    DirtyRanges replaced;
+    changed.add(2, 4);
+
+    SECTION("Uploading everything leaves no previous snapshot")
+    {
+        plan_snapshot_transfers(true, changed, modified, replaced, 10, 12, transfers);
+        REQUIRE(transfers.copy_before_upload.empty());
+        REQUIRE(as_pairs(transfers.upload) == Pairs({ {0, 12} }));
+        REQUIRE(as_pairs(transfers.copy_after_upload) == Pairs({ {0, 12} }));
+    }
+
+    SECTION("Unmodified sets keep their snapshots")
+    {
+        plan_snapshot_transfers(false, changed, modified, replaced, 10, 10, transfers);
+        REQUIRE(transfers.copy_before_upload.empty());
+        REQUIRE(transfers.upload.empty());
+        REQUIRE(transfers.copy_after_upload.empty());
+    }
+
+    SECTION("Modified particles start a new snapshot")
+    {
+        modified.add(5, 6);
+        plan_snapshot_transfers(false, changed, modified, replaced, 10, 10, transfers);
+        REQUIRE(as_pairs(transfers.copy_before_upload) == Pairs({ {2, 4} }));
+        REQUIRE(as_pairs(transfers.upload) == Pairs({ {5, 6} }));
+        REQUIRE(transfers.copy_after_upload.empty());
+    }
+
+    SECTION("Particles appended within the capacity of the buffer have no previous snapshot")
+    {
+        // As recorded by ParticleSet::resize when growing from 10 to 15 particles
+        modified.add(10, 15);
+        modified.add(0, 1);
+        plan_snapshot_transfers(false, changed, modified, replaced, 10, 15, transfers);
+        REQUIRE(as_pairs(transfers.copy_before_upload) == Pairs({ {2, 4} }));
+        REQUIRE(as_pairs(transfers.upload) == Pairs({ {0, 1}, {10, 15} }));
+        REQUIRE(as_pairs(transfers.copy_after_upload) == Pairs({ {10, 15} }));
+    }
+
+    SECTION("Replaced particles have no previous snapshot")
+    {
+        modified.add(0, 3);
+        replaced.add(1, 3);
+        plan_snapshot_transfers(false, changed, modified, replaced, 10, 10, transfers);
+        REQUIRE(as_pairs(transfers.copy_before_upload) == Pairs({ {2, 4} }));
+        REQUIRE(as_pairs(transfers.upload) == Pairs({ {0, 3} }));
+        REQUIRE(as_pairs(transfers.copy_after_upload) == Pairs({ {1, 3} }));
+    }
+
+    SECTION("Changes beyond a shrunk set are not copied")
+    {
+        changed.add(8, 10);
+        modified.add(0, 1);
+        plan_snapshot_transfers(false, changed, modified, replaced, 10, 6, transfers);
+        REQUIRE(as_pairs(transfers.copy_before_upload) == Pairs({ {2, 4} }));
+        REQUIRE(as_pairs(transfers.upload) == Pairs({ {0, 1} }));
+        REQUIRE(transfers.copy_after_upload.empty());
+    }
+}
+
+TEST_CASE("Particles removed and added again before an upload have no previous snapshot", "[particle_set]")
+{
+    using merely3d::DirtyHistory;
+    using merely3d::SnapshotTransfers;
+    using merely3d::plan_snapshot_transfers;
+
+    // A set of 10 particles that has been uploaded
+    DirtyHistory history;
+    history.add(0, 10);
+    const auto uploaded = history.latest_version();
+
+    DirtyRanges modified;
+    DirtyRanges replaced;
+    SnapshotTransfers transfers;
+    size_t min_size = 0;
+
+    SECTION("Shrinking and growing again replaces the particles beyond the smaller size")
+    {
+        // As recorded by ParticleSet::resize(4) and resize(10)
+        history.truncate(4);
+        history.add(4, 10);
+        REQUIRE(history.changes_since(uploaded, modified, min_size));
+        REQUIRE(as_pairs(modified) == Pairs({ {4, 10} }));
+        REQUIRE(min_size == 4);
+
+        replaced.add(min_size, 10);
+        plan_snapshot_transfers(false, DirtyRanges(), modified, replaced, 10, 10, transfers);
+        REQUIRE(as_pairs(transfers.upload) == Pairs({ {4, 10} }));
+        REQUIRE(as_pairs(transfers.copy_after_upload) == Pairs({ {4, 10} }));
+    }
+
+    SECTION("Shrinking alone is seen by every consumer behind it")
+    {
+        history.truncate(6);
+        REQUIRE(history.changes_since(uploaded, modified, min_size));
+        REQUIRE(modified.empty());
+        REQUIRE(min_size == 6);
+
+        // Once uploaded, the truncation is no longer reported
+        const auto shrunk = history.latest_version();
+        history.add(6, 8);
+        REQUIRE(history.changes_since(shrunk, modified, min_size));
+        REQUIRE(as_pairs(modified) == Pairs({ {6, 8} }));
+        REQUIRE(min_size == std::numeric_limits<size_t>::max());
+    }
+
+    SECTION("Modifications without truncation replace nothing")
+    {
+        history.add(2, 3);
+        REQUIRE(history.changes_since(uploaded, modified, min_size));
+        REQUIRE(min_size == std::numeric_limits<size_t>::max());
+    }
+}
@@ -0,0 +1,143 @@
+#include <catch.hpp>
+
+#include <particle_sort.hpp>
+
+#include <algorithm>
+#include <random>
+
+using merely3d::morton_encode;
+using merely3d::radix_sort_by_key;
+using merely3d::ParticleSorter;
+using merely3d::PARTICLE_CHUNK_SIZE;
+
+TEST_CASE("Morton encoding interleaves bits", "[particle_sort]")
+{
+    REQUIRE(morton_encode(0, 0, 0) == 0);
+    REQUIRE(morton_encode(1, 0, 0) == 1);
+    REQUIRE(morton_encode(0, 1, 0) == 2);
+    REQUIRE(morton_encode(0, 0, 1) == 4);
+    REQUIRE(morton_encode(3, 0, 0) == 9);
+    REQUIRE(morton_encode(1023, 1023, 1023) == (1u << 30) - 1);
+
+    // Only the lower 10 bits are used
+    REQUIRE(morton_encode(1024, 0, 0) == 0);
+}
+
+TEST_CASE("Radix sort by key", "[particle_sort]")
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint32_t> distribution(0, (1u << 30) - 1);
+
+    for (unsigned int num_threads : { 1u, 3u, 8u })
+    {
+        SECTION("Threads: " + std::to_string(num_threads))
+        {
+            std::vector<uint32_t> keys(10000);
+            std::vector<uint32_t> values(keys.size());
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                // Use a small key range for half the keys to make sure there are duplicates
+                keys[i] = i % 2 == 0 ? distribution(rng) : distribution(rng) % 16;
+                values[i] = static_cast<uint32_t>(i);
+            }
+
+            std::vector<std::pair<uint32_t, uint32_t>> expected;
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                expected.emplace_back(keys[i], values[i]);
+            }
+            std::stable_sort(expected.begin(), expected.end(),
+                             [] (const std::pair<uint32_t, uint32_t> & a, const std::pair<uint32_t, uint32_t> & b)
+                             {
+                                 return a.first < b.first;
+                             });
+
+            std::vector<uint32_t> key_scratch, value_scratch;
+            radix_sort_by_key(keys, values, key_scratch, value_scratch, 30, num_threads);
+
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                REQUIRE(keys[i] == expected[i].first);
+                REQUIRE(values[i] == expected[i].second);
+            }
+        }
+    }
+}
+
+TEST_CASE("Particle sorter chunks", "[particle_sort]")
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+
+    const size_t num_particles = 3 * PARTICLE_CHUNK_SIZE + 17;
+    std::vector<float> records;
+    for (size_t i = 0; i < num_particles; ++i)
+    {
+        // Position, color, radius
+        records.insert(records.end(), { distribution(rng), distribution(rng), distribution(rng) });
+        records.insert(records.end(), { 0.5f, 0.5f, static_cast<float>(i) });
+        records.push_back(0.1f);
+    }
+
+    ParticleSorter sorter;
+    sorter.sort(records, 7, 6);
+
+    const auto & sorted = sorter.sorted_records();
+    const auto & chunks = sorter.chunks();
+    REQUIRE(sorted.size() == records.size());
+    REQUIRE(chunks.size() == 4);
+
+    SECTION("Sorting is a permutation of the records")
+    {
+        // The third color component holds the original index of the particle
+        std::vector<bool> seen(num_particles, false);
+        for (size_t i = 0; i < num_particles; ++i)
+        {
+            const auto original = static_cast<size_t>(sorted[7 * i + 5]);
+            REQUIRE(!seen[original]);
+            seen[original] = true;
+            REQUIRE(std::equal(&sorted[7 * i], &sorted[7 * i + 7], &records[7 * original]));
+        }
+    }
+
+    SECTION("Chunks cover all particles and bound their spheres")
+    {
+        size_t next = 0;
+        for (const auto & chunk : chunks)
+        {
+            REQUIRE(chunk.first == next);
+            REQUIRE(chunk.changed);
+            next += chunk.count;
+
+            for (size_t i = chunk.first; i < chunk.first + chunk.count; ++i)
+            {
+                const Eigen::Vector3f p(sorted[7 * i], sorted[7 * i + 1], sorted[7 * i + 2]);
+                REQUIRE(chunk.bounds.contains(p + Eigen::Vector3f::Constant(0.1f)));
+                REQUIRE(chunk.bounds.contains(p - Eigen::Vector3f::Constant(0.1f)));
+            }
+        }
+        REQUIRE(next == num_particles);
+    }
+
+    SECTION("Only modified chunks are reported as changed")
+    {
+        sorter.sort(records, 7, 6);
+        for (const auto & chunk : sorter.chunks())
+        {
+            REQUIRE(!chunk.changed);
+        }
+
+        // Changing the color of a particle does not affect its position in the sorted order
+        const auto original = static_cast<size_t>(sorted[7 * 5 + 5]);
+        records[7 * original + 3] = 1.0f;
+        sorter.sort(records, 7, 6);
+        REQUIRE(sorter.chunks()[0].changed);
+        REQUIRE(!sorter.chunks()[1].changed);
+        REQUIRE(!sorter.chunks()[2].changed);
+        REQUIRE(!sorter.chunks()[3].changed);
+
+        sorter.invalidate();
+        sorter.sort(records, 7, 6);
+        REQUIRE(sorter.chunks()[2].changed);
+    }
+}
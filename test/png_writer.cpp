@@ -0,0 +1,162 @@
+#include <catch.hpp>
+
+#include <png_writer.hpp>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using merely3d::PngWriter;
+using merely3d::adler32;
+using merely3d::crc32;
+using merely3d::rgba_to_rgb_top_down;
+
+namespace
+{
+    const unsigned char * bytes_of(const std::string & s)
+    {
+        return reinterpret_cast<const unsigned char *>(s.data());
+    }
+
+    uint32_t read_big_endian(const std::string & s, size_t offset)
+    {
+        const auto b = bytes_of(s) + offset;
+        return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+    }
+
+    struct Chunk
+    {
+        std::string type;
+        std::string data;
+    };
+
+    /// Splits a PNG file into its chunks, checking their CRCs.
+    std::vector<Chunk> read_chunks(const std::string & png)
+    {
+        std::vector<Chunk> chunks;
+        size_t offset = 8;
+        while (offset < png.size())
+        {
+            const auto length = read_big_endian(png, offset);
+            Chunk chunk { png.substr(offset + 4, 4), png.substr(offset + 8, length) };
+            REQUIRE(read_big_endian(png, offset + 8 + length) == crc32(bytes_of(png) + offset + 4, length + 4));
+            chunks.push_back(chunk);
+            offset += 12 + length;
+        }
+        REQUIRE(offset == png.size());
+        return chunks;
+    }
+
+    /// Decodes a zlib stream consisting of stored deflate blocks only, checking its checksum.
+    std::string inflate_stored(const std::string & stream)
+    {
+        REQUIRE(stream.size() >= 6);
+        REQUIRE((uint32_t(bytes_of(stream)[0]) * 256 + bytes_of(stream)[1]) % 31 == 0);
+
+        std::string data;
+        size_t offset = 2;
+        bool final_block = false;
+        while (!final_block)
+        {
+            const auto b = bytes_of(stream) + offset;
+            final_block = (b[0] & 1) != 0;
+            REQUIRE((b[0] >> 1) == 0);
+            const size_t length = b[1] | (size_t(b[2]) << 8);
+            const size_t inverted = b[3] | (size_t(b[4]) << 8);
+            REQUIRE((length ^ inverted) == 0xffff);
+            data += stream.substr(offset + 5, length);
+            offset += 5 + length;
+        }
+        REQUIRE(offset + 4 == stream.size());
+        REQUIRE(read_big_endian(stream, offset) == adler32(bytes_of(data), data.size()));
+        return data;
+    }
+}
+
+TEST_CASE("CRC-32 and Adler-32 checksums", "[png_writer]")
+{
+    const std::string check = "123456789";
+    REQUIRE(crc32(bytes_of(check), check.size()) == 0xcbf43926u);
+    REQUIRE(crc32(nullptr, 0) == 0);
+
+    const std::string wikipedia = "Wikipedia";
+    REQUIRE(adler32(bytes_of(wikipedia), wikipedia.size()) == 0x11e60398u);
+    REQUIRE(adler32(nullptr, 0) == 1);
+
+    // Checksums may be computed piecewise
+    REQUIRE(crc32(bytes_of(check) + 4, 5, crc32(bytes_of(check), 4)) == 0xcbf43926u);
+    REQUIRE(adler32(bytes_of(wikipedia) + 3, 6, adler32(bytes_of(wikipedia), 3)) == 0x11e60398u);
+
+    // Long runs of large bytes must not overflow the sums
+    const std::vector<unsigned char> ones(100000, 0xff);
+    uint32_t a = 1, b = 0;
+    for (const auto byte : ones)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    REQUIRE(adler32(ones.data(), ones.size()) == ((b << 16) | a));
+}
+
+TEST_CASE("PNG writer writes a valid uncompressed PNG", "[png_writer]")
+{
+    // Rows spanning several deflate blocks, which hold at most 65535 bytes each
+    const int width = 100;
+    const int height = 300;
+    std::vector<unsigned char> rgb(3 * width * height);
+    for (size_t i = 0; i < rgb.size(); ++i)
+    {
+        rgb[i] = static_cast<unsigned char>(i * 7);
+    }
+
+    std::ostringstream out;
+    PngWriter writer(out, width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        writer.write_row(rgb.data() + 3 * width * y);
+    }
+    writer.finish();
+    const auto png = out.str();
+
+    REQUIRE(png.substr(0, 8) == std::string("\x89PNG\r\n\x1a\n", 8));
+    const auto chunks = read_chunks(png);
+    REQUIRE(chunks.size() >= 4);
+    REQUIRE(chunks.front().type == "IHDR");
+    REQUIRE(chunks.back().type == "IEND");
+    REQUIRE(chunks.back().data.empty());
+
+    const auto & header = chunks.front().data;
+    REQUIRE(read_big_endian(header, 0) == uint32_t(width));
+    REQUIRE(read_big_endian(header, 4) == uint32_t(height));
+    REQUIRE(header.substr(8) == std::string("\x08\x02\x00\x00\x00", 5));
+
+    std::string stream;
+    for (size_t i = 1; i + 1 < chunks.size(); ++i)
+    {
+        REQUIRE(chunks[i].type == "IDAT");
+        stream += chunks[i].data;
+    }
+
+    std::string expected;
+    for (int y = 0; y < height; ++y)
+    {
+        expected += '\0';
+        expected.append(reinterpret_cast<const char *>(rgb.data()) + 3 * width * y, 3 * width);
+    }
+    REQUIRE(inflate_stored(stream) == expected);
+}
+
+TEST_CASE("RGBA pixels are converted to top-down RGB", "[png_writer]")
+{
+    // Two rows of two pixels, bottom row first
+    const std::vector<unsigned char> rgba = {
+        1, 2, 3, 255,       4, 5, 6, 255,
+        7, 8, 9, 255,       10, 11, 12, 255
+    };
+    std::vector<unsigned char> rgb(12);
+    rgba_to_rgb_top_down(rgba.data(), 2, 2, rgb.data());
+
+    const std::vector<unsigned char> expected = { 7, 8, 9, 10, 11, 12, 1, 2, 3, 4, 5, 6 };
+    REQUIRE(rgb == expected);
+}
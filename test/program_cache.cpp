@@ -0,0 +1,28 @@
+#include <catch.hpp>
+
+#include <program_cache.hpp>
+
+using merely3d::fnv1a_hash;
+using merely3d::program_cache_file_name;
+
+TEST_CASE("FNV-1a hash", "[program_cache]")
+{
+    REQUIRE(fnv1a_hash("") == 14695981039346656037ull);
+    REQUIRE(fnv1a_hash("a") == 0xaf63dc4c8601ec8cull);
+    REQUIRE(fnv1a_hash("foobar") == 0x85944171f73967e8ull);
+}
+
+TEST_CASE("Program cache file names depend on driver and sources", "[program_cache]")
+{
+    const auto name = program_cache_file_name("vendor\nrenderer\nversion", "vertex", "fragment", "");
+    REQUIRE(name.size() == 20);
+    REQUIRE(name.substr(16) == ".bin");
+    REQUIRE(name == program_cache_file_name("vendor\nrenderer\nversion", "vertex", "fragment", ""));
+
+    REQUIRE(name != program_cache_file_name("vendor\nrenderer\nversion 2", "vertex", "fragment", ""));
+    REQUIRE(name != program_cache_file_name("vendor\nrenderer\nversion", "vertex ", "fragment", ""));
+    REQUIRE(name != program_cache_file_name("vendor\nrenderer\nversion", "vertex", "fragment", "geometry"));
+
+    // Text moved from one source to another changes the name
+    REQUIRE(name != program_cache_file_name("vendor\nrenderer\nversion", "vertexf", "ragment", ""));
+}
@@ -0,0 +1,61 @@
+#include <catch.hpp>
+
+#include <range_allocator.hpp>
+
+using merely3d::RangeAllocator;
+using merely3d::NO_FREE_RANGE;
+
+TEST_CASE("Range allocator allocates first fit", "[range_allocator]")
+{
+    RangeAllocator allocator(10);
+    REQUIRE(allocator.capacity() == 10);
+    REQUIRE(allocator.used() == 0);
+
+    REQUIRE(allocator.allocate(4) == 0);
+    REQUIRE(allocator.allocate(3) == 4);
+    REQUIRE(allocator.used() == 7);
+    REQUIRE(allocator.allocate(4) == NO_FREE_RANGE);
+    REQUIRE(allocator.allocate(3) == 7);
+    REQUIRE(allocator.allocate(1) == NO_FREE_RANGE);
+
+    // Empty ranges never need any space
+    REQUIRE(allocator.allocate(0) == 0);
+    REQUIRE(allocator.used() == 10);
+}
+
+TEST_CASE("Range allocator merges adjacent free ranges", "[range_allocator]")
+{
+    RangeAllocator allocator(9);
+    const auto a = allocator.allocate(3);
+    const auto b = allocator.allocate(3);
+    const auto c = allocator.allocate(3);
+    REQUIRE(allocator.free_range_count() == 0);
+
+    allocator.free(a, 3);
+    allocator.free(c, 3);
+    REQUIRE(allocator.free_range_count() == 2);
+    REQUIRE(allocator.allocate(6) == NO_FREE_RANGE);
+
+    allocator.free(b, 3);
+    REQUIRE(allocator.free_range_count() == 1);
+    REQUIRE(allocator.used() == 0);
+    REQUIRE(allocator.allocate(9) == 0);
+}
+
+TEST_CASE("Range allocator grows at the end", "[range_allocator]")
+{
+    RangeAllocator allocator(4);
+    REQUIRE(allocator.allocate(2) == 0);
+    REQUIRE(allocator.allocate(4) == NO_FREE_RANGE);
+
+    // The added space is merged with the free space at the end
+    allocator.grow(8);
+    REQUIRE(allocator.capacity() == 8);
+    REQUIRE(allocator.free_range_count() == 1);
+    REQUIRE(allocator.allocate(4) == 2);
+
+    allocator.reset(5);
+    REQUIRE(allocator.capacity() == 5);
+    REQUIRE(allocator.used() == 0);
+    REQUIRE(allocator.allocate(5) == 0);
+}
@@ -0,0 +1,266 @@
+#include <catch.hpp>
+
+#include <merely3d/scene.hpp>
+#include <scene_data.hpp>
+#include <static_batch.hpp>
+
+#include <stdexcept>
+
+using merely3d::Scene;
+using merely3d::SceneHandle;
+using merely3d::NodeHandle;
+using merely3d::Box;
+using merely3d::Sphere;
+using merely3d::Material;
+using merely3d::renderable;
+using merely3d::detail::SceneData;
+using merely3d::detail::SceneShape;
+
+namespace
+{
+    size_t group_size(SceneData & data, SceneShape shape)
+    {
+        for (const auto & pair : data.groups())
+        {
+            if (pair.second.shape == shape)
+            {
+                return pair.second.size();
+            }
+        }
+        return 0;
+    }
+}
+
+TEST_CASE("Scene handles", "[scene]")
+{
+    Scene scene;
+    REQUIRE(scene.size() == 0);
+    REQUIRE(!scene.contains(SceneHandle()));
+
+    const auto box = scene.add(renderable(Box(1.0f, 2.0f, 3.0f)));
+    const auto sphere = scene.add(renderable(Sphere(1.0f)));
+    REQUIRE(box != sphere);
+    REQUIRE(scene.contains(box));
+    REQUIRE(scene.contains(sphere));
+    REQUIRE(scene.size() == 2);
+
+    scene.remove(box);
+    REQUIRE(!scene.contains(box));
+    REQUIRE(scene.contains(sphere));
+    REQUIRE(scene.size() == 1);
+
+    SECTION("Handles of removed objects are not reused")
+    {
+        const auto other = scene.add(renderable(Box(1.0f, 1.0f, 1.0f)));
+        REQUIRE(other != box);
+        REQUIRE(scene.contains(other));
+        REQUIRE(!scene.contains(box));
+    }
+
+    SECTION("Invalid handles throw")
+    {
+        REQUIRE_THROWS_AS(scene.remove(box), std::invalid_argument);
+        REQUIRE_THROWS_AS(scene.set_transform(box, Eigen::Vector3f::Zero(), Eigen::Quaternionf::Identity()),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(scene.set_material(SceneHandle(), Material()), std::invalid_argument);
+    }
+
+    SECTION("Clear")
+    {
+        scene.clear();
+        REQUIRE(scene.size() == 0);
+        REQUIRE(!scene.contains(sphere));
+    }
+}
+
+TEST_CASE("Scene groups track modified instances", "[scene]")
+{
+    SceneData data;
+    const auto unit = Eigen::Vector3f(1.0f, 1.0f, 1.0f);
+    const auto identity = Eigen::Quaternionf::Identity();
+
+    SceneHandle handles[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        handles[i] = data.add(SceneShape::Box, nullptr, merely3d::NodeHandle(), Eigen::Vector3f(i, 0.0f, 0.0f), identity,
+                              unit, unit, Material());
+    }
+    REQUIRE(group_size(data, SceneShape::Box) == 3);
+
+    auto & group = data.groups().begin()->second;
+    REQUIRE(group.dirty.ranges().size() == 1);
+    REQUIRE(group.replaced.ranges().size() == 1);
+
+    // As the renderer does once the group has been uploaded
+    group.dirty.clear();
+    group.replaced.clear();
+
+    SECTION("Transforms are written in place")
+    {
+        data.set_transform(handles[1], Eigen::Vector3f(5.0f, 6.0f, 7.0f), identity);
+        REQUIRE(group.dirty.ranges().size() == 1);
+        REQUIRE(group.dirty.ranges()[0].begin == 1);
+        REQUIRE(group.dirty.ranges()[0].end == 2);
+        REQUIRE(group.instances[merely3d::FLOATS_PER_INSTANCE + 1] == 6.0f);
+        REQUIRE(group.replaced.empty());
+    }
+
+    SECTION("Removal moves the last instance into the gap")
+    {
+        data.remove(handles[0]);
+        REQUIRE(group.size() == 2);
+        REQUIRE(group.instances[0] == 2.0f);
+        REQUIRE(group.dirty.ranges().size() == 1);
+        REQUIRE(group.dirty.ranges()[0].begin == 0);
+        REQUIRE(group.dirty.ranges()[0].end == 1);
+
+        // The moved object must still be addressable through its handle
+        data.set_transform(handles[2], Eigen::Vector3f(9.0f, 0.0f, 0.0f), identity);
+        REQUIRE(group.instances[0] == 9.0f);
+    }
+
+    SECTION("Removal before rendering replaces the moved instance")
+    {
+        data.remove(handles[0]);
+        REQUIRE(group.replaced.ranges().size() == 1);
+        REQUIRE(group.replaced.ranges()[0].begin == 0);
+        REQUIRE(group.replaced.ranges()[0].end == 1);
+
+        // The moved instance must not be blended in from the transform of the removed object
+        merely3d::SnapshotTransfers transfers;
+        merely3d::plan_snapshot_transfers(false, merely3d::DirtyRanges(), group.dirty, group.replaced,
+                                          3, group.size(), transfers);
+        REQUIRE(transfers.copy_after_upload.ranges().size() == 1);
+        REQUIRE(transfers.copy_after_upload.ranges()[0].begin == 0);
+        REQUIRE(transfers.copy_after_upload.ranges()[0].end == 1);
+    }
+
+    SECTION("Removing the last instance replaces nothing")
+    {
+        data.remove(handles[2]);
+        REQUIRE(group.size() == 2);
+        REQUIRE(group.replaced.empty());
+    }
+
+    SECTION("Removal and addition before rendering replace both instances, although the size is unchanged")
+    {
+        data.remove(handles[0]);
+        data.add(SceneShape::Box, nullptr, merely3d::NodeHandle(), Eigen::Vector3f(7.0f, 0.0f, 0.0f), identity,
+                 unit, unit, Material());
+        REQUIRE(group.size() == 3);
+
+        merely3d::SnapshotTransfers transfers;
+        merely3d::plan_snapshot_transfers(false, merely3d::DirtyRanges(), group.dirty, group.replaced,
+                                          3, group.size(), transfers);
+        const auto & copied = transfers.copy_after_upload.ranges();
+        REQUIRE(copied.size() == 2);
+        REQUIRE(copied[0].begin == 0);
+        REQUIRE(copied[0].end == 1);
+        REQUIRE(copied[1].begin == 2);
+        REQUIRE(copied[1].end == 3);
+    }
+
+    SECTION("Changing to wireframe keeps the object in its group")
+    {
+        // Wireframes are drawn by the same shader as filled geometry, so only the record changes
+        data.set_material(handles[2], Material().with_wireframe(true));
+        REQUIRE(data.groups().size() == 1);
+        REQUIRE(group_size(data, SceneShape::Box) == 3);
+
+        auto & group = data.groups().begin()->second;
+        size_t wireframes = 0;
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            const auto edge_mode = group.instances[merely3d::FLOATS_PER_INSTANCE * i + merely3d::INSTANCE_EDGE_MODE_OFFSET];
+            if (edge_mode == merely3d::EDGE_MODE_WIREFRAME)
+            {
+                ++wireframes;
+                REQUIRE(group.dirty.ranges().size() == 1);
+                REQUIRE(group.dirty.ranges()[0].begin <= i);
+                REQUIRE(group.dirty.ranges()[0].end > i);
+            }
+        }
+        REQUIRE(wireframes == 1);
+    }
+}
+
+TEST_CASE("Scene hierarchy propagates transforms to descendants", "[scene]")
+{
+    SceneData data;
+    const auto unit = Eigen::Vector3f(1.0f, 1.0f, 1.0f);
+    const auto identity = Eigen::Quaternionf::Identity();
+    const auto quarter_turn = Eigen::Quaternionf(Eigen::AngleAxisf(0.5f * 3.14159265f, Eigen::Vector3f::UnitZ()));
+
+    const auto root = data.add_node(Eigen::Vector3f(1.0f, 0.0f, 0.0f), quarter_turn, NodeHandle());
+    const auto child = data.add_node(Eigen::Vector3f(1.0f, 0.0f, 0.0f), identity, root);
+    const auto object = data.add(SceneShape::Sphere, nullptr, child, Eigen::Vector3f(0.0f, 0.0f, 2.0f), identity,
+                                 unit, unit, Material());
+    data.update_transforms();
+
+    const auto & group = data.groups().begin()->second;
+    const auto position = [&] () { return Eigen::Vector3f(group.instances[0], group.instances[1], group.instances[2]); };
+    REQUIRE(position().isApprox(Eigen::Vector3f(1.0f, 1.0f, 2.0f), 1e-5f));
+
+    SECTION("Moving the root moves attached objects of descendants")
+    {
+        data.set_node_transform(root, Eigen::Vector3f(0.0f, 0.0f, 5.0f), identity);
+        data.update_transforms();
+        REQUIRE(position().isApprox(Eigen::Vector3f(1.0f, 0.0f, 7.0f), 1e-5f));
+    }
+
+    SECTION("Object transforms are relative to their node")
+    {
+        data.set_transform(object, Eigen::Vector3f(1.0f, 0.0f, 0.0f), identity);
+        REQUIRE(position().isApprox(Eigen::Vector3f(1.0f, 2.0f, 0.0f), 1e-5f));
+    }
+
+    SECTION("Removing a node removes its subtree")
+    {
+        data.remove_node(root);
+        REQUIRE(!data.contains(root));
+        REQUIRE(!data.contains(child));
+        REQUIRE(!data.contains(object));
+        REQUIRE(data.size() == 0);
+        REQUIRE_THROWS_AS(data.add_node(Eigen::Vector3f::Zero(), identity, child), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Static batches refer to the instance record of each vertex", "[scene]")
+{
+    using merely3d::StaticBatchSource;
+    using merely3d::FLOATS_PER_INSTANCE;
+    using merely3d::FLOATS_PER_BATCH_VERTEX;
+
+    // A single triangle, given by indices into two vertices
+    auto vertices = std::make_shared<const std::vector<float>>(std::vector<float> {
+        0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f
+    });
+    auto faces = std::make_shared<const std::vector<unsigned int>>(std::vector<unsigned int> { 1, 0, 1 });
+
+    StaticBatchSource first;
+    first.vertices_and_normals = vertices;
+    first.faces = faces;
+    first.instances.assign(FLOATS_PER_INSTANCE, 2.0f);
+
+    StaticBatchSource second = first;
+    second.instances.assign(2 * FLOATS_PER_INSTANCE, 1.0f);
+
+    const auto batch = merely3d::build_static_batch({ first, second });
+    REQUIRE(batch.vertex_count == 9);
+    REQUIRE(batch.vertices.size() == 9 * FLOATS_PER_BATCH_VERTEX);
+
+    // Vertices follow the order of the sources, and each vertex is followed by the index of its instance record
+    REQUIRE(batch.vertices[0] == 1.0f);
+    REQUIRE(batch.vertices[FLOATS_PER_BATCH_VERTEX] == 0.0f);
+    REQUIRE(batch.vertices[6] == 0.0f);
+    REQUIRE(batch.vertices[2 * FLOATS_PER_BATCH_VERTEX + 6] == 0.0f);
+    REQUIRE(batch.vertices[3 * FLOATS_PER_BATCH_VERTEX + 6] == 1.0f);
+    REQUIRE(batch.vertices[8 * FLOATS_PER_BATCH_VERTEX + 6] == 2.0f);
+
+    // The records are stored once per instance, in the same order
+    REQUIRE(batch.instances.size() == 3 * FLOATS_PER_INSTANCE);
+    REQUIRE(batch.instances[0] == 2.0f);
+    REQUIRE(batch.instances[FLOATS_PER_INSTANCE] == 1.0f);
+    REQUIRE(batch.instances[3 * FLOATS_PER_INSTANCE - 1] == 1.0f);
+}
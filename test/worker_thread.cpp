@@ -0,0 +1,52 @@
+#include <catch.hpp>
+
+#include <worker_thread.hpp>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using merely3d::WorkerThread;
+
+TEST_CASE("Worker thread runs every task on the same thread", "[worker_thread]")
+{
+    WorkerThread worker;
+
+    std::vector<std::thread::id> ids;
+    for (int i = 0; i < 10; ++i)
+    {
+        worker.start([&ids] { ids.push_back(std::this_thread::get_id()); });
+        worker.wait();
+    }
+
+    REQUIRE(ids.size() == 10);
+    REQUIRE(ids.front() != std::this_thread::get_id());
+    for (const auto & id : ids)
+    {
+        REQUIRE(id == ids.front());
+    }
+}
+
+TEST_CASE("Worker thread rethrows exceptions of its tasks", "[worker_thread]")
+{
+    WorkerThread worker;
+    worker.start([] { throw std::runtime_error("task failed"); });
+    REQUIRE_THROWS_AS(worker.wait(), std::runtime_error);
+
+    // The exception is only rethrown once, and the thread keeps running tasks
+    bool ran = false;
+    worker.start([&ran] { ran = true; });
+    REQUIRE_NOTHROW(worker.wait());
+    REQUIRE(ran);
+}
+
+TEST_CASE("Worker thread completes its task before it is destroyed", "[worker_thread]")
+{
+    bool ran = false;
+    {
+        WorkerThread worker;
+        worker.start([&ran] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); ran = true; });
+    }
+    REQUIRE(ran);
+}